@@ -0,0 +1,63 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// BenchmarkMain.cpp : Headless benchmarks of the OccuRec.Core frame processing. The core sources are compiled
+// directly into this executable, so internal functions can be measured without going through the DLL exports.
+
+#include "stdafx.h"
+#include "SyncLock.h"
+
+#include "BenchmarkUtils.h"
+#include "IntegrationDetectionBenchmark.h"
+#include "GeneratorBenchmark.h"
+#include "KernelBenchmarks.h"
+#include "RecordingBenchmark.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace OccuRecBenchmarks;
+
+static void PrintUsage()
+{
+	printf("Usage: OccuRec.Core.Benchmarks <benchmark> [options]\n\n");
+	PrintIntegrationDetectionBenchmarkUsage();
+	printf("\n");
+	PrintGeneratorBenchmarkUsage();
+	printf("\n");
+	PrintKernelBenchmarksUsage();
+	printf("\n");
+	PrintRecordingBenchmarkUsage();
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return BENCHMARK_EXIT_USAGE;
+	}
+
+	SyncLock::Initialise();
+
+	int rv;
+
+	if (strcmp(argv[1], "detection") == 0)
+		rv = RunIntegrationDetectionBenchmark(argc, argv);
+	else if (strcmp(argv[1], "generator") == 0)
+		rv = RunGeneratorBenchmark(argc, argv);
+	else if (strcmp(argv[1], "kernels") == 0)
+		rv = RunKernelBenchmarks(argc, argv);
+	else if (strcmp(argv[1], "recording") == 0)
+		rv = RunRecordingBenchmark(argc, argv);
+	else
+	{
+		PrintUsage();
+		rv = BENCHMARK_EXIT_USAGE;
+	}
+
+	SyncLock::Uninitialise();
+
+	return rv;
+}
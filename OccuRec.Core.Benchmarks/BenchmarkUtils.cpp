@@ -0,0 +1,89 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "BenchmarkUtils.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.h"
+
+namespace OccuRecBenchmarks
+{
+
+HighResolutionTimer::HighResolutionTimer()
+{
+	Start();
+}
+
+void HighResolutionTimer::Start()
+{
+	m_StartTicks = Ticks();
+}
+
+double HighResolutionTimer::ElapsedSeconds()
+{
+	return (double)(Ticks() - m_StartTicks) / TicksPerSecond();
+}
+
+long long HighResolutionTimer::Ticks()
+{
+	return PlatformPerformanceCounter();
+}
+
+long long HighResolutionTimer::TicksPerSecond()
+{
+	return PlatformPerformanceFrequency();
+}
+
+void SleepMilliseconds(long milliseconds)
+{
+	PlatformSleep(milliseconds);
+}
+
+BenchmarkArgs::BenchmarkArgs(int argc, char** argv, int firstArg)
+{
+	for (int i = firstArg; i < argc; i++)
+	{
+		if (strncmp(argv[i], "--", 2) != 0)
+			continue;
+
+		string name(argv[i] + 2);
+
+		if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0)
+		{
+			m_Values[name] = string(argv[i + 1]);
+			i++;
+		}
+		else
+			m_Values[name] = string("");
+	}
+}
+
+bool BenchmarkArgs::Has(const char* name)
+{
+	return m_Values.find(string(name)) != m_Values.end();
+}
+
+const char* BenchmarkArgs::GetString(const char* name, const char* defaultValue)
+{
+	map<string, string>::iterator it = m_Values.find(string(name));
+	if (it == m_Values.end() || it->second.empty())
+		return defaultValue;
+
+	return it->second.c_str();
+}
+
+long BenchmarkArgs::GetLong(const char* name, long defaultValue)
+{
+	const char* value = GetString(name, NULL);
+	return NULL != value ? atol(value) : defaultValue;
+}
+
+double BenchmarkArgs::GetDouble(const char* name, double defaultValue)
+{
+	const char* value = GetString(name, NULL);
+	return NULL != value ? atof(value) : defaultValue;
+}
+
+}
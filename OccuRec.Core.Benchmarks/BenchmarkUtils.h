@@ -0,0 +1,55 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef BENCHMARK_UTILS_H
+#define BENCHMARK_UTILS_H
+
+#include <map>
+#include <string>
+
+using namespace std;
+
+namespace OccuRecBenchmarks
+{
+
+#define BENCHMARK_EXIT_OK 0
+#define BENCHMARK_EXIT_GATE_FAILED 1
+#define BENCHMARK_EXIT_USAGE 2
+
+class HighResolutionTimer
+{
+	private:
+		long long m_StartTicks;
+
+	public:
+		HighResolutionTimer();
+
+		void Start();
+		double ElapsedSeconds();
+
+		static long long Ticks();
+		static long long TicksPerSecond();
+};
+
+// Yields the CPU for about the given time. The actual sleep can be longer, depending on the OS timer resolution
+void SleepMilliseconds(long milliseconds);
+
+// Parses "--name value" and "--flag" style command line arguments
+class BenchmarkArgs
+{
+	private:
+		map<string, string> m_Values;
+
+	public:
+		BenchmarkArgs(int argc, char** argv, int firstArg);
+
+		bool Has(const char* name);
+		const char* GetString(const char* name, const char* defaultValue);
+		long GetLong(const char* name, long defaultValue);
+		double GetDouble(const char* name, double defaultValue);
+};
+
+}
+
+#endif // BENCHMARK_UTILS_H
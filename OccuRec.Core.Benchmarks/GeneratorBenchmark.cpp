@@ -0,0 +1,178 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+
+#include "GeneratorBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "SyntheticVideo.h"
+#include "SyntheticFrameFeeder.h"
+#include "OcrConfiguration.h"
+#include "IotaVtiRenderer.h"
+
+#include "OccuRec.Core.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace OccuRecBenchmarks
+{
+
+#define DEFAULT_OCR_SETTINGS_FILE "OccuRec/OCR-Settings.xml"
+#define DEFAULT_PAL_VTI_CONFIG "Compatible EasyCap + IOTA-VTI (NON TV-Safe, PAL)"
+#define DEFAULT_NTSC_VTI_CONFIG "IOTA-VTI NON-TVSAFE (NTSC)"
+
+void PrintGeneratorBenchmarkUsage()
+{
+	printf("generator [options]\n");
+	printf("  Feeds synthetic frames with IOTA-VTI timestamps through ProcessVideoFrame().\n");
+	printf("    --standard pal|ntsc    Video standard (default: pal)\n");
+	printf("    --rate N               Integration rate in frames (default: 4)\n");
+	printf("    --frames N             Frames to feed (default: 1000)\n");
+	printf("    --fps F                Frame rate to feed the frames at (default: the video standard rate)\n");
+	printf("    --max                  Feed the frames as fast as possible\n");
+	printf("    --api bmp|pixels       ProcessVideoFrame() with a bitmap or ProcessVideoFrame2() with pixels (default: bmp)\n");
+	printf("    --dropouts P           Probability for a frame to be dropped by the capture (default: 0)\n");
+	printf("    --stars N --passing N  Number of stars and of objects crossing the field\n");
+	printf("    --video-noise S        Analog video noise sigma (default: 1.5)\n");
+	printf("    --seed S               Seed of the synthetic video (default: 1)\n");
+	printf("    --ocr-settings FILE    OCR settings with the character shapes (default: %s)\n", DEFAULT_OCR_SETTINGS_FILE);
+	printf("    --vti-config NAME      OCR configuration to render and recognize (default: the NON TV-Safe one of the standard)\n");
+	printf("    --no-vti               Do not render timestamps and do not run the OCR\n");
+	printf("    --raw-out FILE --truth-out FILE\n");
+	printf("                           Save the frames and the integration boundaries for 'detection --raw --truth'\n");
+	printf("    --max-ocr-errors N --min-fps F\n");
+	printf("                           Fail with exit code %d when the run does not meet the limits\n", BENCHMARK_EXIT_GATE_FAILED);
+}
+
+int RunGeneratorBenchmark(int argc, char** argv)
+{
+	BenchmarkArgs args(argc, argv, 2);
+
+	SyntheticVideoStandard standard = strcmp(args.GetString("standard", "pal"), "ntsc") == 0 ? SyntheticNtsc : SyntheticPal;
+	long integrationRate = args.GetLong("rate", 4);
+
+	SyntheticVideoConfig videoConfig;
+	InitSyntheticVideoConfig(&videoConfig, standard, integrationRate);
+	videoConfig.NumberOfStars = args.GetLong("stars", videoConfig.NumberOfStars);
+	videoConfig.NumberOfPassingStars = args.GetLong("passing", 0);
+	videoConfig.VideoNoiseSigma = (float)args.GetDouble("video-noise", videoConfig.VideoNoiseSigma);
+	videoConfig.DroppedFrameProbability = (float)args.GetDouble("dropouts", 0);
+	videoConfig.Seed = (unsigned int)args.GetLong("seed", 1);
+	videoConfig.IntegrationPhase = videoConfig.Seed % (integrationRate > 0 ? integrationRate : 1);
+
+	SyntheticFeederConfig feederConfig;
+	feederConfig.Frames = args.GetLong("frames", 1000);
+	feederConfig.TargetFps = args.Has("max") ? 0 : args.GetDouble("fps", videoConfig.FrameRate);
+	feederConfig.UsePixelsApi = strcmp(args.GetString("api", "bmp"), "pixels") == 0;
+	feederConfig.RawFile = NULL;
+	feederConfig.TruthFile = NULL;
+
+	if (integrationRate < 1 || feederConfig.Frames < 1)
+	{
+		PrintGeneratorBenchmarkUsage();
+		return BENCHMARK_EXIT_USAGE;
+	}
+
+	bool useVti = !args.Has("no-vti");
+	OcrConfiguration ocrConfig;
+	IotaVtiRenderer* vtiRenderer = NULL;
+
+	if (useVti)
+	{
+		const char* settingsFile = args.GetString("ocr-settings", DEFAULT_OCR_SETTINGS_FILE);
+		const char* configName = args.GetString("vti-config", standard == SyntheticNtsc ? DEFAULT_NTSC_VTI_CONFIG : DEFAULT_PAL_VTI_CONFIG);
+
+		if (!LoadOcrConfiguration(settingsFile, configName, &ocrConfig))
+		{
+			fprintf(stderr, "Cannot load OCR configuration '%s' from '%s'\n", configName, settingsFile);
+			return BENCHMARK_EXIT_USAGE;
+		}
+
+		if (ocrConfig.Width != videoConfig.Width || ocrConfig.Height != videoConfig.Height)
+		{
+			fprintf(stderr, "OCR configuration '%s' is for %ldx%ld frames\n", ocrConfig.Name.c_str(), ocrConfig.Width, ocrConfig.Height);
+			return BENCHMARK_EXIT_USAGE;
+		}
+
+		vtiRenderer = new IotaVtiRenderer(ocrConfig);
+	}
+
+	SyntheticVideo* video = new SyntheticVideo(videoConfig);
+	if (NULL != vtiRenderer)
+		video->AttachVtiRenderer(vtiRenderer);
+
+	// Frames are processed synchronously. The buffered mode needs the frame processing thread started by the DLL
+	SetupCamera(videoConfig.Width, videoConfig.Height, (LPCTSTR)"Synthetic", 0, false, false, true);
+	SetupAav(4, 0, 8, 0, 0, (LPCTSTR)"Benchmarks", 0, 0);
+	SetupIntegrationDetection(5, 0.3f, 1);
+
+	int rv = BENCHMARK_EXIT_OK;
+
+	if (NULL != vtiRenderer && !SetupCoreOcr(ocrConfig, vtiRenderer->ZoneMatrix()))
+	{
+		fprintf(stderr, "Cannot set up the OCR\n");
+		rv = BENCHMARK_EXIT_USAGE;
+	}
+
+	if (args.Has("raw-out"))
+		feederConfig.RawFile = fopen(args.GetString("raw-out", ""), "wb");
+	if (args.Has("truth-out"))
+		feederConfig.TruthFile = fopen(args.GetString("truth-out", ""), "w");
+
+	if (rv == BENCHMARK_EXIT_OK)
+	{
+		SyntheticFeederResults results;
+		FeedSyntheticFrames(video, feederConfig, &results);
+
+		printf("\n%s %ldx%ld x%ld: %ld frames via %s",
+			standard == SyntheticNtsc ? "NTSC" : "PAL", videoConfig.Width, videoConfig.Height, integrationRate,
+			results.FramesFed, feederConfig.UsePixelsApi ? "ProcessVideoFrame2" : "ProcessVideoFrame");
+		if (feederConfig.TargetFps > 0)
+			printf(" at %.3f fps\n", feederConfig.TargetFps);
+		else
+			printf(" at the maximum rate\n");
+
+		printf("  Achieved rate                 : %8.2f fps (%ld late frames)\n", results.AchievedFps, results.LateFrames);
+		printf("  ProcessVideoFrame             : %8.3f us/frame (p99 %.3f us, max %.3f us)\n", results.ProcessMeanUs, results.ProcessP99Us, results.ProcessMaxUs);
+		printf("  Integration periods           : %ld generated, %ld integrated frames reported, detected rate %ld\n", results.IntegrationPeriods, results.IntegratedFrames, results.DetectedIntegrationRate);
+		printf("  Dropped frames                : %ld\n", results.DroppedFrames);
+
+		if (NULL != vtiRenderer)
+			printf("  OCR                           : %s, %ld frames checked, %ld timestamp mismatches, %ld OCR errors\n",
+				results.OcrWorking ? "working" : "NOT working", results.OcrCheckedFrames, results.OcrMismatchedFrames, results.OcrErrors);
+
+		// Regression gates
+		long maxOcrErrors = args.GetLong("max-ocr-errors", -1);
+		double minFps = args.GetDouble("min-fps", 0);
+
+		if (NULL != vtiRenderer && maxOcrErrors >= 0)
+		{
+			long totalErrors = results.OcrErrors + results.OcrMismatchedFrames;
+			if (!results.OcrWorking || totalErrors > maxOcrErrors)
+			{
+				printf("  FAILED: %ld OCR errors and mismatches, more than %ld\n", totalErrors, maxOcrErrors);
+				rv = BENCHMARK_EXIT_GATE_FAILED;
+			}
+		}
+		if (results.AchievedFps < minFps)
+		{
+			printf("  FAILED: achieved %.2f fps, less than %.2f\n", results.AchievedFps, minFps);
+			rv = BENCHMARK_EXIT_GATE_FAILED;
+		}
+	}
+
+	if (NULL != feederConfig.RawFile)
+		fclose(feederConfig.RawFile);
+	if (NULL != feederConfig.TruthFile)
+		fclose(feederConfig.TruthFile);
+
+	delete video;
+	if (NULL != vtiRenderer)
+		delete vtiRenderer;
+
+	return rv;
+}
+
+}
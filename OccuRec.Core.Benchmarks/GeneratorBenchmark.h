@@ -0,0 +1,19 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef GENERATOR_BENCHMARK_H
+#define GENERATOR_BENCHMARK_H
+
+namespace OccuRecBenchmarks
+{
+
+// Feeds synthetic PAL/NTSC frames with IOTA-VTI timestamps through ProcessVideoFrame() at a controlled rate and
+// reports the achieved frame rate, the per-frame processing cost and the correctness of the OCR-ed timestamps
+int RunGeneratorBenchmark(int argc, char** argv);
+
+void PrintGeneratorBenchmarkUsage();
+
+}
+
+#endif // GENERATOR_BENCHMARK_H
@@ -0,0 +1,560 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+
+#include "IntegrationDetectionBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "SyntheticVideo.h"
+
+#include "OccuRec.Core.h"
+#include "OccuRec.IntegrationChecker.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+using namespace std;
+
+namespace OccuRecBenchmarks
+{
+
+struct DetectionScenario
+{
+	const char* Name;
+	long IntegrationRate;
+	float SceneNoiseSigma;
+	float VideoNoiseSigma;
+	float GainJumpProbability;
+	long NumberOfPassingStars;
+};
+
+// The default set of synthetic sequences. Each one stresses a different part of the detection
+static DetectionScenario DETECTION_SCENARIOS[] =
+{
+	{ "x4",           4, 4.0f, 1.5f, 0.0f,   0 },
+	{ "x8-noisy",     8, 4.0f, 3.0f, 0.0f,   0 },
+	{ "x16-gain",    16, 4.0f, 1.5f, 0.002f, 0 },
+	{ "x32-passing", 32, 4.0f, 1.5f, 0.0f,   3 },
+	{ "x64-faint",   64, 2.0f, 1.5f, 0.0f,   0 }
+};
+
+#define DETECTION_SCENARIOS_COUNT (sizeof(DETECTION_SCENARIOS) / sizeof(DetectionScenario))
+
+struct DetectionSequence
+{
+	string Name;
+	long Width;
+	long Height;
+	vector<float> Signatures;
+	vector<bool> Boundaries;
+	bool HasGroundTruth;
+	double SignatureMeanNs;
+	double SignatureP99Ns;
+};
+
+struct DetectionCounts
+{
+	long TruePositives;
+	long FalsePositives;
+	long FalseNegatives;
+	long TrueNegatives;
+	double CheckerNsPerFrame;
+};
+
+struct RocPoint
+{
+	float Threshold;
+	DetectionCounts Counts;
+	double Precision;
+	double Recall;
+	double FalsePositiveRate;
+};
+
+struct DetectionSettings
+{
+	float DiffRatio;
+	float MinSignatureDiff;
+	float DiffGamma;
+	long Tolerance;
+	long WarmupFrames;
+	bool SweepRatio;
+	float SweepFrom;
+	float SweepTo;
+	long SweepSteps;
+};
+
+static void SetupDetectionCore(long width, long height, const DetectionSettings& settings)
+{
+	SetupCamera(width, height, (LPCTSTR)"Synthetic", 0, false, false, true);
+	SetupIntegrationDetection(settings.DiffRatio, settings.MinSignatureDiff, settings.DiffGamma);
+}
+
+static void CompleteSignatureTimings(vector<double>& frameNs, DetectionSequence* sequence)
+{
+	sequence->SignatureMeanNs = 0;
+	sequence->SignatureP99Ns = 0;
+
+	if (frameNs.size() == 0)
+		return;
+
+	double sum = 0;
+	for (unsigned int i = 0; i < frameNs.size(); i++)
+		sum += frameNs[i];
+
+	sort(frameNs.begin(), frameNs.end());
+
+	sequence->SignatureMeanNs = sum / frameNs.size();
+	sequence->SignatureP99Ns = frameNs[(frameNs.size() * 99) / 100];
+}
+
+static void CalculateSyntheticSequence(const DetectionScenario& scenario, long width, long height, long frames, unsigned int seed, const DetectionSettings& settings, DetectionSequence* sequence)
+{
+	SyntheticVideoConfig config;
+	InitSyntheticVideoConfig(&config, width, height, scenario.IntegrationRate);
+	config.SceneNoiseSigma = scenario.SceneNoiseSigma;
+	config.VideoNoiseSigma = scenario.VideoNoiseSigma;
+	config.GainJumpProbability = scenario.GainJumpProbability;
+	config.NumberOfPassingStars = scenario.NumberOfPassingStars;
+	config.IntegrationPhase = seed % scenario.IntegrationRate;
+	config.Seed = seed;
+
+	SyntheticVideo video(config);
+	unsigned char* bmpBits = (unsigned char*)malloc(width * height * 3);
+
+	SetupDetectionCore(width, height, settings);
+
+	sequence->Name = string(scenario.Name);
+	sequence->Width = width;
+	sequence->Height = height;
+	sequence->HasGroundTruth = true;
+	sequence->Signatures.clear();
+	sequence->Boundaries.clear();
+
+	vector<double> frameNs;
+	double nsPerTick = 1E9 / HighResolutionTimer::TicksPerSecond();
+
+	for (long i = 0; i < frames; i++)
+	{
+		bool isNewIntegrationPeriod = video.NextFrame(bmpBits);
+
+		float signature;
+		long long startTicks = HighResolutionTimer::Ticks();
+		CalculateDiffSignature(bmpBits, &signature);
+		long long endTicks = HighResolutionTimer::Ticks();
+
+		frameNs.push_back((endTicks - startTicks) * nsPerTick);
+		sequence->Signatures.push_back(signature);
+		sequence->Boundaries.push_back(isNewIntegrationPeriod);
+	}
+
+	CompleteSignatureTimings(frameNs, sequence);
+
+	free(bmpBits);
+}
+
+static bool LoadGroundTruth(const char* fileName, long long frames, vector<bool>* boundaries)
+{
+	FILE* truthFile = fopen(fileName, "r");
+	if (NULL == truthFile)
+		return false;
+
+	boundaries->assign((unsigned int)frames, false);
+
+	long long frameIndex;
+	while (fscanf(truthFile, "%lld", &frameIndex) == 1)
+	{
+		if (frameIndex >= 0 && frameIndex < frames)
+			(*boundaries)[(unsigned int)frameIndex] = true;
+	}
+
+	fclose(truthFile);
+	return true;
+}
+
+// The raw file is a sequence of bottom-up 24-bit BGR frames, exactly as passed to ProcessVideoFrame(). The optional
+// ground truth file lists the zero based indexes of the frames which start a new integration period
+static bool CalculateRecordedSequence(const char* rawFileName, const char* truthFileName, long width, long height, const DetectionSettings& settings, DetectionSequence* sequence)
+{
+	FILE* rawFile = fopen(rawFileName, "rb");
+	if (NULL == rawFile)
+	{
+		fprintf(stderr, "Cannot open '%s'\n", rawFileName);
+		return false;
+	}
+
+	long frameSize = width * height * 3;
+	unsigned char* bmpBits = (unsigned char*)malloc(frameSize);
+
+	SetupDetectionCore(width, height, settings);
+
+	sequence->Name = string(rawFileName);
+	sequence->Width = width;
+	sequence->Height = height;
+	sequence->Signatures.clear();
+	sequence->Boundaries.clear();
+
+	vector<double> frameNs;
+	double nsPerTick = 1E9 / HighResolutionTimer::TicksPerSecond();
+
+	while (fread(bmpBits, 1, frameSize, rawFile) == (size_t)frameSize)
+	{
+		float signature;
+		long long startTicks = HighResolutionTimer::Ticks();
+		CalculateDiffSignature(bmpBits, &signature);
+		long long endTicks = HighResolutionTimer::Ticks();
+
+		frameNs.push_back((endTicks - startTicks) * nsPerTick);
+		sequence->Signatures.push_back(signature);
+	}
+
+	fclose(rawFile);
+	free(bmpBits);
+
+	CompleteSignatureTimings(frameNs, sequence);
+
+	sequence->HasGroundTruth = false;
+	if (NULL != truthFileName)
+	{
+		if (!LoadGroundTruth(truthFileName, sequence->Signatures.size(), &sequence->Boundaries))
+		{
+			fprintf(stderr, "Cannot open '%s'\n", truthFileName);
+			return false;
+		}
+
+		sequence->HasGroundTruth = true;
+	}
+
+	return true;
+}
+
+static void EvaluateDetector(const DetectionSequence& sequence, float diffRatio, float minSignatureDiff, const DetectionSettings& settings, vector<bool>* detections, DetectionCounts* counts)
+{
+	long frames = (long)sequence.Signatures.size();
+
+	OccuRec::IntegrationChecker* checker = new OccuRec::IntegrationChecker(diffRatio, minSignatureDiff);
+	checker->ControlIntegrationDetectionTuning(false);
+
+	detections->assign(frames, false);
+
+	long long startTicks = HighResolutionTimer::Ticks();
+
+	for (long i = 0; i < frames; i++)
+		// The frame numbers passed by the frame processing start from 1
+		(*detections)[i] = checker->IsNewIntegrationPeriod_Automatic(i + 1, sequence.Signatures[i]);
+
+	long long endTicks = HighResolutionTimer::Ticks();
+
+	delete checker;
+
+	counts->CheckerNsPerFrame = frames > 0 ? (endTicks - startTicks) * 1E9 / HighResolutionTimer::TicksPerSecond() / frames : 0;
+	counts->TruePositives = 0;
+	counts->FalsePositives = 0;
+	counts->FalseNegatives = 0;
+	counts->TrueNegatives = 0;
+
+	if (!sequence.HasGroundTruth)
+		return;
+
+	// Every detected boundary is matched to the nearest not yet matched true boundary within the tolerance
+	vector<bool> matched(frames, false);
+	long positives = 0;
+
+	for (long i = settings.WarmupFrames; i < frames; i++)
+	{
+		if (sequence.Boundaries[i])
+			positives++;
+
+		if (!(*detections)[i])
+			continue;
+
+		bool isMatched = false;
+		for (long offset = 0; offset <= settings.Tolerance && !isMatched; offset++)
+		{
+			long candidates[2] = { i - offset, i + offset };
+			for (int j = 0; j < (offset == 0 ? 1 : 2) && !isMatched; j++)
+			{
+				long k = candidates[j];
+				if (k >= settings.WarmupFrames && k < frames && sequence.Boundaries[k] && !matched[k])
+				{
+					matched[k] = true;
+					isMatched = true;
+				}
+			}
+		}
+
+		if (isMatched)
+			counts->TruePositives++;
+		else
+			counts->FalsePositives++;
+	}
+
+	long negatives = frames - settings.WarmupFrames - positives;
+
+	counts->FalseNegatives = positives - counts->TruePositives;
+	counts->TrueNegatives = negatives > counts->FalsePositives ? negatives - counts->FalsePositives : 0;
+}
+
+static void CompleteRocPoint(RocPoint* point)
+{
+	const DetectionCounts& counts = point->Counts;
+
+	long detected = counts.TruePositives + counts.FalsePositives;
+	long positives = counts.TruePositives + counts.FalseNegatives;
+	long negatives = counts.FalsePositives + counts.TrueNegatives;
+
+	point->Precision = detected > 0 ? (double)counts.TruePositives / detected : 1.0;
+	point->Recall = positives > 0 ? (double)counts.TruePositives / positives : 1.0;
+	point->FalsePositiveRate = negatives > 0 ? (double)counts.FalsePositives / negatives : 0.0;
+}
+
+static bool CompareRocPoints(const RocPoint& a, const RocPoint& b)
+{
+	if (a.FalsePositiveRate != b.FalsePositiveRate)
+		return a.FalsePositiveRate < b.FalsePositiveRate;
+
+	return a.Recall < b.Recall;
+}
+
+static double CalculateAreaUnderCurve(vector<RocPoint> points)
+{
+	sort(points.begin(), points.end(), CompareRocPoints);
+
+	double area = 0;
+	double prevFpr = 0;
+	double prevTpr = 0;
+
+	// Very low thresholds make the checker fire on every other frame, so the recall is not monotonic in the threshold.
+	// Use the ROC envelope: a point that has a lower recall than one at a smaller false positive rate is dominated.
+	for (unsigned int i = 0; i < points.size(); i++)
+	{
+		double tpr = points[i].Recall > prevTpr ? points[i].Recall : prevTpr;
+		area += (points[i].FalsePositiveRate - prevFpr) * (tpr + prevTpr) / 2;
+		prevFpr = points[i].FalsePositiveRate;
+		prevTpr = tpr;
+	}
+
+	area += (1 - prevFpr) * (1 + prevTpr) / 2;
+
+	return area;
+}
+
+static long CountTrueBoundaries(const DetectionSequence& sequence, const DetectionSettings& settings)
+{
+	long count = 0;
+	for (unsigned int i = settings.WarmupFrames; i < sequence.Boundaries.size(); i++)
+		if (sequence.Boundaries[i]) count++;
+
+	return count;
+}
+
+static int ReportSequence(const DetectionSequence& sequence, const DetectionSettings& settings, BenchmarkArgs& args, FILE* csvFile)
+{
+	int rv = BENCHMARK_EXIT_OK;
+
+	vector<bool> detections;
+	DetectionCounts operatingCounts;
+	EvaluateDetector(sequence, settings.DiffRatio, settings.MinSignatureDiff, settings, &detections, &operatingCounts);
+
+	long detectedCount = 0;
+	for (unsigned int i = settings.WarmupFrames; i < detections.size(); i++)
+		if (detections[i]) detectedCount++;
+
+	printf("\n%s: %d frames %ldx%ld", sequence.Name.c_str(), (int)sequence.Signatures.size(), sequence.Width, sequence.Height);
+	if (sequence.HasGroundTruth)
+		printf(", %ld integration boundaries", CountTrueBoundaries(sequence, settings));
+	printf("\n");
+
+	printf("  CalculateDiffSignature        : %8.3f us/frame (p99 %.3f us)\n", sequence.SignatureMeanNs / 1000.0, sequence.SignatureP99Ns / 1000.0);
+	printf("  IsNewIntegrationPeriod        : %8.3f us/frame\n", operatingCounts.CheckerNsPerFrame / 1000.0);
+
+	if (!sequence.HasGroundTruth)
+	{
+		printf("  Detected integration boundaries: %ld (no ground truth given)\n", detectedCount);
+		return rv;
+	}
+
+	RocPoint operatingPoint;
+	operatingPoint.Threshold = settings.SweepRatio ? settings.DiffRatio : settings.MinSignatureDiff;
+	operatingPoint.Counts = operatingCounts;
+	CompleteRocPoint(&operatingPoint);
+
+	printf("  Operating point (ratio %.2f, min diff %.2f): TP %ld FP %ld FN %ld precision %.4f recall %.4f\n",
+		settings.DiffRatio, settings.MinSignatureDiff,
+		operatingCounts.TruePositives, operatingCounts.FalsePositives, operatingCounts.FalseNegatives,
+		operatingPoint.Precision, operatingPoint.Recall);
+
+	vector<RocPoint> rocPoints;
+
+	printf("  ROC sweeping %s (%s fixed at %.2f):\n",
+		settings.SweepRatio ? "diff ratio" : "min signature diff",
+		settings.SweepRatio ? "min signature diff" : "diff ratio",
+		settings.SweepRatio ? settings.MinSignatureDiff : settings.DiffRatio);
+	printf("    %9s %6s %6s %6s %8s %9s %8s %8s\n", "threshold", "TP", "FP", "FN", "TN", "precision", "recall", "FPR");
+
+	for (long step = 0; step < settings.SweepSteps; step++)
+	{
+		RocPoint point;
+		point.Threshold = settings.SweepSteps > 1
+			? settings.SweepFrom + (settings.SweepTo - settings.SweepFrom) * step / (settings.SweepSteps - 1)
+			: settings.SweepFrom;
+
+		if (settings.SweepRatio)
+			EvaluateDetector(sequence, point.Threshold, settings.MinSignatureDiff, settings, &detections, &point.Counts);
+		else
+			EvaluateDetector(sequence, settings.DiffRatio, point.Threshold, settings, &detections, &point.Counts);
+
+		CompleteRocPoint(&point);
+		rocPoints.push_back(point);
+
+		printf("    %9.3f %6ld %6ld %6ld %8ld %9.4f %8.4f %8.5f\n",
+			point.Threshold, point.Counts.TruePositives, point.Counts.FalsePositives, point.Counts.FalseNegatives, point.Counts.TrueNegatives,
+			point.Precision, point.Recall, point.FalsePositiveRate);
+
+		if (NULL != csvFile)
+			fprintf(csvFile, "%s,%s,%.4f,%ld,%ld,%ld,%ld,%.6f,%.6f,%.6f\n",
+				sequence.Name.c_str(), settings.SweepRatio ? "ratio" : "mindiff", point.Threshold,
+				point.Counts.TruePositives, point.Counts.FalsePositives, point.Counts.FalseNegatives, point.Counts.TrueNegatives,
+				point.Precision, point.Recall, point.FalsePositiveRate);
+	}
+
+	double auc = CalculateAreaUnderCurve(rocPoints);
+	printf("  ROC AUC: %.4f\n", auc);
+
+	// Regression gates
+	double minPrecision = args.GetDouble("min-precision", 0);
+	double minRecall = args.GetDouble("min-recall", 0);
+	double minAuc = args.GetDouble("min-auc", 0);
+	double maxSignatureUs = args.GetDouble("max-signature-us", 0);
+
+	if (operatingPoint.Precision < minPrecision)
+	{
+		printf("  FAILED: precision %.4f is below %.4f\n", operatingPoint.Precision, minPrecision);
+		rv = BENCHMARK_EXIT_GATE_FAILED;
+	}
+	if (operatingPoint.Recall < minRecall)
+	{
+		printf("  FAILED: recall %.4f is below %.4f\n", operatingPoint.Recall, minRecall);
+		rv = BENCHMARK_EXIT_GATE_FAILED;
+	}
+	if (auc < minAuc)
+	{
+		printf("  FAILED: ROC AUC %.4f is below %.4f\n", auc, minAuc);
+		rv = BENCHMARK_EXIT_GATE_FAILED;
+	}
+	if (maxSignatureUs > 0 && sequence.SignatureMeanNs / 1000.0 > maxSignatureUs)
+	{
+		printf("  FAILED: CalculateDiffSignature takes %.3f us/frame, more than %.3f us\n", sequence.SignatureMeanNs / 1000.0, maxSignatureUs);
+		rv = BENCHMARK_EXIT_GATE_FAILED;
+	}
+
+	return rv;
+}
+
+void PrintIntegrationDetectionBenchmarkUsage()
+{
+	printf("detection [options]\n");
+	printf("  Replays frames through CalculateDiffSignature() and the IntegrationChecker.\n");
+	printf("    --scenario NAME        Synthetic scenario to run (default: all). One of:");
+	for (unsigned int i = 0; i < DETECTION_SCENARIOS_COUNT; i++)
+		printf(" %s", DETECTION_SCENARIOS[i].Name);
+	printf("\n");
+	printf("    --frames N             Frames per synthetic scenario (default: 1500)\n");
+	printf("    --width W --height H   Frame size (default: 720 x 576)\n");
+	printf("    --seed S               Seed of the synthetic sequences (default: 1)\n");
+	printf("    --raw FILE             Replay recorded bottom-up 24-bit BGR frames instead of synthetic ones\n");
+	printf("    --truth FILE           Indexes of the recorded frames that start a new integration period\n");
+	printf("    --ratio R              Signature difference ratio of the operating point (default: 5)\n");
+	printf("    --min-diff D           Minimum signature difference of the operating point (default: 0.3)\n");
+	printf("    --gamma G              Difference gamma (default: 1)\n");
+	printf("    --sweep ratio|mindiff  Threshold swept for the ROC (default: ratio)\n");
+	printf("    --from F --to T --steps N  Swept threshold range\n");
+	printf("    --tolerance N          Frames a detected boundary may be off and still count (default: 0)\n");
+	printf("    --warmup N             Initial frames excluded from the metrics (default: 16)\n");
+	printf("    --csv FILE             Write the ROC points to a CSV file\n");
+	printf("    --min-precision P --min-recall R --min-auc A --max-signature-us U\n");
+	printf("                           Fail with exit code %d when a sequence does not meet the limits\n", BENCHMARK_EXIT_GATE_FAILED);
+}
+
+int RunIntegrationDetectionBenchmark(int argc, char** argv)
+{
+	BenchmarkArgs args(argc, argv, 2);
+
+	DetectionSettings settings;
+	settings.DiffRatio = (float)args.GetDouble("ratio", 5);
+	settings.MinSignatureDiff = (float)args.GetDouble("min-diff", 0.3);
+	settings.DiffGamma = (float)args.GetDouble("gamma", 1);
+	settings.Tolerance = args.GetLong("tolerance", 0);
+	settings.WarmupFrames = args.GetLong("warmup", 16);
+	settings.SweepRatio = strcmp(args.GetString("sweep", "ratio"), "mindiff") != 0;
+	settings.SweepFrom = (float)args.GetDouble("from", settings.SweepRatio ? 1.0 : 0.05);
+	settings.SweepTo = (float)args.GetDouble("to", settings.SweepRatio ? 20.0 : 3.0);
+	settings.SweepSteps = args.GetLong("steps", settings.SweepRatio ? 39 : 60);
+
+	long width = args.GetLong("width", 720);
+	long height = args.GetLong("height", 576);
+	long frames = args.GetLong("frames", 1500);
+	unsigned int seed = (unsigned int)args.GetLong("seed", 1);
+
+	// The signature area is a 32x32 block right of the centre of the frame
+	if (width < 72 || height < 72 || frames < settings.WarmupFrames)
+	{
+		PrintIntegrationDetectionBenchmarkUsage();
+		return BENCHMARK_EXIT_USAGE;
+	}
+
+	FILE* csvFile = NULL;
+	if (args.Has("csv"))
+	{
+		csvFile = fopen(args.GetString("csv", ""), "w");
+		if (NULL != csvFile)
+			fprintf(csvFile, "sequence,sweep,threshold,tp,fp,fn,tn,precision,recall,fpr\n");
+	}
+
+	int rv = BENCHMARK_EXIT_OK;
+	DetectionSequence sequence;
+
+	if (args.Has("raw"))
+	{
+		if (!CalculateRecordedSequence(args.GetString("raw", ""), args.GetString("truth", NULL), width, height, settings, &sequence))
+			rv = BENCHMARK_EXIT_USAGE;
+		else
+			rv = ReportSequence(sequence, settings, args, csvFile);
+	}
+	else
+	{
+		const char* scenarioName = args.GetString("scenario", "all");
+		bool scenarioFound = false;
+
+		for (unsigned int i = 0; i < DETECTION_SCENARIOS_COUNT; i++)
+		{
+			if (strcmp(scenarioName, "all") != 0 && strcmp(scenarioName, DETECTION_SCENARIOS[i].Name) != 0)
+				continue;
+
+			scenarioFound = true;
+
+			CalculateSyntheticSequence(DETECTION_SCENARIOS[i], width, height, frames, seed, settings, &sequence);
+
+			if (ReportSequence(sequence, settings, args, csvFile) != BENCHMARK_EXIT_OK)
+				rv = BENCHMARK_EXIT_GATE_FAILED;
+		}
+
+		if (!scenarioFound)
+		{
+			fprintf(stderr, "Unknown scenario '%s'\n", scenarioName);
+			rv = BENCHMARK_EXIT_USAGE;
+		}
+	}
+
+	if (NULL != csvFile)
+		fclose(csvFile);
+
+	return rv;
+}
+
+}
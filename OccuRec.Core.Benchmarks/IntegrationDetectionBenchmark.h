@@ -0,0 +1,19 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef INTEGRATION_DETECTION_BENCHMARK_H
+#define INTEGRATION_DETECTION_BENCHMARK_H
+
+namespace OccuRecBenchmarks
+{
+
+// Replays synthetic or recorded video frames through CalculateDiffSignature() and the IntegrationChecker and reports
+// the per-frame cost, the integration boundary precision/recall and the ROC across a range of detection thresholds
+int RunIntegrationDetectionBenchmark(int argc, char** argv);
+
+void PrintIntegrationDetectionBenchmarkUsage();
+
+}
+
+#endif // INTEGRATION_DETECTION_BENCHMARK_H
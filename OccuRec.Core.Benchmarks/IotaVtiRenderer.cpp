@@ -0,0 +1,195 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+
+#include "IotaVtiRenderer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace OccuOcr;
+
+namespace OccuRecBenchmarks
+{
+
+#define TICKS_PER_DAY 864000000000LL
+
+void FormatIotaVtiFieldStamp(const IotaVtiFieldStamp& stamp, char chars[IOTA_VTI_CHAR_POSITIONS])
+{
+	// The OCR-ed character positions are parsed by OcrFrameProcessor::ExtractFieldInfo()
+	// [0] GPS fix, [1] satellites, [2] almanac, [3-8] HHMMSS, [9-12] and [13-16] the two field timestamps in 0.1 ms, [17-24] field number
+	memset(chars, ' ', IOTA_VTI_CHAR_POSITIONS);
+
+	long long timeOfDay = stamp.TimeStampTicks % TICKS_PER_DAY;
+	if (timeOfDay < 0) timeOfDay += TICKS_PER_DAY;
+
+	long hh = (long)(timeOfDay / 36000000000LL);
+	long mm = (long)((timeOfDay / 600000000LL) % 60);
+	long ss = (long)((timeOfDay / 10000000LL) % 60);
+	long tenthsOfMs = (long)((timeOfDay / 1000LL) % 10000);
+
+	chars[0] = stamp.GpsFixType;
+	chars[1] = (char)('0' + (stamp.TrackedSatellites % 10));
+	chars[2] = stamp.AlmanacUpdating ? 'W' : ' ';
+	chars[3] = (char)('0' + hh / 10);
+	chars[4] = (char)('0' + hh % 10);
+	chars[5] = (char)('0' + mm / 10);
+	chars[6] = (char)('0' + mm % 10);
+	chars[7] = (char)('0' + ss / 10);
+	chars[8] = (char)('0' + ss % 10);
+
+	char* ptrMs = stamp.UseSecondTimestampPosition ? &chars[13] : &chars[9];
+	ptrMs[0] = (char)('0' + tenthsOfMs / 1000);
+	ptrMs[1] = (char)('0' + (tenthsOfMs / 100) % 10);
+	ptrMs[2] = (char)('0' + (tenthsOfMs / 10) % 10);
+	ptrMs[3] = (char)('0' + tenthsOfMs % 10);
+
+	// Field number left aligned from position 17. The last char position of the NON TV-Safe configurations is partly
+	// outside of a 720 pixels wide frame, so some digits (e.g. 6) cannot be recognized there
+	char fieldNumberStr[32];
+	sprintf(fieldNumberStr, "%lld", stamp.FieldNumber % 100000000LL);
+	memcpy(&chars[17], fieldNumberStr, strlen(fieldNumberStr));
+}
+
+IotaVtiRenderer::IotaVtiRenderer(const OcrConfiguration& config)
+{
+	m_Config = config;
+
+	long totalPixels = m_Config.Width * m_Config.Height;
+
+	m_ZoneMatrix = (long*)malloc(totalPixels * sizeof(long));
+	BuildOcrZoneMatrix(m_Config, m_ZoneMatrix);
+
+	m_Overlay = (short*)malloc(totalPixels * sizeof(short));
+	for (long i = 0; i < totalPixels; i++)
+		m_Overlay[i] = -1;
+
+	// The timestamp is drawn on a dark background box covering all char positions
+	long boxTop = m_Config.FrameTopOdd;
+	long boxBottom = m_Config.FrameTopEven + 2 * m_Config.CharHeight;
+	long boxLeft = m_Config.CharPositions.front();
+	long boxRight = m_Config.CharPositions.back() + m_Config.CharWidth - 1;
+
+	if (boxBottom >= m_Config.Height) boxBottom = m_Config.Height - 1;
+	if (boxRight >= m_Config.Width) boxRight = m_Config.Width - 1;
+
+	for (long y = boxTop; y <= boxBottom; y++)
+		for (long x = boxLeft; x <= boxRight; x++)
+			m_Overlay[y * m_Config.Width + x] = IOTA_VTI_OFF_LEVEL;
+
+	for (long i = 0; i < totalPixels; i++)
+	{
+		if (m_ZoneMatrix[i] != 0)
+		{
+			m_ZonePixelIndexes.push_back(i);
+			m_ZonePixelPackedInfo.push_back(m_ZoneMatrix[i]);
+		}
+	}
+
+	for (int i = 0; i < 256; i++)
+		for (int j = 0; j < MAX_ZONE_COUNT; j++)
+			m_Glyphs[i][j] = -1;
+
+	for (unsigned int i = 0; i < m_Config.CharDefinitions.size(); i++)
+	{
+		const OcrCharConfig& charDef = m_Config.CharDefinitions[i];
+		unsigned char glyphId = (unsigned char)charDef.Character;
+
+		for (unsigned int j = 0; j < charDef.ZoneSignatures.size(); j++)
+		{
+			long zoneId = charDef.ZoneSignatures[j].ZoneId;
+			if (zoneId >= 0 && zoneId < MAX_ZONE_COUNT)
+				m_Glyphs[glyphId][zoneId] = charDef.ZoneSignatures[j].ZoneValue;
+		}
+	}
+}
+
+IotaVtiRenderer::~IotaVtiRenderer()
+{
+	if (NULL != m_ZoneMatrix)
+	{
+		free(m_ZoneMatrix);
+		m_ZoneMatrix = NULL;
+	}
+
+	if (NULL != m_Overlay)
+	{
+		free(m_Overlay);
+		m_Overlay = NULL;
+	}
+}
+
+const OcrConfiguration& IotaVtiRenderer::Config()
+{
+	return m_Config;
+}
+
+long* IotaVtiRenderer::ZoneMatrix()
+{
+	return m_ZoneMatrix;
+}
+
+long IotaVtiRenderer::OddFieldLineParity()
+{
+	return m_Config.FrameTopOdd % 2;
+}
+
+unsigned char IotaVtiRenderer::GetZonePixelLevel(char character, long zoneId, long zonePixelId)
+{
+	long zoneBehaviour = zoneId < MAX_ZONE_COUNT ? m_Glyphs[(unsigned char)character][zoneId] : -1;
+
+	// The split zones are compared as a top and a bottom half, see CharRecognizer::ComputeSplitZones()
+	bool isTopHalf = zonePixelId < (long)(m_Config.Zones[zoneId].Pixels.size() / 2);
+
+	switch(zoneBehaviour)
+	{
+		case ZoneBehaviour::On:
+		case ZoneBehaviour::NotOff:
+			return IOTA_VTI_ON_LEVEL;
+
+		case ZoneBehaviour::Gray:
+			return IOTA_VTI_GRAY_LEVEL;
+
+		case ZoneBehaviour::OnOff:
+			return isTopHalf ? IOTA_VTI_ON_LEVEL : IOTA_VTI_OFF_LEVEL;
+
+		case ZoneBehaviour::OffOn:
+			return isTopHalf ? IOTA_VTI_OFF_LEVEL : IOTA_VTI_ON_LEVEL;
+
+		default:
+			// Off, NotOn, NotOnOff, NotOffOn and zones not used by the character
+			return IOTA_VTI_OFF_LEVEL;
+	}
+}
+
+void IotaVtiRenderer::Render(const char oddFieldChars[IOTA_VTI_CHAR_POSITIONS], const char evenFieldChars[IOTA_VTI_CHAR_POSITIONS])
+{
+	long zonesCount = (long)m_Config.Zones.size();
+	long charsCount = (long)m_Config.CharPositions.size();
+
+	for (unsigned int i = 0; i < m_ZonePixelIndexes.size(); i++)
+	{
+		long charId;
+		bool isOddField;
+		long zoneId;
+		long zonePixelId;
+		UnpackValue(m_ZonePixelPackedInfo[i], &charId, &isOddField, &zoneId, &zonePixelId);
+
+		if (charId >= charsCount || zoneId >= zonesCount)
+			continue;
+
+		char character = isOddField ? oddFieldChars[charId] : evenFieldChars[charId];
+
+		m_Overlay[m_ZonePixelIndexes[i]] = GetZonePixelLevel(character, zoneId, zonePixelId);
+	}
+}
+
+const short* IotaVtiRenderer::Overlay()
+{
+	return m_Overlay;
+}
+
+}
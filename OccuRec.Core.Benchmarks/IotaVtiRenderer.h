@@ -0,0 +1,79 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef IOTA_VTI_RENDERER_H
+#define IOTA_VTI_RENDERER_H
+
+#include "OcrConfiguration.h"
+#include "OccuRec.Ocr.h"
+#include <vector>
+
+using namespace std;
+
+namespace OccuRecBenchmarks
+{
+
+#define IOTA_VTI_CHAR_POSITIONS 25
+
+// Pixel levels of the rendered timestamp
+#define IOTA_VTI_ON_LEVEL 235
+#define IOTA_VTI_OFF_LEVEL 16
+#define IOTA_VTI_GRAY_LEVEL 150
+
+// The content of the IOTA-VTI timestamp line of a single video field
+struct IotaVtiFieldStamp
+{
+	char GpsFixType;
+	long TrackedSatellites;
+	bool AlmanacUpdating;
+	// Time of day in 100ns ticks. Displayed with a resolution of 0.1 ms
+	long long TimeStampTicks;
+	long long FieldNumber;
+	// The IOTA-VTI shows the milliseconds of the two fields of a frame in two different places
+	bool UseSecondTimestampPosition;
+};
+
+// Formats the characters shown by the IOTA-VTI, in the order of the OCR char positions
+void FormatIotaVtiFieldStamp(const IotaVtiFieldStamp& stamp, char chars[IOTA_VTI_CHAR_POSITIONS]);
+
+// Renders IOTA-VTI timestamps into video frames using the zone based character shapes of an OCR configuration,
+// so the rendered characters are exactly the ones the OCR of the core is configured to recognize
+class IotaVtiRenderer
+{
+	private:
+		OcrConfiguration m_Config;
+		long* m_ZoneMatrix;
+
+		// Top-down overlay of the timestamp area. Pixels outside the area are -1 and show the video
+		short* m_Overlay;
+
+		// Indexes and packed zone info of all zone pixels in the timestamp area
+		vector<long> m_ZonePixelIndexes;
+		vector<long> m_ZonePixelPackedInfo;
+
+		// The zone behaviour for each character and zone, or -1 when the zone is not used by the character
+		long m_Glyphs[256][MAX_ZONE_COUNT];
+
+		unsigned char GetZonePixelLevel(char character, long zoneId, long zonePixelId);
+
+	public:
+		IotaVtiRenderer(const OcrConfiguration& config);
+		~IotaVtiRenderer();
+
+		const OcrConfiguration& Config();
+
+		// The packed zone matrix to pass to SetupCoreOcr()
+		long* ZoneMatrix();
+
+		// The video lines with this parity carry the odd field
+		long OddFieldLineParity();
+
+		void Render(const char oddFieldChars[IOTA_VTI_CHAR_POSITIONS], const char evenFieldChars[IOTA_VTI_CHAR_POSITIONS]);
+
+		const short* Overlay();
+};
+
+}
+
+#endif // IOTA_VTI_RENDERER_H
@@ -0,0 +1,1271 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+
+#include "KernelBenchmarks.h"
+#include "BenchmarkUtils.h"
+#include "SyntheticVideo.h"
+#include "OcrConfiguration.h"
+#include "IotaVtiRenderer.h"
+
+#include "OccuRec.Core.h"
+#include "Compressor.h"
+#include "LocoICompressor.h"
+#include "Lagarith8Compressor.h"
+#include "quicklz.h"
+#include "utils.h"
+#include "crc32c.h"
+#include "psf_fit.h"
+#include "simplified_tracking.h"
+#include "aav_frames_index.h"
+#include "aav_status_section.h"
+#include "aav_bit_packing.h"
+#include "aav_diff_coding.h"
+
+#ifdef _WIN32
+#include "BitmapUtils.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+
+using namespace std;
+
+namespace OccuRecBenchmarks
+{
+
+#define KERNEL_MAX_ITERATIONS 1000000000LL
+#define KERNEL_INTEGRATED_FRAMES 8
+// Four hours at 25 fps
+#define KERNEL_INDEX_FRAMES 360000
+// One minute at 25 fps
+#define KERNEL_STATUS_FRAMES 1500
+
+// The frame data used by all kernels at one frame size. Rendered once from the synthetic video, so the compression
+// kernels see a realistic star field rather than random or constant bytes
+struct KernelFrameData
+{
+	long Width;
+	long Height;
+	// Bottom-up 24-bit BGR bitmap, as passed to ProcessVideoFrame()
+	unsigned char* BmpBits;
+	// Top-down 8-bit monochrome pixels
+	unsigned char* Pixels8;
+	// Sum of KERNEL_INTEGRATED_FRAMES frames, as recorded in 16-bit mode
+	unsigned short* Pixels16;
+	// The KERNEL_INTEGRATED_FRAMES consecutive 8-bit frames of the sum, as recorded without integration
+	unsigned char* Sequence8;
+	// Top-down pixels in the format used by the tracking
+	unsigned long* PixelsLong;
+	// Position of a bright isolated star for the photometry and the PSF fitting
+	long StarX;
+	long StarY;
+};
+
+// Mirrors benchmark::State: the kernel loops on KeepRunning() and reports how much data it processed
+class KernelState
+{
+	private:
+		long long m_MaxIterations;
+		long long m_Iterations;
+		long long m_StartTicks;
+		long long m_PausedTicks;
+		long long m_ElapsedTicks;
+
+	public:
+		KernelFrameData* Data;
+		double ItemsProcessed;
+		double BytesProcessed;
+		string Label;
+		bool Skipped;
+
+		KernelState(KernelFrameData* data, long long maxIterations)
+		{
+			Data = data;
+			m_MaxIterations = maxIterations;
+			m_Iterations = 0;
+			m_StartTicks = 0;
+			m_PausedTicks = 0;
+			m_ElapsedTicks = 0;
+			ItemsProcessed = 0;
+			BytesProcessed = 0;
+			Skipped = false;
+		}
+
+		bool KeepRunning()
+		{
+			if (m_Iterations == 0)
+				m_StartTicks = HighResolutionTimer::Ticks();
+
+			if (m_Iterations < m_MaxIterations)
+			{
+				m_Iterations++;
+				return true;
+			}
+
+			m_ElapsedTicks = HighResolutionTimer::Ticks() - m_StartTicks;
+			return false;
+		}
+
+		void PauseTiming()
+		{
+			m_PausedTicks = HighResolutionTimer::Ticks();
+		}
+
+		void ResumeTiming()
+		{
+			m_StartTicks += HighResolutionTimer::Ticks() - m_PausedTicks;
+		}
+
+		void SkipWithMessage(const char* message)
+		{
+			Skipped = true;
+			Label = string(message);
+		}
+
+		long long Iterations()
+		{
+			return m_Iterations;
+		}
+
+		double ElapsedSeconds()
+		{
+			return (double)m_ElapsedTicks / HighResolutionTimer::TicksPerSecond();
+		}
+};
+
+typedef void (*KernelBenchmarkFunc)(KernelState& state);
+
+struct KernelBenchmark
+{
+	const char* Name;
+	KernelBenchmarkFunc Run;
+	// Kernels that do not depend on the frame size are only run once
+	bool IsFrameSizeDependent;
+};
+
+static void SetupKernelCamera(KernelFrameData* data, long monochromeConversionMode)
+{
+	SetupCamera(data->Width, data->Height, (LPCTSTR)"Synthetic", monochromeConversionMode, false, false, true);
+	SetupIntegrationDetection(5, 0.3f, 1);
+}
+
+static void BM_AccumulateMonochromePixels(KernelState& state, long monochromeConversionMode)
+{
+	KernelFrameData* data = state.Data;
+	long totalPixels = data->Width * data->Height;
+
+	SetupKernelCamera(data, monochromeConversionMode);
+
+	double* integratedPixels = (double*)malloc(totalPixels * sizeof(double));
+	unsigned char* frameCopy = (unsigned char*)malloc(totalPixels);
+	unsigned char* trackedFrame = (unsigned char*)malloc(totalPixels);
+	memset(integratedPixels, 0, totalPixels * sizeof(double));
+
+	while (state.KeepRunning())
+		AccumulateMonochromePixels(data->BmpBits, integratedPixels, frameCopy, trackedFrame);
+
+	state.ItemsProcessed = (double)state.Iterations() * totalPixels;
+	state.BytesProcessed = (double)state.Iterations() * totalPixels * 3;
+
+	free(trackedFrame);
+	free(frameCopy);
+	free(integratedPixels);
+}
+
+static void BM_AccumulateMonochromePixels_R(KernelState& state)
+{
+	BM_AccumulateMonochromePixels(state, 0);
+}
+
+static void BM_AccumulateMonochromePixels_Luma(KernelState& state)
+{
+	BM_AccumulateMonochromePixels(state, 3);
+}
+
+static void PrepareIntegratedFrame(KernelFrameData* data)
+{
+	FrameProcessingStatus frameStatus;
+
+	// Go past the startup frames, so the following frame is accumulated in the integration buffer
+	for (int i = 0; i < 4; i++)
+		ProcessVideoFrame(data->BmpBits, 0, 0, 0, 0, &frameStatus);
+}
+
+static void BM_BufferNewIntegratedFrame(KernelState& state)
+{
+	KernelFrameData* data = state.Data;
+	long totalPixels = data->Width * data->Height;
+
+	SetupKernelCamera(data, 0);
+	SetupAav(4, 0, 8, 0, 0, (LPCTSTR)"Benchmarks", 0, 0);
+	PrepareIntegratedFrame(data);
+
+	while (state.KeepRunning())
+		BufferNewIntegratedFrame(false, 0, 0, 0, 0);
+
+	state.ItemsProcessed = (double)state.Iterations() * totalPixels;
+	state.BytesProcessed = (double)state.Iterations() * totalPixels * sizeof(double);
+}
+
+static void BM_BufferNewIntegratedFrame_Ocr(KernelState& state)
+{
+	KernelFrameData* data = state.Data;
+	long totalPixels = data->Width * data->Height;
+
+	OcrConfiguration ocrConfig;
+	if (!LoadOcrConfiguration("OccuRec/OCR-Settings.xml", "Compatible EasyCap + IOTA-VTI (NON TV-Safe, PAL)", &ocrConfig) ||
+		ocrConfig.Width != data->Width || ocrConfig.Height != data->Height)
+	{
+		state.SkipWithMessage("needs OccuRec/OCR-Settings.xml and a 720x576 frame");
+		return;
+	}
+
+	IotaVtiRenderer vtiRenderer(ocrConfig);
+
+	SetupKernelCamera(data, 0);
+	SetupAav(4, 0, 8, 0, 0, (LPCTSTR)"Benchmarks", 0, 0);
+	SetupCoreOcr(ocrConfig, vtiRenderer.ZoneMatrix());
+	PrepareIntegratedFrame(data);
+
+	while (state.KeepRunning())
+		BufferNewIntegratedFrame(false, 0, 0, 0, 0);
+
+	state.ItemsProcessed = (double)state.Iterations() * totalPixels;
+	state.BytesProcessed = (double)state.Iterations() * totalPixels * sizeof(double);
+
+	DisableOcrProcessing();
+}
+
+static void BM_CalculateDiffSignature(KernelState& state)
+{
+	KernelFrameData* data = state.Data;
+
+	SetupKernelCamera(data, 0);
+
+	float signature;
+	while (state.KeepRunning())
+		CalculateDiffSignature(data->BmpBits, &signature);
+
+	// The signature is calculated from a 32x32 pixels area
+	state.ItemsProcessed = (double)state.Iterations() * 32 * 32;
+	state.BytesProcessed = (double)state.Iterations() * 32 * 32 * 3;
+}
+
+#ifdef _WIN32
+static void BM_GetMonochromePixelsFromBitmap(KernelState& state)
+{
+	KernelFrameData* data = state.Data;
+	long totalPixels = data->Width * data->Height;
+
+	BITMAPINFO bmi;
+	ZeroMemory(&bmi, sizeof(bmi));
+	bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth = data->Width;
+	bmi.bmiHeader.biHeight = data->Height;
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 32;
+	bmi.bmiHeader.biCompression = BI_RGB;
+
+	void* dibBits = NULL;
+	HBITMAP hBitmap = CreateDIBSection(NULL, &bmi, DIB_RGB_COLORS, &dibBits, NULL, 0);
+	if (NULL == hBitmap)
+	{
+		state.SkipWithMessage("CreateDIBSection failed");
+		return;
+	}
+
+	unsigned char* ptrDib = (unsigned char*)dibBits;
+	for (long i = 0; i < totalPixels; i++)
+	{
+		ptrDib[4 * i] = data->BmpBits[3 * i];
+		ptrDib[4 * i + 1] = data->BmpBits[3 * i + 1];
+		ptrDib[4 * i + 2] = data->BmpBits[3 * i + 2];
+		ptrDib[4 * i + 3] = 0;
+	}
+
+	long* pixels = (long*)malloc(totalPixels * sizeof(long));
+
+	// The managed code passes the HBITMAP handle itself
+	while (state.KeepRunning())
+		GetMonochromePixelsFromBitmap(data->Width, data->Height, 8, 0, (HBITMAP*)hBitmap, pixels, 0);
+
+	state.ItemsProcessed = (double)state.Iterations() * totalPixels;
+	state.BytesProcessed = (double)state.Iterations() * totalPixels * 4;
+
+	free(pixels);
+	DeleteObject(hBitmap);
+}
+#else
+static void BM_GetMonochromePixelsFromBitmap(KernelState& state)
+{
+	state.SkipWithMessage("needs a Windows HBITMAP");
+}
+#endif
+
+static void BM_QuickLZCompress(KernelState& state, const void* source, size_t size)
+{
+	char* compressed = (char*)malloc(size + 400);
+	qlz_state_compress* qlzState = (qlz_state_compress*)malloc(sizeof(qlz_state_compress));
+	memset(qlzState, 0, sizeof(qlz_state_compress));
+
+	size_t compressedSize = 0;
+	while (state.KeepRunning())
+		compressedSize = qlz_compress(source, compressed, size, qlzState);
+
+	state.ItemsProcessed = (double)state.Iterations() * state.Data->Width * state.Data->Height;
+	state.BytesProcessed = (double)state.Iterations() * size;
+
+	char label[64];
+	sprintf(label, "ratio %.3f", size > 0 ? (double)compressedSize / size : 0);
+	state.Label = string(label);
+
+	free(qlzState);
+	free(compressed);
+}
+
+static void BM_QuickLZCompress_8(KernelState& state)
+{
+	BM_QuickLZCompress(state, state.Data->Pixels8, state.Data->Width * state.Data->Height);
+}
+
+static void BM_QuickLZCompress_16(KernelState& state)
+{
+	BM_QuickLZCompress(state, state.Data->Pixels16, state.Data->Width * state.Data->Height * sizeof(unsigned short));
+}
+
+// Packed with 12 bits before the compression, as the FULL-IMAGE-BIT-PACKED layouts are. The ratio is to the 16 bit pixels
+static void BM_QuickLZCompress_16_Packed(KernelState& state)
+{
+	KernelFrameData* data = state.Data;
+	long totalPixels = data->Width * data->Height;
+	unsigned char* packed = (unsigned char*)malloc(AavLib::PackedPixelsBytes(totalPixels, 12) + 8);
+	char* compressed = (char*)malloc(totalPixels * sizeof(unsigned short) + 400);
+	qlz_state_compress* qlzState = (qlz_state_compress*)malloc(sizeof(qlz_state_compress));
+	memset(qlzState, 0, sizeof(qlz_state_compress));
+
+	size_t compressedSize = 0;
+	while (state.KeepRunning())
+	{
+		unsigned int packedBytes = AavLib::PackPixels16(data->Pixels16, totalPixels, 12, packed);
+		compressedSize = qlz_compress(packed, compressed, packedBytes, qlzState);
+	}
+
+	state.ItemsProcessed = (double)state.Iterations() * totalPixels;
+	state.BytesProcessed = (double)state.Iterations() * totalPixels * sizeof(unsigned short);
+
+	char label[64];
+	sprintf(label, "ratio %.3f", (double)compressedSize / (totalPixels * sizeof(unsigned short)));
+	state.Label = string(label);
+
+	free(qlzState);
+	free(compressed);
+	free(packed);
+}
+
+static void BM_Lagarith16Compress(KernelState& state, bool reuseTables)
+{
+	KernelFrameData* data = state.Data;
+	long totalPixels = data->Width * data->Height;
+
+	Compressor* compressor = new Compressor(data->Width, data->Height);
+	char* compressed = (char*)malloc(totalPixels * sizeof(unsigned short) + 0x20000 + 1);
+
+	// The frame is compressed again with the tables stored by the first run, as the frames between the key frames
+	if (reuseTables)
+		compressor->CompressDataReusingTables(data->Pixels16, compressed, true);
+
+	int compressedSize = 0;
+	while (state.KeepRunning())
+	{
+		if (reuseTables)
+			compressedSize = compressor->CompressDataReusingTables(data->Pixels16, compressed, false);
+		else
+			compressedSize = compressor->CompressData(data->Pixels16, compressed);
+	}
+
+	state.ItemsProcessed = (double)state.Iterations() * totalPixels;
+	state.BytesProcessed = (double)state.Iterations() * totalPixels * sizeof(unsigned short);
+
+	char label[64];
+	sprintf(label, "ratio %.3f", (double)compressedSize / (totalPixels * sizeof(unsigned short)));
+	state.Label = string(label);
+
+	free(compressed);
+	delete compressor;
+}
+
+static void BM_Lagarith16Compress_NewTables(KernelState& state)
+{
+	BM_Lagarith16Compress(state, false);
+}
+
+static void BM_Lagarith16Compress_ReusedTables(KernelState& state)
+{
+	BM_Lagarith16Compress(state, true);
+}
+
+// The 8 bit frame, the integrated frame scaled to 12 bits, or scaled to 16 bits with noise in the low bits, which
+// gives the decoder a table of thousands of symbols
+static void GetLagarith16Pixels(KernelFrameData* data, int bitsPerPixel, unsigned short* pixels)
+{
+	long totalPixels = data->Width * data->Height;
+	unsigned int random = 1;
+
+	for (long i = 0; i < totalPixels; i++)
+	{
+		random = random * 1103515245 + 12345;
+
+		if (bitsPerPixel == 8)
+			pixels[i] = data->Pixels8[i];
+		else if (bitsPerPixel == 12)
+			pixels[i] = (unsigned short)min(2 * data->Pixels16[i], 0xFFF);
+		else
+			pixels[i] = (unsigned short)min(32 * data->Pixels16[i] + ((random >> 16) & 0x1F), 0xFFFFu);
+	}
+}
+
+static void BM_Lagarith16Decompress(KernelState& state, int bitsPerPixel)
+{
+	KernelFrameData* data = state.Data;
+	long totalPixels = data->Width * data->Height;
+
+	Compressor* compressor = new Compressor(data->Width, data->Height);
+	unsigned short* pixels = (unsigned short*)malloc(totalPixels * sizeof(unsigned short));
+	unsigned short* decompressed = (unsigned short*)malloc(totalPixels * sizeof(unsigned short));
+	char* compressed = (char*)malloc(totalPixels * sizeof(unsigned short) + 0x20000);
+
+	GetLagarith16Pixels(data, bitsPerPixel, pixels);
+	int compressedSize = compressor->CompressData(pixels, compressed);
+	memset(decompressed, 0, totalPixels * sizeof(unsigned short));
+
+	int decompressedSize = 0;
+	while (state.KeepRunning())
+		decompressedSize = compressor->DecompressData(compressed, compressedSize, decompressed);
+
+	state.ItemsProcessed = (double)state.Iterations() * totalPixels;
+	state.BytesProcessed = (double)state.Iterations() * compressedSize;
+
+	// The decoder is checked against the encoder on every run
+	char label[64];
+	if (decompressedSize != compressedSize || 0 != memcmp(pixels, decompressed, totalPixels * sizeof(unsigned short)))
+		sprintf(label, "ROUND TRIP FAILED");
+	else
+		sprintf(label, "ratio %.3f", (double)compressedSize / (totalPixels * sizeof(unsigned short)));
+	state.Label = string(label);
+
+	free(compressed);
+	free(decompressed);
+	free(pixels);
+	delete compressor;
+}
+
+static void BM_Lagarith16Decompress_8(KernelState& state)
+{
+	BM_Lagarith16Decompress(state, 8);
+}
+
+static void BM_Lagarith16Decompress_12(KernelState& state)
+{
+	BM_Lagarith16Decompress(state, 12);
+}
+
+static void BM_Lagarith16Decompress_16(KernelState& state)
+{
+	BM_Lagarith16Decompress(state, 16);
+}
+
+static void BM_Lagarith8(KernelState& state, bool decompress)
+{
+	KernelFrameData* data = state.Data;
+	int totalPixels = data->Width * data->Height;
+
+	Lagarith8Compressor* compressor = new Lagarith8Compressor(data->Width);
+	unsigned char* compressed = (unsigned char*)malloc(Lagarith8Compressor::MaxCompressedBytes(totalPixels));
+	unsigned char* decompressed = (unsigned char*)malloc(totalPixels);
+
+	int compressedSize = compressor->CompressData(data->Pixels8, totalPixels, compressed);
+	memset(decompressed, 0, totalPixels);
+
+	int decompressedSize = 0;
+	while (state.KeepRunning())
+	{
+		if (decompress)
+			decompressedSize = compressor->DecompressData(compressed, compressedSize, decompressed);
+		else
+			compressedSize = compressor->CompressData(data->Pixels8, totalPixels, compressed);
+	}
+
+	state.ItemsProcessed = (double)state.Iterations() * totalPixels;
+	state.BytesProcessed = (double)state.Iterations() * (decompress ? compressedSize : totalPixels);
+
+	// The decoder is checked against the encoder on every run
+	if (!decompress)
+		decompressedSize = compressor->DecompressData(compressed, compressedSize, decompressed);
+
+	char label[64];
+	if (decompressedSize != compressedSize || 0 != memcmp(data->Pixels8, decompressed, totalPixels))
+		sprintf(label, "ROUND TRIP FAILED");
+	else
+		sprintf(label, "ratio %.3f", (double)compressedSize / totalPixels);
+	state.Label = string(label);
+
+	free(decompressed);
+	free(compressed);
+	delete compressor;
+}
+
+static void BM_Lagarith8Compress(KernelState& state)
+{
+	BM_Lagarith8(state, false);
+}
+
+static void BM_Lagarith8Decompress(KernelState& state)
+{
+	BM_Lagarith8(state, true);
+}
+
+static void BM_LocoI(KernelState& state, int bitsPerSample, bool decompress)
+{
+	KernelFrameData* data = state.Data;
+	unsigned int totalPixels = data->Width * data->Height;
+	unsigned int rawBytes = totalPixels * (bitsPerSample / 8);
+	const unsigned char* samples = bitsPerSample == 8 ? data->Pixels8 : (const unsigned char*)data->Pixels16;
+
+	LocoICompressor* compressor = new LocoICompressor(data->Width);
+	unsigned char* compressed = (unsigned char*)malloc(LocoICompressor::MaxCompressedBytes(totalPixels, bitsPerSample));
+	unsigned char* decompressed = (unsigned char*)malloc(rawBytes);
+
+	unsigned int compressedSize = compressor->CompressData(samples, totalPixels, bitsPerSample, compressed);
+	memset(decompressed, 0, rawBytes);
+
+	int decompressedSize = 0;
+	while (state.KeepRunning())
+	{
+		if (decompress)
+			decompressedSize = compressor->DecompressData(compressed, compressedSize, decompressed);
+		else
+			compressedSize = compressor->CompressData(samples, totalPixels, bitsPerSample, compressed);
+	}
+
+	state.ItemsProcessed = (double)state.Iterations() * totalPixels;
+	state.BytesProcessed = (double)state.Iterations() * (decompress ? compressedSize : rawBytes);
+
+	// The decoder is checked against the encoder on every run
+	if (!decompress)
+		decompressedSize = compressor->DecompressData(compressed, compressedSize, decompressed);
+
+	char label[64];
+	if (decompressedSize != (int)compressedSize || 0 != memcmp(samples, decompressed, rawBytes))
+		sprintf(label, "ROUND TRIP FAILED");
+	else
+		sprintf(label, "ratio %.3f", (double)compressedSize / rawBytes);
+	state.Label = string(label);
+
+	free(decompressed);
+	free(compressed);
+	delete compressor;
+}
+
+static void BM_LocoICompress_8(KernelState& state)
+{
+	BM_LocoI(state, 8, false);
+}
+
+static void BM_LocoICompress_16(KernelState& state)
+{
+	BM_LocoI(state, 16, false);
+}
+
+static void BM_LocoIDecompress_8(KernelState& state)
+{
+	BM_LocoI(state, 8, true);
+}
+
+static void BM_LocoIDecompress_16(KernelState& state)
+{
+	BM_LocoI(state, 16, true);
+}
+
+static void BM_Crc32(KernelState& state)
+{
+	KernelFrameData* data = state.Data;
+	long totalPixels = data->Width * data->Height;
+
+	crc32_init();
+
+	unsigned int crc = 0;
+	while (state.KeepRunning())
+		crc ^= compute_crc32(data->Pixels8, totalPixels);
+
+	state.ItemsProcessed = (double)state.Iterations() * totalPixels;
+	state.BytesProcessed = (double)state.Iterations() * totalPixels;
+}
+
+// The CRC-32C which AavImageLayout stores for the pixels of each frame. The label is the share of the time of a PAL
+// frame it takes
+static void BM_Crc32c(KernelState& state, bool sse42)
+{
+	KernelFrameData* data = state.Data;
+	long totalPixels = data->Width * data->Height;
+
+	if (sse42 && !crc32c_has_sse42())
+	{
+		state.SkipWithMessage("no SSE 4.2");
+		return;
+	}
+
+	unsigned int crc = 0;
+	while (state.KeepRunning())
+		crc ^= sse42 ? compute_crc32c_sse42(data->Pixels8, totalPixels) : compute_crc32c_slicing8(data->Pixels8, totalPixels);
+
+	state.ItemsProcessed = (double)state.Iterations() * totalPixels;
+	state.BytesProcessed = (double)state.Iterations() * totalPixels;
+
+	char label[64];
+	sprintf(label, "%.3f%% of a 40 ms frame", 100.0 * state.ElapsedSeconds() / state.Iterations() / 0.040);
+	state.Label = string(label);
+}
+
+static void BM_Crc32c_Slicing8(KernelState& state)
+{
+	BM_Crc32c(state, false);
+}
+
+static void BM_Crc32c_Sse42(KernelState& state)
+{
+	BM_Crc32c(state, true);
+}
+
+// The 16 bit pixels, which are the sums of KERNEL_INTEGRATED_FRAMES frames, packed with 12 bits after checking that they
+// fit in them, and unpacked
+static void BM_BitPacking(KernelState& state, bool unpack)
+{
+	KernelFrameData* data = state.Data;
+	long totalPixels = data->Width * data->Height;
+	unsigned char* packed = (unsigned char*)malloc(AavLib::PackedPixelsBytes(totalPixels, 12) + 8);
+	unsigned short* pixels = (unsigned short*)malloc(totalPixels * sizeof(unsigned short));
+
+	if (!AavLib::PixelsFitInBits(data->Pixels16, totalPixels, 12))
+	{
+		state.SkipWithMessage("the pixels do not fit in 12 bits");
+		free(pixels);
+		free(packed);
+		return;
+	}
+
+	unsigned int packedBytes = AavLib::PackPixels16(data->Pixels16, totalPixels, 12, packed);
+
+	if (unpack)
+	{
+		while (state.KeepRunning())
+			AavLib::UnpackPixels16(packed, totalPixels, 12, pixels);
+
+		if (0 != memcmp(pixels, data->Pixels16, totalPixels * sizeof(unsigned short)))
+			state.SkipWithMessage("the unpacked pixels differ");
+	}
+	else
+	{
+		while (state.KeepRunning())
+		{
+			if (AavLib::PixelsFitInBits(data->Pixels16, totalPixels, 12))
+				packedBytes = AavLib::PackPixels16(data->Pixels16, totalPixels, 12, packed);
+		}
+	}
+
+	state.ItemsProcessed = (double)state.Iterations() * totalPixels;
+	state.BytesProcessed = (double)state.Iterations() * totalPixels * sizeof(unsigned short);
+
+	if (!state.Skipped)
+	{
+		char label[64];
+		sprintf(label, "ratio %.3f", (double)packedBytes / (totalPixels * sizeof(unsigned short)));
+		state.Label = string(label);
+	}
+
+	free(pixels);
+	free(packed);
+}
+
+static void BM_BitPacking_Pack(KernelState& state)
+{
+	BM_BitPacking(state, false);
+}
+
+static void BM_BitPacking_Unpack(KernelState& state)
+{
+	BM_BitPacking(state, true);
+}
+
+// The differences of the second of the consecutive 8 bit frames from the first, as the diff coded layouts take them
+// from the previous frame while copying the frame for the next one, and adding the differences with signs back
+static void BM_DiffCoding8(KernelState& state, bool withSigns, bool decode)
+{
+	KernelFrameData* data = state.Data;
+	long totalPixels = data->Width * data->Height;
+	const unsigned char* basePixels = data->Sequence8;
+	const unsigned char* framePixels = data->Sequence8 + totalPixels;
+	unsigned char* signs = (unsigned char*)malloc(totalPixels / 8 + 1);
+	unsigned char* differences = (unsigned char*)malloc(totalPixels);
+	unsigned char* pixels = (unsigned char*)malloc(totalPixels);
+
+	AavLib::SubtractPixelsWithSigns8(framePixels, basePixels, totalPixels, signs, differences, pixels);
+
+	if (decode)
+	{
+		while (state.KeepRunning())
+			AavLib::AddPixelsWithSigns8(basePixels, signs, differences, totalPixels, pixels);
+
+		if (0 != memcmp(pixels, framePixels, totalPixels))
+			state.SkipWithMessage("the decoded pixels differ");
+	}
+	else if (withSigns)
+	{
+		while (state.KeepRunning())
+			AavLib::SubtractPixelsWithSigns8(framePixels, basePixels, totalPixels, signs, differences, pixels);
+	}
+	else
+	{
+		while (state.KeepRunning())
+			AavLib::SubtractPixels8(framePixels, basePixels, totalPixels, differences, pixels);
+	}
+
+	state.ItemsProcessed = (double)state.Iterations() * totalPixels;
+	state.BytesProcessed = (double)state.Iterations() * totalPixels;
+
+	free(pixels);
+	free(differences);
+	free(signs);
+}
+
+static void BM_DiffCoding8_NoSigns(KernelState& state)
+{
+	BM_DiffCoding8(state, false, false);
+}
+
+static void BM_DiffCoding8_Signs(KernelState& state)
+{
+	BM_DiffCoding8(state, true, false);
+}
+
+static void BM_DiffCoding8_Signs_Decode(KernelState& state)
+{
+	BM_DiffCoding8(state, true, true);
+}
+
+// The zigzag coded differences of the 16 bit sum from the sum of its frames but the last one, and adding them back
+static void BM_DiffCoding16(KernelState& state, bool decode)
+{
+	KernelFrameData* data = state.Data;
+	long totalPixels = data->Width * data->Height;
+	const unsigned char* lastFrame = data->Sequence8 + (KERNEL_INTEGRATED_FRAMES - 1) * totalPixels;
+	unsigned short* basePixels = (unsigned short*)malloc(totalPixels * sizeof(unsigned short));
+	unsigned char* differences = (unsigned char*)malloc(totalPixels * sizeof(unsigned short));
+	unsigned short* pixels = (unsigned short*)malloc(totalPixels * sizeof(unsigned short));
+
+	for (long i = 0; i < totalPixels; i++)
+		basePixels[i] = (unsigned short)(data->Pixels16[i] - lastFrame[i]);
+
+	AavLib::SubtractPixelsZigZag16(data->Pixels16, basePixels, totalPixels, differences, pixels);
+
+	if (decode)
+	{
+		while (state.KeepRunning())
+			AavLib::AddPixelsZigZag16(basePixels, differences, totalPixels, pixels);
+
+		if (0 != memcmp(pixels, data->Pixels16, totalPixels * sizeof(unsigned short)))
+			state.SkipWithMessage("the decoded pixels differ");
+	}
+	else
+	{
+		while (state.KeepRunning())
+			AavLib::SubtractPixelsZigZag16(data->Pixels16, basePixels, totalPixels, differences, pixels);
+	}
+
+	state.ItemsProcessed = (double)state.Iterations() * totalPixels;
+	state.BytesProcessed = (double)state.Iterations() * totalPixels * sizeof(unsigned short);
+
+	free(pixels);
+	free(differences);
+	free(basePixels);
+}
+
+static void BM_DiffCoding16_ZigZag(KernelState& state)
+{
+	BM_DiffCoding16(state, false);
+}
+
+static void BM_DiffCoding16_ZigZag_Decode(KernelState& state)
+{
+	BM_DiffCoding16(state, true);
+}
+
+// Indexing and then writing the index of a long recording, as done by AavFile::EndFrame() and AavFile::EndFile()
+static void BM_AavFramesIndexBuildAndWrite(KernelState& state)
+{
+	FILE* file = tmpfile();
+	if (NULL == file)
+	{
+		state.SkipWithMessage("cannot create a temporary file");
+		return;
+	}
+
+	while (state.KeepRunning())
+	{
+		AavLib::AavFramesIndex* index = new AavLib::AavFramesIndex();
+
+		for (unsigned int i = 0; i < KERNEL_INDEX_FRAMES; i++)
+			index->AddFrame(i, i * 40, 1000 + (__int64)i * 100000, 99996, (long long)i * 40, (i % 32) == 0);
+
+		fseek(file, 0, SEEK_SET);
+		index->WriteIndex(file);
+		fflush(file);
+
+		delete index;
+	}
+
+	state.ItemsProcessed = (double)state.Iterations() * KERNEL_INDEX_FRAMES;
+	state.BytesProcessed = state.ItemsProcessed * 16;
+
+	fclose(file);
+}
+
+// Seeking to a time in a long recording
+static void BM_AavFramesIndexFindFrame(KernelState& state)
+{
+	AavLib::AavFramesIndex* index = new AavLib::AavFramesIndex();
+	for (unsigned int i = 0; i < KERNEL_INDEX_FRAMES; i++)
+		index->AddFrame(i, i * 40, 1000 + (__int64)i * 100000, 99996, (long long)i * 40, (i % 32) == 0);
+
+	long long timeStamp = 0;
+	volatile int frameNo = 0;
+	while (state.KeepRunning())
+	{
+		frameNo = index->FindFrame(timeStamp);
+		timeStamp = (timeStamp + 7919) % (KERNEL_INDEX_FRAMES * 40LL);
+	}
+
+	state.ItemsProcessed = (double)state.Iterations();
+
+	char label[64];
+	sprintf(label, "%d frames", index->GetFramesCount());
+	state.Label = string(label);
+
+	delete index;
+}
+
+// Encoding the status section of a frame with the tags recorded by OccuRec with NTP and OCR timestamps
+static void BM_AavStatusSectionEncode(KernelState& state, unsigned int snapshotInterval)
+{
+	AavLib::AavStatusSection* section = new AavLib::AavStatusSection();
+	section->SetSnapshotInterval(snapshotInterval);
+
+	unsigned int systemTime = section->DefineTag("SystemTime", ULong64);
+	unsigned int integratedFrames = section->DefineTag("IntegratedFrames", UInt16);
+	unsigned int startFrame = section->DefineTag("StartFrame", ULong64);
+	unsigned int endFrame = section->DefineTag("EndFrame", ULong64);
+	unsigned int startTimestamp = section->DefineTag("StartFrameTimestamp", AnsiString255);
+	unsigned int endTimestamp = section->DefineTag("EndFrameTimestamp", AnsiString255);
+	unsigned int gpsTrackedSatellites = section->DefineTag("GPSTrackedSatellites", UInt8);
+	unsigned int gpsAlmanac = section->DefineTag("GPSAlmanacStatus", UInt8);
+	unsigned int gpsFix = section->DefineTag("GPSFixStatus", UInt8);
+	unsigned int ntpStartTimestamp = section->DefineTag("NTPStartTimestamp", ULong64);
+	unsigned int ntpEndTimestamp = section->DefineTag("NTPEndTimestamp", ULong64);
+	unsigned int ntpTimeError = section->DefineTag("NTPTimestampError", UInt16);
+
+	unsigned char* statusBytes = (unsigned char*)malloc(section->MaxFrameBufferSize);
+
+	// The OCR timestamps of one minute of PAL video
+	vector<string> startTimestamps;
+	vector<string> endTimestamps;
+	for (int i = 0; i < KERNEL_STATUS_FRAMES; i++)
+	{
+		char timestamp[32];
+		sprintf(timestamp, "01:23:%02d.%04d %08d", (i / 25) % 60, (i % 25) * 400, i * 4);
+		startTimestamps.push_back(string(timestamp));
+		sprintf(timestamp, "01:23:%02d.%04d %08d", (i / 25) % 60, (i % 25) * 400 + 360, i * 4 + 3);
+		endTimestamps.push_back(string(timestamp));
+	}
+	unsigned int statusBytesCount = 0;
+	long long totalStatusBytes = 0;
+	long long frameNo = 0;
+
+	while (state.KeepRunning())
+	{
+		section->BeginFrame();
+		section->AddFrameStatusTagUInt16(integratedFrames, 4);
+		section->AddFrameStatusTagUInt64(startFrame, frameNo * 4);
+		section->AddFrameStatusTagUInt64(endFrame, frameNo * 4 + 3);
+		section->AddFrameStatusTagUInt64(systemTime, 635000000000000000LL + frameNo * 400000);
+		section->AddFrameStatusTag(startTimestamp, startTimestamps[frameNo % KERNEL_STATUS_FRAMES].c_str());
+		section->AddFrameStatusTag(endTimestamp, endTimestamps[frameNo % KERNEL_STATUS_FRAMES].c_str());
+		section->AddFrameStatusTagUInt8(gpsTrackedSatellites, 9);
+		section->AddFrameStatusTagUInt8(gpsAlmanac, 1);
+		section->AddFrameStatusTagUInt8(gpsFix, 2);
+		section->AddFrameStatusTagUInt64(ntpStartTimestamp, 635000000000000000LL + frameNo * 400000);
+		section->AddFrameStatusTagUInt64(ntpEndTimestamp, 635000000000000000LL + frameNo * 400000 + 399999);
+		section->AddFrameStatusTagUInt16(ntpTimeError, 12 + (int)(frameNo % 3));
+		section->GetDataBytes(statusBytes, &statusBytesCount);
+
+		totalStatusBytes += statusBytesCount;
+		frameNo++;
+	}
+
+	state.ItemsProcessed = (double)state.Iterations();
+	state.BytesProcessed = (double)totalStatusBytes;
+
+	char label[64];
+	sprintf(label, "%.1f bytes/frame", frameNo > 0 ? (double)totalStatusBytes / frameNo : 0);
+	state.Label = string(label);
+
+	free(statusBytes);
+	delete section;
+}
+
+static void BM_AavStatusSectionEncode_Full(KernelState& state)
+{
+	BM_AavStatusSectionEncode(state, 0);
+}
+
+static void BM_AavStatusSectionEncode_Delta(KernelState& state)
+{
+	BM_AavStatusSectionEncode(state, 64);
+}
+
+static void BM_PsfFit(KernelState& state, long matrixSize)
+{
+	KernelFrameData* data = state.Data;
+	long halfWidth = matrixSize / 2;
+
+	unsigned long* matrix = (unsigned long*)malloc(matrixSize * matrixSize * sizeof(unsigned long));
+	for (long y = 0; y < matrixSize; y++)
+		for (long x = 0; x < matrixSize; x++)
+			matrix[y * matrixSize + x] = data->Pixels8[(data->StarY - halfWidth + y) * data->Width + data->StarX - halfWidth + x];
+
+	PsfFit* psfFit = new PsfFit(DataRange8Bit);
+	psfFit->FittingMethod = NonLinearFit;
+
+	while (state.KeepRunning())
+		psfFit->Fit(data->StarX, data->StarY, matrix, matrixSize);
+
+	state.ItemsProcessed = (double)state.Iterations() * matrixSize * matrixSize;
+	state.BytesProcessed = (double)state.Iterations() * matrixSize * matrixSize * sizeof(unsigned long);
+
+	char label[64];
+	sprintf(label, "%s FWHM %.2f", psfFit->IsSolved() ? "solved" : "NOT solved", psfFit->FWHM());
+	state.Label = string(label);
+
+	delete psfFit;
+	free(matrix);
+}
+
+static void BM_PsfFit_17(KernelState& state)
+{
+	BM_PsfFit(state, 17);
+}
+
+static void BM_PsfFit_35(KernelState& state)
+{
+	BM_PsfFit(state, 35);
+}
+
+static void BM_MeasureObjectUsingAperturePhotometry(KernelState& state)
+{
+	KernelFrameData* data = state.Data;
+
+	float aperture = 4.0f;
+	float totalPixels = 0;
+	bool hasSaturatedPixels = false;
+	float reading = 0;
+
+	while (state.KeepRunning())
+		reading = MeasureObjectUsingAperturePhotometry(
+			data->PixelsLong, aperture, data->Width, data->Height, (float)data->StarX, (float)data->StarY, 255, 2.0f, 350,
+			&totalPixels, &hasSaturatedPixels);
+
+	// The signal aperture and the background annulus
+	state.ItemsProcessed = (double)state.Iterations() * (totalPixels + 350);
+	state.BytesProcessed = state.ItemsProcessed * sizeof(unsigned long);
+
+	char label[64];
+	sprintf(label, "reading %.0f", reading);
+	state.Label = string(label);
+}
+
+static KernelBenchmark KERNEL_BENCHMARKS[] =
+{
+	{ "AccumulateMonochromePixels/R",      BM_AccumulateMonochromePixels_R,         true },
+	{ "AccumulateMonochromePixels/Luma",   BM_AccumulateMonochromePixels_Luma,      true },
+	{ "BufferNewIntegratedFrame",          BM_BufferNewIntegratedFrame,             true },
+	{ "BufferNewIntegratedFrame/OCR",      BM_BufferNewIntegratedFrame_Ocr,         true },
+	{ "CalculateDiffSignature",            BM_CalculateDiffSignature,               false },
+	{ "GetMonochromePixelsFromBitmap",     BM_GetMonochromePixelsFromBitmap,        true },
+	{ "QuickLZ/8bit",                      BM_QuickLZCompress_8,                    true },
+	{ "QuickLZ/16bit",                     BM_QuickLZCompress_16,                   true },
+	{ "QuickLZ/16bit/Packed12",            BM_QuickLZCompress_16_Packed,            true },
+	{ "Lagarith16",                        BM_Lagarith16Compress_NewTables,         true },
+	{ "Lagarith16/ReusedTables",           BM_Lagarith16Compress_ReusedTables,      true },
+	{ "Lagarith16/Decompress/8bit",        BM_Lagarith16Decompress_8,               true },
+	{ "Lagarith16/Decompress/12bit",       BM_Lagarith16Decompress_12,              true },
+	{ "Lagarith16/Decompress/16bit",       BM_Lagarith16Decompress_16,              true },
+	{ "Lagarith8",                         BM_Lagarith8Compress,                    true },
+	{ "Lagarith8/Decompress",              BM_Lagarith8Decompress,                  true },
+	{ "LocoI/8bit",                        BM_LocoICompress_8,                      true },
+	{ "LocoI/16bit",                       BM_LocoICompress_16,                     true },
+	{ "LocoI/Decompress/8bit",             BM_LocoIDecompress_8,                    true },
+	{ "LocoI/Decompress/16bit",            BM_LocoIDecompress_16,                   true },
+	{ "crc32",                             BM_Crc32,                                true },
+	{ "crc32c/Slicing8",                   BM_Crc32c_Slicing8,                      true },
+	{ "crc32c/SSE4.2",                     BM_Crc32c_Sse42,                         true },
+	{ "BitPacking/12bit",                  BM_BitPacking_Pack,                      true },
+	{ "BitPacking/Unpack/12bit",           BM_BitPacking_Unpack,                    true },
+	{ "DiffCoding/8bit/NoSigns",           BM_DiffCoding8_NoSigns,                  true },
+	{ "DiffCoding/8bit/Signs",             BM_DiffCoding8_Signs,                    true },
+	{ "DiffCoding/Decode/8bit/Signs",      BM_DiffCoding8_Signs_Decode,             true },
+	{ "DiffCoding/16bit/ZigZag",           BM_DiffCoding16_ZigZag,                  true },
+	{ "DiffCoding/Decode/16bit/ZigZag",    BM_DiffCoding16_ZigZag_Decode,           true },
+	{ "AavFramesIndex/BuildAndWrite",      BM_AavFramesIndexBuildAndWrite,          false },
+	{ "AavFramesIndex/FindFrame",          BM_AavFramesIndexFindFrame,              false },
+	{ "AavStatusSection/Encode",           BM_AavStatusSectionEncode_Full,          false },
+	{ "AavStatusSection/Encode/Delta",     BM_AavStatusSectionEncode_Delta,         false },
+	{ "PsfFit/17",                         BM_PsfFit_17,                            false },
+	{ "PsfFit/35",                         BM_PsfFit_35,                            false },
+	{ "MeasureObjectUsingAperturePhotometry", BM_MeasureObjectUsingAperturePhotometry, false }
+};
+
+#define KERNEL_BENCHMARKS_COUNT (sizeof(KERNEL_BENCHMARKS) / sizeof(KernelBenchmark))
+
+static void CreateKernelFrameData(long width, long height, KernelFrameData* data)
+{
+	long totalPixels = width * height;
+
+	data->Width = width;
+	data->Height = height;
+	data->BmpBits = (unsigned char*)malloc(totalPixels * 3);
+	data->Pixels8 = (unsigned char*)malloc(totalPixels);
+	data->Pixels16 = (unsigned short*)malloc(totalPixels * sizeof(unsigned short));
+	data->Sequence8 = (unsigned char*)malloc(KERNEL_INTEGRATED_FRAMES * totalPixels);
+	data->PixelsLong = (unsigned long*)malloc(totalPixels * sizeof(unsigned long));
+
+	SyntheticVideoConfig config;
+	InitSyntheticVideoConfig(&config, width, height, 1);
+	SyntheticVideo video(config);
+
+	memset(data->Pixels16, 0, totalPixels * sizeof(unsigned short));
+
+	for (int frame = 0; frame < KERNEL_INTEGRATED_FRAMES; frame++)
+	{
+		video.NextFrame(data->BmpBits);
+
+		for (long y = 0; y < height; y++)
+		{
+			unsigned char* ptrRow = data->BmpBits + (height - 1 - y) * width * 3;
+			for (long x = 0; x < width; x++)
+			{
+				data->Pixels16[y * width + x] += ptrRow[3 * x];
+				data->Sequence8[frame * totalPixels + y * width + x] = ptrRow[3 * x];
+			}
+		}
+	}
+
+	for (long y = 0; y < height; y++)
+	{
+		unsigned char* ptrRow = data->BmpBits + (height - 1 - y) * width * 3;
+		for (long x = 0; x < width; x++)
+		{
+			data->Pixels8[y * width + x] = ptrRow[3 * x];
+			data->PixelsLong[y * width + x] = ptrRow[3 * x];
+		}
+	}
+
+	// Use the brightest pixel away from the edges as the star for the PSF fitting and the photometry
+	long bestValue = -1;
+	data->StarX = width / 2;
+	data->StarY = height / 2;
+
+	for (long y = 20; y < height - 20; y++)
+	{
+		for (long x = 20; x < width - 20; x++)
+		{
+			if (data->Pixels8[y * width + x] > bestValue && data->Pixels8[y * width + x] < 250)
+			{
+				bestValue = data->Pixels8[y * width + x];
+				data->StarX = x;
+				data->StarY = y;
+			}
+		}
+	}
+}
+
+static void FreeKernelFrameData(KernelFrameData* data)
+{
+	free(data->BmpBits);
+	free(data->Pixels8);
+	free(data->Pixels16);
+	free(data->Sequence8);
+	free(data->PixelsLong);
+}
+
+static void FormatRate(double perSecond, const char* unit, char* buffer)
+{
+	if (perSecond >= 1E9)
+		sprintf(buffer, "%.2fG%s/s", perSecond / 1E9, unit);
+	else if (perSecond >= 1E6)
+		sprintf(buffer, "%.2fM%s/s", perSecond / 1E6, unit);
+	else if (perSecond >= 1E3)
+		sprintf(buffer, "%.2fk%s/s", perSecond / 1E3, unit);
+	else
+		sprintf(buffer, "%.2f%s/s", perSecond, unit);
+}
+
+static void RunKernel(const KernelBenchmark& kernel, KernelFrameData* data, double minTime, FILE* csvFile)
+{
+	char name[128];
+	if (kernel.IsFrameSizeDependent)
+		sprintf(name, "%s/%ldx%ld", kernel.Name, data->Width, data->Height);
+	else
+		sprintf(name, "%s", kernel.Name);
+
+	// Grow the iterations until the run takes long enough to be measured reliably
+	long long iterations = 1;
+
+	for(;;)
+	{
+		KernelState state(data, iterations);
+		kernel.Run(state);
+
+		if (state.Skipped)
+		{
+			printf("%-52s %s\n", name, ("SKIPPED: " + state.Label).c_str());
+			return;
+		}
+
+		double elapsed = state.ElapsedSeconds();
+
+		if (elapsed >= minTime || iterations >= KERNEL_MAX_ITERATIONS)
+		{
+			double nsPerIteration = elapsed * 1E9 / state.Iterations();
+			char itemsRate[32];
+			char bytesRate[32];
+			FormatRate(state.ItemsProcessed / elapsed, "", itemsRate);
+			FormatRate(state.BytesProcessed / elapsed, "B", bytesRate);
+
+			printf("%-52s %12.0f ns %12lld %14s %14s  %s\n", name, nsPerIteration, state.Iterations(), itemsRate, bytesRate, state.Label.c_str());
+
+			if (NULL != csvFile)
+				fprintf(csvFile, "%s,%ld,%ld,%.1f,%lld,%.0f,%.0f\n",
+					kernel.Name, data->Width, data->Height, nsPerIteration, state.Iterations(),
+					state.ItemsProcessed / elapsed, state.BytesProcessed / elapsed);
+			return;
+		}
+
+		// Aim for 1.4x the minimum time, at most 10x more iterations per step
+		double multiplier = elapsed > 0 ? minTime * 1.4 / elapsed : 10;
+		if (multiplier > 10) multiplier = 10;
+		if (multiplier < 2) multiplier = 2;
+
+		iterations = (long long)(iterations * multiplier);
+	}
+}
+
+static bool ParseFrameSizes(const char* sizes, vector<long>* widths, vector<long>* heights)
+{
+	const char* ptr = sizes;
+
+	while (*ptr != '\0')
+	{
+		long width;
+		long height;
+		int consumed;
+
+		if (sscanf(ptr, "%ldx%ld%n", &width, &height, &consumed) != 2 || width < 72 || height < 72)
+			return false;
+
+		widths->push_back(width);
+		heights->push_back(height);
+
+		ptr += consumed;
+		if (*ptr == ',')
+			ptr++;
+	}
+
+	return widths->size() > 0;
+}
+
+void PrintKernelBenchmarksUsage()
+{
+	printf("kernels [options]\n");
+	printf("  Microbenchmarks of the core pixel kernels. Pixels/s and bytes/s are for the data read by the kernel.\n");
+	printf("    --filter TEXT          Only run the kernels with TEXT in their name\n");
+	printf("    --sizes WxH,...        Frame sizes (default: 352x288,720x576,1280x1024)\n");
+	printf("    --min-time S           Minimum measured time per kernel in seconds (default: 0.5)\n");
+	printf("    --csv FILE             Write the results to a CSV file\n");
+	printf("    --list                 List the kernels\n");
+}
+
+int RunKernelBenchmarks(int argc, char** argv)
+{
+	BenchmarkArgs args(argc, argv, 2);
+
+	if (args.Has("list"))
+	{
+		for (unsigned int i = 0; i < KERNEL_BENCHMARKS_COUNT; i++)
+			printf("%s\n", KERNEL_BENCHMARKS[i].Name);
+
+		return BENCHMARK_EXIT_OK;
+	}
+
+	const char* filter = args.GetString("filter", "");
+	double minTime = args.GetDouble("min-time", 0.5);
+
+	vector<long> widths;
+	vector<long> heights;
+	if (!ParseFrameSizes(args.GetString("sizes", "352x288,720x576,1280x1024"), &widths, &heights) || minTime <= 0)
+	{
+		PrintKernelBenchmarksUsage();
+		return BENCHMARK_EXIT_USAGE;
+	}
+
+	FILE* csvFile = NULL;
+	if (args.Has("csv"))
+	{
+		csvFile = fopen(args.GetString("csv", ""), "w");
+		if (NULL != csvFile)
+			fprintf(csvFile, "kernel,width,height,ns_per_iteration,iterations,items_per_second,bytes_per_second\n");
+	}
+
+	printf("%-52s %15s %12s %14s %14s\n", "Benchmark", "Time", "Iterations", "Pixels/s", "Bytes/s");
+	printf("%s\n", string(112, '-').c_str());
+
+	for (unsigned int s = 0; s < widths.size(); s++)
+	{
+		KernelFrameData data;
+		CreateKernelFrameData(widths[s], heights[s], &data);
+
+		for (unsigned int i = 0; i < KERNEL_BENCHMARKS_COUNT; i++)
+		{
+			if (*filter != '\0' && strstr(KERNEL_BENCHMARKS[i].Name, filter) == NULL)
+				continue;
+
+			// The kernels which do not depend on the frame size run with the frame data of the first size only
+			if (!KERNEL_BENCHMARKS[i].IsFrameSizeDependent && s > 0)
+				continue;
+
+			RunKernel(KERNEL_BENCHMARKS[i], &data, minTime, csvFile);
+		}
+
+		FreeKernelFrameData(&data);
+	}
+
+	if (NULL != csvFile)
+		fclose(csvFile);
+
+	return BENCHMARK_EXIT_OK;
+}
+
+}
@@ -0,0 +1,19 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef KERNEL_BENCHMARKS_H
+#define KERNEL_BENCHMARKS_H
+
+namespace OccuRecBenchmarks
+{
+
+// Microbenchmarks of the core pixel kernels at several frame sizes. Each kernel is run for a growing number of
+// iterations until it takes at least the minimum time, as Google Benchmark does, and reports pixels/s and bytes/s
+int RunKernelBenchmarks(int argc, char** argv);
+
+void PrintKernelBenchmarksUsage();
+
+}
+
+#endif // KERNEL_BENCHMARKS_H
@@ -0,0 +1,497 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+
+#include "OcrConfiguration.h"
+
+#include "OccuRec.Core.h"
+#include "OccuRec.Ocr.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <map>
+
+namespace OccuRecBenchmarks
+{
+
+// Just enough of an XML reader for the OCR settings file: elements, attributes, text and comments
+struct XmlElement
+{
+	string Name;
+	map<string, string> Attributes;
+	string Text;
+	vector<XmlElement> Children;
+
+	const XmlElement* Child(const char* name) const
+	{
+		for (unsigned int i = 0; i < Children.size(); i++)
+			if (Children[i].Name == name) return &Children[i];
+
+		return NULL;
+	}
+
+	string Attribute(const char* name) const
+	{
+		map<string, string>::const_iterator it = Attributes.find(name);
+		return it != Attributes.end() ? it->second : string();
+	}
+
+	long ChildLong(const char* name, long defaultValue) const
+	{
+		const XmlElement* child = Child(name);
+		return NULL != child && !child->Text.empty() ? atol(child->Text.c_str()) : defaultValue;
+	}
+};
+
+class XmlReader
+{
+	private:
+		const string& m_Xml;
+		size_t m_Pos;
+
+		bool StartsWith(const char* token)
+		{
+			return m_Xml.compare(m_Pos, strlen(token), token) == 0;
+		}
+
+		void SkipWhiteSpace()
+		{
+			while (m_Pos < m_Xml.size() && isspace((unsigned char)m_Xml[m_Pos])) m_Pos++;
+		}
+
+		bool SkipPast(const char* token)
+		{
+			size_t end = m_Xml.find(token, m_Pos);
+			if (end == string::npos) return false;
+
+			m_Pos = end + strlen(token);
+			return true;
+		}
+
+		// Skips the declaration, processing instructions and comments
+		bool SkipMarkup()
+		{
+			while (true)
+			{
+				SkipWhiteSpace();
+
+				if (StartsWith("<?"))
+				{
+					if (!SkipPast("?>")) return false;
+				}
+				else if (StartsWith("<!--"))
+				{
+					if (!SkipPast("-->")) return false;
+				}
+				else if (StartsWith("<!"))
+				{
+					if (!SkipPast(">")) return false;
+				}
+				else
+					return true;
+			}
+		}
+
+		string ReadName()
+		{
+			size_t start = m_Pos;
+			while (m_Pos < m_Xml.size() && !isspace((unsigned char)m_Xml[m_Pos]) && m_Xml[m_Pos] != '>' && m_Xml[m_Pos] != '/' && m_Xml[m_Pos] != '=')
+				m_Pos++;
+
+			return m_Xml.substr(start, m_Pos - start);
+		}
+
+		static string Decode(const string& text)
+		{
+			string rv;
+			for (size_t i = 0; i < text.size(); i++)
+			{
+				if (text[i] == '&')
+				{
+					size_t end = text.find(';', i);
+					if (end != string::npos)
+					{
+						string entity = text.substr(i + 1, end - i - 1);
+						if (entity == "amp") { rv += '&'; i = end; continue; }
+						if (entity == "lt") { rv += '<'; i = end; continue; }
+						if (entity == "gt") { rv += '>'; i = end; continue; }
+						if (entity == "quot") { rv += '"'; i = end; continue; }
+						if (entity == "apos") { rv += '\''; i = end; continue; }
+					}
+				}
+
+				rv += text[i];
+			}
+
+			return rv;
+		}
+
+		static string Trim(const string& text)
+		{
+			size_t from = 0;
+			size_t to = text.size();
+			while (from < to && isspace((unsigned char)text[from])) from++;
+			while (to > from && isspace((unsigned char)text[to - 1])) to--;
+
+			return text.substr(from, to - from);
+		}
+
+	public:
+		XmlReader(const string& xml) : m_Xml(xml)
+		{
+			m_Pos = 0;
+
+			// UTF-8 byte order mark
+			if (m_Xml.compare(0, 3, "\xEF\xBB\xBF") == 0)
+				m_Pos = 3;
+		}
+
+		bool ReadDocument(XmlElement* root)
+		{
+			return SkipMarkup() && ReadElement(root);
+		}
+
+		bool ReadElement(XmlElement* element)
+		{
+			if (!StartsWith("<")) return false;
+			m_Pos++;
+
+			element->Name = ReadName();
+			if (element->Name.empty()) return false;
+
+			while (true)
+			{
+				SkipWhiteSpace();
+				if (m_Pos >= m_Xml.size()) return false;
+
+				if (StartsWith("/>"))
+				{
+					m_Pos += 2;
+					return true;
+				}
+
+				if (m_Xml[m_Pos] == '>')
+				{
+					m_Pos++;
+					break;
+				}
+
+				string attributeName = ReadName();
+				SkipWhiteSpace();
+				if (attributeName.empty() || !StartsWith("=")) return false;
+				m_Pos++;
+				SkipWhiteSpace();
+
+				char quote = m_Xml[m_Pos];
+				if (quote != '"' && quote != '\'') return false;
+				size_t end = m_Xml.find(quote, m_Pos + 1);
+				if (end == string::npos) return false;
+
+				element->Attributes[attributeName] = Decode(m_Xml.substr(m_Pos + 1, end - m_Pos - 1));
+				m_Pos = end + 1;
+			}
+
+			string text;
+			while (m_Pos < m_Xml.size())
+			{
+				if (StartsWith("</"))
+				{
+					m_Pos += 2;
+					string closingName = ReadName();
+					if (closingName != element->Name || !SkipPast(">")) return false;
+
+					element->Text = Trim(Decode(text));
+					return true;
+				}
+
+				if (StartsWith("<!--"))
+				{
+					if (!SkipPast("-->")) return false;
+				}
+				else if (StartsWith("<"))
+				{
+					element->Children.push_back(XmlElement());
+					if (!ReadElement(&element->Children.back())) return false;
+				}
+				else
+				{
+					size_t end = m_Xml.find('<', m_Pos);
+					if (end == string::npos) return false;
+
+					text += m_Xml.substr(m_Pos, end - m_Pos);
+					m_Pos = end;
+				}
+			}
+
+			return false;
+		}
+};
+
+static long ParseZoneValue(const string& value)
+{
+	if (value == "On") return ZoneBehaviour::On;
+	if (value == "Off") return ZoneBehaviour::Off;
+	if (value == "Gray") return ZoneBehaviour::Gray;
+	if (value == "NotOn") return ZoneBehaviour::NotOn;
+	if (value == "NotOff") return ZoneBehaviour::NotOff;
+	if (value == "OnOff") return ZoneBehaviour::OnOff;
+	if (value == "OffOn") return ZoneBehaviour::OffOn;
+	if (value == "NotOnOff") return ZoneBehaviour::NotOnOff;
+	if (value == "NotOffOn") return ZoneBehaviour::NotOffOn;
+
+	return -1;
+}
+
+static bool ReadOcrConfiguration(const XmlElement& xmlConfig, OcrConfiguration* config)
+{
+	config->Name = xmlConfig.Attribute("Name");
+	config->Mode = xmlConfig.Attribute("Mode") == "SplitZones" ? ZoneMode::SplitZones : ZoneMode::Standard;
+
+	const XmlElement* alignment = xmlConfig.Child("Alignment");
+	if (NULL == alignment) return false;
+
+	config->Width = alignment->ChildLong("Width", 0);
+	config->Height = alignment->ChildLong("Height", 0);
+	config->FrameTopOdd = alignment->ChildLong("FrameTopOdd", 0);
+	config->FrameTopEven = alignment->ChildLong("FrameTopEven", 0);
+	config->CharWidth = alignment->ChildLong("CharWidth", 0);
+	config->CharHeight = alignment->ChildLong("CharHeight", 0);
+
+	config->CharPositions.clear();
+	const XmlElement* charPositions = alignment->Child("CharPositions");
+	if (NULL != charPositions)
+	{
+		for (unsigned int i = 0; i < charPositions->Children.size(); i++)
+			config->CharPositions.push_back(atol(charPositions->Children[i].Text.c_str()));
+	}
+
+	config->Zones.clear();
+	const XmlElement* zones = xmlConfig.Child("Zones");
+	if (NULL != zones)
+	{
+		for (unsigned int i = 0; i < zones->Children.size(); i++)
+		{
+			const XmlElement& xmlZone = zones->Children[i];
+
+			OcrZoneConfig zone;
+			zone.ZoneId = xmlZone.ChildLong("ZoneId", -1);
+
+			const XmlElement* pixels = xmlZone.Child("Pixels");
+			if (NULL != pixels)
+			{
+				for (unsigned int j = 0; j < pixels->Children.size(); j++)
+				{
+					OcrZonePixelConfig pixel;
+					pixel.X = atol(pixels->Children[j].Attribute("X").c_str());
+					pixel.Y = atol(pixels->Children[j].Attribute("Y").c_str());
+					zone.Pixels.push_back(pixel);
+				}
+			}
+
+			config->Zones.push_back(zone);
+		}
+	}
+
+	config->CharDefinitions.clear();
+	const XmlElement* charDefinitions = xmlConfig.Child("CharDefinitions");
+	if (NULL != charDefinitions)
+	{
+		for (unsigned int i = 0; i < charDefinitions->Children.size(); i++)
+		{
+			const XmlElement& xmlCharDef = charDefinitions->Children[i];
+			const XmlElement* character = xmlCharDef.Child("Character");
+			if (NULL == character || character->Text.empty()) return false;
+
+			OcrCharConfig charDef;
+			charDef.Character = character->Text[0];
+			charDef.FixedPosition = xmlCharDef.ChildLong("FixedPosition", -1);
+
+			const XmlElement* signatures = xmlCharDef.Child("ZoneSignatures");
+			if (NULL != signatures)
+			{
+				for (unsigned int j = 0; j < signatures->Children.size(); j++)
+				{
+					OcrZoneSignatureConfig signature;
+					signature.ZoneId = atol(signatures->Children[j].Attribute("Id").c_str());
+					signature.ZoneValue = ParseZoneValue(signatures->Children[j].Attribute("Value"));
+					if (signature.ZoneValue < 0) return false;
+
+					charDef.ZoneSignatures.push_back(signature);
+				}
+			}
+
+			config->CharDefinitions.push_back(charDef);
+		}
+	}
+
+	// Same requirements as NativeHelpers.SetupBasicOcrMetrix()
+	for (unsigned int i = 0; i < config->Zones.size(); i++)
+	{
+		if (config->Zones[i].ZoneId != (long)i || config->Zones[i].Pixels.size() > MAX_PIXELS_IN_ZONE_COUNT)
+			return false;
+	}
+
+	return
+		config->Width > 0 && config->Height > 0 &&
+		config->Zones.size() <= MAX_ZONE_COUNT &&
+		config->CharPositions.size() > 0 && config->CharPositions.size() <= 25;
+}
+
+bool LoadOcrConfiguration(const char* fileName, const char* configName, OcrConfiguration* config)
+{
+	FILE* settingsFile = fopen(fileName, "rb");
+	if (NULL == settingsFile)
+	{
+		fprintf(stderr, "Cannot open '%s'\n", fileName);
+		return false;
+	}
+
+	string xml;
+	char buffer[4096];
+	size_t bytesRead;
+	while ((bytesRead = fread(buffer, 1, sizeof(buffer), settingsFile)) > 0)
+		xml.append(buffer, bytesRead);
+
+	fclose(settingsFile);
+
+	XmlElement root;
+	XmlReader reader(xml);
+	if (!reader.ReadDocument(&root))
+	{
+		fprintf(stderr, "Cannot parse '%s'\n", fileName);
+		return false;
+	}
+
+	const XmlElement* match = NULL;
+
+	for (unsigned int i = 0; i < root.Children.size() && NULL == match; i++)
+		if (root.Children[i].Name == "Configuration" && root.Children[i].Attribute("Name") == configName)
+			match = &root.Children[i];
+
+	for (unsigned int i = 0; i < root.Children.size() && NULL == match; i++)
+		if (root.Children[i].Name == "Configuration" && root.Children[i].Attribute("Name").find(configName) != string::npos)
+			match = &root.Children[i];
+
+	if (NULL == match)
+	{
+		fprintf(stderr, "There is no OCR configuration '%s' in '%s'\n", configName, fileName);
+		return false;
+	}
+
+	if (!ReadOcrConfiguration(*match, config))
+	{
+		fprintf(stderr, "The OCR configuration '%s' in '%s' is not valid\n", configName, fileName);
+		return false;
+	}
+
+	return true;
+}
+
+static long GetPackedValue(long charId, bool isOddField, long zoneId, long zonePixelId)
+{
+	return
+		(isOddField ? 0x01000000 : 0x02000000) +
+		((charId & 0xFF) << 16) +
+		((zoneId & 0xFF) << 8) +
+		(zonePixelId & 0xFF);
+}
+
+void BuildOcrZoneMatrix(const OcrConfiguration& config, long* matrix)
+{
+	long ocrLinesFrom = config.FrameTopOdd;
+	long ocrLinesTo = config.FrameTopEven + 2 * config.CharHeight;
+
+	// Zone pixel lookup by the position inside the character cell
+	vector<long> cellZone(config.CharWidth * (config.CharHeight + 1), -1);
+	vector<long> cellPixelId(cellZone.size(), -1);
+
+	for (unsigned int i = 0; i < config.Zones.size(); i++)
+	{
+		for (unsigned int j = 0; j < config.Zones[i].Pixels.size(); j++)
+		{
+			long x = config.Zones[i].Pixels[j].X;
+			long y = config.Zones[i].Pixels[j].Y;
+
+			if (x >= 0 && x < config.CharWidth && y >= 0 && y <= config.CharHeight && cellZone[y * config.CharWidth + x] == -1)
+			{
+				cellZone[y * config.CharWidth + x] = config.Zones[i].ZoneId;
+				cellPixelId[y * config.CharWidth + x] = j;
+			}
+		}
+	}
+
+	for (long y = 0; y < config.Height; y++)
+	{
+		bool runOcr = y >= ocrLinesFrom && y <= ocrLinesTo;
+		bool isOddFieldLine = (y - ocrLinesFrom) % 2 == 0;
+		unsigned int charIdx = 0;
+
+		for (long x = 0; x < config.Width; x++)
+		{
+			long* ptrMatrix = matrix + y * config.Width + x;
+			*ptrMatrix = 0;
+
+			if (!runOcr)
+				continue;
+
+			long leftFrom = config.CharPositions[charIdx];
+			long leftTo = leftFrom + config.CharWidth - 1;
+
+			if (x < leftFrom)
+				continue;
+
+			if (x <= leftTo)
+			{
+				long charLeft = x - leftFrom;
+				long charTop = (y - ocrLinesFrom) / 2;
+
+				if (charTop <= config.CharHeight)
+				{
+					long zoneId = cellZone[charTop * config.CharWidth + charLeft];
+					if (zoneId != -1)
+						*ptrMatrix = GetPackedValue(charIdx, isOddFieldLine, zoneId, cellPixelId[charTop * config.CharWidth + charLeft]);
+				}
+			}
+			else if (charIdx < config.CharPositions.size() - 1)
+				charIdx++;
+		}
+	}
+}
+
+bool SetupCoreOcr(const OcrConfiguration& config, long* zoneMatrix)
+{
+	vector<long> zonePixels;
+	for (unsigned int i = 0; i < config.Zones.size(); i++)
+		zonePixels.push_back((long)config.Zones[i].Pixels.size());
+
+	SetupIntegrationPreservationArea(true, config.FrameTopOdd, config.FrameTopEven, config.CharHeight);
+
+	HRESULT hr = SetupOcrAlignment(
+		config.Width, config.Height, config.FrameTopOdd, config.FrameTopEven, config.CharWidth, config.CharHeight,
+		(long)config.CharPositions.size(), (long)config.Zones.size(), config.Mode, zonePixels.size() > 0 ? &zonePixels[0] : NULL);
+
+	if (hr != S_OK)
+		return false;
+
+	for (unsigned int i = 0; i < config.CharDefinitions.size(); i++)
+	{
+		const OcrCharConfig& charDef = config.CharDefinitions[i];
+		SetupOcrChar(charDef.Character, charDef.FixedPosition);
+
+		for (unsigned int j = 0; j < charDef.ZoneSignatures.size(); j++)
+		{
+			long zoneId = charDef.ZoneSignatures[j].ZoneId;
+			long pixelsInZone = zoneId >= 0 && zoneId < (long)config.Zones.size() ? (long)config.Zones[zoneId].Pixels.size() : 0;
+
+			SetupOcrCharDefinitionZone(charDef.Character, zoneId, charDef.ZoneSignatures[j].ZoneValue, pixelsInZone);
+		}
+	}
+
+	return SetupOcrZoneMatrix(zoneMatrix) == S_OK;
+}
+
+}
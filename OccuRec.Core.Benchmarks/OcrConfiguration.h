@@ -0,0 +1,75 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef OCR_CONFIGURATION_H
+#define OCR_CONFIGURATION_H
+
+#include <vector>
+#include <string>
+
+using namespace std;
+
+namespace OccuRecBenchmarks
+{
+
+// Native copy of the OCR configuration used by the managed OcrManager (OccuRec\OCR-Settings.xml)
+
+struct OcrZonePixelConfig
+{
+	long X;
+	long Y;
+};
+
+struct OcrZoneConfig
+{
+	long ZoneId;
+	vector<OcrZonePixelConfig> Pixels;
+};
+
+struct OcrZoneSignatureConfig
+{
+	long ZoneId;
+	// One of the OccuOcr::ZoneBehaviour values
+	long ZoneValue;
+};
+
+struct OcrCharConfig
+{
+	char Character;
+	long FixedPosition;
+	vector<OcrZoneSignatureConfig> ZoneSignatures;
+};
+
+struct OcrConfiguration
+{
+	string Name;
+	// One of the OccuOcr::ZoneMode values
+	long Mode;
+
+	long Width;
+	long Height;
+	long FrameTopOdd;
+	long FrameTopEven;
+	long CharWidth;
+	long CharHeight;
+	vector<long> CharPositions;
+
+	vector<OcrZoneConfig> Zones;
+	vector<OcrCharConfig> CharDefinitions;
+};
+
+// Loads the named configuration from an OCR-Settings.xml file. If there is no configuration with this exact name
+// the first one which contains the given name is used
+bool LoadOcrConfiguration(const char* fileName, const char* configName, OcrConfiguration* config);
+
+// Builds the packed zone matrix in the same way as the managed OcrZoneChecker. The matrix has Width * Height entries
+void BuildOcrZoneMatrix(const OcrConfiguration& config, long* matrix);
+
+// Configures the OCR of the core exactly as NativeHelpers.SetupOcr() does. Must be called after SetupCamera()
+// and SetupAav() as they reset the OCR configuration
+bool SetupCoreOcr(const OcrConfiguration& config, long* zoneMatrix);
+
+}
+
+#endif // OCR_CONFIGURATION_H
@@ -0,0 +1,871 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+
+#include "RecordingBenchmark.h"
+#include "BenchmarkUtils.h"
+#include "SyntheticVideo.h"
+#include "OcrConfiguration.h"
+#include "IotaVtiRenderer.h"
+
+#include "OccuRec.Core.h"
+#include "OccuRec.Math.h"
+#include "simplified_tracking.h"
+
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+
+using namespace std;
+
+namespace OccuRecBenchmarks
+{
+
+#define DEFAULT_OCR_SETTINGS_FILE "OccuRec/OCR-Settings.xml"
+#define DEFAULT_PAL_VTI_CONFIG "Compatible EasyCap + IOTA-VTI (NON TV-Safe, PAL)"
+#define DEFAULT_NTSC_VTI_CONFIG "IOTA-VTI NON-TVSAFE (NTSC)"
+
+#define PRODUCER_RING_SLOTS 16
+
+struct RecordingLayout
+{
+	const char* Name;
+	// USE_IMAGE_LAYOUT and compression algorithm passed to SetupAav()
+	long ImageLayout;
+	long CompressionAlgorithm;
+	long Bpp;
+	const char* Description;
+};
+
+static RecordingLayout RECORDING_LAYOUTS[] =
+{
+	{ "raw",          1, 0, 8,  "FULL-IMAGE-RAW, UNCOMPRESSED" },
+	{ "quicklz",      4, 0, 8,  "FULL-IMAGE-RAW, QUICKLZ" },
+	{ "raw16",        1, 0, 16, "FULL-IMAGE-RAW, UNCOMPRESSED, 16 bit" },
+	{ "quicklz16",    4, 0, 16, "FULL-IMAGE-RAW, QUICKLZ, 16 bit" },
+	{ "lagarith16",   4, 1, 16, "FULL-IMAGE-RAW, LAGARITH16, 16 bit" },
+	{ "locoi",        4, 2, 8,  "FULL-IMAGE-RAW, LOCO-I" },
+	{ "locoi16",      4, 2, 16, "FULL-IMAGE-RAW, LOCO-I, 16 bit" },
+	{ "lagarith8",    4, 3, 8,  "FULL-IMAGE-RAW, LAGARITH8" },
+	{ "diff",         3, 0, 8,  "FULL-IMAGE-DIFFERENTIAL-CODING, QUICKLZ" },
+	{ "diff-nosigns", 2, 0, 8,  "FULL-IMAGE-DIFFERENTIAL-CODING-NOSIGNS, QUICKLZ" },
+	{ "diff-motion",  6, 0, 8,  "FULL-IMAGE-DIFFERENTIAL-CODING, QUICKLZ, motion compensated" },
+	{ "roi",          7, 0, 8,  "REGIONS-OF-INTEREST, QUICKLZ, 64 x 64 around the brightest star" }
+};
+
+#define RECORDING_LAYOUTS_COUNT (sizeof(RECORDING_LAYOUTS) / sizeof(RecordingLayout))
+
+// Renders the synthetic video on a separate thread, so the rendering time does not limit the measured frame rate
+class SyntheticFrameProducer
+{
+	private:
+		SyntheticVideo* m_Video;
+		unsigned char* m_Slots[PRODUCER_RING_SLOTS];
+		volatile LONG m_Produced;
+		volatile LONG m_Consumed;
+		volatile LONG m_Stop;
+		volatile LONG m_Running;
+		long long m_StarvedTicks;
+
+		static void ThreadProc(void* context);
+
+	public:
+		SyntheticFrameProducer(SyntheticVideo* video);
+		~SyntheticFrameProducer();
+
+		// Waits for the next rendered frame. The frame stays valid until ReleaseFrame() is called
+		unsigned char* NextFrame();
+		void ReleaseFrame();
+
+		// Time spent waiting for the renderer, which means that the results are limited by the rendering
+		double StarvedSeconds();
+};
+
+SyntheticFrameProducer::SyntheticFrameProducer(SyntheticVideo* video)
+{
+	m_Video = video;
+	m_Produced = 0;
+	m_Consumed = 0;
+	m_Stop = 0;
+	m_Running = 1;
+	m_StarvedTicks = 0;
+
+	for (int i = 0; i < PRODUCER_RING_SLOTS; i++)
+		m_Slots[i] = (unsigned char*)malloc(video->Width() * video->Height() * 3);
+
+	PlatformStartThread(ThreadProc, this);
+}
+
+SyntheticFrameProducer::~SyntheticFrameProducer()
+{
+	PlatformInterlockedIncrement(&m_Stop);
+
+	while (m_Running != 0)
+		SleepMilliseconds(1);
+
+	for (int i = 0; i < PRODUCER_RING_SLOTS; i++)
+		free(m_Slots[i]);
+}
+
+void SyntheticFrameProducer::ThreadProc(void* context)
+{
+	SyntheticFrameProducer* producer = (SyntheticFrameProducer*)context;
+
+	while (producer->m_Stop == 0)
+	{
+		if (producer->m_Produced - producer->m_Consumed >= PRODUCER_RING_SLOTS)
+		{
+			PlatformYieldThread();
+			continue;
+		}
+
+		producer->m_Video->NextFrame(producer->m_Slots[producer->m_Produced % PRODUCER_RING_SLOTS]);
+		PlatformInterlockedIncrement(&producer->m_Produced);
+	}
+
+	PlatformInterlockedDecrement(&producer->m_Running);
+}
+
+unsigned char* SyntheticFrameProducer::NextFrame()
+{
+	if (m_Produced == m_Consumed)
+	{
+		long long startTicks = HighResolutionTimer::Ticks();
+
+		while (m_Produced == m_Consumed)
+			PlatformYieldThread();
+
+		m_StarvedTicks += HighResolutionTimer::Ticks() - startTicks;
+	}
+
+	return m_Slots[m_Consumed % PRODUCER_RING_SLOTS];
+}
+
+void SyntheticFrameProducer::ReleaseFrame()
+{
+	PlatformInterlockedIncrement(&m_Consumed);
+}
+
+double SyntheticFrameProducer::StarvedSeconds()
+{
+	return (double)m_StarvedTicks / HighResolutionTimer::TicksPerSecond();
+}
+
+struct RecordingBenchmarkConfig
+{
+	SyntheticVideoConfig Video;
+	const char* VideoStandard;
+	double Seconds;
+	long WarmupFrames;
+	// Frames per second fed to the core. 0 feeds the frames as fast as the core accepts them
+	double TargetFps;
+	bool BufferedProcessing;
+	// Buffered camera frames after which the capture waits (at the maximum rate) or drops the frame (at a fixed rate)
+	long RawQueueLimit;
+	// Passed to SetupAavWriteBehind()
+	long WriteBufferKb;
+	long DurabilityIntervalMs;
+	// Each layout is recorded once with each of these numbers of compression threads
+	vector<long> CompressionThreads;
+	// Passed to SetupAavStatusDeltaEncoding()
+	long StatusSnapshotInterval;
+	// Passed to SetupAavLagarith16TableReuse()
+	long Lagarith16TablesKeyFrame;
+	// Passed to SetupAavKeyFrames()
+	long KeyFrameInterval;
+	long SceneChangeThreshold;
+	// Passed to SetupAavPixelsCrc() and SetupAavBitPacking()
+	bool PixelsCrc;
+	long BitPacking;
+	// Passed to SetupAavTiles()
+	long TileSize;
+	bool Tracking;
+	OcrConfiguration* Ocr;
+	IotaVtiRenderer* VtiRenderer;
+	string OutputDirectory;
+	bool KeepFiles;
+	// Read the recorded file back with the AAV reader
+	bool ReadBack;
+};
+
+struct RecordingBenchmarkResult
+{
+	const RecordingLayout* Layout;
+	long CompressionThreads;
+
+	long FramesFed;
+	long CaptureDroppedFrames;
+	double ElapsedSeconds;
+	double SustainedFps;
+	double RendererStarvedSeconds;
+
+	CoreProfilingInfo Profiling;
+
+	long DetectedIntegrationRate;
+	long IntegrationDroppedFrames;
+	bool OcrWorking;
+	long OcrErrors;
+
+	// 0 when the file was not read back or could not be decoded
+	double ReadBackOpenMs;
+	double ReadBackFps;
+	double ReadBackRandomFrameMs;
+};
+
+static double TicksToSeconds(const CoreProfilingInfo& profiling, __int64 ticks)
+{
+	return profiling.TicksPerSecond > 0 ? (double)ticks / profiling.TicksPerSecond : 0;
+}
+
+static bool s_FrameProcessingThreadStarted = false;
+
+static void LocateBrightestStar(SyntheticVideo* video, double* x, double* y)
+{
+	long width = video->Width();
+	long height = video->Height();
+
+	unsigned char* bmpBits = (unsigned char*)malloc(width * height * 3);
+	video->NextFrame(bmpBits);
+
+	long bestValue = -1;
+	*x = width / 2;
+	*y = height / 2;
+
+	// Stay away from the edges and from the timestamp at the bottom of the frame
+	for (long row = 20; row < height - 80; row++)
+	{
+		// The bitmap is bottom-up
+		unsigned char* ptrRow = bmpBits + (height - 1 - row) * width * 3;
+
+		for (long col = 20; col < width - 20; col++)
+		{
+			if (ptrRow[3 * col] > bestValue && ptrRow[3 * col] < 250)
+			{
+				bestValue = ptrRow[3 * col];
+				*x = col;
+				*y = row;
+			}
+		}
+	}
+
+	free(bmpBits);
+	video->Reset();
+}
+
+static void FeedFrame(unsigned char* bmpBits)
+{
+	FrameProcessingStatus frameStatus;
+
+	// The VTI time is only known as time of day, so the current UTC day is 0
+	ProcessVideoFrame(bmpBits, 0, 0, 0, 0, &frameStatus);
+}
+
+static void WaitForFramesToBeProcessed(long long framesFed)
+{
+	CoreProfilingInfo profiling;
+
+	for(;;)
+	{
+		GetProfilingInfo(&profiling);
+		if (profiling.ProcessedFrames >= framesFed)
+			break;
+
+		SleepMilliseconds(1);
+	}
+}
+
+// Opens the file, decodes all frames in order in batches and then single frames at random positions
+static void ReadBackRecording(const char* fileName, RecordingBenchmarkResult* result)
+{
+	AavReaderFileInfo fileInfo;
+	long long ticksPerSecond = HighResolutionTimer::TicksPerSecond();
+	long long startTicks = HighResolutionTimer::Ticks();
+
+	if (S_OK != OpenAavReader((LPCTSTR)fileName, &fileInfo) || fileInfo.FramesCount == 0)
+	{
+		CloseAavReader();
+		return;
+	}
+
+	result->ReadBackOpenMs = (HighResolutionTimer::Ticks() - startTicks) * 1000.0 / ticksPerSecond;
+
+	const long batchFrames = 32;
+	long frameBytes = fileInfo.Width * fileInfo.Height * (fileInfo.DataBpp > 8 ? 2 : 1);
+	unsigned char* pixels = (unsigned char*)malloc(batchFrames * frameBytes);
+	bool decoded = true;
+
+	startTicks = HighResolutionTimer::Ticks();
+
+	for (long frameNo = 0; decoded && frameNo < fileInfo.FramesCount; frameNo += batchFrames)
+		decoded = S_OK == ReadAavFrames(frameNo, min(batchFrames, fileInfo.FramesCount - frameNo), pixels, NULL);
+
+	double seconds = (double)(HighResolutionTimer::Ticks() - startTicks) / ticksPerSecond;
+
+	const long randomFrames = 200;
+	unsigned int random = 1;
+	startTicks = HighResolutionTimer::Ticks();
+
+	for (long i = 0; decoded && i < randomFrames; i++)
+	{
+		random = random * 1103515245 + 12345;
+		decoded = S_OK == ReadAavFrames((long)((random >> 8) % fileInfo.FramesCount), 1, pixels, NULL);
+	}
+
+	if (decoded)
+	{
+		result->ReadBackFps = seconds > 0 ? fileInfo.FramesCount / seconds : 0;
+		result->ReadBackRandomFrameMs = (HighResolutionTimer::Ticks() - startTicks) * 1000.0 / ticksPerSecond / randomFrames;
+	}
+
+	free(pixels);
+	CloseAavReader();
+}
+
+static void RunRecording(const RecordingBenchmarkConfig& config, const RecordingLayout& layout, long compressionThreads, RecordingBenchmarkResult* result)
+{
+	memset(result, 0, sizeof(RecordingBenchmarkResult));
+	result->Layout = &layout;
+	result->CompressionThreads = compressionThreads;
+
+	SyntheticVideo* video = new SyntheticVideo(config.Video);
+	if (NULL != config.VtiRenderer)
+		video->AttachVtiRenderer(config.VtiRenderer);
+
+	double starX;
+	double starY;
+	LocateBrightestStar(video, &starX, &starY);
+
+	SetupCamera(config.Video.Width, config.Video.Height, (LPCTSTR)"Synthetic", 0, false, false, true);
+	SetupGrabberInfo((LPCTSTR)"Synthetic", (LPCTSTR)config.VideoStandard, (float)config.Video.FrameRate, 0);
+	SetupAav(layout.ImageLayout, layout.CompressionAlgorithm, layout.Bpp, config.BufferedProcessing ? 1 : 0, 0, (LPCTSTR)"Benchmarks", 0, 0);
+	SetupAavWriteBehind(config.WriteBufferKb, config.DurabilityIntervalMs);
+	SetupAavCompressionThreads(compressionThreads);
+	SetupAavStatusDeltaEncoding(config.StatusSnapshotInterval);
+	SetupAavLagarith16TableReuse(config.Lagarith16TablesKeyFrame);
+	SetupAavKeyFrames(config.KeyFrameInterval, config.SceneChangeThreshold);
+	SetupAavPixelsCrc(config.PixelsCrc ? 1 : 0);
+	SetupAavBitPacking(config.BitPacking);
+	SetupAavTiles(config.TileSize);
+
+	// The region of the REGIONS-OF-INTEREST layout, which follows the star when it is tracked
+	SetupAavRegionOfInterest(0, starX > 32 ? (long)starX - 32 : 0, starY > 32 ? (long)starY - 32 : 0, 64, 64, config.Tracking ? 0 : -1);
+	SetupIntegrationDetection(5, 0.3f, 1);
+
+	if (NULL != config.Ocr)
+		SetupCoreOcr(*config.Ocr, config.VtiRenderer->ZoneMatrix());
+
+	if (config.Tracking)
+	{
+		// The default tracking settings of OccuRec
+		TrackerSettings(0, 1.5, 12, 0.1, 0.4);
+		ConfigureSaturationLevels(250, 4000, 16000);
+		TrackerNewConfiguration(config.Video.Width, config.Video.Height, 1, false);
+		TrackerConfigureObject(0, false, false, starX, starY, 5);
+		TrackerInitialiseNewTracking();
+		EnableTracking(0, -1, 1, 5, 5, 2.0f, 350);
+	}
+	else
+		DisableTracking();
+
+	if (config.BufferedProcessing && !s_FrameProcessingThreadStarted)
+	{
+		// Started by DllMain() when the core is loaded as a DLL
+		PlatformStartThread(FrameProcessingThreadProc, NULL);
+		s_FrameProcessingThreadStarted = true;
+	}
+
+	ResetProfilingInfo();
+
+	SyntheticFrameProducer* producer = new SyntheticFrameProducer(video);
+
+	// Let the integration detection find the integration rate, then lock it as the user would do before recording
+	for (long i = 0; i < config.WarmupFrames; i++)
+	{
+		FeedFrame(producer->NextFrame());
+		producer->ReleaseFrame();
+
+		if (config.BufferedProcessing)
+			WaitForFramesToBeProcessed(i + 1);
+	}
+
+	LockIntegration(true);
+
+	char fileName[512];
+	sprintf(fileName, "%s/recording-benchmark-%s.aav", config.OutputDirectory.c_str(), layout.Name);
+
+	StartRecording((LPCTSTR)fileName);
+	ResetProfilingInfo();
+
+	long long ticksPerSecond = HighResolutionTimer::TicksPerSecond();
+	long long frameTicks = config.TargetFps > 0 ? (long long)(ticksPerSecond / config.TargetFps) : 0;
+	long long durationTicks = (long long)(config.Seconds * ticksPerSecond);
+
+	HighResolutionTimer timer;
+	long long startTicks = HighResolutionTimer::Ticks();
+	long long frameIndex = 0;
+
+	for(;;)
+	{
+		long long nowTicks = HighResolutionTimer::Ticks();
+		if (nowTicks - startTicks >= durationTicks)
+			break;
+
+		unsigned char* bmpBits = producer->NextFrame();
+
+		if (frameTicks > 0)
+		{
+			long long dueTicks = startTicks + frameIndex * frameTicks;
+			frameIndex++;
+
+			while (HighResolutionTimer::Ticks() < dueTicks)
+				PlatformYieldThread();
+
+			// A capture which is late by more than a frame, or has no free buffers, drops the frame
+			bool dropFrame = HighResolutionTimer::Ticks() - dueTicks > frameTicks;
+
+			if (!dropFrame && config.BufferedProcessing)
+			{
+				CoreProfilingInfo profiling;
+				GetProfilingInfo(&profiling);
+				dropFrame = profiling.RawFrameBufferLength >= config.RawQueueLimit;
+			}
+
+			if (dropFrame)
+			{
+				result->CaptureDroppedFrames++;
+				producer->ReleaseFrame();
+				continue;
+			}
+		}
+		else if (config.BufferedProcessing)
+		{
+			// Back pressure at the maximum rate
+			CoreProfilingInfo profiling;
+			GetProfilingInfo(&profiling);
+
+			while (profiling.RawFrameBufferLength >= config.RawQueueLimit)
+			{
+				PlatformYieldThread();
+				GetProfilingInfo(&profiling);
+			}
+		}
+
+		FeedFrame(bmpBits);
+		producer->ReleaseFrame();
+
+		result->FramesFed++;
+	}
+
+	// Everything fed must be processed and written to disk before the time is taken
+	WaitForFramesToBeProcessed(result->FramesFed);
+
+	ImageStatus* imageStatus = new ImageStatus();
+	GetCurrentImageStatus(imageStatus);
+
+	StopRecording(NULL);
+
+	result->ElapsedSeconds = timer.ElapsedSeconds();
+	result->SustainedFps = result->ElapsedSeconds > 0 ? result->FramesFed / result->ElapsedSeconds : 0;
+	result->RendererStarvedSeconds = producer->StarvedSeconds();
+
+	GetProfilingInfo(&result->Profiling);
+
+	result->DetectedIntegrationRate = imageStatus->DetectedIntegrationRate;
+	result->IntegrationDroppedFrames = imageStatus->DropedFramesSinceIntegrationLock;
+	result->OcrWorking = imageStatus->OcrWorking != 0;
+	result->OcrErrors = imageStatus->OcrErrorsSinceLastReset;
+
+	delete imageStatus;
+	delete producer;
+	delete video;
+
+	DisableTracking();
+	LockIntegration(false);
+
+	if (config.ReadBack)
+		ReadBackRecording(fileName, result);
+
+	if (!config.KeepFiles)
+		remove(fileName);
+}
+
+static void PrintStage(const char* name, const RecordingBenchmarkResult& result, __int64 ticks)
+{
+	double seconds = TicksToSeconds(result.Profiling, ticks);
+	long long frames = result.Profiling.ProcessedFrames;
+
+	printf("    %-22s: %8.3f ms/frame %7.1f %% of a core\n",
+		name,
+		frames > 0 ? seconds * 1000.0 / frames : 0,
+		result.ElapsedSeconds > 0 ? 100.0 * seconds / result.ElapsedSeconds : 0);
+}
+
+static void PrintRecordingResult(const RecordingBenchmarkResult& result)
+{
+	const CoreProfilingInfo& profiling = result.Profiling;
+	double mbWritten = profiling.BytesWritten / (1024.0 * 1024.0);
+
+	printf("\n%s (%s), %ld compression threads\n", result.Layout->Name, result.Layout->Description, result.CompressionThreads);
+	printf("  Sustained rate                : %8.2f fps (%ld frames in %.2f s)\n", result.SustainedFps, result.FramesFed, result.ElapsedSeconds);
+	printf("  Dropped frames                : %ld by the capture, %lld by the recording, %ld since the integration lock\n",
+		result.CaptureDroppedFrames, profiling.DroppedRecordingFrames, result.IntegrationDroppedFrames);
+	printf("  Recorded frames               : %lld (integration rate x%ld)\n", profiling.RecordedFrames, result.DetectedIntegrationRate);
+	printf("  Queue high-water marks        : %ld camera frames, %ld integrated frames\n", profiling.RawFrameBufferHighWaterMark, profiling.RecordingBufferHighWaterMark);
+	printf("  Written                       : %8.2f MB, %.2f MB/s\n", mbWritten, result.ElapsedSeconds > 0 ? mbWritten / result.ElapsedSeconds : 0);
+	printf("  Write-behind disk writes      : %lld writes, %.2f ms avg %.2f ms max latency, %.2f MB/s, %lld syncs, %.3f s stalled\n",
+		profiling.DiskWrites,
+		profiling.DiskWrites > 0 ? TicksToSeconds(profiling, profiling.DiskWriteLatencyTicks) * 1000.0 / profiling.DiskWrites : 0,
+		TicksToSeconds(profiling, profiling.DiskWriteMaxLatencyTicks) * 1000.0,
+		profiling.DiskWriteLatencyTicks > 0 ? mbWritten / TicksToSeconds(profiling, profiling.DiskWriteLatencyTicks) : 0,
+		profiling.DiskSyncs,
+		TicksToSeconds(profiling, profiling.DiskWriteStallTicks));
+	if (result.CompressionThreads > 0)
+		printf("  Compression workers           : %8.3f ms per recorded frame, %.1f %% of %ld cores, %.3f s stalled\n",
+			profiling.RecordedFrames > 0 ? TicksToSeconds(profiling, profiling.CompressionWorkerTicks) * 1000.0 / profiling.RecordedFrames : 0,
+			result.ElapsedSeconds > 0 ? 100.0 * TicksToSeconds(profiling, profiling.CompressionWorkerTicks) / (result.ElapsedSeconds * result.CompressionThreads) : 0,
+			result.CompressionThreads,
+			TicksToSeconds(profiling, profiling.CompressionStallTicks));
+	printf("  Time per camera frame:\n");
+	PrintStage("Integration", result, profiling.FrameProcessingTicks - profiling.OcrTicks - profiling.TrackingTicks);
+	PrintStage("OCR", result, profiling.OcrTicks);
+	PrintStage("Tracking", result, profiling.TrackingTicks);
+	PrintStage("Compression", result, profiling.CompressionTicks);
+	PrintStage("Disk writes", result, profiling.DiskWriteTicks);
+	PrintStage("Other recording", result, profiling.RecordingTicks - profiling.CompressionTicks - profiling.DiskWriteTicks);
+
+	if (result.ReadBackOpenMs > 0)
+	{
+		if (result.ReadBackFps > 0)
+			printf("  Read back                     : %8.2f fps in order, %.3f ms per frame at random, opened in %.2f ms\n",
+				result.ReadBackFps, result.ReadBackRandomFrameMs, result.ReadBackOpenMs);
+		else
+			printf("  Read back                     : the images cannot be decoded, opened in %.2f ms\n", result.ReadBackOpenMs);
+	}
+
+	if (result.OcrWorking || result.OcrErrors > 0)
+		printf("  OCR                           : %s, %ld errors\n", result.OcrWorking ? "working" : "NOT working", result.OcrErrors);
+
+	if (result.RendererStarvedSeconds > 0.05 * result.ElapsedSeconds)
+		printf("  WARNING: waited %.2f s for the synthetic video renderer, the rate is limited by the renderer\n", result.RendererStarvedSeconds);
+}
+
+static void PrintCompressionScaling(const vector<RecordingBenchmarkResult>& results)
+{
+	printf("\nScaling with the compression threads (speedup of the sustained rate over the first run of the layout):\n");
+	printf("  %-14s %8s %10s %8s %12s\n", "Layout", "Threads", "fps", "Speedup", "Stalled s");
+
+	for (unsigned int i = 0; i < results.size(); i++)
+	{
+		const RecordingBenchmarkResult& result = results[i];
+
+		const RecordingBenchmarkResult* baseline = &result;
+		for (unsigned int j = 0; j < i; j++)
+			if (results[j].Layout == result.Layout)
+			{
+				baseline = &results[j];
+				break;
+			}
+
+		printf("  %-14s %8ld %10.2f %7.2fx %12.3f\n",
+			result.Layout->Name,
+			result.CompressionThreads,
+			result.SustainedFps,
+			baseline->SustainedFps > 0 ? result.SustainedFps / baseline->SustainedFps : 0,
+			TicksToSeconds(result.Profiling, result.Profiling.CompressionStallTicks));
+	}
+}
+
+static void WriteJsonStage(FILE* file, const char* name, const RecordingBenchmarkResult& result, __int64 ticks, bool isLast)
+{
+	double seconds = TicksToSeconds(result.Profiling, ticks);
+	long long frames = result.Profiling.ProcessedFrames;
+
+	fprintf(file, "        \"%s\": { \"msPerFrame\": %.4f, \"corePercent\": %.2f }%s\n",
+		name,
+		frames > 0 ? seconds * 1000.0 / frames : 0,
+		result.ElapsedSeconds > 0 ? 100.0 * seconds / result.ElapsedSeconds : 0,
+		isLast ? "" : ",");
+}
+
+static void WriteJsonResults(const char* fileName, const char* label, const RecordingBenchmarkConfig& config, const vector<RecordingBenchmarkResult>& results)
+{
+	FILE* file = fopen(fileName, "w");
+	if (NULL == file)
+	{
+		fprintf(stderr, "Cannot write '%s'\n", fileName);
+		return;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"benchmark\": \"recording\",\n");
+	fprintf(file, "  \"label\": \"%s\",\n", label);
+	fprintf(file, "  \"build\": \"%s %s\",\n", __DATE__, __TIME__);
+	fprintf(file, "  \"videoStandard\": \"%s\",\n", config.VideoStandard);
+	fprintf(file, "  \"width\": %ld,\n", config.Video.Width);
+	fprintf(file, "  \"height\": %ld,\n", config.Video.Height);
+	fprintf(file, "  \"integrationRate\": %ld,\n", config.Video.IntegrationRate);
+	fprintf(file, "  \"seconds\": %.2f,\n", config.Seconds);
+	fprintf(file, "  \"targetFps\": %.3f,\n", config.TargetFps);
+	fprintf(file, "  \"bufferedProcessing\": %s,\n", config.BufferedProcessing ? "true" : "false");
+	fprintf(file, "  \"writeBufferKb\": %ld,\n", config.WriteBufferKb);
+	fprintf(file, "  \"durabilityIntervalMs\": %ld,\n", config.DurabilityIntervalMs);
+	fprintf(file, "  \"statusSnapshotInterval\": %ld,\n", config.StatusSnapshotInterval);
+	fprintf(file, "  \"lagarith16TablesKeyFrame\": %ld,\n", config.Lagarith16TablesKeyFrame);
+	fprintf(file, "  \"keyFrameInterval\": %ld,\n", config.KeyFrameInterval);
+	fprintf(file, "  \"sceneChangeThreshold\": %ld,\n", config.SceneChangeThreshold);
+	fprintf(file, "  \"pixelsCrc\": %s,\n", config.PixelsCrc ? "true" : "false");
+	fprintf(file, "  \"bitPacking\": %ld,\n", config.BitPacking);
+	fprintf(file, "  \"tileSize\": %ld,\n", config.TileSize);
+	fprintf(file, "  \"ocr\": %s,\n", NULL != config.Ocr ? "true" : "false");
+	fprintf(file, "  \"tracking\": %s,\n", config.Tracking ? "true" : "false");
+	fprintf(file, "  \"layouts\": [\n");
+
+	for (unsigned int i = 0; i < results.size(); i++)
+	{
+		const RecordingBenchmarkResult& result = results[i];
+		const CoreProfilingInfo& profiling = result.Profiling;
+
+		fprintf(file, "    {\n");
+		fprintf(file, "      \"name\": \"%s\",\n", result.Layout->Name);
+		fprintf(file, "      \"imageLayout\": %ld,\n", result.Layout->ImageLayout);
+		fprintf(file, "      \"compressionAlgorithm\": %ld,\n", result.Layout->CompressionAlgorithm);
+		fprintf(file, "      \"bpp\": %ld,\n", result.Layout->Bpp);
+		fprintf(file, "      \"compressionThreads\": %ld,\n", result.CompressionThreads);
+		fprintf(file, "      \"framesFed\": %ld,\n", result.FramesFed);
+		fprintf(file, "      \"elapsedSeconds\": %.4f,\n", result.ElapsedSeconds);
+		fprintf(file, "      \"sustainedFps\": %.3f,\n", result.SustainedFps);
+		fprintf(file, "      \"captureDroppedFrames\": %ld,\n", result.CaptureDroppedFrames);
+		fprintf(file, "      \"recordingDroppedFrames\": %lld,\n", profiling.DroppedRecordingFrames);
+		fprintf(file, "      \"integrationDroppedFrames\": %ld,\n", result.IntegrationDroppedFrames);
+		fprintf(file, "      \"recordedFrames\": %lld,\n", profiling.RecordedFrames);
+		fprintf(file, "      \"detectedIntegrationRate\": %ld,\n", result.DetectedIntegrationRate);
+		fprintf(file, "      \"rawQueueHighWaterMark\": %ld,\n", profiling.RawFrameBufferHighWaterMark);
+		fprintf(file, "      \"recordingQueueHighWaterMark\": %ld,\n", profiling.RecordingBufferHighWaterMark);
+		fprintf(file, "      \"bytesWritten\": %lld,\n", profiling.BytesWritten);
+		fprintf(file, "      \"mbPerSecond\": %.3f,\n", result.ElapsedSeconds > 0 ? profiling.BytesWritten / (1024.0 * 1024.0) / result.ElapsedSeconds : 0);
+		fprintf(file, "      \"diskWrites\": %lld,\n", profiling.DiskWrites);
+		fprintf(file, "      \"diskWriteLatencyMs\": %.4f,\n", profiling.DiskWrites > 0 ? TicksToSeconds(profiling, profiling.DiskWriteLatencyTicks) * 1000.0 / profiling.DiskWrites : 0);
+		fprintf(file, "      \"diskWriteMaxLatencyMs\": %.4f,\n", TicksToSeconds(profiling, profiling.DiskWriteMaxLatencyTicks) * 1000.0);
+		fprintf(file, "      \"diskSyncs\": %lld,\n", profiling.DiskSyncs);
+		fprintf(file, "      \"diskWriteStallSeconds\": %.4f,\n", TicksToSeconds(profiling, profiling.DiskWriteStallTicks));
+		fprintf(file, "      \"compressionWorkerSeconds\": %.4f,\n", TicksToSeconds(profiling, profiling.CompressionWorkerTicks));
+		fprintf(file, "      \"compressionStallSeconds\": %.4f,\n", TicksToSeconds(profiling, profiling.CompressionStallTicks));
+		fprintf(file, "      \"ocrWorking\": %s,\n", result.OcrWorking ? "true" : "false");
+		fprintf(file, "      \"ocrErrors\": %ld,\n", result.OcrErrors);
+		fprintf(file, "      \"rendererStarvedSeconds\": %.4f,\n", result.RendererStarvedSeconds);
+		if (config.ReadBack)
+		{
+			fprintf(file, "      \"readBackOpenMs\": %.4f,\n", result.ReadBackOpenMs);
+			fprintf(file, "      \"readBackFps\": %.3f,\n", result.ReadBackFps);
+			fprintf(file, "      \"readBackRandomFrameMs\": %.4f,\n", result.ReadBackRandomFrameMs);
+		}
+		fprintf(file, "      \"stages\": {\n");
+		WriteJsonStage(file, "integration", result, profiling.FrameProcessingTicks - profiling.OcrTicks - profiling.TrackingTicks, false);
+		WriteJsonStage(file, "ocr", result, profiling.OcrTicks, false);
+		WriteJsonStage(file, "tracking", result, profiling.TrackingTicks, false);
+		WriteJsonStage(file, "compression", result, profiling.CompressionTicks, false);
+		WriteJsonStage(file, "diskWrites", result, profiling.DiskWriteTicks, false);
+		WriteJsonStage(file, "otherRecording", result, profiling.RecordingTicks - profiling.CompressionTicks - profiling.DiskWriteTicks, true);
+		fprintf(file, "      }\n");
+		fprintf(file, "    }%s\n", i + 1 < results.size() ? "," : "");
+	}
+
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+
+	fclose(file);
+}
+
+void PrintRecordingBenchmarkUsage()
+{
+	printf("recording [options]\n");
+	printf("  Records synthetic video through the integration, OCR, tracking and AAV writing for each image layout.\n");
+	printf("    --layouts A,B,...      Layouts to record (default: all). One of:\n");
+	for (unsigned int i = 0; i < RECORDING_LAYOUTS_COUNT; i++)
+		printf("                             %-14s %s\n", RECORDING_LAYOUTS[i].Name, RECORDING_LAYOUTS[i].Description);
+	printf("    --seconds S            Recording time per layout (default: 10)\n");
+	printf("    --fps F                Feed the frames at this rate, dropping frames the core cannot take (default: as fast as possible)\n");
+	printf("    --standard pal|ntsc    Video standard (default: pal)\n");
+	printf("    --rate N               Integration rate in frames (default: 4)\n");
+	printf("    --warmup N             Frames fed before the integration is locked and the recording starts (default: 100)\n");
+	printf("    --sync                 Process the frames in the calling thread instead of the frame processing thread\n");
+	printf("    --queue-limit N        Camera frames the capture buffers before it waits or drops (default: 8)\n");
+	printf("    --write-buffer-kb N    Size of each of the two write-behind buffers of the AAV file (default: 8192)\n");
+	printf("    --durability-ms N      Interval at which the AAV file is synced to the disk, 0 after every write (default: 1000)\n");
+	printf("    --compression-threads A,B,...\n");
+	printf("                           Record each layout with each number of image compression threads, 0 compresses\n");
+	printf("                           on the recording thread (default: 0)\n");
+	printf("    --status-snapshots N   Write only the changed status tags, with all of them every N frames (default: 0, all\n");
+	printf("                           of them in every frame)\n");
+	printf("    --lagarith16-tables N  Let the Lagarith16 frames reuse the tables of the previous frame, with new ones every\n");
+	printf("                           N frames (default: 0, new tables in every frame)\n");
+	printf("    --key-frames N         Record a key frame of the diff coded layouts every N frames, 0 only for the first\n");
+	printf("                           frame (default: 32)\n");
+	printf("    --scene-change N       Also record a key frame when the mean difference from the base frame is above N gray\n");
+	printf("                           levels (default: 0, never)\n");
+	printf("    --no-pixels-crc        Do not store the CRC-32C of the pixels of each frame\n");
+	printf("    --bit-packing N        Pack the pixels of the 16 bit UNCOMPRESSED and QUICKLZ layouts with N bits, 10, 12\n");
+	printf("                           or 14 (default: 0, 16 bits)\n");
+	printf("    --tiles N              Compress the raw layouts in independent tiles of N x N pixels, 16 to 1024 (default: 0,\n");
+	printf("                           whole images)\n");
+	printf("    --no-vti               Do not render timestamps and do not run the OCR\n");
+	printf("    --no-tracking          Do not track a star\n");
+	printf("    --ocr-settings FILE    OCR settings with the character shapes (default: %s)\n", DEFAULT_OCR_SETTINGS_FILE);
+	printf("    --out-dir DIR          Directory for the recorded files, which should be on the disk to measure (default: .)\n");
+	printf("    --keep                 Keep the recorded files\n");
+	printf("    --read-back            Decode the recorded files in order and at random with the AAV reader\n");
+	printf("    --json FILE            Write the results as JSON, for comparing builds and machines\n");
+	printf("    --label TEXT           Label stored in the JSON results, e.g. the machine name\n");
+}
+
+int RunRecordingBenchmark(int argc, char** argv)
+{
+	BenchmarkArgs args(argc, argv, 2);
+
+	SyntheticVideoStandard standard = strcmp(args.GetString("standard", "pal"), "ntsc") == 0 ? SyntheticNtsc : SyntheticPal;
+	long integrationRate = args.GetLong("rate", 4);
+
+	RecordingBenchmarkConfig config;
+	InitSyntheticVideoConfig(&config.Video, standard, integrationRate);
+	config.VideoStandard = standard == SyntheticNtsc ? "NTSC" : "PAL";
+	config.Seconds = args.GetDouble("seconds", 10);
+	config.WarmupFrames = args.GetLong("warmup", 100);
+	config.TargetFps = args.GetDouble("fps", 0);
+	config.BufferedProcessing = !args.Has("sync");
+	config.RawQueueLimit = args.GetLong("queue-limit", 8);
+	config.WriteBufferKb = args.GetLong("write-buffer-kb", 8192);
+	config.DurabilityIntervalMs = args.GetLong("durability-ms", 1000);
+	config.StatusSnapshotInterval = args.GetLong("status-snapshots", 0);
+	config.Lagarith16TablesKeyFrame = args.GetLong("lagarith16-tables", 0);
+	config.KeyFrameInterval = args.GetLong("key-frames", 32);
+	config.SceneChangeThreshold = args.GetLong("scene-change", 0);
+	config.PixelsCrc = !args.Has("no-pixels-crc");
+	config.BitPacking = args.GetLong("bit-packing", 0);
+	config.TileSize = args.GetLong("tiles", 0);
+	config.Tracking = !args.Has("no-tracking");
+	config.Ocr = NULL;
+	config.VtiRenderer = NULL;
+	config.OutputDirectory = string(args.GetString("out-dir", "."));
+	config.KeepFiles = args.Has("keep");
+	config.ReadBack = args.Has("read-back");
+
+	string threadCounts = string(args.GetString("compression-threads", "0")) + ",";
+	size_t start = 0;
+	size_t comma;
+
+	while ((comma = threadCounts.find(',', start)) != string::npos)
+	{
+		string count = threadCounts.substr(start, comma - start);
+		start = comma + 1;
+
+		if (count.empty())
+			continue;
+
+		if (atol(count.c_str()) < 0)
+		{
+			PrintRecordingBenchmarkUsage();
+			return BENCHMARK_EXIT_USAGE;
+		}
+
+		config.CompressionThreads.push_back(atol(count.c_str()));
+	}
+
+	vector<const RecordingLayout*> layouts;
+	string layoutNames = string(args.GetString("layouts", "")) + ",";
+	start = 0;
+
+	while ((comma = layoutNames.find(',', start)) != string::npos)
+	{
+		string name = layoutNames.substr(start, comma - start);
+		start = comma + 1;
+
+		if (name.empty())
+			continue;
+
+		const RecordingLayout* layout = NULL;
+		for (unsigned int i = 0; i < RECORDING_LAYOUTS_COUNT; i++)
+			if (name == RECORDING_LAYOUTS[i].Name)
+				layout = &RECORDING_LAYOUTS[i];
+
+		if (NULL == layout)
+		{
+			fprintf(stderr, "Unknown layout '%s'\n", name.c_str());
+			return BENCHMARK_EXIT_USAGE;
+		}
+
+		layouts.push_back(layout);
+	}
+
+	if (layouts.size() == 0)
+	{
+		for (unsigned int i = 0; i < RECORDING_LAYOUTS_COUNT; i++)
+			layouts.push_back(&RECORDING_LAYOUTS[i]);
+	}
+
+	if (integrationRate < 1 || config.Seconds <= 0 || config.WarmupFrames < 10 || config.RawQueueLimit < 1 ||
+		config.WriteBufferKb < 1 || config.DurabilityIntervalMs < 0 || config.CompressionThreads.size() == 0 ||
+		config.StatusSnapshotInterval < 0 || config.StatusSnapshotInterval > 65535 ||
+		config.Lagarith16TablesKeyFrame < 0 || config.Lagarith16TablesKeyFrame > 65535 ||
+		config.KeyFrameInterval < 0 || config.KeyFrameInterval > 65535 || config.SceneChangeThreshold < 0 || config.SceneChangeThreshold > 255 ||
+		(config.BitPacking != 0 && config.BitPacking != 10 && config.BitPacking != 12 && config.BitPacking != 14) ||
+		(config.TileSize != 0 && (config.TileSize < 16 || config.TileSize > 1024)))
+	{
+		PrintRecordingBenchmarkUsage();
+		return BENCHMARK_EXIT_USAGE;
+	}
+
+	OcrConfiguration ocrConfig;
+
+	if (!args.Has("no-vti"))
+	{
+		const char* settingsFile = args.GetString("ocr-settings", DEFAULT_OCR_SETTINGS_FILE);
+		const char* configName = standard == SyntheticNtsc ? DEFAULT_NTSC_VTI_CONFIG : DEFAULT_PAL_VTI_CONFIG;
+
+		if (!LoadOcrConfiguration(settingsFile, configName, &ocrConfig))
+		{
+			fprintf(stderr, "Cannot load OCR configuration '%s' from '%s'\n", configName, settingsFile);
+			return BENCHMARK_EXIT_USAGE;
+		}
+
+		config.Ocr = &ocrConfig;
+		config.VtiRenderer = new IotaVtiRenderer(ocrConfig);
+	}
+
+	printf("%s %ldx%ld x%ld, %s, %s processing, OCR %s, tracking %s, %.1f s per layout\n",
+		config.VideoStandard, config.Video.Width, config.Video.Height, integrationRate,
+		config.TargetFps > 0 ? "fixed rate" : "as fast as possible",
+		config.BufferedProcessing ? "buffered" : "synchronous",
+		NULL != config.Ocr ? "on" : "off", config.Tracking ? "on" : "off", config.Seconds);
+
+	vector<RecordingBenchmarkResult> results;
+
+	for (unsigned int i = 0; i < layouts.size(); i++)
+	{
+		for (unsigned int j = 0; j < config.CompressionThreads.size(); j++)
+		{
+			RecordingBenchmarkResult result;
+			RunRecording(config, *layouts[i], config.CompressionThreads[j], &result);
+
+			PrintRecordingResult(result);
+			results.push_back(result);
+		}
+	}
+
+	if (config.CompressionThreads.size() > 1)
+		PrintCompressionScaling(results);
+
+	if (args.Has("json"))
+		WriteJsonResults(args.GetString("json", ""), args.GetString("label", ""), config, results);
+
+	if (NULL != config.VtiRenderer)
+		delete config.VtiRenderer;
+
+	return BENCHMARK_EXIT_OK;
+}
+
+}
@@ -0,0 +1,19 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef RECORDING_BENCHMARK_H
+#define RECORDING_BENCHMARK_H
+
+namespace OccuRecBenchmarks
+{
+
+// Records synthetic video with IOTA-VTI timestamps to AAV files for each image layout, feeding the frames as fast as
+// the core accepts them (or at a fixed rate), and reports the sustained frame rate and where the time is spent
+int RunRecordingBenchmark(int argc, char** argv);
+
+void PrintRecordingBenchmarkUsage();
+
+}
+
+#endif // RECORDING_BENCHMARK_H
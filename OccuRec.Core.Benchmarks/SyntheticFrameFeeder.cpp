@@ -0,0 +1,166 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+
+#include "SyntheticFrameFeeder.h"
+#include "BenchmarkUtils.h"
+
+#include "OccuRec.Core.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+namespace OccuRecBenchmarks
+{
+
+// Field timestamps kept for checking the OCR-ed integrated frames. Must cover the longest integration period
+#define TRUTH_FIELDS_WINDOW 4096
+
+static void BitmapToTopDownPixels(const unsigned char* bmpBits, long width, long height, long* pixels)
+{
+	long stride = width * 3;
+
+	for (long y = 0; y < height; y++)
+	{
+		const unsigned char* ptrRow = bmpBits + (height - 1 - y) * stride;
+		long* ptrPixels = pixels + y * width;
+
+		for (long x = 0; x < width; x++)
+		{
+			*ptrPixels = *ptrRow;
+			ptrPixels++;
+			ptrRow += 3;
+		}
+	}
+}
+
+void FeedSyntheticFrames(SyntheticVideo* video, const SyntheticFeederConfig& config, SyntheticFeederResults* results)
+{
+	long width = video->Width();
+	long height = video->Height();
+
+	unsigned char* bmpBits = (unsigned char*)malloc(width * height * 3);
+	long* pixels = config.UsePixelsApi ? (long*)malloc(width * height * sizeof(long)) : NULL;
+
+	memset(results, 0, sizeof(SyntheticFeederResults));
+
+	map<long long, long long> truthTimeStamps;
+	vector<double> processUs;
+	processUs.reserve(config.Frames);
+
+	long long ticksPerSecond = HighResolutionTimer::TicksPerSecond();
+	long long frameTicks = config.TargetFps > 0 ? (long long)(ticksPerSecond / config.TargetFps) : 0;
+	long long lastUniqueFrameNo = 0;
+
+	ImageStatus* imageStatus = new ImageStatus();
+	FrameProcessingStatus frameStatus;
+
+	long long startTicks = HighResolutionTimer::Ticks();
+
+	for (long i = 0; i < config.Frames; i++)
+	{
+		SyntheticFrameInfo frameInfo;
+		video->NextFrame(bmpBits, &frameInfo);
+
+		results->DroppedFrames += frameInfo.DroppedFrames;
+		if (frameInfo.IsNewIntegrationPeriod)
+			results->IntegrationPeriods++;
+
+		truthTimeStamps[frameInfo.FirstFieldNumber] = frameInfo.FirstFieldTimeStamp;
+		truthTimeStamps[frameInfo.SecondFieldNumber] = frameInfo.SecondFieldTimeStamp;
+		while (truthTimeStamps.size() > TRUTH_FIELDS_WINDOW)
+			truthTimeStamps.erase(truthTimeStamps.begin());
+
+		if (NULL != config.RawFile)
+			fwrite(bmpBits, 1, width * height * 3, config.RawFile);
+
+		if (NULL != config.TruthFile && frameInfo.IsNewIntegrationPeriod)
+			fprintf(config.TruthFile, "%ld\n", i);
+
+		if (NULL != pixels)
+			BitmapToTopDownPixels(bmpBits, width, height, pixels);
+
+		if (frameTicks > 0)
+		{
+			// Sleep while there is enough time left and spin for the rest to hit the schedule precisely
+			long long dueTicks = startTicks + i * frameTicks;
+			long long remainingTicks = dueTicks - HighResolutionTimer::Ticks();
+
+			if (remainingTicks > 2 * ticksPerSecond / 1000)
+				SleepMilliseconds((long)(remainingTicks * 1000 / ticksPerSecond) - 1);
+
+			while (HighResolutionTimer::Ticks() < dueTicks)
+				;
+
+			if (HighResolutionTimer::Ticks() - dueTicks > frameTicks)
+				results->LateFrames++;
+		}
+
+		// The VTI time is only known as time of day, so the current UTC day is 0
+		long long callStartTicks = HighResolutionTimer::Ticks();
+
+		if (NULL != pixels)
+			ProcessVideoFrame2(pixels, 0, 0, 0, 0, &frameStatus);
+		else
+			ProcessVideoFrame(bmpBits, 0, 0, 0, 0, &frameStatus);
+
+		long long callEndTicks = HighResolutionTimer::Ticks();
+
+		processUs.push_back((callEndTicks - callStartTicks) * 1E6 / ticksPerSecond);
+
+		GetCurrentImageStatus(imageStatus);
+
+		if (imageStatus->UniqueFrameNo != lastUniqueFrameNo)
+		{
+			lastUniqueFrameNo = imageStatus->UniqueFrameNo;
+			results->IntegratedFrames++;
+
+			if (imageStatus->OcrWorking != 0)
+			{
+				map<long long, long long>::iterator it = truthTimeStamps.find(imageStatus->EndExposureFrameNo);
+
+				results->OcrCheckedFrames++;
+				if (it == truthTimeStamps.end() || it->second != imageStatus->EndExposureTicks)
+					results->OcrMismatchedFrames++;
+			}
+		}
+	}
+
+	long long endTicks = HighResolutionTimer::Ticks();
+
+	results->FramesFed = config.Frames;
+	results->ElapsedSeconds = (double)(endTicks - startTicks) / ticksPerSecond;
+	results->AchievedFps = results->ElapsedSeconds > 0 ? config.Frames / results->ElapsedSeconds : 0;
+	results->OcrErrors = imageStatus->OcrErrorsSinceLastReset;
+	results->OcrWorking = imageStatus->OcrWorking != 0;
+	results->DetectedIntegrationRate = imageStatus->DetectedIntegrationRate;
+
+	if (processUs.size() > 0)
+	{
+		double sum = 0;
+		for (unsigned int i = 0; i < processUs.size(); i++)
+			sum += processUs[i];
+
+		sort(processUs.begin(), processUs.end());
+
+		results->ProcessMeanUs = sum / processUs.size();
+		results->ProcessP99Us = processUs[(processUs.size() * 99) / 100];
+		results->ProcessMaxUs = processUs.back();
+	}
+
+	delete imageStatus;
+
+	if (NULL != pixels)
+		free(pixels);
+
+	free(bmpBits);
+}
+
+}
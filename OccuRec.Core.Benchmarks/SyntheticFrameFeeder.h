@@ -0,0 +1,56 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef SYNTHETIC_FRAME_FEEDER_H
+#define SYNTHETIC_FRAME_FEEDER_H
+
+#include "SyntheticVideo.h"
+#include <stdio.h>
+
+namespace OccuRecBenchmarks
+{
+
+struct SyntheticFeederConfig
+{
+	long Frames;
+	// Frames per second passed to the core. 0 feeds the frames as fast as the core accepts them
+	double TargetFps;
+	// Use ProcessVideoFrame2() with top-down pixels instead of ProcessVideoFrame() with a bottom-up bitmap
+	bool UsePixelsApi;
+	// Optional copies of the fed frames and the integration boundaries, in the format read by the detection benchmark
+	FILE* RawFile;
+	FILE* TruthFile;
+};
+
+struct SyntheticFeederResults
+{
+	long FramesFed;
+	long DroppedFrames;
+	long IntegrationPeriods;
+	double ElapsedSeconds;
+	double AchievedFps;
+
+	// Time spent in the ProcessVideoFrame call only, excluding the frame rendering
+	double ProcessMeanUs;
+	double ProcessP99Us;
+	double ProcessMaxUs;
+	// Frames fed later than their scheduled time by more than one frame period
+	long LateFrames;
+
+	// Integrated frames reported by the core and how many of their OCR-ed end timestamps were checked against the generator
+	long IntegratedFrames;
+	long OcrCheckedFrames;
+	long OcrMismatchedFrames;
+	long OcrErrors;
+	bool OcrWorking;
+	long DetectedIntegrationRate;
+};
+
+// Feeds a synthetic video into the core at a controlled rate and verifies the OCR-ed timestamps of the integrated frames.
+// The core must already be configured for the size of the video and must not use buffered frame processing
+void FeedSyntheticFrames(SyntheticVideo* video, const SyntheticFeederConfig& config, SyntheticFeederResults* results);
+
+}
+
+#endif // SYNTHETIC_FRAME_FEEDER_H
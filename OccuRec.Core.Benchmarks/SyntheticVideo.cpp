@@ -0,0 +1,456 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+
+#include "SyntheticVideo.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define NOISE_TABLE_SIZE_BITS 20
+#define FWHM_TO_SIGMA 2.35482
+
+namespace OccuRecBenchmarks
+{
+
+SyntheticRandom::SyntheticRandom(unsigned int seed)
+{
+	m_State = 0x9E3779B97F4A7C15ULL ^ ((unsigned long long)seed * 0xBF58476D1CE4E5B9ULL);
+	if (m_State == 0) m_State = 0x9E3779B97F4A7C15ULL;
+
+	m_HasSpareGaussian = false;
+	m_SpareGaussian = 0;
+}
+
+unsigned int SyntheticRandom::NextUInt()
+{
+	m_State ^= m_State >> 12;
+	m_State ^= m_State << 25;
+	m_State ^= m_State >> 27;
+
+	return (unsigned int)((m_State * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+double SyntheticRandom::NextDouble()
+{
+	return NextUInt() / 4294967296.0;
+}
+
+double SyntheticRandom::NextGaussian()
+{
+	if (m_HasSpareGaussian)
+	{
+		m_HasSpareGaussian = false;
+		return m_SpareGaussian;
+	}
+
+	// Marsaglia polar method
+	double u, v, s;
+	do
+	{
+		u = 2.0 * NextDouble() - 1.0;
+		v = 2.0 * NextDouble() - 1.0;
+		s = u * u + v * v;
+	}
+	while (s >= 1.0 || s == 0.0);
+
+	double mul = sqrt(-2.0 * log(s) / s);
+
+	m_SpareGaussian = v * mul;
+	m_HasSpareGaussian = true;
+
+	return u * mul;
+}
+
+void InitSyntheticVideoConfig(SyntheticVideoConfig* config, long width, long height, long integrationRate)
+{
+	config->Width = width;
+	config->Height = height;
+	config->IntegrationRate = integrationRate;
+	config->IntegrationPhase = 0;
+
+	config->Background = 40;
+	config->SceneNoiseSigma = 4;
+	config->VideoNoiseSigma = 1.5;
+
+	// Roughly 60 stars in a PAL frame
+	config->NumberOfStars = (width * height) / 7000;
+	config->StarFluxMin = 500;
+	config->StarFluxMax = 20000;
+	config->PsfFwhm = 2.5;
+	config->Scintillation = 0.05;
+
+	config->GainJumpProbability = 0;
+	config->GainJumpMagnitude = 0.1;
+
+	config->NumberOfPassingStars = 0;
+	config->PassingStarFlux = 30000;
+	config->PassingStarSpeed = 0.5;
+
+	config->FrameRate = 25;
+	config->Interlaced = true;
+	config->OddFieldFirst = true;
+	config->OddFieldLineParity = 0;
+
+	config->DroppedFrameProbability = 0;
+
+	config->StartTimeOfDayTicks = 12 * 36000000000LL;
+	config->FirstFieldNumber = 1000;
+	config->GpsFixType = 'P';
+	config->TrackedSatellites = 8;
+	config->AlmanacUpdating = false;
+
+	config->Seed = 1;
+}
+
+void InitSyntheticVideoConfig(SyntheticVideoConfig* config, SyntheticVideoStandard standard, long integrationRate)
+{
+	if (standard == SyntheticNtsc)
+	{
+		InitSyntheticVideoConfig(config, 720, 480, integrationRate);
+		config->FrameRate = 30000.0 / 1001.0;
+	}
+	else
+	{
+		InitSyntheticVideoConfig(config, 720, 576, integrationRate);
+		config->FrameRate = 25;
+	}
+}
+
+SyntheticVideo::SyntheticVideo(const SyntheticVideoConfig& config)
+{
+	m_Config = config;
+	if (m_Config.IntegrationRate < 1) m_Config.IntegrationRate = 1;
+	m_Config.IntegrationPhase = m_Config.IntegrationPhase % m_Config.IntegrationRate;
+
+	m_Scene = (float*)malloc(m_Config.Width * m_Config.Height * sizeof(float));
+
+	m_SecondFieldScene = NULL;
+	if (m_Config.Interlaced && m_Config.IntegrationRate == 1 && m_Config.NumberOfPassingStars > 0)
+		m_SecondFieldScene = (float*)malloc(m_Config.Width * m_Config.Height * sizeof(float));
+
+	// A table of unit gaussian deviates, read from a random offset for every frame, is much cheaper
+	// than generating a new deviate for every pixel and still gives independent noise between frames
+	m_NoiseTableSize = 1 << NOISE_TABLE_SIZE_BITS;
+	m_NoiseTable = (float*)malloc(m_NoiseTableSize * sizeof(float));
+
+	m_Random = NULL;
+	m_VtiRenderer = NULL;
+
+	Reset();
+}
+
+SyntheticVideo::~SyntheticVideo()
+{
+	if (NULL != m_Scene)
+	{
+		free(m_Scene);
+		m_Scene = NULL;
+	}
+
+	if (NULL != m_SecondFieldScene)
+	{
+		free(m_SecondFieldScene);
+		m_SecondFieldScene = NULL;
+	}
+
+	if (NULL != m_NoiseTable)
+	{
+		free(m_NoiseTable);
+		m_NoiseTable = NULL;
+	}
+
+	if (NULL != m_Random)
+	{
+		delete m_Random;
+		m_Random = NULL;
+	}
+}
+
+long SyntheticVideo::Width()
+{
+	return m_Config.Width;
+}
+
+long SyntheticVideo::Height()
+{
+	return m_Config.Height;
+}
+
+long long SyntheticVideo::FrameNo()
+{
+	return m_FrameNo;
+}
+
+long long SyntheticVideo::IntegrationPeriodNo()
+{
+	return m_IntegrationPeriodNo;
+}
+
+void SyntheticVideo::Reset()
+{
+	if (NULL != m_Random)
+		delete m_Random;
+
+	m_Random = new SyntheticRandom(m_Config.Seed);
+
+	for (long i = 0; i < m_NoiseTableSize; i++)
+		m_NoiseTable[i] = (float)m_Random->NextGaussian();
+
+	m_Stars.clear();
+	for (long i = 0; i < m_Config.NumberOfStars; i++)
+	{
+		SyntheticStar star;
+		star.X = 4 + m_Random->NextDouble() * (m_Config.Width - 8);
+		star.Y = 4 + m_Random->NextDouble() * (m_Config.Height - 8);
+		// Uniform in magnitude, so faint stars are more common than bright ones
+		star.Flux = m_Config.StarFluxMin * pow((double)m_Config.StarFluxMax / m_Config.StarFluxMin, m_Random->NextDouble());
+		star.VelocityX = 0;
+		star.VelocityY = 0;
+		m_Stars.push_back(star);
+	}
+
+	m_PassingStars.clear();
+	for (long i = 0; i < m_Config.NumberOfPassingStars; i++)
+	{
+		// Place the passing objects so they cross the centre of the frame, where the integration detection looks
+		SyntheticStar star;
+		star.X = m_Config.Width / 2 - 64 - 48 * i;
+		star.Y = m_Config.Height / 2 - 16 + 10 * (i % 4);
+		star.Flux = m_Config.PassingStarFlux;
+		star.VelocityX = m_Config.PassingStarSpeed;
+		star.VelocityY = 0.1 * m_Config.PassingStarSpeed * (m_Random->NextDouble() - 0.5);
+		m_PassingStars.push_back(star);
+	}
+
+	m_FrameNo = 0;
+	m_IntegrationPeriodNo = 0;
+	m_Gain = 1.0;
+}
+
+bool SyntheticVideo::AttachVtiRenderer(IotaVtiRenderer* vtiRenderer)
+{
+	if (NULL != vtiRenderer &&
+		(vtiRenderer->Config().Width != m_Config.Width || vtiRenderer->Config().Height != m_Config.Height))
+		return false;
+
+	m_VtiRenderer = vtiRenderer;
+	if (NULL != m_VtiRenderer)
+		m_Config.OddFieldLineParity = m_VtiRenderer->OddFieldLineParity();
+
+	return true;
+}
+
+void SyntheticVideo::RenderStar(float* scene, double x, double y, double flux)
+{
+	double sigma = m_Config.PsfFwhm / FWHM_TO_SIGMA;
+	double twoSigmaSquared = 2 * sigma * sigma;
+	double peak = flux / (3.14159265358979 * twoSigmaSquared);
+	long radius = (long)ceil(4 * sigma);
+
+	long xFrom = (long)x - radius;
+	long xTo = (long)x + radius;
+	long yFrom = (long)y - radius;
+	long yTo = (long)y + radius;
+
+	if (xFrom < 0) xFrom = 0;
+	if (yFrom < 0) yFrom = 0;
+	if (xTo >= m_Config.Width) xTo = m_Config.Width - 1;
+	if (yTo >= m_Config.Height) yTo = m_Config.Height - 1;
+
+	for (long py = yFrom; py <= yTo; py++)
+	{
+		float* ptrScene = scene + py * m_Config.Width + xFrom;
+		double dy = py - y;
+
+		for (long px = xFrom; px <= xTo; px++)
+		{
+			double dx = px - x;
+			*ptrScene += (float)(peak * exp(-(dx * dx + dy * dy) / twoSigmaSquared));
+			ptrScene++;
+		}
+	}
+}
+
+void SyntheticVideo::RenderScene(float* scene, double midFrameNo)
+{
+	long totalPixels = m_Config.Width * m_Config.Height;
+	long mask = m_NoiseTableSize - 1;
+	long offset = m_Random->NextUInt() & mask;
+
+	for (long i = 0; i < totalPixels; i++)
+		scene[i] = m_Config.Background + m_Config.SceneNoiseSigma * m_NoiseTable[(offset + i) & mask];
+
+	for (unsigned int i = 0; i < m_Stars.size(); i++)
+	{
+		double flux = m_Stars[i].Flux * (1 + m_Config.Scintillation * m_Random->NextGaussian());
+		RenderStar(scene, m_Stars[i].X, m_Stars[i].Y, flux > 0 ? flux : 0);
+	}
+
+	// The passing objects are drawn at their position in the middle of the exposure
+	double wrapWidth = m_Config.Width + 40;
+
+	for (unsigned int i = 0; i < m_PassingStars.size(); i++)
+	{
+		double x = fmod(m_PassingStars[i].X + m_PassingStars[i].VelocityX * midFrameNo + 20, wrapWidth);
+		if (x < 0) x += wrapWidth;
+		double y = m_PassingStars[i].Y + m_PassingStars[i].VelocityY * midFrameNo;
+
+		RenderStar(scene, x - 20, y, m_PassingStars[i].Flux);
+	}
+}
+
+void SyntheticVideo::RenderNextIntegrationPeriod()
+{
+	if (NULL != m_SecondFieldScene)
+	{
+		// Without integration the two fields of a frame are exposed 1/2 frame apart and moving objects are in different places
+		RenderScene(m_Scene, m_FrameNo + 0.25);
+		RenderScene(m_SecondFieldScene, m_FrameNo + 0.75);
+	}
+	else
+		RenderScene(m_Scene, m_FrameNo + m_Config.IntegrationRate / 2.0);
+
+	m_IntegrationPeriodNo++;
+}
+
+long long SyntheticVideo::FieldTimeStamp(long long fieldIndex)
+{
+	long long timeStamp = m_Config.StartTimeOfDayTicks + (long long)(fieldIndex * 10000000.0 / (2 * m_Config.FrameRate));
+
+	// The IOTA-VTI shows the time with a resolution of 0.1 ms
+	return (timeStamp / 1000) * 1000;
+}
+
+void SyntheticVideo::RenderVtiTimestamp(const SyntheticFrameInfo& frameInfo)
+{
+	IotaVtiFieldStamp stamp;
+	stamp.GpsFixType = m_Config.GpsFixType;
+	stamp.TrackedSatellites = m_Config.TrackedSatellites;
+	stamp.AlmanacUpdating = m_Config.AlmanacUpdating;
+
+	char firstFieldChars[IOTA_VTI_CHAR_POSITIONS];
+	char secondFieldChars[IOTA_VTI_CHAR_POSITIONS];
+
+	stamp.TimeStampTicks = frameInfo.FirstFieldTimeStamp;
+	stamp.FieldNumber = frameInfo.FirstFieldNumber;
+	stamp.UseSecondTimestampPosition = (frameInfo.FirstFieldNumber % 2) == 1;
+	FormatIotaVtiFieldStamp(stamp, firstFieldChars);
+
+	stamp.TimeStampTicks = frameInfo.SecondFieldTimeStamp;
+	stamp.FieldNumber = frameInfo.SecondFieldNumber;
+	stamp.UseSecondTimestampPosition = (frameInfo.SecondFieldNumber % 2) == 1;
+	FormatIotaVtiFieldStamp(stamp, secondFieldChars);
+
+	if (m_Config.OddFieldFirst)
+		m_VtiRenderer->Render(firstFieldChars, secondFieldChars);
+	else
+		m_VtiRenderer->Render(secondFieldChars, firstFieldChars);
+}
+
+bool SyntheticVideo::NextFrame(unsigned char* bmpBits)
+{
+	return NextFrame(bmpBits, NULL);
+}
+
+bool SyntheticVideo::NextFrame(unsigned char* bmpBits, SyntheticFrameInfo* frameInfo)
+{
+	bool isNewIntegrationPeriod = false;
+	long droppedFrames = 0;
+
+	for(;;)
+	{
+		bool isBoundary =
+			m_FrameNo == 0 ||
+			(m_FrameNo >= m_Config.IntegrationPhase && (m_FrameNo - m_Config.IntegrationPhase) % m_Config.IntegrationRate == 0);
+
+		if (isBoundary)
+		{
+			RenderNextIntegrationPeriod();
+			// A boundary in a dropped frame is seen as a boundary in the next captured frame
+			isNewIntegrationPeriod = true;
+		}
+
+		if (m_Config.GainJumpProbability > 0 && m_Random->NextDouble() < m_Config.GainJumpProbability)
+			m_Gain *= m_Random->NextDouble() < 0.5 ? 1 - m_Config.GainJumpMagnitude : 1 + m_Config.GainJumpMagnitude;
+
+		if (m_FrameNo > 0 && m_Config.DroppedFrameProbability > 0 && m_Random->NextDouble() < m_Config.DroppedFrameProbability)
+		{
+			m_FrameNo++;
+			droppedFrames++;
+			continue;
+		}
+
+		break;
+	}
+
+	SyntheticFrameInfo info;
+	info.FrameNo = m_FrameNo;
+	info.IntegrationPeriodNo = m_IntegrationPeriodNo;
+	info.IsNewIntegrationPeriod = isNewIntegrationPeriod;
+	info.DroppedFrames = droppedFrames;
+	info.FirstFieldNumber = m_Config.FirstFieldNumber + 2 * m_FrameNo;
+	info.FirstFieldTimeStamp = FieldTimeStamp(2 * m_FrameNo);
+	info.SecondFieldNumber = info.FirstFieldNumber + 1;
+	info.SecondFieldTimeStamp = FieldTimeStamp(2 * m_FrameNo + 1);
+
+	const short* overlay = NULL;
+	if (NULL != m_VtiRenderer)
+	{
+		RenderVtiTimestamp(info);
+		overlay = m_VtiRenderer->Overlay();
+	}
+
+	long mask = m_NoiseTableSize - 1;
+	long offset = m_Random->NextUInt() & mask;
+	long stride = m_Config.Width * 3;
+	float gain = (float)m_Gain;
+	float videoNoiseSigma = m_Config.VideoNoiseSigma;
+
+	long noiseIndex = offset;
+
+	for (long y = 0; y < m_Config.Height; y++)
+	{
+		bool isOddFieldLine = (y % 2) == m_Config.OddFieldLineParity;
+		bool isSecondFieldLine = isOddFieldLine != m_Config.OddFieldFirst;
+
+		const float* ptrScene = (isSecondFieldLine && NULL != m_SecondFieldScene ? m_SecondFieldScene : m_Scene) + y * m_Config.Width;
+		const short* ptrOverlay = NULL != overlay ? overlay + y * m_Config.Width : NULL;
+
+		// Bottom-up bitmap, as received from the video capture
+		unsigned char* ptrRow = bmpBits + (m_Config.Height - 1 - y) * stride;
+
+		for (long x = 0; x < m_Config.Width; x++)
+		{
+			float value = NULL != ptrOverlay && ptrOverlay[x] >= 0 ? ptrOverlay[x] : gain * *ptrScene;
+			value += videoNoiseSigma * m_NoiseTable[noiseIndex & mask];
+
+			unsigned char pixel;
+			if (value <= 0)
+				pixel = 0;
+			else if (value >= 255)
+				pixel = 255;
+			else
+				pixel = (unsigned char)(value + 0.5f);
+
+			*ptrRow = pixel;
+			*(ptrRow + 1) = pixel;
+			*(ptrRow + 2) = pixel;
+
+			ptrRow += 3;
+			ptrScene++;
+			noiseIndex++;
+		}
+	}
+
+	m_FrameNo++;
+
+	if (NULL != frameInfo)
+		*frameInfo = info;
+
+	return isNewIntegrationPeriod;
+}
+
+}
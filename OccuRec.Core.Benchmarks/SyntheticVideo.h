@@ -0,0 +1,173 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef SYNTHETIC_VIDEO_H
+#define SYNTHETIC_VIDEO_H
+
+#include "IotaVtiRenderer.h"
+#include <vector>
+
+using namespace std;
+
+namespace OccuRecBenchmarks
+{
+
+// Small deterministic random number generator (xorshift64*). Used instead of <random> so the generated
+// sequences are identical across compilers and standard libraries and the benchmark results are comparable
+class SyntheticRandom
+{
+	private:
+		unsigned long long m_State;
+		bool m_HasSpareGaussian;
+		double m_SpareGaussian;
+
+	public:
+		SyntheticRandom(unsigned int seed);
+
+		unsigned int NextUInt();
+		double NextDouble();
+		double NextGaussian();
+};
+
+struct SyntheticStar
+{
+	double X;
+	double Y;
+	double Flux;
+	double VelocityX;
+	double VelocityY;
+};
+
+struct SyntheticVideoConfig
+{
+	long Width;
+	long Height;
+
+	// Number of consecutive video frames showing the same integrated exposure
+	long IntegrationRate;
+	// Index of the first frame of the first full integration period
+	long IntegrationPhase;
+
+	float Background;
+	// Noise of the integrated exposure itself (sky and shot noise). Changes only at the integration boundaries
+	float SceneNoiseSigma;
+	// Analog video noise. Different in every video frame, including the repeated frames of the same integration
+	float VideoNoiseSigma;
+
+	long NumberOfStars;
+	float StarFluxMin;
+	float StarFluxMax;
+	float PsfFwhm;
+	// Relative flux change of the stars between two integration periods
+	float Scintillation;
+
+	// Probability per video frame for a sudden gain (AGC) change and its relative size
+	float GainJumpProbability;
+	float GainJumpMagnitude;
+
+	// Bright objects moving across the field, including the area used for the integration detection
+	long NumberOfPassingStars;
+	float PassingStarFlux;
+	float PassingStarSpeed;
+
+	// Video standard timing. The field timestamps advance by 1 / (2 * FrameRate) seconds
+	double FrameRate;
+	// Interlaced frames carry two fields exposed half a frame apart
+	bool Interlaced;
+	bool OddFieldFirst;
+	// The video lines with this parity (y % 2) carry the odd field
+	long OddFieldLineParity;
+
+	// Probability per video frame to be lost by the capture. Lost frames still advance the camera time and field numbers
+	float DroppedFrameProbability;
+
+	// Content of the IOTA-VTI timestamp, when a renderer is attached
+	long long StartTimeOfDayTicks;
+	long long FirstFieldNumber;
+	char GpsFixType;
+	long TrackedSatellites;
+	bool AlmanacUpdating;
+
+	unsigned int Seed;
+};
+
+enum SyntheticVideoStandard
+{
+	SyntheticPal = 0,
+	SyntheticNtsc = 1
+};
+
+void InitSyntheticVideoConfig(SyntheticVideoConfig* config, long width, long height, long integrationRate);
+
+// PAL 720x576 at 25 fps or NTSC 720x480 at 29.97 fps
+void InitSyntheticVideoConfig(SyntheticVideoConfig* config, SyntheticVideoStandard standard, long integrationRate);
+
+struct SyntheticFrameInfo
+{
+	// Camera frame number, which includes the dropped frames
+	long long FrameNo;
+	long long IntegrationPeriodNo;
+	bool IsNewIntegrationPeriod;
+	// Number of frames dropped right before this one
+	long DroppedFrames;
+
+	// Field numbers and the timestamps shown by the IOTA-VTI (time of day truncated to 0.1 ms) in the order of exposure
+	long long FirstFieldNumber;
+	long long FirstFieldTimeStamp;
+	long long SecondFieldNumber;
+	long long SecondFieldTimeStamp;
+};
+
+// Renders a deterministic sequence of video frames from an integrating camera with known integration boundaries
+class SyntheticVideo
+{
+	private:
+		SyntheticVideoConfig m_Config;
+		SyntheticRandom* m_Random;
+
+		float* m_Scene;
+		// Scene of the second field of interlaced frames when every field is a separate exposure (x1 with moving objects)
+		float* m_SecondFieldScene;
+		float* m_NoiseTable;
+		long m_NoiseTableSize;
+
+		vector<SyntheticStar> m_Stars;
+		vector<SyntheticStar> m_PassingStars;
+
+		long long m_FrameNo;
+		long long m_IntegrationPeriodNo;
+		double m_Gain;
+
+		IotaVtiRenderer* m_VtiRenderer;
+
+		void RenderStar(float* scene, double x, double y, double flux);
+		void RenderScene(float* scene, double midFrameNo);
+		void RenderNextIntegrationPeriod();
+		void RenderVtiTimestamp(const SyntheticFrameInfo& frameInfo);
+		long long FieldTimeStamp(long long fieldIndex);
+
+	public:
+		SyntheticVideo(const SyntheticVideoConfig& config);
+		~SyntheticVideo();
+
+		long Width();
+		long Height();
+		long long FrameNo();
+		long long IntegrationPeriodNo();
+
+		void Reset();
+
+		// Draws the IOTA-VTI timestamp into all following frames. The renderer must match the frame size and
+		// outlive the video. Returns false if the sizes differ
+		bool AttachVtiRenderer(IotaVtiRenderer* vtiRenderer);
+
+		// Renders the next video frame as a bottom-up 24-bit BGR bitmap, which is the format passed to ProcessVideoFrame().
+		// Returns true when the rendered frame is the first frame of a new integration period.
+		bool NextFrame(unsigned char* bmpBits);
+		bool NextFrame(unsigned char* bmpBits, SyntheticFrameInfo* frameInfo);
+};
+
+}
+
+#endif // SYNTHETIC_VIDEO_H
@@ -0,0 +1,954 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// CoreTestDriver.c : Headless tests of the OccuRec.Core shared library. Written in C and using only the exported
+// functions, so the tests also check that the library can be loaded and used the way the other hosts do.
+
+#include "OccuRec.Core.Api.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_EXIT_OK 0
+#define TEST_EXIT_FAILED 1
+#define TEST_EXIT_USAGE 2
+
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 240
+
+#define TEST_STAR_X 150.3
+#define TEST_STAR_Y 110.7
+
+// A region around the star, which crosses the tiles of 48 pixels
+#define TEST_REGION_X 130
+#define TEST_REGION_Y 90
+#define TEST_REGION_WIDTH 30
+#define TEST_REGION_HEIGHT 20
+
+static int s_Failures = 0;
+
+#define CHECK(condition) \
+	do { if (!(condition)) { fprintf(stderr, "%s:%d: CHECK FAILED: %s\n", __FILE__, __LINE__, #condition); s_Failures++; } } while (0)
+
+static unsigned int s_Random = 12345;
+
+// How far the star has drifted from TEST_STAR_X, TEST_STAR_Y, half as far in y as in x
+static double s_StarDrift = 0;
+
+// The gray pixels of the last TEST_RENDERED_FRAMES rendered frames, top-down, which the decoded frames are compared with
+#define TEST_RENDERED_FRAMES 128
+static unsigned char s_RenderedPixels[TEST_RENDERED_FRAMES * TEST_WIDTH * TEST_HEIGHT];
+static int s_RenderedFramesCount = 0;
+
+// A small LCG, so the synthetic video is the same on all platforms
+static int NextRandom(int range)
+{
+	s_Random = s_Random * 1103515245 + 12345;
+	return (int)((s_Random >> 16) % (unsigned int)range);
+}
+
+// Renders a bottom-up 24 bit video frame, as received from the video capture, with a star at TEST_STAR_X, TEST_STAR_Y
+// moved by the drift
+static void RenderFrame(unsigned char* bmpBits, int noiseRange)
+{
+	unsigned char* renderedPixels = s_RenderedPixels + (s_RenderedFramesCount % TEST_RENDERED_FRAMES) * TEST_WIDTH * TEST_HEIGHT;
+	int x, y;
+
+	for (y = 0; y < TEST_HEIGHT; y++)
+	{
+		unsigned char* ptrRow = bmpBits + (TEST_HEIGHT - 1 - y) * TEST_WIDTH * 3;
+
+		for (x = 0; x < TEST_WIDTH; x++)
+		{
+			double dx = x - TEST_STAR_X - s_StarDrift;
+			double dy = y - TEST_STAR_Y - s_StarDrift / 2;
+			double value = 30 + 160 * exp(-(dx * dx + dy * dy) / (2 * 1.6 * 1.6)) + NextRandom(noiseRange);
+			unsigned char pixel = value >= 255 ? 255 : (unsigned char)value;
+
+			ptrRow[3 * x] = pixel;
+			ptrRow[3 * x + 1] = pixel;
+			ptrRow[3 * x + 2] = pixel;
+			renderedPixels[y * TEST_WIDTH + x] = pixel;
+		}
+	}
+
+	s_RenderedFramesCount++;
+}
+
+// Returns the number of the most recent rendered frame with the pixels of the decoded frame, of the whole image or only
+// of the test region, or -1 when none has them
+static int FindRenderedFrame(const unsigned char* framePixels, long pixelBytes, int comparesTestRegionOnly)
+{
+	int left = comparesTestRegionOnly ? TEST_REGION_X : 0;
+	int top = comparesTestRegionOnly ? TEST_REGION_Y : 0;
+	int right = comparesTestRegionOnly ? TEST_REGION_X + TEST_REGION_WIDTH : TEST_WIDTH;
+	int bottom = comparesTestRegionOnly ? TEST_REGION_Y + TEST_REGION_HEIGHT : TEST_HEIGHT;
+	int frameNo, x, y;
+
+	for (frameNo = s_RenderedFramesCount - 1; frameNo >= 0 && frameNo >= s_RenderedFramesCount - TEST_RENDERED_FRAMES; frameNo--)
+	{
+		const unsigned char* renderedPixels = s_RenderedPixels + (frameNo % TEST_RENDERED_FRAMES) * TEST_WIDTH * TEST_HEIGHT;
+		int isSame = 1;
+
+		for (y = top; y < bottom && isSame; y++)
+		{
+			for (x = left; x < right && isSame; x++)
+			{
+				unsigned int pixel = pixelBytes == 1 ? framePixels[y * TEST_WIDTH + x] : ((const unsigned short*)framePixels)[y * TEST_WIDTH + x];
+				isSame = pixel == renderedPixels[y * TEST_WIDTH + x];
+			}
+		}
+
+		if (isSame)
+			return frameNo;
+	}
+
+	return -1;
+}
+
+static void SetupTestCamera(long imageLayout, long compression, long bpp)
+{
+	CHECK(S_OK == SetupCamera(TEST_WIDTH, TEST_HEIGHT, (LPCTSTR)"Synthetic", 0, false, false, true));
+	CHECK(S_OK == SetupGrabberInfo((LPCTSTR)"Synthetic", (LPCTSTR)"PAL", 25.0f, 0));
+	CHECK(S_OK == SetupAav(imageLayout, compression, bpp, 0, 0, (LPCTSTR)"CoreTestDriver", 0, 0));
+	CHECK(S_OK == SetupIntegrationDetection(5, 0.3f, 1));
+	CHECK(S_OK == DisableOcrProcessing());
+	CHECK(S_OK == DisableTracking());
+}
+
+static void ProcessFrame(unsigned char* bmpBits)
+{
+	FrameProcessingStatus frameStatus;
+	CHECK(S_OK == ProcessVideoFrame(bmpBits, 0, 0, 0, 0, &frameStatus));
+}
+
+static void PlatformTestThreadProc(void* context)
+{
+	int i;
+	HANDLE mutex = ((HANDLE*)context)[0];
+	volatile LONG* counter = (volatile LONG*)((HANDLE*)context)[1];
+
+	for (i = 0; i < 10000; i++)
+	{
+		PlatformLockMutex(mutex);
+		(*counter)++;
+		PlatformUnlockMutex(mutex);
+	}
+}
+
+static void TestPlatform(void)
+{
+	volatile LONG counter = 0;
+	HANDLE context[2];
+	HANDLE threads[4];
+	int i;
+	__int64 startTicks;
+	double elapsedMs;
+
+	context[0] = PlatformCreateMutex();
+	context[1] = (HANDLE)&counter;
+
+	for (i = 0; i < 4; i++)
+		threads[i] = PlatformStartThread(PlatformTestThreadProc, context);
+
+	for (i = 0; i < 4; i++)
+		PlatformWaitForThread(threads[i]);
+
+	CHECK(counter == 40000);
+	PlatformDestroyMutex(context[0]);
+
+	CHECK(PlatformInterlockedIncrement(&counter) == 40001);
+	CHECK(PlatformInterlockedDecrement(&counter) == 40000);
+	CHECK(PlatformCompareExchange(&counter, 5, 40000) == 40000);
+	CHECK(counter == 5);
+	CHECK(PlatformCompareExchange(&counter, 7, 40000) == 5);
+	CHECK(counter == 5);
+
+	startTicks = PlatformPerformanceCounter();
+	PlatformSleep(20);
+	elapsedMs = 1000.0 * (PlatformPerformanceCounter() - startTicks) / PlatformPerformanceFrequency();
+	CHECK(elapsedMs >= 15);
+	CHECK(PlatformNumberOfProcessors() >= 1);
+}
+
+static int ReadFileMagic(const char* fileName, long* fileSize, unsigned int* framesCount)
+{
+	unsigned char header[9];
+	int isAavFile;
+	FILE* file = fopen(fileName, "rb");
+
+	if (NULL == file)
+		return 0;
+
+	isAavFile = fread(header, 1, 9, file) == 9 && header[0] == 'F' && header[1] == 'S' && header[2] == 'T' && header[3] == 'F';
+
+	// Written after the index when the file is closed
+	*framesCount = header[5] | (header[6] << 8) | (header[7] << 16) | ((unsigned int)header[8] << 24);
+
+	fseek(file, 0, SEEK_END);
+	*fileSize = ftell(file);
+	fclose(file);
+
+	return isAavFile;
+}
+
+// Decodes all frames at once and then the last frame alone, which needs its key frame and the frames after it. Every
+// decoded frame must have the pixels of a rendered frame, only inside the test region for the lossy layouts
+static void TestReadingBack(const char* fileName, unsigned int framesCount, long bpp, int comparesTestRegionOnly)
+{
+	AavReaderFileInfo fileInfo;
+	AavReaderFrameInfo* frameInfos;
+	unsigned char* pixels;
+	unsigned char* lastFramePixels;
+	unsigned char* regionPixels;
+	long pixelBytes = bpp > 8 ? 2 : 1;
+	long statusBytesCount = 0;
+	long keyFrameNo = -1;
+	long y;
+	int renderedFrameNo;
+	int prevRenderedFrameNo = -1;
+	unsigned int i;
+	unsigned char statusBytes[4096];
+
+	CHECK(S_OK == OpenAavReader((LPCTSTR)fileName, &fileInfo));
+	CHECK(fileInfo.FramesCount == (long)framesCount);
+	CHECK(fileInfo.Width == TEST_WIDTH && fileInfo.Height == TEST_HEIGHT);
+	CHECK(fileInfo.IndexRebuilt == 0);
+
+	pixels = (unsigned char*)malloc(framesCount * TEST_WIDTH * TEST_HEIGHT * pixelBytes);
+	lastFramePixels = (unsigned char*)malloc(TEST_WIDTH * TEST_HEIGHT * pixelBytes);
+	regionPixels = (unsigned char*)malloc(TEST_REGION_WIDTH * TEST_REGION_HEIGHT * pixelBytes);
+	frameInfos = (AavReaderFrameInfo*)malloc(framesCount * sizeof(AavReaderFrameInfo));
+
+	CHECK(S_OK == ReadAavFrames(0, framesCount, pixels, frameInfos));
+	CHECK(frameInfos[framesCount - 1].TimeStamp >= frameInfos[0].TimeStamp);
+
+	// Every frame is decoded to the pixels it was recorded with, and the integrated frames between the non-integrated
+	// first and last frames are in the order they were rendered
+	for (i = 0; i < framesCount; i++)
+	{
+		renderedFrameNo = FindRenderedFrame(pixels + i * TEST_WIDTH * TEST_HEIGHT * pixelBytes, pixelBytes, comparesTestRegionOnly);
+		CHECK(renderedFrameNo >= 0);
+		if (i >= 2 && i < framesCount - 1)
+			CHECK(renderedFrameNo > prevRenderedFrameNo);
+
+		prevRenderedFrameNo = renderedFrameNo;
+	}
+
+	CHECK(S_OK == ReadAavFrames(framesCount - 1, 1, lastFramePixels, NULL));
+	CHECK(0 == memcmp(lastFramePixels, pixels + (framesCount - 1) * TEST_WIDTH * TEST_HEIGHT * pixelBytes, TEST_WIDTH * TEST_HEIGHT * pixelBytes));
+	CHECK(E_FAIL == ReadAavFrames(framesCount - 1, 2, pixels, NULL));
+
+	// The star is brighter than the background
+	if (bpp == 8)
+		CHECK(lastFramePixels[110 * TEST_WIDTH + 150] > lastFramePixels[10 * TEST_WIDTH + 10] + 50);
+	else
+		CHECK(((unsigned short*)lastFramePixels)[110 * TEST_WIDTH + 150] > ((unsigned short*)lastFramePixels)[10 * TEST_WIDTH + 10] + 50);
+
+	// Seeking to the last frame decodes the frames from its key frame
+	CHECK(S_OK == FindAavKeyFrame(framesCount - 1, &keyFrameNo));
+	CHECK(keyFrameNo >= 0 && keyFrameNo < (long)framesCount);
+	CHECK(S_OK == ReadAavFrames(keyFrameNo, framesCount - keyFrameNo, pixels, NULL));
+	CHECK(0 == memcmp(lastFramePixels, pixels + (framesCount - 1 - keyFrameNo) * TEST_WIDTH * TEST_HEIGHT * pixelBytes, TEST_WIDTH * TEST_HEIGHT * pixelBytes));
+	CHECK(E_FAIL == FindAavKeyFrame(framesCount, &keyFrameNo));
+
+	// The region of the last frame is the same as in the whole frame
+	CHECK(S_OK == ReadAavFrameRegion(framesCount - 1, TEST_REGION_X, TEST_REGION_Y, TEST_REGION_WIDTH, TEST_REGION_HEIGHT, regionPixels));
+	for (y = 0; y < TEST_REGION_HEIGHT; y++)
+	{
+		CHECK(0 == memcmp(
+			regionPixels + y * TEST_REGION_WIDTH * pixelBytes,
+			lastFramePixels + ((TEST_REGION_Y + y) * TEST_WIDTH + TEST_REGION_X) * pixelBytes,
+			TEST_REGION_WIDTH * pixelBytes));
+	}
+	CHECK(E_FAIL == ReadAavFrameRegion(framesCount - 1, TEST_WIDTH - 10, 0, TEST_REGION_WIDTH, TEST_REGION_HEIGHT, regionPixels));
+
+	CHECK(S_OK == ReadAavFrameStatus(framesCount - 1, statusBytes, sizeof(statusBytes), &statusBytesCount));
+	CHECK(statusBytesCount == frameInfos[framesCount - 1].StatusBytesCount && statusBytesCount > 0);
+
+	CHECK(S_OK == CloseAavReader());
+	CHECK(E_FAIL == ReadAavFrames(0, 1, pixels, NULL));
+
+	free(frameInfos);
+	free(regionPixels);
+	free(lastFramePixels);
+	free(pixels);
+}
+
+static void TestRecording(const char* outputDirectory, const char* layoutName, long imageLayout, long compression, long bpp)
+{
+	unsigned char* bmpBits = (unsigned char*)malloc(TEST_WIDTH * TEST_HEIGHT * 3);
+	CoreProfilingInfo profilingInfo;
+	char fileName[512];
+	long fileSize = 0;
+	unsigned int framesCount = 0;
+	int i;
+
+	sprintf(fileName, "%s/core-test-%s.aav", outputDirectory, layoutName);
+	remove(fileName);
+
+	SetupTestCamera(imageLayout, compression, bpp);
+
+	// The integration is not locked, so every video frame is recorded
+	for (i = 0; i < 10; i++)
+	{
+		RenderFrame(bmpBits, 8);
+		ProcessFrame(bmpBits);
+	}
+
+	CHECK(S_OK == StartRecording((LPCTSTR)fileName));
+	CHECK(S_OK == ResetProfilingInfo());
+
+	for (i = 0; i < 50; i++)
+	{
+		RenderFrame(bmpBits, 8);
+		ProcessFrame(bmpBits);
+	}
+
+	CHECK(S_OK == StopRecording(NULL));
+	CHECK(S_OK == GetProfilingInfo(&profilingInfo));
+
+	printf("%s: recorded %lld frames, %lld bytes\n", layoutName, profilingInfo.RecordedFrames, profilingInfo.BytesWritten);
+
+	CHECK(profilingInfo.ProcessedFrames == 50);
+	CHECK(profilingInfo.RecordedFrames >= 50);
+	CHECK(profilingInfo.DroppedRecordingFrames == 0);
+	CHECK(profilingInfo.DiskWrites >= 1);
+	CHECK(ReadFileMagic(fileName, &fileSize, &framesCount));
+	// Frames recorded before the profiling was reset are also in the file
+	CHECK(framesCount >= profilingInfo.RecordedFrames);
+	CHECK(fileSize > TEST_WIDTH * TEST_HEIGHT / 10);
+
+	TestReadingBack(fileName, framesCount, bpp, 0);
+
+	remove(fileName);
+	free(bmpBits);
+}
+
+// Records the star drifting back and forth by up to 6 pixels while it is tracked, so the motion compensated layout
+// shifts the previous frames by the tracked offsets
+static void TestMotionCompensation(const char* outputDirectory, const char* layoutName, long compression, long bpp)
+{
+	unsigned char* bmpBits = (unsigned char*)malloc(TEST_WIDTH * TEST_HEIGHT * 3);
+	char fileName[512];
+	long fileSize = 0;
+	unsigned int framesCount = 0;
+	int i;
+
+	sprintf(fileName, "%s/core-test-%s.aav", outputDirectory, layoutName);
+	remove(fileName);
+
+	SetupTestCamera(6, compression, bpp);
+	CHECK(S_OK == TrackerSettings(0, 1.5, 12, 0.1, 0.4));
+	CHECK(S_OK == TrackerNewConfiguration(TEST_WIDTH, TEST_HEIGHT, 1, false));
+	CHECK(S_OK == TrackerConfigureObject(0, false, false, TEST_STAR_X, TEST_STAR_Y, 5));
+	CHECK(S_OK == TrackerInitialiseNewTracking());
+	CHECK(S_OK == EnableTracking(0, -1, 1, 5, 5, 2.0f, 350));
+
+	// The first recorded frames are those processed before the recording is started
+	for (i = 0; i < 10; i++)
+	{
+		RenderFrame(bmpBits, 8);
+		ProcessFrame(bmpBits);
+	}
+
+	CHECK(S_OK == StartRecording((LPCTSTR)fileName));
+
+	// The last frame is back next to the start, where TestReadingBack() looks for the star
+	for (i = 0; i < 60; i++)
+	{
+		s_StarDrift = 0.6 * (i % 20 < 10 ? i % 20 : 20 - i % 20);
+		RenderFrame(bmpBits, 8);
+		ProcessFrame(bmpBits);
+	}
+
+	CHECK(S_OK == StopRecording(NULL));
+	CHECK(S_OK == DisableTracking());
+	s_StarDrift = 0;
+
+	CHECK(ReadFileMagic(fileName, &fileSize, &framesCount));
+	printf("%s: recorded %u frames, %ld bytes\n", layoutName, framesCount, fileSize);
+	CHECK(framesCount >= 60);
+
+	TestReadingBack(fileName, framesCount, bpp, 0);
+
+	remove(fileName);
+	free(bmpBits);
+}
+
+// Records a diff coded file with a key frame only when the mean difference from the base frame is above the
+// threshold, and returns the number of frames since the key frame of its last frame
+static long FramesSinceLastKeyFrame(const char* outputDirectory, long imageLayout, long compression, long bpp, long sceneChangeThreshold)
+{
+	unsigned char* bmpBits = (unsigned char*)malloc(TEST_WIDTH * TEST_HEIGHT * 3);
+	char fileName[512];
+	long fileSize = 0;
+	unsigned int framesCount = 0;
+	long keyFrameNo = -1;
+	AavReaderFileInfo fileInfo;
+	int i;
+
+	sprintf(fileName, "%s/core-test-scene-change.aav", outputDirectory);
+
+	CHECK(S_OK == SetupAavKeyFrames(0, sceneChangeThreshold));
+	SetupTestCamera(imageLayout, compression, bpp);
+	CHECK(S_OK == StartRecording((LPCTSTR)fileName));
+
+	for (i = 0; i < 20; i++)
+	{
+		RenderFrame(bmpBits, 8);
+		ProcessFrame(bmpBits);
+	}
+
+	CHECK(S_OK == StopRecording(NULL));
+	CHECK(S_OK == SetupAavKeyFrames(32, 0));
+	CHECK(ReadFileMagic(fileName, &fileSize, &framesCount));
+
+	CHECK(S_OK == OpenAavReader((LPCTSTR)fileName, &fileInfo));
+	CHECK(S_OK == FindAavKeyFrame(framesCount - 1, &keyFrameNo));
+	CHECK(S_OK == CloseAavReader());
+
+	remove(fileName);
+	free(bmpBits);
+	return (long)framesCount - 1 - keyFrameNo;
+}
+
+// The noise of the frames is a mean difference of about 2.6 gray levels from the frame before them, of the 8 bit
+// pixels or of the 16 bit pixels
+static void TestSceneChangeKeyFrames(const char* outputDirectory, long imageLayout, long compression, long bpp)
+{
+	CHECK(0 == FramesSinceLastKeyFrame(outputDirectory, imageLayout, compression, bpp, 1));
+	CHECK(19 <= FramesSinceLastKeyFrame(outputDirectory, imageLayout, compression, bpp, 255));
+}
+
+// Records a fixed region around TEST_REGION_X, TEST_REGION_Y and a region following the drifting star, so between
+// the reference frames only the two crops are stored and the rest of the image is that of the reference frame
+static void TestRegionsOfInterest(const char* outputDirectory, const char* layoutName, long compression, long bpp)
+{
+	unsigned char* bmpBits = (unsigned char*)malloc(TEST_WIDTH * TEST_HEIGHT * 3);
+	unsigned char* pixels = (unsigned char*)malloc(2 * TEST_WIDTH * TEST_HEIGHT * 2);
+	long pixelBytes = bpp > 8 ? 2 : 1;
+	char fileName[512];
+	long fileSize = 0;
+	unsigned int framesCount = 0;
+	long keyFrameNo = -1;
+	AavReaderFileInfo fileInfo;
+	int i;
+
+	sprintf(fileName, "%s/core-test-%s.aav", outputDirectory, layoutName);
+	remove(fileName);
+
+	CHECK(E_FAIL == SetupAavRegionOfInterest(16, 0, 0, 10, 10, -1));
+	CHECK(E_FAIL == SetupAavRegionOfInterest(0, -1, 0, 10, 10, -1));
+	CHECK(E_FAIL == SetupAavRegionOfInterest(0, 0, 0, 10, 10, -2));
+	CHECK(S_OK == SetupAavRegionOfInterest(0, TEST_REGION_X, TEST_REGION_Y, TEST_REGION_WIDTH, TEST_REGION_HEIGHT, -1));
+	CHECK(S_OK == SetupAavRegionOfInterest(1, 0, 0, 16, 16, 0));
+
+	SetupTestCamera(7, compression, bpp);
+	CHECK(S_OK == TrackerSettings(0, 1.5, 12, 0.1, 0.4));
+	CHECK(S_OK == TrackerNewConfiguration(TEST_WIDTH, TEST_HEIGHT, 1, false));
+	CHECK(S_OK == TrackerConfigureObject(0, false, false, TEST_STAR_X, TEST_STAR_Y, 5));
+	CHECK(S_OK == TrackerInitialiseNewTracking());
+	CHECK(S_OK == EnableTracking(0, -1, 1, 5, 5, 2.0f, 350));
+
+	// The first recorded frames are those processed before the recording is started
+	for (i = 0; i < 10; i++)
+	{
+		RenderFrame(bmpBits, 8);
+		ProcessFrame(bmpBits);
+	}
+
+	CHECK(S_OK == StartRecording((LPCTSTR)fileName));
+
+	for (i = 0; i < 60; i++)
+	{
+		s_StarDrift = 0.6 * (i % 20 < 10 ? i % 20 : 20 - i % 20);
+		RenderFrame(bmpBits, 8);
+		ProcessFrame(bmpBits);
+	}
+
+	CHECK(S_OK == StopRecording(NULL));
+	CHECK(S_OK == DisableTracking());
+	CHECK(S_OK == SetupAavRegionOfInterest(0, 0, 0, 0, 0, -1));
+	CHECK(S_OK == SetupAavRegionOfInterest(1, 0, 0, 0, 0, -1));
+	s_StarDrift = 0;
+
+	CHECK(ReadFileMagic(fileName, &fileSize, &framesCount));
+	printf("%s: recorded %u frames, %ld bytes\n", layoutName, framesCount, fileSize);
+	CHECK(framesCount >= 60);
+	// Two reference frames and the crops
+	CHECK(fileSize < 3 * TEST_WIDTH * TEST_HEIGHT * pixelBytes);
+
+	// Only the crops are those of the rendered frames
+	TestReadingBack(fileName, framesCount, bpp, 1);
+
+	// The background of the last frame, outside the regions, is that of its reference frame
+	CHECK(S_OK == OpenAavReader((LPCTSTR)fileName, &fileInfo));
+	CHECK(S_OK == FindAavKeyFrame(framesCount - 1, &keyFrameNo));
+	CHECK(keyFrameNo >= 0 && keyFrameNo < (long)framesCount - 1);
+	CHECK(S_OK == ReadAavFrames(keyFrameNo, 1, pixels, NULL));
+	CHECK(S_OK == ReadAavFrames(framesCount - 1, 1, pixels + TEST_WIDTH * TEST_HEIGHT * pixelBytes, NULL));
+	CHECK(0 == memcmp(pixels, pixels + TEST_WIDTH * TEST_HEIGHT * pixelBytes, 80 * TEST_WIDTH * pixelBytes));
+	CHECK(S_OK == CloseAavReader());
+
+	remove(fileName);
+	free(pixels);
+	free(bmpBits);
+}
+
+// Copies the file as it would be left by a crash while its last frame was written: without the index, the user
+// metadata table and their offsets in the header
+static int CopyAsCrashedFile(const char* fileName, const char* crashedFileName)
+{
+	FILE* file = fopen(fileName, "rb");
+	FILE* crashedFile;
+	unsigned char* bytes;
+	long fileSize;
+	long long indexTableOffset = 0;
+	size_t crashedFileSize;
+	int copied;
+
+	if (NULL == file)
+		return 0;
+
+	fseek(file, 0, SEEK_END);
+	fileSize = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	bytes = (unsigned char*)malloc(fileSize);
+	copied = fread(bytes, 1, fileSize, file) == (size_t)fileSize;
+	fclose(file);
+
+	memcpy(&indexTableOffset, bytes + 9, 8);
+	copied = copied && indexTableOffset > 100 && indexTableOffset < fileSize;
+
+	crashedFile = copied ? fopen(crashedFileName, "wb") : NULL;
+	if (NULL != crashedFile)
+	{
+		memset(bytes + 5, 0, 12);
+		memset(bytes + 0x19, 0, 8);
+
+		crashedFileSize = (size_t)indexTableOffset - 100;
+		copied = fwrite(bytes, 1, crashedFileSize, crashedFile) == crashedFileSize;
+		fclose(crashedFile);
+	}
+	else
+		copied = 0;
+
+	free(bytes);
+	return copied;
+}
+
+// Changes one gray level of a pixel in the middle of the file, which is in the pixels of a frame of an uncompressed file
+static int CorruptMiddleByte(const char* fileName)
+{
+	FILE* file = fopen(fileName, "r+b");
+	long fileSize;
+	int value;
+	int corrupted;
+
+	if (NULL == file)
+		return 0;
+
+	fseek(file, 0, SEEK_END);
+	fileSize = ftell(file);
+	fseek(file, fileSize / 2, SEEK_SET);
+	value = fgetc(file);
+	fseek(file, fileSize / 2, SEEK_SET);
+	corrupted = value != EOF && fputc(value ^ 1, file) != EOF;
+	fclose(file);
+
+	return corrupted;
+}
+
+// Changes one bit of the last image byte of the first frame after the middle of the file, which is the last byte of
+// the CRC when it is stored after the compressed bytes
+static int CorruptFrameCrc(const char* fileName)
+{
+	FILE* file = fopen(fileName, "r+b");
+	unsigned char* bytes;
+	long fileSize;
+	long offset;
+	long crcOffset = -1;
+	unsigned int imageSectionBytes;
+	int corrupted = 0;
+
+	if (NULL == file)
+		return 0;
+
+	fseek(file, 0, SEEK_END);
+	fileSize = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	bytes = (unsigned char*)malloc(fileSize);
+
+	if (fread(bytes, 1, fileSize, file) == (size_t)fileSize)
+	{
+		// The frame start magic, the timestamp, the exposure and the length of the image section
+		for (offset = fileSize / 2; offset + 20 <= fileSize && crcOffset < 0; offset++)
+		{
+			if (bytes[offset] == 0xFF && bytes[offset + 1] == 0x22 && bytes[offset + 2] == 0x01 && bytes[offset + 3] == 0xEE)
+			{
+				imageSectionBytes = bytes[offset + 16] | (bytes[offset + 17] << 8) | (bytes[offset + 18] << 16) | ((unsigned int)bytes[offset + 19] << 24);
+				if (imageSectionBytes > 6 && offset + 20 + (long)imageSectionBytes <= fileSize)
+					crcOffset = offset + 20 + (long)imageSectionBytes - 1;
+			}
+		}
+	}
+
+	if (crcOffset >= 0)
+	{
+		fseek(file, crcOffset, SEEK_SET);
+		corrupted = fputc(bytes[crcOffset] ^ 1, file) != EOF;
+	}
+
+	fclose(file);
+	free(bytes);
+
+	return corrupted;
+}
+
+// Records a file with or without the CRC of the pixels, corrupts it and reads it back
+static HRESULT ReadCorruptedFile(const char* outputDirectory, long imageLayout, long compression, long bpp, long pixelsCrc, int (*corruptFile)(const char*))
+{
+	unsigned char* bmpBits = (unsigned char*)malloc(TEST_WIDTH * TEST_HEIGHT * 3);
+	unsigned char* pixels;
+	char fileName[512];
+	long fileSize = 0;
+	unsigned int framesCount = 0;
+	AavReaderFileInfo fileInfo;
+	HRESULT result = E_FAIL;
+	int i;
+
+	sprintf(fileName, "%s/core-test-crc.aav", outputDirectory);
+
+	CHECK(S_OK == SetupAavPixelsCrc(pixelsCrc));
+	SetupTestCamera(imageLayout, compression, bpp);
+	CHECK(S_OK == StartRecording((LPCTSTR)fileName));
+
+	for (i = 0; i < 20; i++)
+	{
+		RenderFrame(bmpBits, 8);
+		ProcessFrame(bmpBits);
+	}
+
+	CHECK(S_OK == StopRecording(NULL));
+	CHECK(S_OK == SetupAavPixelsCrc(1));
+	CHECK(ReadFileMagic(fileName, &fileSize, &framesCount));
+	CHECK(corruptFile(fileName));
+
+	pixels = (unsigned char*)malloc(framesCount * TEST_WIDTH * TEST_HEIGHT * (bpp > 8 ? 2 : 1));
+	CHECK(S_OK == OpenAavReader((LPCTSTR)fileName, &fileInfo));
+	result = ReadAavFrames(0, framesCount, pixels, NULL);
+	CHECK(S_OK == CloseAavReader());
+
+	remove(fileName);
+	free(pixels);
+	free(bmpBits);
+	return result;
+}
+
+// The changed pixel is only found when the file has the CRC of the pixels. The 16 bit Lagarith16 frames, raw and
+// diff coded, store the CRC after their compressed bytes, where a changed bit is found by checking it
+static void TestPixelsCrc(const char* outputDirectory)
+{
+	CHECK(E_FAIL == ReadCorruptedFile(outputDirectory, 1, 0, 8, 1, CorruptMiddleByte));
+	CHECK(S_OK == ReadCorruptedFile(outputDirectory, 1, 0, 8, 0, CorruptMiddleByte));
+	CHECK(E_FAIL == ReadCorruptedFile(outputDirectory, 4, 1, 16, 1, CorruptFrameCrc));
+	CHECK(E_FAIL == ReadCorruptedFile(outputDirectory, 2, 1, 16, 1, CorruptFrameCrc));
+	CHECK(E_FAIL == ReadCorruptedFile(outputDirectory, 4, 0, 8, 1, CorruptFrameCrc));
+}
+
+static void TestRecovery(const char* outputDirectory)
+{
+	unsigned char* bmpBits = (unsigned char*)malloc(TEST_WIDTH * TEST_HEIGHT * 3);
+	char fileName[512];
+	char crashedFileName[512];
+	long fileSize = 0;
+	long recoveredFileSize = 0;
+	unsigned int framesCount = 0;
+	unsigned int recoveredFramesCount = 0;
+	long recoveredFrames = 0;
+	AavReaderFileInfo fileInfo;
+	int i;
+
+	sprintf(fileName, "%s/core-test-recovery.aav", outputDirectory);
+	sprintf(crashedFileName, "%s/core-test-crashed.aav", outputDirectory);
+
+	SetupTestCamera(4, 0, 8);
+
+	CHECK(S_OK == StartRecording((LPCTSTR)fileName));
+
+	for (i = 0; i < 20; i++)
+	{
+		RenderFrame(bmpBits, 8);
+		ProcessFrame(bmpBits);
+	}
+
+	CHECK(S_OK == StopRecording(NULL));
+	CHECK(ReadFileMagic(fileName, &fileSize, &framesCount));
+	CHECK(framesCount >= 20);
+
+	// A complete file is left unchanged
+	CHECK(S_OK == RecoverAavFile((LPCTSTR)fileName, &recoveredFrames));
+	CHECK(recoveredFrames == (long)framesCount);
+	CHECK(ReadFileMagic(fileName, &recoveredFileSize, &recoveredFramesCount));
+	CHECK(recoveredFileSize == fileSize);
+
+	// The torn last frame is left out by the reader, which finds the frames without the index
+	CHECK(CopyAsCrashedFile(fileName, crashedFileName));
+	CHECK(S_OK == OpenAavReader((LPCTSTR)crashedFileName, &fileInfo));
+	CHECK(fileInfo.IndexRebuilt != 0);
+	CHECK(fileInfo.FramesCount == (long)framesCount - 1);
+	CHECK(S_OK == CloseAavReader());
+
+	// The torn last frame is cut
+	CHECK(S_OK == RecoverAavFile((LPCTSTR)crashedFileName, &recoveredFrames));
+	CHECK(recoveredFrames == (long)framesCount - 1);
+	CHECK(ReadFileMagic(crashedFileName, &recoveredFileSize, &recoveredFramesCount));
+	CHECK(recoveredFramesCount == framesCount - 1);
+	CHECK(recoveredFileSize < fileSize);
+
+	CHECK(E_FAIL == RecoverAavFile((LPCTSTR)"no-such-file.aav", &recoveredFrames));
+
+	remove(fileName);
+	remove(crashedFileName);
+	free(bmpBits);
+}
+
+// The frames in a partly filled write buffer are written once the durability interval of 100 ms has passed, also
+// when no more frames come
+static void TestDurability(const char* outputDirectory)
+{
+	unsigned char* bmpBits = (unsigned char*)malloc(TEST_WIDTH * TEST_HEIGHT * 3);
+	char fileName[512];
+	long headerSize = 0;
+	long fileSize = 0;
+	unsigned int framesCount = 0;
+	int i;
+
+	sprintf(fileName, "%s/core-test-durability.aav", outputDirectory);
+
+	SetupTestCamera(1, 0, 8);
+
+	CHECK(S_OK == StartRecording((LPCTSTR)fileName));
+	CHECK(ReadFileMagic(fileName, &headerSize, &framesCount));
+
+	for (i = 0; i < 2; i++)
+	{
+		RenderFrame(bmpBits, 8);
+		ProcessFrame(bmpBits);
+	}
+
+	PlatformSleep(500);
+	CHECK(ReadFileMagic(fileName, &fileSize, &framesCount));
+	CHECK(fileSize >= headerSize + TEST_WIDTH * TEST_HEIGHT);
+
+	CHECK(S_OK == StopRecording(NULL));
+
+	remove(fileName);
+	free(bmpBits);
+}
+
+static void TestIntegrationDetection(void)
+{
+	unsigned char* bmpBits = (unsigned char*)malloc(TEST_WIDTH * TEST_HEIGHT * 3);
+	ImageStatus imageStatus;
+	int i;
+
+	SetupTestCamera(4, 0, 8);
+
+	// An x4 integrating camera outputs each integrated frame four times
+	for (i = 0; i < 400; i++)
+	{
+		if (i % 4 == 0)
+			RenderFrame(bmpBits, 40);
+
+		ProcessFrame(bmpBits);
+	}
+
+	CHECK(S_OK == GetCurrentImageStatus(&imageStatus));
+	printf("Detected integration rate: %ld\n", imageStatus.DetectedIntegrationRate);
+	CHECK(imageStatus.DetectedIntegrationRate == 4);
+
+	free(bmpBits);
+}
+
+static void TestTracking(void)
+{
+	unsigned char* bmpBits = (unsigned char*)malloc(TEST_WIDTH * TEST_HEIGHT * 3);
+	ImageStatus imageStatus;
+	int i;
+
+	SetupTestCamera(4, 0, 8);
+
+	// The default tracking settings of OccuRec, with the initial position one pixel off
+	CHECK(S_OK == TrackerSettings(0, 1.5, 12, 0.1, 0.4));
+	CHECK(S_OK == TrackerNewConfiguration(TEST_WIDTH, TEST_HEIGHT, 1, false));
+	CHECK(S_OK == TrackerConfigureObject(0, false, false, TEST_STAR_X + 1, TEST_STAR_Y - 1, 5));
+	CHECK(S_OK == TrackerInitialiseNewTracking());
+	CHECK(S_OK == EnableTracking(0, -1, 1, 5, 5, 2.0f, 350));
+
+	for (i = 0; i < 20; i++)
+	{
+		RenderFrame(bmpBits, 4);
+		ProcessFrame(bmpBits);
+	}
+
+	CHECK(S_OK == GetCurrentImageStatus(&imageStatus));
+	printf("Tracked target at (%.2f, %.2f), located: %ld\n", imageStatus.TrkdTargetXPos, imageStatus.TrkdTargetYPos, imageStatus.TrkdTargetIsLocated);
+
+	CHECK(imageStatus.TrkdTargetIsLocated != 0);
+	CHECK(fabs(imageStatus.TrkdTargetXPos - TEST_STAR_X) < 0.5);
+	CHECK(fabs(imageStatus.TrkdTargetYPos - TEST_STAR_Y) < 0.5);
+
+	free(bmpBits);
+}
+
+static void PrintUsage(void)
+{
+	printf("Usage: CoreTestDriver <test> [output directory]\n\n");
+	printf("  platform     Threads, mutexes, interlocked operations, sleep and timer\n");
+	printf("  recording    Records a synthetic video with each AAV image layout\n");
+	printf("  integration  Detects the integration rate of a synthetic x4 integrating camera\n");
+	printf("  tracking     Tracks a synthetic star\n");
+}
+
+int main(int argc, char* argv[])
+{
+	const char* outputDirectory = argc > 2 ? argv[2] : ".";
+
+	if (argc < 2)
+	{
+		PrintUsage();
+		return TEST_EXIT_USAGE;
+	}
+
+	if (strcmp(argv[1], "platform") == 0)
+		TestPlatform();
+	else if (strcmp(argv[1], "recording") == 0)
+	{
+		// Small write-behind buffers, so the recording switches between them many times
+		CHECK(S_OK == SetupAavWriteBehind(256, 100));
+
+		TestRecording(outputDirectory, "raw", 1, 0, 8);
+		TestRecording(outputDirectory, "diff", 3, 0, 8);
+		TestRecording(outputDirectory, "quicklz", 4, 0, 8);
+		TestRecording(outputDirectory, "lagarith16", 4, 1, 16);
+		TestRecording(outputDirectory, "lagarith16-nosigns", 2, 1, 8);
+		TestRecording(outputDirectory, "diff16", 3, 0, 16);
+		TestRecording(outputDirectory, "lagarith16-diff16", 2, 1, 16);
+		TestRecording(outputDirectory, "locoi", 4, 2, 8);
+		TestRecording(outputDirectory, "locoi16", 4, 2, 16);
+		TestRecording(outputDirectory, "locoi-diff", 3, 2, 8);
+		TestRecording(outputDirectory, "lagarith8", 4, 3, 8);
+		TestRecording(outputDirectory, "lagarith8-nosigns", 2, 3, 8);
+
+		// The same layouts compressed by worker threads
+		CHECK(E_FAIL == SetupAavCompressionThreads(-1));
+		CHECK(S_OK == SetupAavCompressionThreads(3));
+
+		TestRecording(outputDirectory, "diff-threads", 3, 0, 8);
+		TestRecording(outputDirectory, "lagarith16-threads", 4, 1, 16);
+		TestRecording(outputDirectory, "locoi-threads", 4, 2, 8);
+		TestRecording(outputDirectory, "lagarith8-threads", 4, 3, 8);
+
+		CHECK(S_OK == SetupAavCompressionThreads(0));
+
+		// Only the status tags which changed, with all of them every 16 frames
+		CHECK(E_FAIL == SetupAavStatusDeltaEncoding(-1));
+		CHECK(S_OK == SetupAavStatusDeltaEncoding(16));
+
+		TestRecording(outputDirectory, "diff-status-delta", 3, 0, 8);
+
+		CHECK(S_OK == SetupAavStatusDeltaEncoding(0));
+
+		// The Lagarith16 tables reused between the frames, with new ones every 8 frames
+		CHECK(E_FAIL == SetupAavLagarith16TableReuse(-1));
+		CHECK(S_OK == SetupAavLagarith16TableReuse(8));
+
+		TestRecording(outputDirectory, "lagarith16-tables", 4, 1, 16);
+		TestRecording(outputDirectory, "lagarith16-tables-nosigns", 2, 1, 8);
+
+		// The workers store the tables in every frame
+		CHECK(S_OK == SetupAavCompressionThreads(3));
+		TestRecording(outputDirectory, "lagarith16-tables-threads", 4, 1, 16);
+		CHECK(S_OK == SetupAavCompressionThreads(0));
+
+		CHECK(S_OK == SetupAavLagarith16TableReuse(0));
+
+		// A key frame every 8 frames, or only when the mean difference from the base frame is above 2 gray levels
+		CHECK(E_FAIL == SetupAavKeyFrames(-1, 0));
+		CHECK(E_FAIL == SetupAavKeyFrames(8, 256));
+		CHECK(S_OK == SetupAavKeyFrames(8, 0));
+
+		TestRecording(outputDirectory, "diff-key-frames", 3, 0, 8);
+
+		CHECK(S_OK == SetupAavKeyFrames(0, 2));
+
+		TestRecording(outputDirectory, "diff-scene-change", 2, 3, 8);
+		TestRecording(outputDirectory, "diff16-scene-change", 3, 0, 16);
+		TestSceneChangeKeyFrames(outputDirectory, 3, 0, 8);
+		TestSceneChangeKeyFrames(outputDirectory, 2, 1, 16);
+
+		CHECK(S_OK == SetupAavKeyFrames(32, 0));
+
+		// The 16 bit pixels packed with 10 bits each, which the sums of single 8 bit frames fit in
+		CHECK(E_FAIL == SetupAavBitPacking(11));
+		CHECK(S_OK == SetupAavBitPacking(10));
+
+		TestRecording(outputDirectory, "raw16-packed", 1, 0, 16);
+		TestRecording(outputDirectory, "quicklz16-packed", 4, 0, 16);
+
+		CHECK(S_OK == SetupAavBitPacking(0));
+
+		// The raw layouts split into tiles of 48 pixels, cut at the right and bottom edges of the image
+		CHECK(E_FAIL == SetupAavTiles(8));
+		CHECK(S_OK == SetupAavTiles(48));
+
+		TestRecording(outputDirectory, "raw-tiles", 1, 0, 8);
+		TestRecording(outputDirectory, "quicklz-tiles", 4, 0, 8);
+		TestRecording(outputDirectory, "locoi16-tiles", 4, 2, 16);
+		TestRecording(outputDirectory, "lagarith8-tiles", 4, 3, 8);
+
+		CHECK(S_OK == SetupAavTiles(0));
+
+		// Without the tracking the motion compensated layout is the differences from the previous frame
+		TestRecording(outputDirectory, "diff-motion", 6, 0, 8);
+		TestMotionCompensation(outputDirectory, "diff-motion-tracked", 0, 8);
+		TestMotionCompensation(outputDirectory, "lagarith8-motion-tracked", 3, 8);
+		TestMotionCompensation(outputDirectory, "lagarith16-motion16-tracked", 1, 16);
+
+		// Only the crops of the regions of interest between the reference frames, LAGARITH16 falls back to QUICKLZ
+		TestRegionsOfInterest(outputDirectory, "roi", 0, 8);
+		TestRegionsOfInterest(outputDirectory, "locoi16-roi", 2, 16);
+		TestRegionsOfInterest(outputDirectory, "lagarith16-roi16", 1, 16);
+		CHECK(S_OK == SetupAavCompressionThreads(3));
+		TestRegionsOfInterest(outputDirectory, "lagarith8-roi-threads", 3, 8);
+		CHECK(S_OK == SetupAavCompressionThreads(0));
+
+		TestPixelsCrc(outputDirectory);
+		TestRecovery(outputDirectory);
+		TestDurability(outputDirectory);
+	}
+	else if (strcmp(argv[1], "integration") == 0)
+		TestIntegrationDetection();
+	else if (strcmp(argv[1], "tracking") == 0)
+		TestTracking();
+	else
+	{
+		PrintUsage();
+		return TEST_EXIT_USAGE;
+	}
+
+	if (s_Failures > 0)
+	{
+		fprintf(stderr, "%s: %d check(s) failed\n", argv[1], s_Failures);
+		return TEST_EXIT_FAILED;
+	}
+
+	printf("%s: passed\n", argv[1]);
+	return TEST_EXIT_OK;
+}
@@ -0,0 +1,429 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// StatusSectionTests.cpp : Round trip of the status section. Linked with the objects of the core rather than the
+// shared library, as the status tags and the message lists cannot be set with the exported functions. The frames are
+// decoded as the readers of the section do and compared with the tag values which were set.
+
+#include "stdafx.h"
+#include "aav_status_section.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define TEST_EXIT_OK 0
+#define TEST_EXIT_FAILED 1
+
+// A key frame every 8 frames, and a few frames past the last key frame
+#define TEST_SNAPSHOT_INTERVAL 8
+#define TEST_FRAMES (5 * TEST_SNAPSHOT_INTERVAL + 3)
+
+#define TEST_MAX_MESSAGES 16
+
+static int s_Failures = 0;
+
+#define CHECK(condition) \
+	do { if (!(condition)) { fprintf(stderr, "%s:%d: CHECK FAILED: %s\n", __FILE__, __LINE__, #condition); s_Failures++; } } while (0)
+
+// The value of a tag in a frame. The fixed size values are kept as their little endian bytes
+struct TestTagValue
+{
+	bool IsSet;
+	unsigned long long Value;
+	string Text;
+	vector<string> Messages;
+};
+
+// Decodes the frames of version 2 of the status section one after the other, keeping the tags of the previous frame
+// and the steps of the ULong64 tags as the readers do
+class TestStatusDecoder
+{
+	private:
+		vector<AavTagType> m_TagTypes;
+		vector<TestTagValue> m_PrevTags;
+		vector<long long> m_Steps;
+
+	public:
+		vector<TestTagValue> Tags;
+
+		// The number of entries of each STATUS_ENTRY_* code in the delta frames
+		unsigned int EntriesCount[4];
+		// The ULong64 tags of the delta frames which were set without an entry, as they kept their step
+		unsigned int PredictedCount;
+		// The ULong64 tags of the delta frames written as values although they were set in the previous frame
+		unsigned int FallbackCount;
+
+		TestStatusDecoder(const vector<AavTagType>& tagTypes)
+		{
+			m_TagTypes = tagTypes;
+			TestTagValue notSet;
+			notSet.IsSet = false;
+			notSet.Value = 0;
+			Tags.assign(tagTypes.size(), notSet);
+			m_PrevTags = Tags;
+			m_Steps.assign(tagTypes.size(), 0);
+			memset(EntriesCount, 0, sizeof(EntriesCount));
+			PredictedCount = 0;
+			FallbackCount = 0;
+		}
+
+		bool DecodeFrame(const unsigned char* bytes, unsigned int bytesCount);
+
+	private:
+		static unsigned int FixedValueBytes(AavTagType tagType);
+		bool DecodeValue(unsigned int tagId, const unsigned char* bytes, unsigned int bytesCount, unsigned int* pos);
+};
+
+unsigned int TestStatusDecoder::FixedValueBytes(AavTagType tagType)
+{
+	switch(tagType)
+	{
+		case UInt8: return 1;
+		case UInt16: return 2;
+		case ULong64: return 8;
+		case Real: return 4;
+		default: return 0;
+	}
+}
+
+// A whole value, as written in the key frames and by the STATUS_ENTRY_VALUE entries
+bool TestStatusDecoder::DecodeValue(unsigned int tagId, const unsigned char* bytes, unsigned int bytesCount, unsigned int* pos)
+{
+	TestTagValue& tag = Tags[tagId];
+	tag.IsSet = true;
+
+	if (m_TagTypes[tagId] == AnsiString255)
+	{
+		if (*pos + 1 > bytesCount || *pos + 1 + bytes[*pos] > bytesCount)
+			return false;
+
+		tag.Text = string((const char*)bytes + *pos + 1, bytes[*pos]);
+		*pos += 1 + bytes[*pos];
+		return true;
+	}
+
+	if (m_TagTypes[tagId] == List16OfAnsiString255)
+	{
+		if (*pos + 1 > bytesCount)
+			return false;
+
+		unsigned int messagesCount = bytes[(*pos)++];
+		tag.Messages.clear();
+		for (unsigned int i = 0; i < messagesCount; i++)
+		{
+			if (*pos + 1 > bytesCount || *pos + 1 + bytes[*pos] > bytesCount)
+				return false;
+
+			tag.Messages.push_back(string((const char*)bytes + *pos + 1, bytes[*pos]));
+			*pos += 1 + bytes[*pos];
+		}
+		return true;
+	}
+
+	unsigned int valueBytes = FixedValueBytes(m_TagTypes[tagId]);
+	if (valueBytes == 0 || *pos + valueBytes > bytesCount)
+		return false;
+
+	tag.Value = 0;
+	memcpy(&tag.Value, bytes + *pos, valueBytes);
+	*pos += valueBytes;
+	return true;
+}
+
+bool TestStatusDecoder::DecodeFrame(const unsigned char* bytes, unsigned int bytesCount)
+{
+	if (bytesCount < 2)
+		return false;
+
+	bool keyFrame = bytes[0] == STATUS_KEY_FRAME;
+	unsigned int tagsCount = m_TagTypes.size();
+
+	for (unsigned int tagId = 0; tagId < tagsCount; tagId++)
+	{
+		TestTagValue& tag = Tags[tagId];
+		tag.Messages.clear();
+
+		// The tags which are not in a key frame are not set, the tags which are not in a delta frame are as predicted
+		if (keyFrame || m_TagTypes[tagId] == List16OfAnsiString255)
+			tag.IsSet = false;
+		else if (tag.IsSet && m_TagTypes[tagId] == ULong64)
+			tag.Value += (unsigned long long)m_Steps[tagId];
+	}
+
+	vector<bool> hasEntry(tagsCount, false);
+	unsigned int entriesCount = bytes[1];
+	unsigned int pos = 2;
+
+	for (unsigned int i = 0; i < entriesCount; i++)
+	{
+		if (pos + 1 > bytesCount)
+			return false;
+
+		unsigned int tagId = bytes[pos++];
+		if (tagId >= tagsCount)
+			return false;
+
+		hasEntry[tagId] = true;
+
+		if (keyFrame)
+		{
+			if (!DecodeValue(tagId, bytes, bytesCount, &pos))
+				return false;
+			continue;
+		}
+
+		if (pos + 1 > bytesCount)
+			return false;
+
+		unsigned char entryCode = bytes[pos++];
+		if (entryCode > STATUS_ENTRY_NOT_SET)
+			return false;
+
+		EntriesCount[entryCode]++;
+		TestTagValue& tag = Tags[tagId];
+
+		if (entryCode == STATUS_ENTRY_VALUE)
+		{
+			if (m_TagTypes[tagId] == ULong64 && m_PrevTags[tagId].IsSet)
+				FallbackCount++;
+
+			if (!DecodeValue(tagId, bytes, bytesCount, &pos))
+				return false;
+		}
+		else if (entryCode == STATUS_ENTRY_DELTA)
+		{
+			// A zigzag varint of the difference from the prediction, which is already in the value
+			if (m_TagTypes[tagId] != ULong64 || !tag.IsSet)
+				return false;
+
+			unsigned long long zigzag = 0;
+			unsigned int shift = 0;
+			unsigned char varintByte;
+			do
+			{
+				if (pos + 1 > bytesCount || shift > 63)
+					return false;
+
+				varintByte = bytes[pos++];
+				zigzag |= (unsigned long long)(varintByte & 0x7F) << shift;
+				shift += 7;
+			}
+			while ((varintByte & 0x80) != 0);
+
+			tag.Value += (zigzag >> 1) ^ (0 - (zigzag & 1));
+		}
+		else if (entryCode == STATUS_ENTRY_PREFIX)
+		{
+			if (m_TagTypes[tagId] != AnsiString255 || !tag.IsSet || pos + 2 > bytesCount)
+				return false;
+
+			unsigned int prefixLen = bytes[pos];
+			unsigned int suffixLen = bytes[pos + 1];
+			if (prefixLen > tag.Text.size() || pos + 2 + suffixLen > bytesCount)
+				return false;
+
+			tag.Text = tag.Text.substr(0, prefixLen) + string((const char*)bytes + pos + 2, suffixLen);
+			pos += 2 + suffixLen;
+		}
+		else
+			tag.IsSet = false;
+	}
+
+	if (pos != bytesCount)
+		return false;
+
+	// The steps of the ULong64 tags between this frame and the previous one, which start again from 0 at each key frame
+	for (unsigned int tagId = 0; tagId < tagsCount; tagId++)
+	{
+		if (m_TagTypes[tagId] != ULong64)
+			continue;
+
+		if (!keyFrame && Tags[tagId].IsSet && !hasEntry[tagId])
+			PredictedCount++;
+
+		m_Steps[tagId] = !keyFrame && Tags[tagId].IsSet && m_PrevTags[tagId].IsSet
+			? (long long)(Tags[tagId].Value - m_PrevTags[tagId].Value)
+			: 0;
+	}
+
+	m_PrevTags = Tags;
+	return true;
+}
+
+static void SetFixedSizeTag(vector<TestTagValue>& expected, unsigned int tagId, const void* value, unsigned int valueBytes)
+{
+	expected[tagId].IsSet = true;
+	expected[tagId].Value = 0;
+	memcpy(&expected[tagId].Value, value, valueBytes);
+}
+
+// Records TEST_FRAMES frames with tags which keep their step, change it, jump by more than a varint of 8 bytes can
+// hold, share prefixes, stop being set and carry messages, and compares each decoded frame with the tags which were set
+static void TestStatusRoundTrip(void)
+{
+	AavLib::AavStatusSection* section = new AavLib::AavStatusSection();
+	section->SetSnapshotInterval(TEST_SNAPSHOT_INTERVAL);
+
+	vector<AavTagType> tagTypes;
+
+	// Not defined grouped by type, as the fixed size tags are written in a different order than their tag ids
+	unsigned int timestamp = section->DefineTag("StartFrameTimestamp", AnsiString255);
+	tagTypes.push_back(AnsiString255);
+	unsigned int systemTime = section->DefineTag("SystemTime", ULong64);
+	tagTypes.push_back(ULong64);
+	unsigned int gpsFix = section->DefineTag("GPSFixStatus", UInt8);
+	tagTypes.push_back(UInt8);
+	unsigned int messages = section->DefineTag("Messages", List16OfAnsiString255);
+	tagTypes.push_back(List16OfAnsiString255);
+	unsigned int integratedFrames = section->DefineTag("IntegratedFrames", UInt16);
+	tagTypes.push_back(UInt16);
+	unsigned int startFrame = section->DefineTag("StartFrame", ULong64);
+	tagTypes.push_back(ULong64);
+	unsigned int gain = section->DefineTag("Gain", Real);
+	tagTypes.push_back(Real);
+	unsigned int offset = section->DefineTag("Offset", ULong64);
+	tagTypes.push_back(ULong64);
+
+	unsigned char* statusBytes = (unsigned char*)malloc(section->MaxFrameBufferSize);
+	TestStatusDecoder decoder(tagTypes);
+
+	for (int frameNo = 0; frameNo < TEST_FRAMES; frameNo++)
+	{
+		TestTagValue notSet;
+		notSet.IsSet = false;
+		notSet.Value = 0;
+		vector<TestTagValue> expected(tagTypes.size(), notSet);
+
+		section->BeginFrame();
+
+		// Predicted from the step, which changes once
+		long long startFrameValue = frameNo < 20 ? frameNo * 4 : 80 + (frameNo - 20) * 7;
+		section->AddFrameStatusTagUInt64(startFrame, startFrameValue);
+		SetFixedSizeTag(expected, startFrame, &startFrameValue, 8);
+
+		// Deltas of a few ticks from the predicted step
+		long long systemTimeValue = 635000000000000000LL + frameNo * 400000LL + (frameNo % 3);
+		section->AddFrameStatusTagUInt64(systemTime, systemTimeValue);
+		SetFixedSizeTag(expected, systemTime, &systemTimeValue, 8);
+
+		// Jumps which do not fit in a varint of 8 bytes, both ways
+		long long offsetValue = frameNo % 5 == 2 ? 0x7FFF000000000000LL + frameNo : -(long long)frameNo;
+		section->AddFrameStatusTagUInt64(offset, offsetValue);
+		SetFixedSizeTag(expected, offset, &offsetValue, 8);
+
+		unsigned short integratedFramesValue = frameNo < 30 ? 4 : 8;
+		section->AddFrameStatusTagUInt16(integratedFrames, integratedFramesValue);
+		SetFixedSizeTag(expected, integratedFrames, &integratedFramesValue, 2);
+
+		// Not set for a few frames, within a snapshot interval and across a key frame
+		if ((frameNo < 10 || frameNo >= 13) && (frameNo < 31 || frameNo >= 34))
+		{
+			unsigned char gpsFixValue = (unsigned char)(frameNo / 9);
+			section->AddFrameStatusTagUInt8(gpsFix, gpsFixValue);
+			SetFixedSizeTag(expected, gpsFix, &gpsFixValue, 1);
+		}
+
+		float gainValue = 1.5f + (frameNo / 10) * 0.25f;
+		section->AddFrameStatusTagReal(gain, gainValue);
+		SetFixedSizeTag(expected, gain, &gainValue, 4);
+
+		// Share a prefix with the previous timestamp, but not the ones which cannot be read
+		if (frameNo < 25 || frameNo >= 27)
+		{
+			char timestampValue[32];
+			if (frameNo % 11 == 5)
+				strcpy(timestampValue, "NO TIMESTAMP");
+			else
+				sprintf(timestampValue, "01:23:%02d.%04d", frameNo / 25, (frameNo % 25) * 400);
+
+			section->AddFrameStatusTag(timestamp, timestampValue);
+			expected[timestamp].IsSet = true;
+			expected[timestamp].Text = string(timestampValue);
+		}
+
+		// More messages than are kept in one of the frames
+		if (frameNo % 7 == 3)
+		{
+			int messagesCount = frameNo == 17 ? 20 : 2;
+			for (int i = 0; i < messagesCount; i++)
+			{
+				char message[64];
+				sprintf(message, "Message %d of frame %d", i, frameNo);
+				section->AddFrameStatusTagMessage(messages, message);
+
+				if (i >= messagesCount - TEST_MAX_MESSAGES)
+					expected[messages].Messages.push_back(string(message));
+			}
+			expected[messages].IsSet = true;
+		}
+
+		unsigned int statusBytesCount = 0;
+		section->GetDataBytes(statusBytes, &statusBytesCount);
+		CHECK(statusBytesCount <= (unsigned int)section->MaxFrameBufferSize);
+		CHECK(statusBytes[0] == (frameNo % TEST_SNAPSHOT_INTERVAL == 0 ? STATUS_KEY_FRAME : STATUS_DELTA_FRAME));
+
+		if (!decoder.DecodeFrame(statusBytes, statusBytesCount))
+		{
+			fprintf(stderr, "Cannot decode the status of frame %d\n", frameNo);
+			s_Failures++;
+			break;
+		}
+
+		for (unsigned int tagId = 0; tagId < tagTypes.size(); tagId++)
+		{
+			const TestTagValue& tag = decoder.Tags[tagId];
+			bool isSame = tag.IsSet == expected[tagId].IsSet;
+
+			if (isSame && tag.IsSet)
+			{
+				if (tagTypes[tagId] == AnsiString255)
+					isSame = tag.Text == expected[tagId].Text;
+				else if (tagTypes[tagId] == List16OfAnsiString255)
+					isSame = tag.Messages == expected[tagId].Messages;
+				else
+					isSame = tag.Value == expected[tagId].Value;
+			}
+
+			if (!isSame)
+			{
+				fprintf(stderr, "Tag %u of frame %d is not decoded as it was set\n", tagId, frameNo);
+				s_Failures++;
+			}
+		}
+	}
+
+	printf("Status delta entries: %u values (%u ULong64 fallbacks), %u deltas, %u prefixes, %u not set, %u predicted\n",
+		decoder.EntriesCount[STATUS_ENTRY_VALUE], decoder.FallbackCount, decoder.EntriesCount[STATUS_ENTRY_DELTA],
+		decoder.EntriesCount[STATUS_ENTRY_PREFIX], decoder.EntriesCount[STATUS_ENTRY_NOT_SET], decoder.PredictedCount);
+
+	// Each kind of entry is written
+	CHECK(decoder.EntriesCount[STATUS_ENTRY_VALUE] > 0);
+	CHECK(decoder.EntriesCount[STATUS_ENTRY_DELTA] > 0);
+	CHECK(decoder.EntriesCount[STATUS_ENTRY_PREFIX] > 0);
+	CHECK(decoder.EntriesCount[STATUS_ENTRY_NOT_SET] > 0);
+	CHECK(decoder.PredictedCount > 0);
+	CHECK(decoder.FallbackCount > 0);
+
+	free(statusBytes);
+	delete section;
+}
+
+int main(int argc, char* argv[])
+{
+	TestStatusRoundTrip();
+
+	if (s_Failures > 0)
+	{
+		fprintf(stderr, "%d check(s) failed\n", s_Failures);
+		return TEST_EXIT_FAILED;
+	}
+
+	printf("All checks passed\n");
+	return TEST_EXIT_OK;
+}
@@ -7,30 +7,58 @@
 #include "Compressor.h"
 #include <memory.h>
 #include <algorithm>
+#include <iterator>
 #include "ProbabilityCoder.h"
 #include "RangeCoder.h"
 #include <assert.h>
+#include <math.h>
 
 Compressor::Compressor(int frame_width, int frame_height){
 	assert(frame_width>0);
 	assert(frame_height>0);
 	width = frame_width;
 	height = frame_height;
+	encoder_tables_valid = false;
+	decoder_tables_valid = false;
+	stored_tables_size = 0;
 }
 
 bool compare(const DecoderPair &a, const DecoderPair &b){
 	return a.cprobability>b.cprobability;
 }
 
-void Compressor::PrepareTables(unsigned short * uncompressed, int uncompressed_symbol_count){
+void Compressor::CountFrequencies(unsigned short * uncompressed, int uncompressed_symbol_count){
 	memset(frequencies,0,sizeof(frequencies));
-	memset(decoder_table,0,sizeof(decoder_table));
-	table_entries=0;
-	
-	// get symbol frequencies
 	for ( int a=0;a<uncompressed_symbol_count;a++){
 		frequencies[uncompressed[a]]++;
 	}
+}
+
+void Compressor::PrepareTables(int uncompressed_symbol_count, bool cover_range){
+	memset(decoder_table,0,sizeof(decoder_table));
+	table_entries=0;
+
+	// Tables which will be reused also give the least probability to the symbols missing between the smallest and
+	// the largest symbol and a little above it, as the next frames have a few values the frame does not have.
+	// Symbols spread over the whole range, as the pairs of 8 bit pixels, are not worth it
+	int first = 0;
+	int last = -1;
+	if ( cover_range ){
+		int seen = 0;
+		for ( int a=0;a<0x10000;a++){
+			if ( frequencies[a] ){
+				if ( last < 0 ){
+					first = a;
+				}
+				last = a;
+				seen++;
+			}
+		}
+		last = std::min(last+(last-first)/8+1,0xFFFF);
+		if ( last-first+1 > 4*seen+256 ){
+			last = -1;
+		}
+	}
 
 	// compact the table (remove entries with 0 frequency) and scale values so that that the 
 	// probability entry represents a fraction with 1<<FRACTIONAL_BITS as denominator. cprobability will
@@ -38,7 +66,7 @@ void Compressor::PrepareTables(unsigned short * uncompressed, int uncompressed_s
 	int total = uncompressed_symbol_count;
 	int nt=0;
 	for ( int a=0;a<0x10000;a++){
-		if ( frequencies[a] ){
+		if ( frequencies[a] || (a >= first && a <= last) ){
 			double ll = frequencies[a];
 			ll*=1<<FRACTIONAL_BITS;
 			int v = (int)(ll/total+0.5);
@@ -52,8 +80,8 @@ void Compressor::PrepareTables(unsigned short * uncompressed, int uncompressed_s
 		}
 	}
 
-	// sort the values so they are arranged from most frequent to least
-	std::sort(std::begin(decoder_table),std::end(decoder_table),compare);
+	// sort the values so they are arranged from most frequent to least, the entries past them are all 0
+	std::sort(decoder_table,decoder_table+table_entries,compare);
 
 	// correct rounding errors in the probabilty scaling
 	total = 1<<FRACTIONAL_BITS;
@@ -87,14 +115,37 @@ void Compressor::PrepareTables(unsigned short * uncompressed, int uncompressed_s
 	}
 }
 
+// Whether the tables of the previous frame can code the counted frequencies. The divergence of the tables from
+// the frequencies is the number of bits the frame takes with them over the bits with its own probabilities
+bool Compressor::CanReuseTables(int uncompressed_symbol_count){
+	if ( !encoder_tables_valid ){
+		return false;
+	}
+
+	double divergence = 0;
+	for ( int a=0;a<0x10000;a++){
+		if ( frequencies[a] ){
+			if ( encoder_table[a].probability == 0 ){
+				return false;
+			}
+			double ll = (double)frequencies[a]*(1<<FRACTIONAL_BITS);
+			divergence += frequencies[a]*log(ll/((double)uncompressed_symbol_count*encoder_table[a].probability));
+		}
+	}
+
+	// in bits
+	divergence /= log(2.0);
+	return divergence < 8.0*stored_tables_size;
+}
+
 inline void WriteShort(void * dest,unsigned short val){
 	unsigned char * d = (unsigned char *)dest;
 	d[0]=(unsigned char)val;
 	d[1]=(unsigned char)(val>>8);
 }
 
-inline unsigned short ReadShort(void * src){
-	unsigned char * s = (unsigned char *)src;
+inline unsigned short ReadShort(const void * src){
+	const unsigned char * s = (const unsigned char *)src;
 	return s[0]+(s[1]<<8);
 }
 
@@ -121,45 +172,77 @@ int Compressor::StoreDecompressionTable(void * comp){
 	return (table_entries+1)*sizeof(unsigned short)+prob.GetBytesUsed();
 }
 
-int Compressor::LoadDecompressionTable(void * comp){
-	unsigned short * compressed = (unsigned short *)comp;
+int Compressor::LoadDecompressionTable(const void * comp, int compressed_size){
+	const unsigned short * compressed = (const unsigned short *)comp;
 	
+	decoder_tables_valid = false;
+
 	// load number of table entries 
+	if ( compressed_size < (int)(2*sizeof(unsigned short)) )
+		return -1;
 	table_entries = ReadShort(compressed)+1;
+	if ( compressed_size < (int)((table_entries+1)*sizeof(unsigned short)) )
+		return -1;
 
 	// load the values the entries decode to
 	for ( int a=0;a<table_entries;a++){
 		decoder_table[a].decoded_value = ReadShort(compressed+a+1);
 	}
 	if ( table_entries == 1){
+		decoder_tables_valid = true;
 		return 2*sizeof(unsigned short);
 	}
 
-	// store the probability of each entry
-	ProbabilityCoder prob(&compressed[table_entries+1],FRACTIONAL_BITS);
+	// load the probability of each entry
+	ProbabilityCoder prob(&compressed[table_entries+1],FRACTIONAL_BITS,compressed_size-(table_entries+1)*sizeof(unsigned short));
 	int cp=0;
 	for (int a=0;a<table_entries;a++){
 		decoder_table[a].cprobability = cp;
 		int v = prob.ReadSymbol();
-		assert(v);
 		if ( v == 0 )
 			return -1;
 		cp += v;
+		if ( cp > (1<<FRACTIONAL_BITS))
+			return -1;
 	}
 
-	assert(cp==(1<<FRACTIONAL_BITS));
 	if ( cp != (1<<FRACTIONAL_BITS)){
 		return -1;
 	}
 	decoder_table[table_entries].cprobability = 1<<FRACTIONAL_BITS;
+	PrepareDecoderLookup();
+	decoder_tables_valid = true;
 	return (table_entries+1)*sizeof(unsigned short)+prob.GetBytesUsed();
 }
 
-int Compressor::CompressData(unsigned short * uncompressed, void * compressed){
+// The first symbol of each 1<<(FRACTIONAL_BITS-DECODER_LOOKUP_BITS) wide slice of the cumulative probabilities,
+// so the decoder only searches the few symbols starting in the same slice
+void Compressor::PrepareDecoderLookup(){
+	int h=1;
+	for ( int a=0;a<(1<<DECODER_LOOKUP_BITS);a++){
+		for ( ; decoder_table[h].cprobability<=(a<<(FRACTIONAL_BITS-DECODER_LOOKUP_BITS));h++);
+		decoder_lookup[a]=h-1;
+	}
+}
+
+// The special case invalid header that indicates the data could not be compressed, followed by the raw data
+inline bool IsRawFrame(const void * compressed, int compressed_size, int uncompressed_size){
+	if ( compressed_size != 8+uncompressed_size ){
+		return false;
+	}
+	const unsigned char * temp = (const unsigned char *)compressed;
+	int a=0;
+	for ( ;a<8 && temp[a]==0; a++){};
+	return a == 8;
+}
+
+int Compressor::CompressWithNewTables(unsigned short * uncompressed, void * compressed, bool cover_range){
 	
 	int compressed_size = 0;
-	PrepareTables(uncompressed,width*height);
+	PrepareTables(width*height,cover_range);
 	compressed_size = StoreDecompressionTable(compressed);
+	stored_tables_size = compressed_size;
+	encoder_tables_valid = true;
 	if ( table_entries > 1){
 		compressed_size += RangeCompress(uncompressed,((unsigned char*)compressed)+compressed_size,width*height,encoder_table);
 	}
@@ -172,34 +255,100 @@ int Compressor::CompressData(unsigned short * uncompressed, void * compressed){
 		memcpy(temp+8,uncompressed,width*height*sizeof(unsigned short));
 
 		compressed_size = 8+width*height*sizeof(unsigned short);
+		encoder_tables_valid = false;
 	}
 
 	return compressed_size;
 }
 
-int Compressor::DecompressData(void * compressed,unsigned short * uncompressed){
+int Compressor::CompressData(unsigned short * uncompressed, void * compressed){
+	CountFrequencies(uncompressed,width*height);
+	return CompressWithNewTables(uncompressed,compressed,false);
+}
+
+int Compressor::CompressDataReusingTables(unsigned short * uncompressed, void * compressed, bool new_tables){
+	unsigned char * dest = (unsigned char *)compressed;
 
-	{ // Check for special case header indicating the data could not be compressed
-		unsigned char * temp = (unsigned char *)compressed;
-		int a=0;
-		for ( ;a<8 && temp[a]==0; a++){};
-		if ( a == 8 ){
-			memcpy(uncompressed,temp+8,width*height*sizeof(unsigned short));
-			return 8+width*height*sizeof(unsigned short);
+	CountFrequencies(uncompressed,width*height);
+	if ( !new_tables && CanReuseTables(width*height) ){
+		int compressed_size = 0;
+		if ( table_entries > 1){
+			compressed_size = RangeCompress(uncompressed,dest+1,width*height,encoder_table);
+		}
+		if ( compressed_size < width*height*sizeof(unsigned short)){
+			dest[0]=TABLES_REUSED;
+			return 1+compressed_size;
 		}
-		
 	}
- 
-	int compressed_size = LoadDecompressionTable(compressed);
-	if ( compressed_size > 0 ){
-		if ( table_entries > 1 ){
-			compressed_size += RangeDecompress(((unsigned char*)compressed)+compressed_size,uncompressed,width*height,decoder_table,NULL);
-		} else {
-			const int v = decoder_table[0].decoded_value;
-			for ( int a=0;a<width*height;a++){
-				uncompressed[a]=v;
-			}
+
+	dest[0]=TABLES_STORED;
+	return 1+CompressWithNewTables(uncompressed,dest+1,true);
+}
+
+// Decodes the symbols coded with the loaded tables
+int Compressor::DecodeSymbols(const void * compressed, int compressed_size, unsigned short * uncompressed){
+	if ( table_entries == 1 ){
+		const unsigned short v = decoder_table[0].decoded_value;
+		for ( int a=0;a<width*height;a++){
+			uncompressed[a]=v;
 		}
+		return 0;
 	}
-	return compressed_size;
+
+	return RangeDecompress(compressed,compressed_size,uncompressed,width*height,decoder_table,decoder_lookup);
+}
+
+int Compressor::DecompressData(const void * compressed, int compressed_size, unsigned short * uncompressed){
+
+	const int uncompressed_size = width*height*sizeof(unsigned short);
+
+	if ( IsRawFrame(compressed,compressed_size,uncompressed_size) ){
+		memcpy(uncompressed,((const unsigned char *)compressed)+8,uncompressed_size);
+		decoder_tables_valid = false;
+		return 8+uncompressed_size;
+	}
+ 
+	int table_size = LoadDecompressionTable(compressed,compressed_size);
+	if ( table_size < 0 )
+		return -1;
+
+	int data_size = DecodeSymbols(((const unsigned char*)compressed)+table_size,compressed_size-table_size,uncompressed);
+	if ( data_size < 0 )
+		return -1;
+
+	return table_size+data_size;
+}
+
+bool Compressor::ReusesTables(const void * compressed, int compressed_size){
+	return compressed_size > 0 && ((const unsigned char *)compressed)[0] == TABLES_REUSED;
+}
+
+bool Compressor::LoadTables(const void * compressed, int compressed_size){
+	const unsigned char * source = (const unsigned char *)compressed;
+
+	decoder_tables_valid = false;
+	if ( compressed_size < 1 || source[0] != TABLES_STORED || IsRawFrame(source+1,compressed_size-1,width*height*sizeof(unsigned short)) ){
+		return false;
+	}
+
+	return LoadDecompressionTable(source+1,compressed_size-1) >= 0;
+}
+
+int Compressor::DecompressDataReusingTables(const void * compressed, int compressed_size, unsigned short * uncompressed){
+	const unsigned char * source = (const unsigned char *)compressed;
+
+	if ( compressed_size < 1 ){
+		return -1;
+	}
+
+	int data_size;
+	if ( source[0] == TABLES_STORED ){
+		data_size = DecompressData(source+1,compressed_size-1,uncompressed);
+	} else if ( source[0] == TABLES_REUSED && decoder_tables_valid ){
+		data_size = DecodeSymbols(source+1,compressed_size-1,uncompressed);
+	} else {
+		return -1;
+	}
+
+	return data_size < 0 ? -1 : 1+data_size;
 }
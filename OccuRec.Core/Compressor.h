@@ -6,6 +6,16 @@
 #pragma once
 
 #define FRACTIONAL_BITS 20
+// Of the 8 bit compressor, whose 256 symbols all fit in this precision, so its decoder finds a symbol with one
+// lookup of all the bits of the cumulative probability
+#define FRACTIONAL_BITS_8 12
+// The decoder finds a symbol from this many top bits of its cumulative probability. Larger tables do not fit
+// in the L1 cache with the decoder table and are slower
+#define DECODER_LOOKUP_BITS 12
+
+// The first byte of a frame written by CompressDataReusingTables()
+#define TABLES_STORED 0
+#define TABLES_REUSED 1
 
 struct EncoderPair{
 	int probability; // Symbol probability * (1<<FRACTIONAL_BITS)
@@ -24,10 +34,21 @@ private:
 	int frequencies[0x10000]; // need (max possible number of symbols) entries
 	EncoderPair encoder_table[0x10000]; // need (max possible number of symbols) entries
 	DecoderPair decoder_table[0x10001]; // need (max possible number of symbols + 1) entries
+	unsigned short decoder_lookup[1<<DECODER_LOOKUP_BITS];
+
+	// Whether the encoder and the decoder tables are those of the last frame, and the bytes it took to store them
+	bool encoder_tables_valid;
+	bool decoder_tables_valid;
+	int stored_tables_size;
 
-	void PrepareTables(unsigned short * uncompressed, int uncompressed_symbol_count);
+	void CountFrequencies(unsigned short * uncompressed, int uncompressed_symbol_count);
+	void PrepareTables(int uncompressed_symbol_count, bool cover_range);
+	bool CanReuseTables(int uncompressed_symbol_count);
+	int CompressWithNewTables(unsigned short * uncompressed, void * compressed, bool cover_range);
+	int DecodeSymbols(const void * compressed, int compressed_size, unsigned short * uncompressed);
 	int StoreDecompressionTable(void * compressed);
-	int LoadDecompressionTable(void * compressed);
+	int LoadDecompressionTable(const void * compressed, int compressed_size);
+	void PrepareDecoderLookup();
 	
 public:
 	// frame_width and frame_height must be > 0
@@ -40,7 +61,34 @@ public:
 	*/
 	int CompressData(unsigned short * uncompressed, void * compressed);
 	
-	// Returns the number of bytes used in the compressed buffer, or a
-	// negative value if an error occurred
-	int DecompressData(void * compressed, unsigned short * uncompressed);
+	/*
+	Decodes a frame written by CompressData() from the compressed_size bytes of the compressed buffer into
+	frame_width*frame_height symbols. Damaged data is never read past compressed_size.
+	Returns the number of bytes used in the compressed buffer, or a
+	negative value if an error occurred
+	*/
+	int DecompressData(const void * compressed, int compressed_size, unsigned short * uncompressed);
+
+	/*
+	As CompressData(), after a byte telling whether the frame stores its tables or reuses the tables of the
+	previous frame. Consecutive frames of a star field have nearly the same symbol frequencies, so the tables
+	are reused, unless new_tables is set, while the frame has no symbol missing from them and the bits they cost
+	over the frame's own frequencies, their divergence, stay below the size of the last stored tables.
+	Compressed buffer must be 1 byte larger than for CompressData().
+	*/
+	int CompressDataReusingTables(unsigned short * uncompressed, void * compressed, bool new_tables);
+
+	// Whether a frame written by CompressDataReusingTables() needs the tables of an earlier frame
+	static bool ReusesTables(const void * compressed, int compressed_size);
+
+	// Loads the tables of a frame written by CompressDataReusingTables() which stores them. Returns false if the
+	// frame has no tables or they are damaged
+	bool LoadTables(const void * compressed, int compressed_size);
+
+	/*
+	Decodes a frame written by CompressDataReusingTables(). A frame which reuses tables is decoded with the tables
+	of the last frame decoded or given to LoadTables(), which must be the frame that stored them.
+	Returns the number of bytes used in the compressed buffer, or a negative value if an error occurred
+	*/
+	int DecompressDataReusingTables(const void * compressed, int compressed_size, unsigned short * uncompressed);
 };
@@ -31,15 +31,15 @@ namespace LockFree
 	public:
 		tSysInfo()
 		{
-			GetSystemInfo( &sysinfo );
+			numberOfProcessors = PlatformNumberOfProcessors();
 		}
 		 
 		unsigned int GetNumberofProcessors()
 		{
-			return sysinfo.dwNumberOfProcessors;
+			return numberOfProcessors;
 		}
 	private:
-		SYSTEM_INFO sysinfo;
+		unsigned int numberOfProcessors;
 	};
 	//
 
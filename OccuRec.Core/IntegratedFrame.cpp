@@ -2,7 +2,7 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
-#include "StdAfx.h"
+#include "stdafx.h"
 #include "IntegratedFrame.h"
 #include "stdlib.h"
 
@@ -10,6 +10,10 @@
 IntegratedFrame::IntegratedFrame(long totalPixelsInFrame, bool is16Bit)
 {
 	m_TotalPixelsInFrame = totalPixelsInFrame;
+	HasTrackedPosition = false;
+	TrackedXPos = 0;
+	TrackedYPos = 0;
+	RegionsCount = 0;
 	if (is16Bit)
 	{
 		Pixels = NULL;
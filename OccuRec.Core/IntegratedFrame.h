@@ -3,6 +3,9 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #pragma once
+
+#include "aav_tiles.h"
+
 class IntegratedFrame
 {
 private:
@@ -28,6 +31,14 @@ public:
 	__int64 SecondaryStartTimestamp;
 	__int64 SecondaryEndTimestamp;
 	char OcrErrorMessageStr[255];
+	// The last tracked position of the guiding star, or of the target, which the motion compensated layouts shift by
+	bool HasTrackedPosition;
+	double TrackedXPos;
+	double TrackedYPos;
+	// The regions of interest as the x, y, width and height of each, which the REGIONS-OF-INTEREST layout stores
+	// between its reference frames
+	unsigned int RegionsCount;
+	unsigned int Regions[4 * AAV_MAX_REGIONS_OF_INTEREST];
 
 	IntegratedFrame(long totalPixelsInFrame, bool is16Bit);
 	~IntegratedFrame(void);
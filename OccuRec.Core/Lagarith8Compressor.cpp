@@ -0,0 +1,327 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+
+#include "Lagarith8Compressor.h"
+#include <memory.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <math.h>
+#include "ProbabilityCoder.h"
+#include "RangeCoder.h"
+#include <assert.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LAGARITH8_SSE2
+#include <emmintrin.h>
+#endif
+
+// The median of the left and upper bytes and of their gradient, in the byte arithmetic of Lagarith
+inline unsigned char PredictMedian(unsigned char left, unsigned char above, unsigned char above_left){
+	unsigned char gradient = (unsigned char)(left+above-above_left);
+	unsigned char lo = std::min(left,above);
+	unsigned char hi = std::max(left,above);
+	return std::max(lo,std::min(hi,gradient));
+}
+
+Lagarith8Compressor::Lagarith8Compressor(int frame_width){
+	assert(frame_width>0);
+	width = frame_width;
+	residuals = NULL;
+	residuals_size = 0;
+	table_entries = 0;
+}
+
+Lagarith8Compressor::~Lagarith8Compressor(){
+	free(residuals);
+}
+
+int Lagarith8Compressor::MaxCompressedBytes(int samples_count){
+	// the data is stored raw when it does not compress, but the range coder may write up to 1.5 bytes per byte first
+	return LAGARITH8_HEADER_BYTES+1+256+512+samples_count+samples_count/2+16;
+}
+
+void Lagarith8Compressor::PredictResiduals(const unsigned char * samples, int samples_count, int row_width){
+	for ( int row=0;row<samples_count;row+=row_width){
+		const unsigned char * s = samples+row;
+		unsigned char * r = residuals+row;
+		int count = std::min(row_width,samples_count-row);
+
+		if ( row == 0 ){
+			r[0] = s[0];
+			for ( int a=1;a<count;a++){
+				r[a] = (unsigned char)(s[a]-s[a-1]);
+			}
+			continue;
+		}
+
+		const unsigned char * above = s-row_width;
+		r[0] = (unsigned char)(s[0]-above[0]);
+		int a=1;
+#ifdef LAGARITH8_SSE2
+		// the encoder has all the bytes, so 16 predictions are made at once
+		for ( ;a+16<=count;a+=16){
+			__m128i left = _mm_loadu_si128((const __m128i *)(s+a-1));
+			__m128i up = _mm_loadu_si128((const __m128i *)(above+a));
+			__m128i up_left = _mm_loadu_si128((const __m128i *)(above+a-1));
+			__m128i gradient = _mm_sub_epi8(_mm_add_epi8(left,up),up_left);
+			__m128i lo = _mm_min_epu8(left,up);
+			__m128i hi = _mm_max_epu8(left,up);
+			__m128i prediction = _mm_max_epu8(lo,_mm_min_epu8(hi,gradient));
+			__m128i current = _mm_loadu_si128((const __m128i *)(s+a));
+			_mm_storeu_si128((__m128i *)(r+a),_mm_sub_epi8(current,prediction));
+		}
+#endif
+		for ( ;a<count;a++){
+			r[a] = (unsigned char)(s[a]-PredictMedian(s[a-1],above[a],above[a-1]));
+		}
+	}
+}
+
+// The decoder needs the byte before each byte, so the bytes are restored one at a time in place
+void Lagarith8Compressor::RestoreSamples(unsigned char * samples, int samples_count, int row_width){
+	for ( int row=0;row<samples_count;row+=row_width){
+		unsigned char * s = samples+row;
+		int count = std::min(row_width,samples_count-row);
+
+		if ( row == 0 ){
+			for ( int a=1;a<count;a++){
+				s[a] = (unsigned char)(s[a]+s[a-1]);
+			}
+			continue;
+		}
+
+		const unsigned char * above = s-row_width;
+		s[0] = (unsigned char)(s[0]+above[0]);
+		unsigned char left = s[0];
+		for ( int a=1;a<count;a++){
+			left = (unsigned char)(s[a]+PredictMedian(left,above[a],above[a-1]));
+			s[a] = left;
+		}
+	}
+}
+
+bool compare8(const DecoderPair &a, const DecoderPair &b){
+	return a.cprobability>b.cprobability;
+}
+
+void Lagarith8Compressor::CountFrequencies(const unsigned char * symbols, int symbols_count, int * histogram){
+	memset(frequencies,0,sizeof(frequencies));
+	int a=0;
+	for ( ;a+4<=symbols_count;a+=4){
+		frequencies[0][symbols[a]]++;
+		frequencies[1][symbols[a+1]]++;
+		frequencies[2][symbols[a+2]]++;
+		frequencies[3][symbols[a+3]]++;
+	}
+	for ( ;a<symbols_count;a++){
+		frequencies[0][symbols[a]]++;
+	}
+	for ( int s=0;s<256;s++){
+		histogram[s] = frequencies[0][s]+frequencies[1][s]+frequencies[2][s]+frequencies[3][s];
+	}
+}
+
+// The order 0 entropy of the histogram in bits, close to the size the range coder gives
+double EstimateBits(const int * histogram, int symbols_count){
+	double bits=0;
+	for ( int s=0;s<256;s++){
+		if ( histogram[s] ){
+			bits += histogram[s]*log2((double)symbols_count/histogram[s]);
+		}
+	}
+	return bits;
+}
+
+void Lagarith8Compressor::PrepareTables(const int * histogram, int samples_count){
+	// scale the frequencies to 1<<FRACTIONAL_BITS_8, each symbol which occurs keeps at least 1
+	const int total = 1<<FRACTIONAL_BITS_8;
+	int nt=0;
+	table_entries=0;
+	for ( int s=0;s<256;s++){
+		int f = histogram[s];
+		if ( f ){
+			int v = (int)(((long long)f*total+samples_count/2)/samples_count);
+			if ( v == 0 ){
+				v=1;
+			}
+			nt += v;
+			decoder_table[table_entries].cprobability = v;
+			decoder_table[table_entries].decoded_value = s;
+			table_entries++;
+		}
+	}
+
+	// most frequent first, and the rounding errors corrected so the probabilities stay in decending order, as the
+	// ProbabilityCoder needs them
+	std::sort(decoder_table,decoder_table+table_entries,compare8);
+	while ( nt < total ){
+		for ( int e=0;e<table_entries && nt < total;e++){
+			decoder_table[e].cprobability++;
+			nt++;
+		}
+	}
+	while ( nt > total ){
+		for ( int e=table_entries-1;e>=0 && nt > total;e--){
+			if ( decoder_table[e].cprobability > 1 ){
+				decoder_table[e].cprobability--;
+				nt--;
+			}
+		}
+	}
+
+	memset(encoder_table,0,sizeof(encoder_table));
+	int low=0;
+	for ( int e=0;e<table_entries;e++){
+		int s = decoder_table[e].decoded_value;
+		encoder_table[s].cprobability=low;
+		encoder_table[s].probability=decoder_table[e].cprobability;
+		low+=decoder_table[e].cprobability;
+	}
+}
+
+// The number of entries, their bytes and their probabilities
+int Lagarith8Compressor::StoreTables(unsigned char * compressed){
+	compressed[0] = (unsigned char)(table_entries-1);
+	for ( int e=0;e<table_entries;e++){
+		compressed[e+1] = (unsigned char)decoder_table[e].decoded_value;
+	}
+	if ( table_entries == 1 ){
+		return 2;
+	}
+
+	ProbabilityCoder prob(compressed+table_entries+1,FRACTIONAL_BITS_8+1);
+	for ( int e=0;e<table_entries;e++){
+		prob.WriteSymbol(decoder_table[e].cprobability);
+	}
+	return table_entries+1+prob.GetBytesUsed();
+}
+
+int Lagarith8Compressor::LoadTables(const unsigned char * compressed, int compressed_size){
+	if ( compressed_size < 2 ){
+		return -1;
+	}
+	table_entries = compressed[0]+1;
+	if ( compressed_size < table_entries+1 ){
+		return -1;
+	}
+	for ( int e=0;e<table_entries;e++){
+		decoder_table[e].decoded_value = compressed[e+1];
+	}
+	if ( table_entries == 1 ){
+		return 2;
+	}
+
+	ProbabilityCoder prob(compressed+table_entries+1,FRACTIONAL_BITS_8+1,compressed_size-(table_entries+1));
+	int cp=0;
+	for ( int e=0;e<table_entries;e++){
+		int v = prob.ReadSymbol();
+		if ( v == 0 || cp+v > (1<<FRACTIONAL_BITS_8) ){
+			return -1;
+		}
+		decoder_table[e].cprobability = cp;
+		memset(decoder_lookup+cp,e,v);
+		cp += v;
+	}
+	if ( cp != (1<<FRACTIONAL_BITS_8) ){
+		return -1;
+	}
+	decoder_table[table_entries].cprobability = cp;
+
+	return table_entries+1+prob.GetBytesUsed();
+}
+
+int Lagarith8Compressor::CompressData(const unsigned char * samples, int samples_count, void * compressed){
+	return CompressData(samples,samples_count,width,compressed);
+}
+
+int Lagarith8Compressor::CompressData(const unsigned char * samples, int samples_count, int row_width, void * compressed){
+	assert(row_width>0);
+	unsigned char * dest = (unsigned char *)compressed;
+	memcpy(dest+1,&samples_count,4);
+
+	if ( samples_count > 0 ){
+		if ( residuals_size < samples_count ){
+			free(residuals);
+			residuals = (unsigned char *)malloc(samples_count);
+			residuals_size = samples_count;
+		}
+
+		// Noise which is not correlated between the pixels gives worse residuals than the bytes themselves, so the
+		// bytes are coded without the prediction when their entropy is lower
+		int sample_histogram[256];
+		int residual_histogram[256];
+		PredictResiduals(samples,samples_count,row_width);
+		CountFrequencies(samples,samples_count,sample_histogram);
+		CountFrequencies(residuals,samples_count,residual_histogram);
+		bool predicted = EstimateBits(residual_histogram,samples_count) < EstimateBits(sample_histogram,samples_count);
+		const unsigned char * symbols = predicted ? residuals : samples;
+		PrepareTables(predicted ? residual_histogram : sample_histogram,samples_count);
+
+		int compressed_size = LAGARITH8_HEADER_BYTES+StoreTables(dest+LAGARITH8_HEADER_BYTES);
+		if ( table_entries > 1 ){
+			compressed_size += RangeCompress8(symbols,dest+compressed_size,samples_count,encoder_table);
+		}
+
+		if ( compressed_size < LAGARITH8_HEADER_BYTES+samples_count ){
+			dest[0] = predicted ? LAGARITH8_PREDICTED : LAGARITH8_CODED;
+			return compressed_size;
+		}
+	}
+
+	// If the data didn't compress, store the raw data
+	dest[0] = LAGARITH8_RAW;
+	memcpy(dest+LAGARITH8_HEADER_BYTES,samples,samples_count);
+	return LAGARITH8_HEADER_BYTES+samples_count;
+}
+
+bool Lagarith8Compressor::ReadHeader(const void * compressed, int compressed_size, int * samples_count){
+	const unsigned char * source = (const unsigned char *)compressed;
+	if ( compressed_size < LAGARITH8_HEADER_BYTES || source[0] > LAGARITH8_PREDICTED ){
+		return false;
+	}
+	memcpy(samples_count,source+1,4);
+	return *samples_count >= 0;
+}
+
+int Lagarith8Compressor::DecompressData(const void * compressed, int compressed_size, unsigned char * samples){
+	return DecompressData(compressed,compressed_size,width,samples);
+}
+
+int Lagarith8Compressor::DecompressData(const void * compressed, int compressed_size, int row_width, unsigned char * samples){
+	const unsigned char * source = (const unsigned char *)compressed;
+	int samples_count;
+	if ( row_width <= 0 || !ReadHeader(compressed,compressed_size,&samples_count) ){
+		return -1;
+	}
+
+	if ( source[0] == LAGARITH8_RAW ){
+		if ( samples_count > compressed_size-LAGARITH8_HEADER_BYTES ){
+			return -1;
+		}
+		memcpy(samples,source+LAGARITH8_HEADER_BYTES,samples_count);
+		return LAGARITH8_HEADER_BYTES+samples_count;
+	}
+
+	int table_size = LoadTables(source+LAGARITH8_HEADER_BYTES,compressed_size-LAGARITH8_HEADER_BYTES);
+	if ( table_size < 0 ){
+		return -1;
+	}
+
+	int data_size = 0;
+	if ( table_entries == 1 ){
+		memset(samples,decoder_table[0].decoded_value,samples_count);
+	} else {
+		data_size = RangeDecompress8(source+LAGARITH8_HEADER_BYTES+table_size,compressed_size-LAGARITH8_HEADER_BYTES-table_size,samples,samples_count,decoder_table,decoder_lookup);
+		if ( data_size < 0 ){
+			return -1;
+		}
+	}
+
+	if ( source[0] == LAGARITH8_PREDICTED ){
+		RestoreSamples(samples,samples_count,row_width);
+	}
+	return LAGARITH8_HEADER_BYTES+table_size+data_size;
+}
@@ -0,0 +1,67 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+
+#pragma once
+
+#include "Compressor.h"
+
+// The first byte of a compressed frame, followed by the number of bytes. The bytes are stored raw, range coded, or
+// their prediction errors are range coded
+#define LAGARITH8_RAW 0
+#define LAGARITH8_CODED 1
+#define LAGARITH8_PREDICTED 2
+#define LAGARITH8_HEADER_BYTES 5
+
+/*
+Lagarith for 8 bit frames. Each byte is predicted by the median of its left and upper neighbours and of their
+gradient, as Lagarith does, and the prediction errors are range coded with tables of the 256 byte values. Frames
+whose prediction errors have a higher entropy than their bytes have the bytes coded instead. The bytes are rows of
+frame_width bytes, the last one may be shorter. Not thread safe, each thread needs its own.
+*/
+class Lagarith8Compressor{
+private:
+	int width;
+	unsigned char * residuals;
+	int residuals_size;
+	int table_entries;
+	int frequencies[4][256]; // 4 histograms, so consecutive equal bytes do not wait on each other's counts
+	EncoderPair encoder_table[256];
+	DecoderPair decoder_table[257];
+	unsigned char decoder_lookup[1<<FRACTIONAL_BITS_8];
+
+	void PredictResiduals(const unsigned char * samples, int samples_count, int row_width);
+	void RestoreSamples(unsigned char * samples, int samples_count, int row_width);
+	void CountFrequencies(const unsigned char * symbols, int symbols_count, int * histogram);
+	void PrepareTables(const int * histogram, int samples_count);
+	int StoreTables(unsigned char * compressed);
+	int LoadTables(const unsigned char * compressed, int compressed_size);
+
+public:
+	// frame_width must be > 0
+	Lagarith8Compressor(int frame_width);
+	~Lagarith8Compressor();
+
+	// The size of the compressed buffer needed for samples_count bytes
+	static int MaxCompressedBytes(int samples_count);
+
+	// Returns the number of bytes written to the compressed buffer
+	int CompressData(const unsigned char * samples, int samples_count, void * compressed);
+
+	// The same for rows of row_width bytes, e.g. the rows of a tile
+	int CompressData(const unsigned char * samples, int samples_count, int row_width, void * compressed);
+
+	// The number of bytes of a compressed frame, or false if it has no valid header
+	static bool ReadHeader(const void * compressed, int compressed_size, int * samples_count);
+
+	/*
+	Decodes a frame written by CompressData() into the samples, which must have room for the bytes given by
+	ReadHeader(). Damaged data is never read past compressed_size.
+	Returns the number of bytes used in the compressed buffer, or a negative value if an error occurred
+	*/
+	int DecompressData(const void * compressed, int compressed_size, unsigned char * samples);
+
+	// The same for a frame compressed with rows of row_width bytes
+	int DecompressData(const void * compressed, int compressed_size, int row_width, unsigned char * samples);
+};
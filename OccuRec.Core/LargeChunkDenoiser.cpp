@@ -5,6 +5,7 @@
 #include "stdafx.h"
 #include "LargeChunkDenoiser.h"
 #include <stack>
+#include <stdlib.h>
 
 long* s_CheckedPixels = NULL;
 long s_ChunkDenoiseIndex;
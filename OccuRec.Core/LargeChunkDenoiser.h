@@ -4,7 +4,7 @@
 
 #pragma once
 
-#include <windows.h>
+#include "platform.h"
 
 HRESULT LargeChunkDenoise(unsigned long* pixels, long width, long height, unsigned long onColour, unsigned long offColour);
 
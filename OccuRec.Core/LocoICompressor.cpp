@@ -0,0 +1,618 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+#include "LocoICompressor.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LOCOI_SSE2
+#include <emmintrin.h>
+#endif
+
+// The contexts are halved after this many samples, so they follow the changes of the statistics in the image
+#define LOCOI_RESET 64
+#define LOCOI_MIN_C -128
+#define LOCOI_MAX_C 127
+
+static inline int Quantize(int gradient, int t1, int t2, int t3)
+{
+	return
+		(gradient > 0) + (gradient >= t1) + (gradient >= t2) + (gradient >= t3) -
+		(gradient < 0) - (gradient <= -t1) - (gradient <= -t2) - (gradient <= -t3);
+}
+
+// The median edge detector: the smaller of the left and upper samples above a horizontal or vertical edge, the
+// larger one below it, or the plane through the three neighbours
+static inline int PredictMed(int a, int b, int c)
+{
+	int maxAB = a > b ? a : b;
+	int minAB = a > b ? b : a;
+	return c >= maxAB ? minAB : (c <= minAB ? maxAB : a + b - c);
+}
+
+static inline unsigned int CountLeadingZeros(unsigned long long value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	if (_BitScanReverse(&index, (unsigned long)(value >> 32)))
+		return 31 - index;
+	_BitScanReverse(&index, (unsigned long)value);
+	return 63 - index;
+#else
+	return __builtin_clzll(value);
+#endif
+}
+
+LocoICompressor::LocoICompressor(unsigned int width)
+{
+	m_Width = width;
+	m_Rows = (int*)malloc(2 * (width + 2) * sizeof(int));
+	m_Predictions = (int*)malloc(width * sizeof(int));
+	m_SignedContexts = (int*)malloc(width * sizeof(int));
+
+	Reset(8);
+}
+
+LocoICompressor::~LocoICompressor()
+{
+	free(m_Rows);
+	free(m_Predictions);
+	free(m_SignedContexts);
+}
+
+// The default thresholds and limit of JPEG-LS for lossless coding
+void LocoICompressor::Reset(unsigned int bitsPerSample)
+{
+	m_BitsPerSample = bitsPerSample;
+	m_MaxValue = (1 << bitsPerSample) - 1;
+
+	int factor = ((int)(m_MaxValue < 4095 ? m_MaxValue : 4095) + 128) / 256;
+	m_T1 = factor + 2;
+	m_T2 = 4 * factor + 3;
+	m_T3 = 17 * factor + 4;
+	m_Limit = 2 * (bitsPerSample + (bitsPerSample > 8 ? bitsPerSample : 8));
+
+	int initialA = (int)(m_MaxValue + 1 + 32) / 64;
+	for (int i = 0; i < LOCOI_CONTEXTS; i++)
+	{
+		m_Contexts[i].A = initialA > 2 ? initialA : 2;
+		m_Contexts[i].B = 0;
+		m_Contexts[i].N = 1;
+		m_Contexts[i].C = 0;
+	}
+}
+
+unsigned int LocoICompressor::MaxCompressedBytes(unsigned int samplesCount, unsigned int bitsPerSample)
+{
+	return LOCOI_HEADER_BYTES + samplesCount * (bitsPerSample > 8 ? 2 : 1);
+}
+
+#ifdef LOCOI_SSE2
+
+// Quantize() of 4 gradients. The comparisons give -1 for true
+static inline __m128i QuantizeSse2(__m128i gradient, __m128i t1, __m128i t2, __m128i t3)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i one = _mm_set1_epi32(1);
+
+	__m128i positive = _mm_add_epi32(
+		_mm_add_epi32(_mm_cmpgt_epi32(gradient, zero), _mm_cmpgt_epi32(gradient, _mm_sub_epi32(t1, one))),
+		_mm_add_epi32(_mm_cmpgt_epi32(gradient, _mm_sub_epi32(t2, one)), _mm_cmpgt_epi32(gradient, _mm_sub_epi32(t3, one))));
+
+	__m128i negative = _mm_add_epi32(
+		_mm_add_epi32(_mm_cmpgt_epi32(zero, gradient), _mm_cmpgt_epi32(_mm_sub_epi32(one, t1), gradient)),
+		_mm_add_epi32(_mm_cmpgt_epi32(_mm_sub_epi32(one, t2), gradient), _mm_cmpgt_epi32(_mm_sub_epi32(one, t3), gradient)));
+
+	return _mm_sub_epi32(negative, positive);
+}
+
+static inline __m128i Select(__m128i mask, __m128i ifTrue, __m128i ifFalse)
+{
+	return _mm_or_si128(_mm_and_si128(mask, ifTrue), _mm_andnot_si128(mask, ifFalse));
+}
+
+// 81 * q1 + 9 * q2 without the 32 bit multiplication which SSE2 does not have
+static inline __m128i ContextOfGradients(__m128i q1, __m128i q2)
+{
+	return _mm_add_epi32(
+		_mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(q1, 6), _mm_slli_epi32(q1, 4)), q1),
+		_mm_add_epi32(_mm_slli_epi32(q2, 3), q2));
+}
+
+#endif
+
+// The predictions and the contexts of the row of the encoder, which knows all samples. The rows have a virtual
+// sample on each side
+void LocoICompressor::PredictRow(const int* above, const int* current, unsigned int samplesCount)
+{
+	int t1 = m_T1;
+	int t2 = m_T2;
+	int t3 = m_T3;
+	unsigned int i = 0;
+
+#ifdef LOCOI_SSE2
+	__m128i t1x4 = _mm_set1_epi32(t1);
+	__m128i t2x4 = _mm_set1_epi32(t2);
+	__m128i t3x4 = _mm_set1_epi32(t3);
+
+	for (; i + 4 <= samplesCount; i += 4)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(current + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(above + i + 1));
+		__m128i c = _mm_loadu_si128((const __m128i*)(above + i));
+		__m128i d = _mm_loadu_si128((const __m128i*)(above + i + 2));
+
+		__m128i aAboveB = _mm_cmpgt_epi32(a, b);
+		__m128i maxAB = Select(aAboveB, a, b);
+		__m128i minAB = Select(aAboveB, b, a);
+		__m128i plane = _mm_sub_epi32(_mm_add_epi32(a, b), c);
+		__m128i prediction = Select(_mm_cmpgt_epi32(maxAB, c), Select(_mm_cmpgt_epi32(c, minAB), plane, maxAB), minAB);
+		_mm_storeu_si128((__m128i*)(m_Predictions + i), prediction);
+
+		__m128i context = _mm_add_epi32(
+			ContextOfGradients(QuantizeSse2(_mm_sub_epi32(d, b), t1x4, t2x4, t3x4), QuantizeSse2(_mm_sub_epi32(b, c), t1x4, t2x4, t3x4)),
+			QuantizeSse2(_mm_sub_epi32(c, a), t1x4, t2x4, t3x4));
+		_mm_storeu_si128((__m128i*)(m_SignedContexts + i), context);
+	}
+#endif
+
+	for (; i < samplesCount; i++)
+	{
+		int a = current[i];
+		int b = above[i + 1];
+		int c = above[i];
+		int d = above[i + 2];
+
+		m_Predictions[i] = PredictMed(a, b, c);
+		m_SignedContexts[i] = 81 * Quantize(d - b, t1, t2, t3) + 9 * Quantize(b - c, t1, t2, t3) + Quantize(c - a, t1, t2, t3);
+	}
+}
+
+// The part of the contexts of the row which the decoder knows before decoding it, from the upper samples
+void LocoICompressor::ContextsOfRow(const int* above, unsigned int samplesCount)
+{
+	int t1 = m_T1;
+	int t2 = m_T2;
+	int t3 = m_T3;
+	unsigned int i = 0;
+
+#ifdef LOCOI_SSE2
+	__m128i t1x4 = _mm_set1_epi32(t1);
+	__m128i t2x4 = _mm_set1_epi32(t2);
+	__m128i t3x4 = _mm_set1_epi32(t3);
+
+	for (; i + 4 <= samplesCount; i += 4)
+	{
+		__m128i b = _mm_loadu_si128((const __m128i*)(above + i + 1));
+		__m128i c = _mm_loadu_si128((const __m128i*)(above + i));
+		__m128i d = _mm_loadu_si128((const __m128i*)(above + i + 2));
+
+		__m128i context = ContextOfGradients(QuantizeSse2(_mm_sub_epi32(d, b), t1x4, t2x4, t3x4), QuantizeSse2(_mm_sub_epi32(b, c), t1x4, t2x4, t3x4));
+		_mm_storeu_si128((__m128i*)(m_SignedContexts + i), context);
+	}
+#endif
+
+	for (; i < samplesCount; i++)
+	{
+		int b = above[i + 1];
+		int c = above[i];
+		int d = above[i + 2];
+
+		m_SignedContexts[i] = 81 * Quantize(d - b, t1, t2, t3) + 9 * Quantize(b - c, t1, t2, t3);
+	}
+}
+
+// Up to 32 bits, the first bit written first
+inline void LocoICompressor::PutBits(unsigned int value, unsigned int bitsCount)
+{
+	m_Bits = (m_Bits << bitsCount) | value;
+	m_BitsCount += bitsCount;
+
+	if (m_BitsCount >= 32)
+	{
+		m_BitsCount -= 32;
+		unsigned int word = (unsigned int)(m_Bits >> m_BitsCount);
+
+		if (m_Output + 4 <= m_OutputEnd)
+		{
+			m_Output[0] = (unsigned char)(word >> 24);
+			m_Output[1] = (unsigned char)(word >> 16);
+			m_Output[2] = (unsigned char)(word >> 8);
+			m_Output[3] = (unsigned char)word;
+			m_Output += 4;
+		}
+		else
+			m_OutputFull = true;
+	}
+}
+
+inline void LocoICompressor::PutZeros(unsigned int bitsCount)
+{
+	while (bitsCount > 32)
+	{
+		PutBits(0, 32);
+		bitsCount -= 32;
+	}
+
+	PutBits(0, bitsCount);
+}
+
+// The last bits, padded with zeros to a whole byte
+void LocoICompressor::FlushBits()
+{
+	while (m_BitsCount > 0)
+	{
+		unsigned int bitsCount = m_BitsCount >= 8 ? 8 : m_BitsCount;
+		m_BitsCount -= bitsCount;
+
+		if (m_Output < m_OutputEnd)
+			*m_Output++ = (unsigned char)(((m_Bits >> m_BitsCount) & ((1 << bitsCount) - 1)) << (8 - bitsCount));
+		else
+			m_OutputFull = true;
+	}
+}
+
+// At least 57 bits in the window. Far from the end of the data 8 bytes are read at once and the window gets the
+// bits after the whole bytes it takes too, which are the same as the next read puts there. Zeros are read past the
+// end of the data and counted as an overrun
+inline void LocoICompressor::FillWindow()
+{
+	if (m_InputEnd - m_Input >= 8)
+	{
+		unsigned long long word =
+			((unsigned long long)m_Input[0] << 56) | ((unsigned long long)m_Input[1] << 48) |
+			((unsigned long long)m_Input[2] << 40) | ((unsigned long long)m_Input[3] << 32) |
+			((unsigned long long)m_Input[4] << 24) | ((unsigned long long)m_Input[5] << 16) |
+			((unsigned long long)m_Input[6] << 8) | (unsigned long long)m_Input[7];
+
+		m_Window |= word >> m_WindowBits;
+		unsigned int bytesCount = (63 - m_WindowBits) >> 3;
+		m_Input += bytesCount;
+		m_WindowBits += 8 * bytesCount;
+		return;
+	}
+
+	while (m_WindowBits <= 56)
+	{
+		unsigned long long byte = 0;
+		if (m_Input < m_InputEnd)
+			byte = *m_Input++;
+		else
+			m_InputOverrun++;
+
+		m_Window |= byte << (56 - m_WindowBits);
+		m_WindowBits += 8;
+	}
+}
+
+static inline void UpdateContext(LocoIContext* context, int error)
+{
+	int a = context->A + (error >= 0 ? error : -error);
+	int b = context->B + error;
+	int n = context->N;
+	int c = context->C;
+
+	if (n == LOCOI_RESET)
+	{
+		a >>= 1;
+		b = b >= 0 ? b >> 1 : -((1 - b) >> 1);
+		n >>= 1;
+	}
+
+	n++;
+
+	// The bias correction moves by one when the mean error is outside [-1, 0]. The contexts are visited in a
+	// random order, so this is done with conditional moves rather than branches
+	int down = b <= -n;
+	int up = b > 0;
+	b += (down - up) * n;
+	c += (up & (c < LOCOI_MAX_C)) - (down & (c > LOCOI_MIN_C));
+	b = down && b <= -n ? 1 - n : b;
+	b = up && b > 0 ? 0 : b;
+
+	context->A = a;
+	context->B = b;
+	context->N = n;
+	context->C = c;
+}
+
+static inline unsigned int BitLength(unsigned int value)
+{
+	return 64 - CountLeadingZeros((unsigned long long)value | 1);
+}
+
+// The Golomb-Rice parameter for the mean absolute error of the context, the smallest k with N << k >= A
+static inline unsigned int GolombParameter(const LocoIContext* context)
+{
+	int k = (int)BitLength(context->A) - (int)BitLength(context->N);
+	k = k > 0 ? k : 0;
+	return k + ((context->N << k) < context->A);
+}
+
+void LocoICompressor::EncodeSample(int sample, int prediction, int signedContext)
+{
+	int sign = signedContext < 0 ? -1 : 1;
+	LocoIContext* context = &m_Contexts[signedContext * sign];
+
+	int correctedPrediction = prediction + sign * context->C;
+	correctedPrediction = correctedPrediction < 0 ? 0 : correctedPrediction;
+	correctedPrediction = correctedPrediction > (int)m_MaxValue ? (int)m_MaxValue : correctedPrediction;
+
+	// The error modulo the range of the samples, in [-range / 2, range / 2)
+	int range = (int)m_MaxValue + 1;
+	int error = sign * (sample - correctedPrediction);
+	error += error < 0 ? range : 0;
+	error -= error >= (range + 1) / 2 ? range : 0;
+
+	unsigned int k = GolombParameter(context);
+
+	// The errors are mapped to 0, -1, 1, -2, 2... or to -1, 0, -2, 1... when the context is biased to negative errors
+	int negativeBias = k == 0 && 2 * context->B <= -context->N;
+	unsigned int mappedError = error >= 0 ? 2 * error + negativeBias : -2 * error - 1 - negativeBias;
+
+	// The unary part is limited, longer codes are followed by the mapped error itself
+	unsigned int maxUnaryBits = m_Limit - m_BitsPerSample - 1;
+	unsigned int unaryBits = mappedError >> k;
+	if (unaryBits < maxUnaryBits)
+	{
+		unsigned int code = (1 << k) | (mappedError & ((1 << k) - 1));
+		if (unaryBits + k + 1 <= 32)
+			PutBits(code, unaryBits + k + 1);
+		else
+		{
+			PutZeros(unaryBits);
+			PutBits(code, k + 1);
+		}
+	}
+	else
+	{
+		PutZeros(maxUnaryBits);
+		PutBits(1, 1);
+		PutBits(mappedError - 1, m_BitsPerSample);
+	}
+
+	UpdateContext(context, error);
+}
+
+bool LocoICompressor::DecodeSample(int prediction, int signedContext, int* sample)
+{
+	int sign = signedContext < 0 ? -1 : 1;
+	LocoIContext* context = &m_Contexts[signedContext * sign];
+
+	int correctedPrediction = prediction + sign * context->C;
+	correctedPrediction = correctedPrediction < 0 ? 0 : correctedPrediction;
+	correctedPrediction = correctedPrediction > (int)m_MaxValue ? (int)m_MaxValue : correctedPrediction;
+
+	unsigned int k = GolombParameter(context);
+
+	// The unary part is at most 47 zeros and the window has at least 57 bits
+	if (m_WindowBits <= 56)
+		FillWindow();
+
+	if (m_Window == 0)
+		return false;
+
+	unsigned int maxUnaryBits = m_Limit - m_BitsPerSample - 1;
+	unsigned int unaryBits = CountLeadingZeros(m_Window);
+	if (unaryBits > maxUnaryBits)
+		return false;
+
+	m_Window <<= unaryBits + 1;
+	m_WindowBits -= unaryBits + 1;
+
+	// Only the 16 bit codes may need more bits
+	if (m_WindowBits < 16)
+		FillWindow();
+
+	unsigned int mappedError;
+	if (unaryBits < maxUnaryBits)
+	{
+		mappedError = (unaryBits << k) | (unsigned int)((m_Window >> 1) >> (63 - k));
+		m_Window <<= k;
+		m_WindowBits -= k;
+	}
+	else
+	{
+		mappedError = (unsigned int)(m_Window >> (64 - m_BitsPerSample)) + 1;
+		m_Window <<= m_BitsPerSample;
+		m_WindowBits -= m_BitsPerSample;
+	}
+
+	int negativeBias = k == 0 && 2 * context->B <= -context->N;
+	int isNegative = (int)(mappedError & 1) ^ negativeBias;
+	int error = (int)(mappedError >> 1) ^ -isNegative;
+
+	UpdateContext(context, error);
+
+	int range = (int)m_MaxValue + 1;
+	int value = correctedPrediction + sign * error;
+	value += value < 0 ? range : 0;
+	value -= value > (int)m_MaxValue ? range : 0;
+
+	*sample = value;
+	return value >= 0 && value <= (int)m_MaxValue;
+}
+
+unsigned int LocoICompressor::CompressData(const unsigned char* samples, unsigned int samplesCount, unsigned int bitsPerSample, unsigned char* compressed)
+{
+	return CompressData(samples, samplesCount, m_Width, bitsPerSample, compressed);
+}
+
+unsigned int LocoICompressor::CompressData(const unsigned char* samples, unsigned int samplesCount, unsigned int rowWidth, unsigned int bitsPerSample, unsigned char* compressed)
+{
+	if (rowWidth == 0 || rowWidth > m_Width)
+		rowWidth = m_Width;
+
+	unsigned int sampleBytes = bitsPerSample > 8 ? 2 : 1;
+	unsigned int rawBytes = samplesCount * sampleBytes;
+
+	Reset(8 * sampleBytes);
+
+	compressed[0] = LOCOI_CODED_SAMPLES;
+	compressed[1] = (unsigned char)m_BitsPerSample;
+	memcpy(compressed + 2, &samplesCount, 4);
+
+	// The coding stops when it is no smaller than the raw samples
+	m_Output = compressed + LOCOI_HEADER_BYTES;
+	m_OutputEnd = m_Output + rawBytes;
+	m_OutputFull = false;
+	m_Bits = 0;
+	m_BitsCount = 0;
+
+	int* above = m_Rows;
+	int* current = m_Rows + m_Width + 2;
+	memset(above, 0, (rowWidth + 2) * sizeof(int));
+
+	for (unsigned int firstSample = 0; firstSample < samplesCount && !m_OutputFull; firstSample += rowWidth)
+	{
+		unsigned int rowSamples = samplesCount - firstSample < rowWidth ? samplesCount - firstSample : rowWidth;
+
+		if (sampleBytes == 1)
+		{
+			for (unsigned int i = 0; i < rowSamples; i++)
+				current[i + 1] = samples[firstSample + i];
+		}
+		else
+		{
+			const unsigned short* samples16 = (const unsigned short*)samples + firstSample;
+			for (unsigned int i = 0; i < rowSamples; i++)
+				current[i + 1] = samples16[i];
+		}
+
+		// The first sample has the upper sample as its left and upper left neighbours
+		current[0] = above[1];
+
+		PredictRow(above, current, rowSamples);
+
+		for (unsigned int i = 0; i < rowSamples; i++)
+			EncodeSample(current[i + 1], m_Predictions[i], m_SignedContexts[i]);
+
+		current[rowSamples + 1] = current[rowSamples];
+		current[0] = current[1];
+
+		int* row = above;
+		above = current;
+		current = row;
+	}
+
+	FlushBits();
+
+	if (m_OutputFull)
+	{
+		compressed[0] = LOCOI_RAW_SAMPLES;
+		memcpy(compressed + LOCOI_HEADER_BYTES, samples, rawBytes);
+		return LOCOI_HEADER_BYTES + rawBytes;
+	}
+
+	return (unsigned int)(m_Output - compressed);
+}
+
+bool LocoICompressor::ReadHeader(const unsigned char* compressed, unsigned int compressedSize, unsigned int* samplesCount, unsigned int* bitsPerSample)
+{
+	if (compressedSize < LOCOI_HEADER_BYTES)
+		return false;
+
+	if (compressed[0] != LOCOI_RAW_SAMPLES && compressed[0] != LOCOI_CODED_SAMPLES)
+		return false;
+
+	if (compressed[1] != 8 && compressed[1] != 16)
+		return false;
+
+	*bitsPerSample = compressed[1];
+	memcpy(samplesCount, compressed + 2, 4);
+	return true;
+}
+
+int LocoICompressor::DecompressData(const unsigned char* compressed, unsigned int compressedSize, unsigned char* samples)
+{
+	return DecompressData(compressed, compressedSize, m_Width, samples);
+}
+
+int LocoICompressor::DecompressData(const unsigned char* compressed, unsigned int compressedSize, unsigned int rowWidth, unsigned char* samples)
+{
+	if (rowWidth == 0 || rowWidth > m_Width)
+		return -1;
+
+	unsigned int samplesCount;
+	unsigned int bitsPerSample;
+	if (!ReadHeader(compressed, compressedSize, &samplesCount, &bitsPerSample))
+		return -1;
+
+	unsigned int sampleBytes = bitsPerSample / 8;
+
+	if (compressed[0] == LOCOI_RAW_SAMPLES)
+	{
+		if (samplesCount > (compressedSize - LOCOI_HEADER_BYTES) / sampleBytes)
+			return -1;
+
+		memcpy(samples, compressed + LOCOI_HEADER_BYTES, samplesCount * sampleBytes);
+		return LOCOI_HEADER_BYTES + samplesCount * sampleBytes;
+	}
+
+	Reset(bitsPerSample);
+
+	m_Input = compressed + LOCOI_HEADER_BYTES;
+	m_InputEnd = compressed + compressedSize;
+	m_Window = 0;
+	m_WindowBits = 0;
+	m_InputOverrun = 0;
+
+	int* above = m_Rows;
+	int* current = m_Rows + m_Width + 2;
+	memset(above, 0, (rowWidth + 2) * sizeof(int));
+
+	for (unsigned int firstSample = 0; firstSample < samplesCount; firstSample += rowWidth)
+	{
+		unsigned int rowSamples = samplesCount - firstSample < rowWidth ? samplesCount - firstSample : rowWidth;
+
+		ContextsOfRow(above, rowSamples);
+
+		int a = above[1];
+		for (unsigned int i = 0; i < rowSamples; i++)
+		{
+			int b = above[i + 1];
+			int c = above[i];
+			int sample;
+
+			if (!DecodeSample(PredictMed(a, b, c), m_SignedContexts[i] + Quantize(c - a, m_T1, m_T2, m_T3), &sample))
+				return -1;
+
+			current[i + 1] = sample;
+			a = sample;
+		}
+
+		if (sampleBytes == 1)
+		{
+			for (unsigned int i = 0; i < rowSamples; i++)
+				samples[firstSample + i] = (unsigned char)current[i + 1];
+		}
+		else
+		{
+			unsigned short* samples16 = (unsigned short*)samples + firstSample;
+			for (unsigned int i = 0; i < rowSamples; i++)
+				samples16[i] = (unsigned short)current[i + 1];
+		}
+
+		current[rowSamples + 1] = current[rowSamples];
+		current[0] = current[1];
+
+		int* row = above;
+		above = current;
+		current = row;
+	}
+
+	// The bits read from the window, which holds bytes which were read but not used
+	unsigned long long bitsUsed = 8 * ((unsigned long long)(m_Input - compressed - LOCOI_HEADER_BYTES) + m_InputOverrun) - m_WindowBits;
+	unsigned long long bytesUsed = (bitsUsed + 7) / 8;
+	if (bytesUsed > compressedSize - LOCOI_HEADER_BYTES)
+		return -1;
+
+	return LOCOI_HEADER_BYTES + (int)bytesUsed;
+}
@@ -0,0 +1,110 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef LOCOICOMPRESSOR_H
+#define LOCOICOMPRESSOR_H
+
+// The contexts of the gradients around a sample, 9 x 9 x 9 quantized gradients folded by their sign
+#define LOCOI_CONTEXTS 365
+
+// The first byte of a compressed image
+#define LOCOI_RAW_SAMPLES 0
+#define LOCOI_CODED_SAMPLES 1
+
+// The mode, the bits per sample and the number of samples
+#define LOCOI_HEADER_BYTES 6
+
+// The adaptive state of one context
+struct LocoIContext
+{
+	// Sum of the absolute prediction errors, sum of the errors (the bias), number of samples
+	int A;
+	int B;
+	int N;
+	// Correction of the prediction for the bias of the context
+	int C;
+};
+
+// Lossless predictive image coding as in LOCO-I, the regular mode of JPEG-LS (ITU T.87) without its run mode and
+// without the JPEG-LS marker syntax. Each sample is predicted by the median edge detector from its left, upper
+// and upper left neighbours and the prediction is corrected by the bias of the context of the sample, one of 365
+// contexts given by the quantized gradients between its four causal neighbours. The prediction errors are coded
+// with the Golomb-Rice code whose parameter is adapted to the mean absolute error of the context, so the noise of
+// a star field costs close to its entropy and the few bright pixels of the stars do not change the coding of the
+// background. The contexts are reset for every image, so each frame is decoded on its own.
+//
+// The samples are rows of the given width, the last one may be shorter, of 8 bits or 16 bits. The predictions
+// and the contexts of a row are computed in a separate pass without branches, 4 samples at a time with SSE2.
+// Images which do not compress are stored raw after the header. Not thread safe, each thread needs its own
+class LocoICompressor
+{
+	private:
+		unsigned int m_Width;
+		unsigned int m_MaxValue;
+		unsigned int m_BitsPerSample;
+		int m_T1;
+		int m_T2;
+		int m_T3;
+		int m_Limit;
+
+		LocoIContext m_Contexts[LOCOI_CONTEXTS];
+
+		// The previous and current rows of samples, with one more sample on each side, and the predictions and the
+		// signed contexts of the current row
+		int* m_Rows;
+		int* m_Predictions;
+		int* m_SignedContexts;
+
+		unsigned char* m_Output;
+		unsigned char* m_OutputEnd;
+		unsigned long long m_Bits;
+		unsigned int m_BitsCount;
+		bool m_OutputFull;
+
+		const unsigned char* m_Input;
+		const unsigned char* m_InputEnd;
+		unsigned long long m_Window;
+		unsigned int m_WindowBits;
+		unsigned int m_InputOverrun;
+
+		void Reset(unsigned int bitsPerSample);
+		void PredictRow(const int* above, const int* current, unsigned int samplesCount);
+		void ContextsOfRow(const int* above, unsigned int samplesCount);
+
+		void PutBits(unsigned int value, unsigned int bitsCount);
+		void PutZeros(unsigned int bitsCount);
+		void FlushBits();
+		void FillWindow();
+
+		void EncodeSample(int sample, int prediction, int signedContext);
+		bool DecodeSample(int prediction, int signedContext, int* sample);
+
+	public:
+		// The width of the image rows, which must be > 0
+		LocoICompressor(unsigned int width);
+		~LocoICompressor();
+
+		// Bytes which CompressData() may write for samplesCount samples
+		static unsigned int MaxCompressedBytes(unsigned int samplesCount, unsigned int bitsPerSample);
+
+		// Compresses the samples, of 1 byte each, or of 2 bytes each when bitsPerSample is 16, into the compressed
+		// buffer, which must have room for MaxCompressedBytes(). Returns the number of bytes written
+		unsigned int CompressData(const unsigned char* samples, unsigned int samplesCount, unsigned int bitsPerSample, unsigned char* compressed);
+
+		// The same for rows of rowWidth samples, up to the width of the compressor, e.g. the rows of a tile
+		unsigned int CompressData(const unsigned char* samples, unsigned int samplesCount, unsigned int rowWidth, unsigned int bitsPerSample, unsigned char* compressed);
+
+		// The number of samples and their bits stored in the header of a compressed image, or false if it has none
+		static bool ReadHeader(const unsigned char* compressed, unsigned int compressedSize, unsigned int* samplesCount, unsigned int* bitsPerSample);
+
+		// Decodes the compressedSize bytes of an image written by CompressData() into the samples, which must have room
+		// for the samples given by ReadHeader(). Damaged data is never read past compressedSize. Returns the number of
+		// bytes used in the compressed buffer, or a negative value if the data is damaged
+		int DecompressData(const unsigned char* compressed, unsigned int compressedSize, unsigned char* samples);
+
+		// The same for an image compressed with rows of rowWidth samples
+		int DecompressData(const unsigned char* compressed, unsigned int compressedSize, unsigned int rowWidth, unsigned char* samples);
+};
+
+#endif // LOCOICOMPRESSOR_H
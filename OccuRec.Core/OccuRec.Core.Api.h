@@ -0,0 +1,195 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef OCCUREC_CORE_API_H
+#define OCCUREC_CORE_API_H
+
+// The exported functions of the core (see OccuRec.Core.def). They use C linkage, so the library
+// can be used from C, from .NET and from the ctypes/FFI of other languages on all platforms
+
+#include "platform.h"
+
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
+typedef struct NativePsfFitInfo
+{	
+	float XCenter;
+	float YCenter;
+	float FWHM;
+	float IMax;
+	float I0;
+	float X0;
+	float Y0;
+	unsigned char MatrixSize;
+	unsigned char IsSolved;
+
+	unsigned char IsAsymmetric;
+	unsigned char Reserved;
+	float R0;
+	float R02;	
+} NativePsfFitInfo;
+
+typedef struct ImageStatus
+{
+	__int64 StartExposureTicks;
+	__int64 EndExposureTicks;
+	__int64 StartExposureFrameNo;
+	__int64 EndExposureFrameNo;	
+	long CountedFrames;
+	float CutOffRatio;
+	__int64 IntegratedFrameNo;
+	__int64 UniqueFrameNo;
+	long PerformedAction;
+	float PerformedActionProgress;
+	long DetectedIntegrationRate;
+	long DropedFramesSinceIntegrationLock;
+	long OcrWorking;
+	long OcrErrorsSinceLastReset;
+	long UserIntegratonRateHint;
+	long TrkdTargetIsLocated;
+	float TrkdTargetXPos;
+	float TrkdTargetYPos;
+	long TrkdTargetIsTracked;
+	float TrkdTargetMeasurement;
+	long TrkdTargetHasSaturatedPixels;
+	long TrkdGuidingIsLocated;
+	float TrkdGuidingXPos;
+	float TrkdGuidingYPos;
+	long TrkdGuidingIsTracked;
+	float TrkdGuidingMeasurement;
+	long TrkdGuidingHasSaturatedPixels;
+	NativePsfFitInfo TrkdTargetPsfInfo;
+	NativePsfFitInfo TrkdGuidingPsfInfo;
+	double TrkdTargetResiduals[290];
+	double TrkdGuidingResiduals[290];
+} ImageStatus;
+
+typedef struct FrameProcessingStatus
+{
+	__int64 CameraFrameNo;
+	__int64 IntegratedFrameNo;
+	long IntegratedFramesSoFar;
+	float FrameDiffSignature;
+	float CurrentSignatureRatio;
+} FrameProcessingStatus;
+
+typedef struct CoreProfilingInfo
+{
+	// Frequency of the PlatformPerformanceCounter() ticks used for all times
+	__int64 TicksPerSecond;
+	// Processing of the camera frames, including the integration, the OCR and the tracking
+	__int64 FrameProcessingTicks;
+	__int64 OcrTicks;
+	__int64 TrackingTicks;
+	// Recording of the integrated frames, including the image compression and the disk writes
+	__int64 RecordingTicks;
+	__int64 CompressionTicks;
+	__int64 DiskWriteTicks;
+	__int64 BytesWritten;
+	__int64 ProcessedFrames;
+	__int64 RecordedFrames;
+	// Integrated frames which could not be recorded because the recording buffer was full
+	__int64 DroppedRecordingFrames;
+	long RawFrameBufferLength;
+	long RawFrameBufferHighWaterMark;
+	long RecordingBufferLength;
+	long RecordingBufferHighWaterMark;
+	// Done by the write-behind thread of the AAV file. The latency of each write includes the periodic syncs
+	__int64 DiskWrites;
+	__int64 DiskWriteLatencyTicks;
+	__int64 DiskWriteMaxLatencyTicks;
+	__int64 DiskSyncs;
+	// Time the recording waited for the write-behind thread because both write buffers were full
+	__int64 DiskWriteStallTicks;
+	// Done by the compression worker threads. The time spent by all workers, and the time the recording waited
+	// for them because all compression jobs were in use
+	__int64 CompressionWorkerTicks;
+	__int64 CompressionStallTicks;
+} CoreProfilingInfo;
+
+typedef struct AavReaderFileInfo
+{
+	long FramesCount;
+	long Width;
+	long Height;
+	long DataBpp;
+	// Non zero when the file was not ended properly and its frames were found without the index
+	long IndexRebuilt;
+	long StatusSectionVersion;
+} AavReaderFileInfo;
+
+typedef struct AavReaderFrameInfo
+{
+	__int64 TimeStamp;
+	long Exposure;
+	long ElapsedTime;
+	long LayoutId;
+	long ByteMode;
+	long StatusBytesCount;
+} AavReaderFrameInfo;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+HRESULT SetupCamera(long width, long height, LPCTSTR szCameraModel, long monochromeConversionMode, bool flipHorizontally, bool flipVertically, bool isIntegrating);
+HRESULT SetupGrabberInfo(LPCTSTR szGrabberName, LPCTSTR szVideoMode, float frameRate, long hardwareTimingCorrection);
+HRESULT SetupIntegrationDetection(float minDiffRatio, float minSignDiff, float diffGamma);
+HRESULT SetupIntegrationPreservationArea(bool preserveVti, int areaTopOdd, int areaTopEven, int areaHeight);
+HRESULT SetupOcrAlignment(long width, long height, long frameTopOdd, long frameTopEven, long charWidth, long charHeight, long numberOfCharPositions, long numberOfZones, long zoneMode, long* pixelsInZones);
+HRESULT SetupOcrZoneMatrix(long* matrix);
+HRESULT SetupOcrChar(char character, long fixedPosition);
+HRESULT SetupOcrCharDefinitionZone(char character, long zoneId, long zoneValue, long zonePixelsCount);
+HRESULT DisableOcrProcessing();
+HRESULT SetupAav(long useImageLayout, long compressionAlgorithm, long bpp, long usesBufferedMode, long integrationDetectionTuning, LPCTSTR szOccuRecVersion, long recordNtpTimestamp, long recordSecondaryTimestamp);
+HRESULT SetupNtpDebugParams(long debugValue1, float debugValue2);
+HRESULT SetupAavWriteBehind(long bufferSizeKb, long durabilityIntervalMs);
+HRESULT SetupAavCompressionThreads(long numberOfThreads);
+HRESULT SetupAavStatusDeltaEncoding(long snapshotInterval);
+HRESULT SetupAavLagarith16TableReuse(long tablesKeyFrame);
+HRESULT SetupAavKeyFrames(long keyFrameInterval, long sceneChangeThreshold);
+HRESULT SetupAavBitPacking(long bitsPerPixel);
+HRESULT SetupAavPixelsCrc(long enabled);
+HRESULT SetupAavTiles(long tileSize);
+HRESULT SetupAavRegionOfInterest(long regionNo, long x, long y, long width, long height, long trackedObjectId);
+HRESULT RecoverAavFile(LPCTSTR szFileName, long* recoveredFrames);
+HRESULT OpenAavReader(LPCTSTR szFileName, AavReaderFileInfo* fileInfo);
+HRESULT ReadAavFrames(long firstFrameNo, long framesCount, BYTE* pixels, AavReaderFrameInfo* frameInfos);
+HRESULT ReadAavFrameStatus(long frameNo, BYTE* statusBytes, long maxStatusBytes, long* statusBytesCount);
+HRESULT ReadAavFrameRegion(long frameNo, long x, long y, long width, long height, BYTE* pixels);
+HRESULT FindAavKeyFrame(long frameNo, long* keyFrameNo);
+HRESULT CloseAavReader();
+HRESULT GetCurrentImage(BYTE* bitmapPixels);
+HRESULT GetCurrentImageStatus(ImageStatus* ImageStatus);
+HRESULT ProcessVideoFrame(LPVOID bmpBits, __int64 currentUtcDayAsTicks, __int64 currentNtpTimeAsTicks, double ntpBasedTimeError, __int64 currentSecondaryTimeAsTicks, FrameProcessingStatus* frameInfo);
+HRESULT ProcessVideoFrame2(long* pixels, __int64 currentUtcDayAsTicks, __int64 currentNtpTimeAsTicks, double ntpBasedTimeError, __int64 currentSecondaryTimeAsTicks, FrameProcessingStatus* frameInfo);
+HRESULT StartRecording(LPCTSTR szFileName);
+HRESULT StopRecording(long* pixels);
+HRESULT StartOcrTesting(LPCTSTR szFileName);
+HRESULT LockIntegration(bool lock);
+HRESULT SetManualIntegrationHint(long manualRate);
+HRESULT SetNoIntegrationStackRate(long stackRate);
+HRESULT ControlIntegrationCalibration(long operation);
+HRESULT GetIntegrationCalibrationDataConfig(long* gammasLength, long* signaturesPerCycle);
+HRESULT GetIntegrationCalibrationData(float* rawSignatures, float* gammas);
+HRESULT InitNewIntegrationPeriodTesting(float differenceRatio, float minimumDifference);
+HRESULT TestNewIntegrationPeriod(__int64 frameNo, float diffSignature, bool* isNew);
+HRESULT EnableTracking(long targetObjectId, long guidingObjectId, long frequency, float targetAperture, float guidingAperture, float innerRadiusOfBackgroundApertureInSignalApertures, long numberOfPixelsInBackgroundAperture);
+HRESULT DisableTracking();
+HRESULT GetProfilingInfo(CoreProfilingInfo* profilingInfo);
+HRESULT ResetProfilingInfo();
+
+HRESULT TrackerSettings(double maxElongation, double minFWHM, double maxFWHM, double minCertainty, double minGuidingStarCertainty);
+HRESULT TrackerNewConfiguration(long width, long height, long numTrackedObjects, bool isFullDisappearance);
+HRESULT TrackerConfigureObject(long objectId, bool isFixedAperture, bool isOccultedStar, double startingX, double startingY, double apertureInPixels);
+HRESULT TrackerNextFrame(long frameId, unsigned long* pixels);
+HRESULT TrackerInitialiseNewTracking();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OCCUREC_CORE_API_H
@@ -15,9 +15,11 @@
 #include "stdlib.h"
 #include <vector>
 #include <stdio.h>
+#include <math.h>
+#include <stdexcept>
 #include "IntegratedFrame.h";
 #include "aav_lib.h"
-#include <windows.h>
+#include "platform.h"
 
 #include "IotaVtiOcr.h"
 #include "OccuRec.Ocr.h"
@@ -25,6 +27,7 @@
 
 #include "simplified_tracking.h"
 #include "OccuRec.Math.h"
+#include "aav_profiling.h"
 
 using namespace OccuOcr;
 
@@ -34,6 +37,13 @@ using namespace OccuOcr;
 
 bool AAV_16 = false;
 long AAV16_MAX_BINNED_FRAMES = 0;
+long AAV16_BIT_PACKING = 0;
+long AAV_TILE_SIZE = 0;
+// The regions of interest of the REGIONS-OF-INTEREST layout. A region with a width of 0 is not used, and a region with
+// a tracked object id of -1 does not follow a tracked object
+long AAV_REGION_WIDTH[AAV_MAX_REGIONS_OF_INTEREST];
+long AAV_REGION_HEIGHT[AAV_MAX_REGIONS_OF_INTEREST];
+long AAV_REGION_TRACKED_OBJECT_ID[AAV_MAX_REGIONS_OF_INTEREST];
 long IMAGE_WIDTH;
 long IMAGE_HEIGHT;
 long IMAGE_STRIDE;
@@ -41,6 +51,7 @@ long IMAGE_TOTAL_PIXELS;
 long MONOCHROME_CONVERSION_MODE;
 long USE_IMAGE_LAYOUT = 4;
 long USE_COMPRESSION_ALGORITHM = 0;
+long AAV_KEY_FRAME_INTERVAL = 32;
 bool USE_BUFFERED_FRAME_PROCESSING = true;
 bool INTEGRATION_DETECTION_TUNING = false;
 bool USE_NTP_TIMESTAMP = false;
@@ -105,6 +116,13 @@ __int64 numberOfDiffSignaturesCalculated;
 long numberOfIntegratedFrames;
 bool lastFrameWasNewIntegrationPeriod;
 bool trackedThisIntegrationPeriod = false;
+// The position of the guiding star, or of the target when there is no guiding star, when it was last tracked
+bool trackedObjectIsLocated = false;
+double trackedObjectXPos = 0;
+double trackedObjectYPos = 0;
+// The top left corner of each region of interest, where it was set up or centred on its tracked object when it was last located
+long regionOfInterestX[AAV_MAX_REGIONS_OF_INTEREST];
+long regionOfInterestY[AAV_MAX_REGIONS_OF_INTEREST];
 
 double* integratedPixels = NULL;
 
@@ -164,6 +182,13 @@ unsigned int STATUS_TAG_NTP_TIME_ERROR;
 
 OccuRec::IntegrationChecker* integrationChecker;
 
+CoreProfilingInfo coreProfilingInfo;
+
+__int64 ProfilingTicks()
+{
+	return PlatformPerformanceCounter();
+}
+
 void ClearResourses()
 {
 	if (NULL != prtPreviousDiffArea)
@@ -357,6 +382,12 @@ HRESULT SetupAav(long useImageLayout, long compressionAlgorithm, long bpp, long
 		case 5:
 			DebugViewPrint(L"AAVSetup: ImageLayout = STATUS-CHANNEL-ONLY::QUICKLZ; BufferedMode = %d; IntegrationTuning: %s\n", USE_BUFFERED_FRAME_PROCESSING ? 1:0, INTEGRATION_DETECTION_TUNING ? L"Y":L"N"); 
 			break;
+		case 6:
+			DebugViewPrint(L"AAVSetup: ImageLayout = FULL-IMAGE-DIFFERENTIAL-CODING::MOTION-COMPENSATED; BufferedMode = %d; IntegrationTuning: %s\n", USE_BUFFERED_FRAME_PROCESSING ? 1:0, INTEGRATION_DETECTION_TUNING ? L"Y":L"N"); 
+			break;
+		case 7:
+			DebugViewPrint(L"AAVSetup: ImageLayout = REGIONS-OF-INTEREST; BufferedMode = %d; IntegrationTuning: %s\n", USE_BUFFERED_FRAME_PROCESSING ? 1:0, INTEGRATION_DETECTION_TUNING ? L"Y":L"N"); 
+			break;
 		default:
 			DebugViewPrint(L"AAVSetup: ImageLayout = %d; BufferedMode = %d; IntegrationTuning: %s\n", USE_IMAGE_LAYOUT, USE_BUFFERED_FRAME_PROCESSING ? 1:0, INTEGRATION_DETECTION_TUNING ? L"Y":L"N"); 
 			break;
@@ -375,6 +406,238 @@ HRESULT SetupNtpDebugParams(long debugValue1, float debugValue2)
 	return S_OK;
 }
 
+// The size of each of the two write buffers and how often the recorded file is synced to the disk. Used by the next recording
+HRESULT SetupAavWriteBehind(long bufferSizeKb, long durabilityIntervalMs)
+{
+	if (bufferSizeKb <= 0 || durabilityIntervalMs < 0)
+		return E_FAIL;
+
+	AavSetupWriteBehind((unsigned int)bufferSizeKb * 1024, (unsigned int)durabilityIntervalMs);
+
+	return S_OK;
+}
+
+#define MAX_AAV_COMPRESSION_THREADS 64
+
+// The number of worker threads compressing the recorded images. 0 compresses them on the recording thread. Used by the next recording
+HRESULT SetupAavCompressionThreads(long numberOfThreads)
+{
+	if (numberOfThreads < 0 || numberOfThreads > MAX_AAV_COMPRESSION_THREADS)
+		return E_FAIL;
+
+	AavSetupCompressionThreads((unsigned int)numberOfThreads);
+
+	return S_OK;
+}
+
+#define MAX_AAV_STATUS_SNAPSHOT_INTERVAL 65535
+
+// Writes only the status tags which changed since the previous frame, with all of them every snapshotInterval frames for
+// the random access. 0 writes all of them in every frame, which is readable by the readers of version 1. Used by the next recording
+HRESULT SetupAavStatusDeltaEncoding(long snapshotInterval)
+{
+	if (snapshotInterval < 0 || snapshotInterval > MAX_AAV_STATUS_SNAPSHOT_INTERVAL)
+		return E_FAIL;
+
+	AavSetupStatusDeltaEncoding((unsigned int)snapshotInterval);
+
+	return S_OK;
+}
+
+#define MAX_AAV_LAGARITH16_TABLES_KEY_FRAME 65535
+
+// Lets the frames of the LAGARITH16 layouts reuse the probability tables of the previous frame while they fit its
+// symbols, with new tables every tablesKeyFrame frames for the random access. 0 stores the tables in every frame,
+// which is readable by the older readers. Not used when the images are compressed by worker threads, which always
+// store the tables. Used by the next recording
+HRESULT SetupAavLagarith16TableReuse(long tablesKeyFrame)
+{
+	if (tablesKeyFrame < 0 || tablesKeyFrame > MAX_AAV_LAGARITH16_TABLES_KEY_FRAME)
+		return E_FAIL;
+
+	AavSetupLagarith16TableReuse((unsigned int)tablesKeyFrame);
+
+	return S_OK;
+}
+
+#define MAX_AAV_KEY_FRAME_INTERVAL 65535
+#define MAX_AAV_SCENE_CHANGE_THRESHOLD 255
+
+// The diff coded layouts record a key frame every keyFrameInterval frames, and also when the mean absolute difference
+// of the frame from its base frame is above sceneChangeThreshold gray levels, of the 16 bit pixels when the layout is
+// 16 bit. 0 records only the first frame of the layout as a key frame, or does not check for scene changes. Used by
+// the next recording
+HRESULT SetupAavKeyFrames(long keyFrameInterval, long sceneChangeThreshold)
+{
+	if (keyFrameInterval < 0 || keyFrameInterval > MAX_AAV_KEY_FRAME_INTERVAL ||
+		sceneChangeThreshold < 0 || sceneChangeThreshold > MAX_AAV_SCENE_CHANGE_THRESHOLD)
+	{
+		return E_FAIL;
+	}
+
+	AAV_KEY_FRAME_INTERVAL = keyFrameInterval;
+	AavSetupSceneChangeKeyFrames((unsigned int)sceneChangeThreshold);
+
+	return S_OK;
+}
+
+// Stores the pixels of the 16 bit raw layouts with bitsPerPixel bits each, 10, 12 or 14, e.g. 10 bits for the sums of 4
+// frames. A frame with a brighter pixel is stored with 16 bits. 0 stores every pixel in 2 bytes, which is readable by the
+// older readers. Used by the next recording
+HRESULT SetupAavBitPacking(long bitsPerPixel)
+{
+	if (bitsPerPixel != 0 && bitsPerPixel != 10 && bitsPerPixel != 12 && bitsPerPixel != 14)
+		return E_FAIL;
+
+	AAV16_BIT_PACKING = bitsPerPixel;
+
+	return S_OK;
+}
+
+// Stores the CRC-32C of the pixels of each frame, which the AAV reader checks when it decodes the frame. On by default,
+// the older readers ignore it. Used by the next recording
+HRESULT SetupAavPixelsCrc(long enabled)
+{
+	AavSetupPixelsCrc(enabled != 0);
+
+	return S_OK;
+}
+
+#define MIN_AAV_TILE_SIZE 16
+#define MAX_AAV_TILE_SIZE 1024
+
+// Splits the images of the raw layouts into tiles of tileSize x tileSize pixels, which are compressed independently, so
+// the readers decode a region of a frame from the tiles it overlaps. LAGARITH16 codes whole frames and is not tiled.
+// 0 stores the whole images, which is readable by the older readers. Used by the next recording
+HRESULT SetupAavTiles(long tileSize)
+{
+	if (tileSize != 0 && (tileSize < MIN_AAV_TILE_SIZE || tileSize > MAX_AAV_TILE_SIZE))
+		return E_FAIL;
+
+	AAV_TILE_SIZE = tileSize;
+	AavSetupTiles((unsigned int)tileSize);
+
+	return S_OK;
+}
+
+#define MAX_AAV_REGION_SIZE 65535
+
+// Sets up the region regionNo, 0 to 15, of the REGIONS-OF-INTEREST layout, which between its reference frames every
+// AAV_KEY_FRAME_INTERVAL frames stores only the crops of the regions. A region with trackedObjectId of an object
+// configured in the tracker is centred on the object when it is located, and a trackedObjectId of -1 keeps it where
+// it is. A width or height of 0 removes the region. Used by the frames processed after it
+HRESULT SetupAavRegionOfInterest(long regionNo, long x, long y, long width, long height, long trackedObjectId)
+{
+	if (regionNo < 0 || regionNo >= AAV_MAX_REGIONS_OF_INTEREST ||
+		x < 0 || y < 0 || x > MAX_AAV_REGION_SIZE || y > MAX_AAV_REGION_SIZE ||
+		width < 0 || height < 0 || width > MAX_AAV_REGION_SIZE || height > MAX_AAV_REGION_SIZE || trackedObjectId < -1)
+	{
+		return E_FAIL;
+	}
+
+	regionOfInterestX[regionNo] = x;
+	regionOfInterestY[regionNo] = y;
+	AAV_REGION_HEIGHT[regionNo] = height;
+	AAV_REGION_TRACKED_OBJECT_ID[regionNo] = trackedObjectId;
+	AAV_REGION_WIDTH[regionNo] = height > 0 ? width : 0;
+
+	return S_OK;
+}
+
+// Makes a file which was being recorded when OccuRec or the computer stopped readable again, by rebuilding its index
+HRESULT RecoverAavFile(LPCTSTR szFileName, long* recoveredFrames)
+{
+	unsigned int frames = 0;
+	bool success = AavRecoverFile((const char*)szFileName, &frames);
+
+	*recoveredFrames = (long)frames;
+
+	return success ? S_OK : E_FAIL;
+}
+
+HRESULT OpenAavReader(LPCTSTR szFileName, AavReaderFileInfo* fileInfo)
+{
+	if (!AavOpenReader((const char*)szFileName))
+		return E_FAIL;
+
+	fileInfo->FramesCount = (long)g_AavReader->GetFramesCount();
+	fileInfo->Width = (long)g_AavReader->Width;
+	fileInfo->Height = (long)g_AavReader->Height;
+	fileInfo->DataBpp = (long)g_AavReader->DataBpp;
+	fileInfo->IndexRebuilt = g_AavReader->IsIndexRebuilt() ? 1 : 0;
+	fileInfo->StatusSectionVersion = (long)g_AavReader->StatusSectionVersion;
+
+	return S_OK;
+}
+
+HRESULT ReadAavFrames(long firstFrameNo, long framesCount, BYTE* pixels, AavReaderFrameInfo* frameInfos)
+{
+	if (NULL == g_AavReader || firstFrameNo < 0 || framesCount < 0 || framesCount > (long)g_AavReader->GetFramesCount() - firstFrameNo)
+		return E_FAIL;
+
+	vector<AavLib::AavReaderFrame> frames(framesCount > 0 ? framesCount : 1);
+	unsigned int decodedFrames = g_AavReader->DecodeFrames((unsigned int)firstFrameNo, (unsigned int)framesCount, pixels, &frames[0]);
+
+	if (NULL != frameInfos)
+	{
+		for (unsigned int i = 0; i < decodedFrames; i++)
+		{
+			frameInfos[i].TimeStamp = frames[i].TimeStamp;
+			frameInfos[i].Exposure = (long)frames[i].Exposure;
+			frameInfos[i].ElapsedTime = (long)frames[i].ElapsedTime;
+			frameInfos[i].LayoutId = frames[i].LayoutId;
+			frameInfos[i].ByteMode = frames[i].ByteMode;
+			frameInfos[i].StatusBytesCount = (long)frames[i].StatusBytesCount;
+		}
+	}
+
+	return decodedFrames == (unsigned int)framesCount ? S_OK : E_FAIL;
+}
+
+HRESULT ReadAavFrameStatus(long frameNo, BYTE* statusBytes, long maxStatusBytes, long* statusBytesCount)
+{
+	AavLib::AavReaderFrame frame;
+	if (NULL == g_AavReader || frameNo < 0 || !g_AavReader->GetFrame((unsigned int)frameNo, &frame))
+		return E_FAIL;
+
+	*statusBytesCount = (long)frame.StatusBytesCount;
+	if (maxStatusBytes < (long)frame.StatusBytesCount)
+		return E_FAIL;
+
+	memcpy(statusBytes, frame.StatusBytes, frame.StatusBytesCount);
+	return S_OK;
+}
+
+// The region of the image of the frame, width * height pixels of 1 byte, or of 2 bytes when the file is 16 bit. Only the
+// tiles which overlap the region are decoded when the frame is tiled
+HRESULT ReadAavFrameRegion(long frameNo, long x, long y, long width, long height, BYTE* pixels)
+{
+	if (NULL == g_AavReader || frameNo < 0 || x < 0 || y < 0 || width <= 0 || height <= 0)
+		return E_FAIL;
+
+	return g_AavReader->DecodeRegion((unsigned int)frameNo, (unsigned int)x, (unsigned int)y, (unsigned int)width, (unsigned int)height, pixels) ? S_OK : E_FAIL;
+}
+
+// The key frame at or before the frame, from which the frames up to it are decoded in order when seeking to it
+HRESULT FindAavKeyFrame(long frameNo, long* keyFrameNo)
+{
+	if (NULL == g_AavReader || frameNo < 0 || frameNo >= (long)g_AavReader->GetFramesCount())
+		return E_FAIL;
+
+	int foundFrameNo = g_AavReader->FindKeyFrame((unsigned int)frameNo);
+	if (foundFrameNo < 0)
+		return E_FAIL;
+
+	*keyFrameNo = (long)foundFrameNo;
+	return S_OK;
+}
+
+HRESULT CloseAavReader()
+{
+	AavCloseReader();
+	return S_OK;
+}
+
 HRESULT SetupIntegrationPreservationArea(bool preserveVti, int areaTopOdd, int areaTopEven, int areaHeight)
 {
 	OCR_PRESERVE_VTI = preserveVti;
@@ -900,8 +1163,83 @@ void CalculateDiffSignature2(long* pixels, float* signatureThisPrev)
 	HandleCalibrationAfterSignatureCalc(*signatureThisPrev);
 }
 
+// Converts a bottom-up 24-bit bitmap to top-down monochrome pixels, keeps a copy of them for the OCR and the tracking
+// and adds them to the integrated pixels
+void AccumulateMonochromePixels(unsigned char* bmpBits, double* integratedPixels, unsigned char* frameCopyPixels, unsigned char* trackedFramePixels)
+{
+	unsigned char* ptrPixelItt = bmpBits + (IMAGE_HEIGHT - 1) * IMAGE_STRIDE;
+
+	double* ptrPixels = integratedPixels;
+	unsigned char* ptrFirstOrLastFrameCopy = frameCopyPixels;
+	unsigned char* ptrCurrTrackedFramePixels = trackedFramePixels;
+
+	for (int y = 0; y < IMAGE_HEIGHT; y++)
+	{
+		for (int x = 0; x < IMAGE_WIDTH; x++)
+		{
+			unsigned char thisPixel;
+
+			if (MONOCHROME_CONVERSION_MODE == 0)
+				thisPixel= *(ptrPixelItt + 2); //R
+			else if (MONOCHROME_CONVERSION_MODE == 1)
+				thisPixel= *(ptrPixelItt + 1); //G
+			else if (MONOCHROME_CONVERSION_MODE == 2)
+				thisPixel = *(ptrPixelItt); //B
+			else if (MONOCHROME_CONVERSION_MODE == 3)
+			{
+				// YUV Conversion (PAL & NTSC)
+				// Luma = 0.299 R + 0.587 G + 0.114 B
+				double luma = 0.299* *(ptrPixelItt) + 0.587* *(ptrPixelItt + 1) + 0.114* *(ptrPixelItt + 2);
+
+				if (luma < 0)
+					thisPixel = 0;
+				else if (luma > 255)
+					thisPixel = 255;
+				else
+					thisPixel = (unsigned char)luma;
+			}
+
+			// Saving the first/last frame raw pixels for OCR-ing
+			*ptrFirstOrLastFrameCopy = thisPixel;
+			*ptrCurrTrackedFramePixels = thisPixel;
+		    *ptrPixels += thisPixel;
+
+			ptrPixels++;
+			ptrFirstOrLastFrameCopy++;
+			ptrCurrTrackedFramePixels++;
+			ptrPixelItt+=3;
+		}
+
+		ptrPixelItt = ptrPixelItt - 2 * IMAGE_STRIDE;
+	}
+}
+
 long detectedIntegrationRate = 0;
 
+// The regions of interest of the frame, moved inside the image
+void CopyRegionsOfInterest(IntegratedFrame* frame)
+{
+	frame->RegionsCount = 0;
+
+	for (int i = 0; i < AAV_MAX_REGIONS_OF_INTEREST; i++)
+	{
+		long width = AAV_REGION_WIDTH[i] < IMAGE_WIDTH ? AAV_REGION_WIDTH[i] : IMAGE_WIDTH;
+		long height = AAV_REGION_HEIGHT[i] < IMAGE_HEIGHT ? AAV_REGION_HEIGHT[i] : IMAGE_HEIGHT;
+		if (width <= 0 || height <= 0)
+			continue;
+
+		long x = regionOfInterestX[i] < IMAGE_WIDTH - width ? regionOfInterestX[i] : IMAGE_WIDTH - width;
+		long y = regionOfInterestY[i] < IMAGE_HEIGHT - height ? regionOfInterestY[i] : IMAGE_HEIGHT - height;
+
+		unsigned int* region = &frame->Regions[4 * frame->RegionsCount];
+		region[0] = (unsigned int)(x > 0 ? x : 0);
+		region[1] = (unsigned int)(y > 0 ? y : 0);
+		region[2] = (unsigned int)width;
+		region[3] = (unsigned int)height;
+		frame->RegionsCount++;
+	}
+}
+
 long BufferNewIntegratedFrame(bool isNewIntegrationPeriod, __int64 currentUtcDayAsTicks, __int64 currentNtpTimeAsTicks,  __int64 currentSecondaryTimeAsTicks, double ntpBasedTimeError)
 {
 	long numItems = 0;
@@ -1065,6 +1403,9 @@ long BufferNewIntegratedFrame(bool isNewIntegrationPeriod, __int64 currentUtcDay
 		OcrErrorCode firstErrorCode = OcrErrorCode::Unknown;
 		OcrErrorCode secondErrorCode = OcrErrorCode::Unknown;
 
+		// The OCR zone pixels are collected in the loop above, which is counted as integration time
+		__int64 ocrStartTicks = ProfilingTicks();
+
 		if (runOCR)
 		{
 
@@ -1171,6 +1512,8 @@ long BufferNewIntegratedFrame(bool isNewIntegrationPeriod, __int64 currentUtcDay
 
 			hasOcrErors = ocrManager->OcrErrorsSinceReset > ocrErrorsSiceLastReset;
 			ocrErrorsSiceLastReset = ocrManager->OcrErrorsSinceReset;
+
+			coreProfilingInfo.OcrTicks += ProfilingTicks() - ocrStartTicks;
 		}
 
 		if (integratedFrameCouldBeRecorded)
@@ -1298,6 +1641,10 @@ long BufferNewIntegratedFrame(bool isNewIntegrationPeriod, __int64 currentUtcDay
 			frame->SecondaryStartTimestamp = firstFrameSecondaryTimestamp;
 			frame->SecondaryEndTimestamp = lastFrameSecondaryTimestamp;
 			frame->NTPTimestampError = (long)(0.5 + ntpBasedTimeError * 10);
+			frame->HasTrackedPosition = RUN_TRACKING && trackedObjectIsLocated;
+			frame->TrackedXPos = trackedObjectXPos;
+			frame->TrackedYPos = trackedObjectYPos;
+			CopyRegionsOfInterest(frame);
 
 			if (OCR_FAILED_TEST_RECORDING && hasOcrErors)
 				sprintf(&frame->OcrErrorMessageStr[0], "FirstFieldError: %d; LastFieldError: %d", (long)firstErrorCode, (long)secondErrorCode);
@@ -1308,15 +1655,22 @@ long BufferNewIntegratedFrame(bool isNewIntegrationPeriod, __int64 currentUtcDay
 
 			numItems = AddFrameToRecordingBuffer(frame);
 
-			numRecordedFrames++;
+			if (numItems < 0)
+			{
+				// The recorder thread is not keeping up
+				delete frame;
+				coreProfilingInfo.DroppedRecordingFrames++;
+			}
+			else
+				numRecordedFrames++;
 		}
 		else if (NULL != frame)
 		{
 			delete frame;
 		}
-
-		return numItems;
 	}
+
+	return numItems;
 }
 
 void HandleTracking(unsigned char* pixelsChar, long* pixels)
@@ -1325,6 +1679,8 @@ void HandleTracking(unsigned char* pixelsChar, long* pixels)
 		idxFrameNumber % TRACKING_FREQUENCY == 0 &&
 		!trackedThisIntegrationPeriod)
 	{
+		__int64 trackingStartTicks = ProfilingTicks();
+
 		// Run the tracking
 		if (NULL != pixelsChar)
 			TrackerNextFrame_int8(idxFrameNumber, pixelsChar);
@@ -1348,6 +1704,10 @@ void HandleTracking(unsigned char* pixelsChar, long* pixels)
 			latestImageStatus.TrkdTargetYPos = trackingInfo.CenterYDouble;
 			latestImageStatus.TrkdTargetIsTracked = 1;
 
+			trackedObjectIsLocated = trackingInfo.IsLocated != 0;
+			trackedObjectXPos = trackingInfo.CenterXDouble;
+			trackedObjectYPos = trackingInfo.CenterYDouble;
+
 			if (NULL != pixelsChar)
 				totalReading = MeasureObjectUsingAperturePhotometry_int8(pixelsChar, TRACKED_TARGET_APERTURE, IMAGE_WIDTH, IMAGE_HEIGHT, trackingInfo.CenterXDouble, trackingInfo.CenterYDouble, SATURATION_8BIT, TRACKING_BG_INNER_RADIUS, TRACKING_BG_MIN_NUM_PIXELS, &totalPixels, &hasSaturatedPixels);
 			else
@@ -1366,6 +1726,10 @@ void HandleTracking(unsigned char* pixelsChar, long* pixels)
 			latestImageStatus.TrkdGuidingYPos = trackingInfo.CenterYDouble;
 			latestImageStatus.TrkdGuidingIsTracked = 1;
 
+			trackedObjectIsLocated = trackingInfo.IsLocated != 0;
+			trackedObjectXPos = trackingInfo.CenterXDouble;
+			trackedObjectYPos = trackingInfo.CenterYDouble;
+
 			if (NULL != pixelsChar)
 				totalReading = MeasureObjectUsingAperturePhotometry_int8(pixelsChar, TRACKED_GUIDING_APERTURE, IMAGE_WIDTH, IMAGE_HEIGHT, trackingInfo.CenterXDouble, trackingInfo.CenterYDouble, SATURATION_8BIT, TRACKING_BG_INNER_RADIUS, TRACKING_BG_MIN_NUM_PIXELS, &totalPixels, &hasSaturatedPixels);
 			else
@@ -1374,8 +1738,24 @@ void HandleTracking(unsigned char* pixelsChar, long* pixels)
 			latestImageStatus.TrkdGuidingMeasurement = totalReading;
 			latestImageStatus.TrkdGuidingHasSaturatedPixels = hasSaturatedPixels ? 1 : 0;
 		}
+
+		// The regions of interest which follow a tracked object are centred on it
+		for (int i = 0; i < AAV_MAX_REGIONS_OF_INTEREST; i++)
+		{
+			NativePsfFitInfo psfInfo;
+
+			if (AAV_REGION_WIDTH[i] > 0 && AAV_REGION_TRACKED_OBJECT_ID[i] > -1 &&
+				S_OK == TrackerGetTargetState(AAV_REGION_TRACKED_OBJECT_ID[i], &trackingInfo, &psfInfo, &residuals[0]) &&
+				trackingInfo.IsLocated)
+			{
+				regionOfInterestX[i] = (long)floor(trackingInfo.CenterXDouble - AAV_REGION_WIDTH[i] / 2.0 + 0.5);
+				regionOfInterestY[i] = (long)floor(trackingInfo.CenterYDouble - AAV_REGION_HEIGHT[i] / 2.0 + 0.5);
+			}
+		}
 		
 		trackedThisIntegrationPeriod = INTEGRATION_LOCKED;
+
+		coreProfilingInfo.TrackingTicks += ProfilingTicks() - trackingStartTicks;
 	}
 	else
 	{
@@ -1387,6 +1767,8 @@ void HandleTracking(unsigned char* pixelsChar, long* pixels)
 
 HRESULT ProcessVideoFrame2(long* pixels, __int64 currentUtcDayAsTicks, __int64 currentNtpTimeAsTicks, double ntpBasedTimeError,  __int64 currentSecondaryTimeAsTicks, FrameProcessingStatus* frameInfo)
 {
+	__int64 startTicks = ProfilingTicks();
+
 	frameInfo->FrameDiffSignature = 0;
 
 	float diffSignature;
@@ -1470,11 +1852,17 @@ HRESULT ProcessVideoFrame2(long* pixels, __int64 currentUtcDayAsTicks, __int64 c
 
 	if (lastFrameWasNewIntegrationPeriod)
 		trackedThisIntegrationPeriod = false;
+
+	coreProfilingInfo.FrameProcessingTicks += ProfilingTicks() - startTicks;
+	coreProfilingInfo.ProcessedFrames++;
+
 	return S_OK;
 }
 
 void ProcessRawFrame(RawFrame* rawFrame)
 {
+	__int64 startTicks = ProfilingTicks();
+
 	float diffSignature;
 
 	CalculateDiffSignature(rawFrame->BmpBits, &diffSignature);
@@ -1506,13 +1894,7 @@ void ProcessRawFrame(RawFrame* rawFrame)
 	lastFrameNtpTimestamp = rawFrame->CurrentNtpTimeAsTicks;
 	lastFrameSecondaryTimestamp = rawFrame->CurrentSecondaryTimeAsTicks;
 
-	long stride = 3 * IMAGE_WIDTH;
-	unsigned char* ptrPixelItt = rawFrame->BmpBits + (IMAGE_HEIGHT - 1) * IMAGE_STRIDE;
-
-	double* ptrPixels = integratedPixels;
-
 	unsigned char* ptrFirstOrLastFrameCopy = NULL;
-	unsigned char* ptrCurrTrackedFramePixels = currTrackedFramePixels;
 
 	if (isNewIntegrationPeriod)
 	{
@@ -1525,46 +1907,7 @@ void ProcessRawFrame(RawFrame* rawFrame)
 		lastFrameWasNewIntegrationPeriod = false;
 	}
 
-	for (int y = 0; y < IMAGE_HEIGHT; y++)
-	{
-		for (int x = 0; x < IMAGE_WIDTH; x++)
-		{
-			unsigned char thisPixel;
-
-			if (MONOCHROME_CONVERSION_MODE == 0)
-				thisPixel= *(ptrPixelItt + 2); //R
-			else if (MONOCHROME_CONVERSION_MODE == 1)
-				thisPixel= *(ptrPixelItt + 1); //G
-			else if (MONOCHROME_CONVERSION_MODE == 2)
-				thisPixel = *(ptrPixelItt); //B
-			else if (MONOCHROME_CONVERSION_MODE == 3)
-			{
-				// YUV Conversion (PAL & NTSC)
-				// Luma = 0.299 R + 0.587 G + 0.114 B
-				double luma = 0.299* *(ptrPixelItt) + 0.587* *(ptrPixelItt + 1) + 0.114* *(ptrPixelItt + 2);
-
-				if (luma < 0)
-					thisPixel = 0;
-				else if (luma > 255)
-					thisPixel = 255;
-				else
-					thisPixel = (unsigned char)luma;
-			}
-
-			// Saving the first/last frame raw pixels for OCR-ing
-			*ptrFirstOrLastFrameCopy = thisPixel;
-			*ptrCurrTrackedFramePixels = thisPixel;
-
-		    *ptrPixels += thisPixel;
-
-			ptrPixels++;
-			ptrFirstOrLastFrameCopy++;
-			ptrCurrTrackedFramePixels++;
-			ptrPixelItt+=3;
-		}
-
-		ptrPixelItt = ptrPixelItt - 2 * IMAGE_STRIDE;
-	}
+	AccumulateMonochromePixels(rawFrame->BmpBits, integratedPixels, ptrFirstOrLastFrameCopy, currTrackedFramePixels);
 
 	numberOfIntegratedFrames++;
 
@@ -1575,6 +1918,9 @@ void ProcessRawFrame(RawFrame* rawFrame)
 
 	if (lastFrameWasNewIntegrationPeriod)
 		trackedThisIntegrationPeriod = false;
+
+	coreProfilingInfo.FrameProcessingTicks += ProfilingTicks() - startTicks;
+	coreProfilingInfo.ProcessedFrames++;
 }
 
 void ProcessBufferedVideoFrame()
@@ -1604,7 +1950,7 @@ void FrameProcessingThreadProc( void* pContext )
 	{
 		ProcessBufferedVideoFrame();
 
-		Sleep(1);
+		PlatformSleep(1);
 	};
 }
 
@@ -1672,13 +2018,7 @@ HRESULT ProcessVideoFrameSynchronous(LPVOID bmpBits, __int64 currentUtcDayAsTick
 	frameInfo->FrameDiffSignature  = diffSignature;
 	//frameInfo->CurrentSignatureRatio  = NULL != integrationChecker ? integrationChecker->CurrentSignatureRatio : 0;
 
-	long stride = 3 * IMAGE_WIDTH;
-	unsigned char* ptrPixelItt = buf + (IMAGE_HEIGHT - 1) * IMAGE_STRIDE;
-
-	double* ptrPixels = integratedPixels;
-
 	unsigned char* ptrFirstOrLastFrameCopy = NULL;
-	unsigned char* ptrCurrTrackedFramePixels = currTrackedFramePixels;
 
 	if (isNewIntegrationPeriod)
 	{
@@ -1690,46 +2030,8 @@ HRESULT ProcessVideoFrameSynchronous(LPVOID bmpBits, __int64 currentUtcDayAsTick
 		ptrFirstOrLastFrameCopy = lastIntegratedFramePixels;
 		lastFrameWasNewIntegrationPeriod = false;
 	}
-	
-	for (int y = 0; y < IMAGE_HEIGHT; y++)
-	{
-		for (int x = 0; x < IMAGE_WIDTH; x++)
-		{
-			unsigned char thisPixel;
-
-			if (MONOCHROME_CONVERSION_MODE == 0)
-				thisPixel= *(ptrPixelItt + 2); //R
-			else if (MONOCHROME_CONVERSION_MODE == 1)
-				thisPixel= *(ptrPixelItt + 1); //G
-			else if (MONOCHROME_CONVERSION_MODE == 2)
-				thisPixel = *(ptrPixelItt); //B
-			else if (MONOCHROME_CONVERSION_MODE == 3)
-			{
-				// YUV Conversion (PAL & NTSC)
-				// Luma = 0.299 R + 0.587 G + 0.114 B
-				double luma = 0.299* *(ptrPixelItt) + 0.587* *(ptrPixelItt + 1) + 0.114* *(ptrPixelItt + 2);
-
-				if (luma < 0)
-					thisPixel = 0;
-				else if (luma > 255)
-					thisPixel = 255;
-				else
-					thisPixel = (unsigned char)luma;
-			}
-
-			// Saving the first/last frame raw pixels for OCR-ing
-			*ptrFirstOrLastFrameCopy = thisPixel;
-			*ptrCurrTrackedFramePixels = thisPixel;
-		    *ptrPixels += thisPixel;
-
-			ptrPixels++;
-			ptrFirstOrLastFrameCopy++;
-			ptrCurrTrackedFramePixels++;
-			ptrPixelItt+=3;
-		}
 
-		ptrPixelItt = ptrPixelItt - 2 * IMAGE_STRIDE;
-	}
+	AccumulateMonochromePixels(buf, integratedPixels, ptrFirstOrLastFrameCopy, currTrackedFramePixels);
 
 	numberOfIntegratedFrames++;
 
@@ -1753,13 +2055,24 @@ HRESULT ProcessVideoFrame(LPVOID bmpBits, __int64 currentUtcDayAsTicks, __int64
 	if (USE_BUFFERED_FRAME_PROCESSING)
 		return ProcessVideoFrameBuffered(bmpBits, currentUtcDayAsTicks, currentNtpTimeAsTicks, ntpBasedTimeError, currentSecondaryTimeAsTicks, frameInfo);
 	else
-		return ProcessVideoFrameSynchronous(bmpBits, currentUtcDayAsTicks, currentNtpTimeAsTicks, ntpBasedTimeError, currentSecondaryTimeAsTicks, frameInfo);
+	{
+		__int64 startTicks = ProfilingTicks();
+
+		HRESULT rv = ProcessVideoFrameSynchronous(bmpBits, currentUtcDayAsTicks, currentNtpTimeAsTicks, ntpBasedTimeError, currentSecondaryTimeAsTicks, frameInfo);
+
+		coreProfilingInfo.FrameProcessingTicks += ProfilingTicks() - startTicks;
+		coreProfilingInfo.ProcessedFrames++;
+
+		return rv;
+	}
 }
 
 long long firstRecordedFrameTimestamp = 0;
 
 void RecordCurrentFrame(IntegratedFrame* nextFrame)
 {
+	__int64 startTicks = ProfilingTicks();
+
 	long long timeStamp = WindowsTicksToAavTicks((nextFrame->StartTimeStamp + nextFrame->EndTimeStamp) / 2);
 	unsigned int exposureIn10thMilliseconds = (nextFrame->EndTimeStamp - nextFrame->StartTimeStamp) / 1000;
 
@@ -1815,12 +2128,26 @@ void RecordCurrentFrame(IntegratedFrame* nextFrame)
 		AavFrameAddStatusTag64(STATUS_TAG_SECONDARY_END_TIMESTAMP, secondaryEndTimeStamp);
 	}
 
+	__int64 compressionStartTicks = ProfilingTicks();
+
+	AavFrameSetTrackedPosition(USE_IMAGE_LAYOUT, nextFrame->HasTrackedPosition, nextFrame->TrackedXPos, nextFrame->TrackedYPos);
+	AavFrameSetRegionsOfInterest(USE_IMAGE_LAYOUT, nextFrame->RegionsCount, nextFrame->Regions);
+
 	if (AAV_16)
 		AavFrameAddImage16(USE_IMAGE_LAYOUT, nextFrame->Pixels16);
 	else
 		AavFrameAddImage(USE_IMAGE_LAYOUT, nextFrame->Pixels);
 
+	__int64 writeStartTicks = ProfilingTicks();
+
 	AavEndFrame();
+
+	__int64 endTicks = ProfilingTicks();
+
+	coreProfilingInfo.CompressionTicks += writeStartTicks - compressionStartTicks;
+	coreProfilingInfo.DiskWriteTicks += endTicks - writeStartTicks;
+	coreProfilingInfo.RecordingTicks += endTicks - startTicks;
+	coreProfilingInfo.RecordedFrames++;
 }
 
 void RecordAllbufferedFrames()
@@ -1849,13 +2176,11 @@ void RecorderThreadProc( void* pContext )
 	{
 		RecordAllbufferedFrames();
 
-		Sleep(1);
+		PlatformSleep(1);
 	};
 
 	// Record all remaining frames, after 'recording' has been set to false
 	RecordAllbufferedFrames();
-
-    _endthread();
 }
 
 void CopyBuffer(IntegratedFrame* frame, unsigned char* rawPixels)
@@ -1870,6 +2195,35 @@ void CopyBuffer(IntegratedFrame* frame, unsigned char* rawPixels)
 }
 
 
+// Defines a FULL-IMAGE-RAW layout, which is tiled when the tiles are set up and the compression is not LAGARITH16, or else
+// bit packed in the 16 bit files when the compression works on bytes. LAGARITH16 and LOCO-I code the 16 bit pixels, whose
+// unused high bits cost them next to nothing
+void DefineRawImageLayout(unsigned char layoutId, const char* compression)
+{
+	bool isTiled = AAV_TILE_SIZE > 0 && 0 != strcmp(compression, "LAGARITH16");
+	bool isBitPacked = AAV_16 && AAV16_BIT_PACKING > 0 && (0 == strcmp(compression, "UNCOMPRESSED") || 0 == strcmp(compression, "QUICKLZ"));
+
+	if (isTiled)
+		AavDefineImageLayout(layoutId, AAV_16 ? 16 : 8, "FULL-IMAGE-TILED", compression, 0, NULL);
+	else if (isBitPacked)
+		AavDefineImageLayout(layoutId, (unsigned char)AAV16_BIT_PACKING, "FULL-IMAGE-BIT-PACKED", compression, 0, NULL);
+	else
+		AavDefineImageLayout(layoutId, AAV_16 ? 16 : 8, "FULL-IMAGE-RAW", compression, 0, NULL);
+}
+
+// The SECTION-DATA-COMPRESSION of the compressed layouts for the compressionAlgorithm passed to SetupAav()
+const char* CompressionName(long compressionAlgorithm)
+{
+	if (compressionAlgorithm == 1)
+		return "LAGARITH16";
+	else if (compressionAlgorithm == 2)
+		return "LOCO-I";
+	else if (compressionAlgorithm == 3)
+		return AAV_16 ? "LAGARITH16" : "LAGARITH8";
+	else
+		return "QUICKLZ";
+}
+
 HRESULT StartRecordingInternal(LPCTSTR szFileName)
 {
 	AavNewFile((const char*)szFileName);
@@ -1935,11 +2289,27 @@ HRESULT StartRecordingInternal(LPCTSTR szFileName)
 	AavDefineImageSection(IMAGE_WIDTH, IMAGE_HEIGHT, AAV_16 ? 16 : 8);
 	AavAddOrUpdateImageSectionTag("IMAGE-BYTE-ORDER", "LITTLE-ENDIAN");
 	
-	AavDefineImageLayout(1, AAV_16 ? 16 : 8, "FULL-IMAGE-RAW", "UNCOMPRESSED", 0, NULL);
+	DefineRawImageLayout(1, "UNCOMPRESSED");
+
+	const char* compression = CompressionName(USE_COMPRESSION_ALGORITHM);
 	
-	AavDefineImageLayout(2, AAV_16 ? 16 : 8, "FULL-IMAGE-DIFFERENTIAL-CODING-NOSIGNS", USE_COMPRESSION_ALGORITHM == 1 ? "LAGARITH16" : "QUICKLZ", 32, "PREV-FRAME");
-	AavDefineImageLayout(3, AAV_16 ? 16 : 8, "FULL-IMAGE-DIFFERENTIAL-CODING", USE_COMPRESSION_ALGORITHM == 1 ? "LAGARITH16" : "QUICKLZ", 32, "PREV-FRAME");
-	AavDefineImageLayout(4, AAV_16 ? 16 : 8, "FULL-IMAGE-RAW", USE_COMPRESSION_ALGORITHM == 1 ? "LAGARITH16" : "QUICKLZ", 0, NULL);
+	AavDefineImageLayout(2, AAV_16 ? 16 : 8, "FULL-IMAGE-DIFFERENTIAL-CODING-NOSIGNS", compression, AAV_KEY_FRAME_INTERVAL, "PREV-FRAME");
+	AavDefineImageLayout(3, AAV_16 ? 16 : 8, "FULL-IMAGE-DIFFERENTIAL-CODING", compression, AAV_KEY_FRAME_INTERVAL, "PREV-FRAME");
+	DefineRawImageLayout(4, compression);
+
+	// The differences from the previous frame shifted by the drift of the tracked star, which is not shifted when
+	// there is no tracking. Only defined when selected, as the readers which do not know the tag would take it for a
+	// plain diff coded layout
+	if (USE_IMAGE_LAYOUT == 6)
+	{
+		AavDefineImageLayout(6, AAV_16 ? 16 : 8, "FULL-IMAGE-DIFFERENTIAL-CODING", compression, AAV_KEY_FRAME_INTERVAL, "PREV-FRAME");
+		AavAddOrUpdateImageLayoutTag(6, "DIFFCODE-MOTION-COMPENSATION", "TRACKED-OBJECT");
+	}
+
+	// A reference frame every key frame interval and only the crops of the regions of interest in between. Only defined
+	// when selected, as the readers which do not know the data layout reject the file
+	if (USE_IMAGE_LAYOUT == 7)
+		AavDefineImageLayout(7, AAV_16 ? 16 : 8, "REGIONS-OF-INTEREST", compression, AAV_KEY_FRAME_INTERVAL, "KEY-FRAME");
 
 	if (RECORD_ONLY_STATUS_CHANNEL_WITH_OCRED_TIMESTAMPS)
 	{
@@ -2017,7 +2387,7 @@ HRESULT StartRecordingInternal(LPCTSTR szFileName)
 	AAV16_MAX_BINNED_FRAMES = 0;
 
 	// Create a new thread
-	hRecordingThread = (HANDLE)_beginthread(RecorderThreadProc, 0, NULL);
+	hRecordingThread = PlatformStartThread(RecorderThreadProc, NULL);
 
 	return S_OK;
 }
@@ -2032,7 +2402,8 @@ HRESULT StopRecording(long* pixels)
 {
 	recording = false;
 
-	WaitForSingleObject(hRecordingThread, INFINITE); // wait for thread to exit
+	PlatformWaitForThread(hRecordingThread); // wait for thread to exit
+	hRecordingThread = NULL;
 
 	if (NULL == ocrManager || !ocrManager->IsReceivingTimeStamps())
 	{
@@ -2057,6 +2428,7 @@ HRESULT StopRecording(long* pixels)
 		frame->NTPTimestampError = 0;
 		frame->SecondaryStartTimestamp = 0;
 		frame->SecondaryEndTimestamp = 0;
+		CopyRegionsOfInterest(frame);
 
 		RecordCurrentFrame(frame);
 	}
@@ -2079,7 +2451,7 @@ HRESULT StopRecording(long* pixels)
 HRESULT StartOcrTesting(LPCTSTR szFileName)
 {
 	if (!OCR_IS_SETUP)
-		throw new exception("OCR hasn't been setup. Cannot start testing.");
+		throw std::runtime_error("OCR hasn't been setup. Cannot start testing.");
 
 	OCR_FAILED_TEST_RECORDING = true;
 
@@ -2096,6 +2468,7 @@ HRESULT DisableOcrProcessing()
 HRESULT EnableTracking(long targetObjectId, long guidingObjectId, long frequency, float targetAperture, float guidingAperture, float innerRadiusOfBackgroundApertureInSignalApertures, long numberOfPixelsInBackgroundAperture)
 {
 	RUN_TRACKING = true;
+	trackedObjectIsLocated = false;
 	TRACKED_TARGET_ID = targetObjectId;
 	TRACKED_GUIDING_ID = guidingObjectId;
 	TRACKING_FREQUENCY = frequency;
@@ -2112,5 +2485,44 @@ HRESULT DisableTracking()
 {
 	RUN_TRACKING = false;
 
+	return S_OK;
+}
+
+HRESULT GetProfilingInfo(CoreProfilingInfo* profilingInfo)
+{
+	*profilingInfo = coreProfilingInfo;
+
+	profilingInfo->TicksPerSecond = PlatformPerformanceFrequency();
+	profilingInfo->BytesWritten = g_AdvBytesWritten;
+	profilingInfo->RawFrameBufferLength = GetRawFrameBufferLength();
+	profilingInfo->RawFrameBufferHighWaterMark = rawFrameBufferHighWaterMark;
+	profilingInfo->RecordingBufferLength = GetRecordingBufferLength();
+	profilingInfo->RecordingBufferHighWaterMark = recordingBufferHighWaterMark;
+	profilingInfo->DiskWrites = AavLib::g_AavDiskWrites;
+	profilingInfo->DiskWriteLatencyTicks = AavLib::g_AavDiskWriteTicks;
+	profilingInfo->DiskWriteMaxLatencyTicks = AavLib::g_AavDiskWriteMaxTicks;
+	profilingInfo->DiskSyncs = AavLib::g_AavDiskSyncs;
+	profilingInfo->DiskWriteStallTicks = AavLib::g_AavWriteStallTicks;
+	profilingInfo->CompressionWorkerTicks = AavLib::g_AavCompressionWorkerTicks;
+	profilingInfo->CompressionStallTicks = AavLib::g_AavCompressionStallTicks;
+
+	return S_OK;
+}
+
+HRESULT ResetProfilingInfo()
+{
+	::ZeroMemory(&coreProfilingInfo, sizeof(CoreProfilingInfo));
+
+	g_AdvBytesWritten = 0;
+	AavLib::g_AavDiskWrites = 0;
+	AavLib::g_AavDiskWriteTicks = 0;
+	AavLib::g_AavDiskWriteMaxTicks = 0;
+	AavLib::g_AavDiskSyncs = 0;
+	AavLib::g_AavWriteStallTicks = 0;
+	AavLib::g_AavCompressionWorkerTicks = 0;
+	AavLib::g_AavCompressionStallTicks = 0;
+	rawFrameBufferHighWaterMark = 0;
+	recordingBufferHighWaterMark = 0;
+
 	return S_OK;
 }
\ No newline at end of file
@@ -154,7 +154,7 @@ namespace OccuRec
 		float bestLowSigma = 1000;
 		float bestHighSigma = 1000;
 
-		int signaturesCount = min(processedManualRateSignatures, currentManualRate * 10);
+		int signaturesCount = (int)min(processedManualRateSignatures, (__int64)(currentManualRate * 10));
 
 		for (int i = 0; i < currentManualRate; i++)
 		{			
@@ -2,11 +2,12 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
-#include "StdAfx.h"
+#include "stdafx.h"
 
 #include "OccuRec.Ocr.h"
 #include "stdio.h"
 #include <algorithm>
+#include <stdexcept>
 #include <functional>
 #include <numeric>
 #include "utils.h"
@@ -49,7 +50,7 @@ Zone::Zone(long zonePixelsCount)
 	ZonePixelsCount = zonePixelsCount;
 
 	if (zonePixelsCount > MAX_PIXELS_IN_ZONE_COUNT)
-		throw std::exception("Zone can only have up to MAX_PIXELS_IN_ZONE_COUNT pixels");
+		throw std::runtime_error("Zone can only have up to MAX_PIXELS_IN_ZONE_COUNT pixels");
 
 	for (int i = 0; i < MAX_PIXELS_IN_ZONE_COUNT; i++)
 	{
@@ -154,7 +155,7 @@ char CharRecognizer::Ocr(long frameMedian)
 		return OcrSplitZones();
 	}
 	else
-		throw new exception("Unsupported ZoneMode");
+		throw std::runtime_error("Unsupported ZoneMode");
 }
 
 char CharRecognizer::OcrSplitZones()
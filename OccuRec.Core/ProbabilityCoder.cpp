@@ -23,6 +23,14 @@ ProbabilityCoder::ProbabilityCoder(void * buffer, int start_bits){
 	bitpos=0;
 	stream = (unsigned char *)buffer;
 	max_val=1<<(start_bits-1);
+	end_bitpos=0xFFFFFFFF;
+}
+
+ProbabilityCoder::ProbabilityCoder(const void * buffer, int start_bits, unsigned int buffer_bytes){
+	bitpos=0;
+	stream = (unsigned char *)buffer;
+	max_val=1<<(start_bits-1);
+	end_bitpos=buffer_bytes<(0xFFFFFFFF>>3)?buffer_bytes*8:0xFFFFFFFF;
 }
 
 unsigned int ProbabilityCoder::GetBytesUsed(){
@@ -57,6 +65,8 @@ unsigned int ProbabilityCoder::ReadSymbol(){
 	unsigned int symbol=0;
 	unsigned int new_max=0;
 	for ( unsigned int a=1;a<=max_val;a<<=1){
+		if ( bitpos >= end_bitpos )
+			return 0;
 		bool bit;
 		READ_BIT(bit);
 		if ( bit ){
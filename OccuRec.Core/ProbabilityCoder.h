@@ -9,15 +9,18 @@
 This class stores or loads probability values which must be in decending order. Each value is required to
 be less than or equal to the preceeding value. The max number of bits per value is entered in the
 constructor, and this value is decreased when ever a symbol is written or read that doesn't use
-all the bits.
+all the bits. A reader given the size of the buffer returns 0, which is never a valid value, instead of
+reading past its end.
 */
 class ProbabilityCoder{
 private:
 	unsigned int bitpos;
 	unsigned char * stream;
 	unsigned int max_val;
+	unsigned int end_bitpos;
 public:
 	ProbabilityCoder(void * buffer, int start_bits);
+	ProbabilityCoder(const void * buffer, int start_bits, unsigned int buffer_bytes);
 	unsigned int GetBytesUsed();
 	void WriteSymbol(unsigned int symbol);
 	unsigned int ReadSymbol();
@@ -13,16 +13,18 @@
 #define SHIFT_BITS		23
 #define SHIFT			FRACTIONAL_BITS
 
-int RangeCompress(const unsigned short * src, void * dest,int length, EncoderPair * encoder_table){
+// The encoder of both the 16 bit and the 8 bit symbols, with the probabilities in 1<<shift units
+template <typename Symbol, int shift>
+inline int RangeCompressSymbols(const Symbol * src, void * dest,int length, const EncoderPair * encoder_table){
 
 	unsigned int low = 0;
     unsigned int range = TOP_VALUE;
-	const unsigned short * const end = src+length;
+	const Symbol * const end = src+length;
 	unsigned char * dst = (unsigned char *)dest;
 
 	do {
 		// encode the current symbol
-		range >>= SHIFT;
+		range >>= shift;
 		unsigned int i = *src++;
 		low += range * encoder_table[i].cprobability;
 		range *= encoder_table[i].probability;
@@ -82,23 +84,22 @@ int RangeCompress(const unsigned short * src, void * dest,int length, EncoderPai
 	return ending-(unsigned char *)dest;
 }
 
-int RangeDecompress( const void * source, unsigned short * dest,int length, DecoderPair * decoder_table, const int * const hash ){
-	
+int RangeCompress(const unsigned short * src, void * dest,int length, EncoderPair * encoder_table){
+	return RangeCompressSymbols<unsigned short,SHIFT>(src,dest,length,encoder_table);
+}
 
-	// Create a lookup table to speed up decoding.
-	// Looking up a starting position for a linear search based on the top
-	// bits of the search value is faster than doing a binary search
-	const int lookup_size=4096;
-	const int lookup_shift = SHIFT - 12;
-	unsigned short lookup[lookup_size];
-	int h=1;
-	for ( int a=0;a<lookup_size;a++){
-		for ( ; decoder_table[h].cprobability<=(a<<lookup_shift);h++);
-		lookup[a]=h-1;
-	}
+int RangeCompress8(const unsigned char * src, void * dest, int length, const EncoderPair * encoder_table){
+	return RangeCompressSymbols<unsigned char,FRACTIONAL_BITS_8>(src,dest,length,encoder_table);
+}
+
+int RangeDecompress(const void * source, int source_size, unsigned short * dest, int length, const DecoderPair * decoder_table, const unsigned short * lookup){
+
+	if ( source_size < 4 )
+		return -1;
 
 	// initialize the decoder variables
 	const unsigned char * src = (const unsigned char *)source;
+	const unsigned char * const src_end = src+source_size;
 	unsigned short * ending = dest+length;
 	unsigned int range=TOP_VALUE;
 	unsigned int low=(src[0]<<24)+(src[1]<<16)+(src[2]<<8)+src[3];
@@ -106,24 +107,85 @@ int RangeDecompress( const void * source, unsigned short * dest,int length, Deco
 	unsigned short * dst = dest;
 
 	while ( dst < ending ){
-		// if the range gets too small, read in bytes
+		// if the range gets too small, read in bytes. Past the end of damaged data zeros are read and the
+		// source size is checked once at the end
 		while ( range <= BOTTOM_VALUE){
 			range <<= 8;
-			assert( range != 0 );
 			low <<= 8;
-			low += src[0];
+			if ( src < src_end ){
+				low += src[0];
+			}
 			src++;
 		}
 
-		// decode the current symbol
+		// decode the current symbol, whose cumulative probability range holds v. Only damaged data gives a v
+		// outside of the table
 		unsigned int help = range >> SHIFT;
-		int x =lookup[low/help>>lookup_shift];
-		for ( ; decoder_table[x+1].cprobability*help<=low;x++){};
+		unsigned int v = low/help;
+		if ( v >= (1<<SHIFT) ){
+			return -1;
+		}
+		int x = lookup[v>>(SHIFT-DECODER_LOOKUP_BITS)];
+		for ( ; decoder_table[x+1].cprobability<=(int)v;x++){};
 		low -= decoder_table[x].cprobability*help;
 		*dst++=decoder_table[x].decoded_value;
 		range = (decoder_table[x+1].cprobability-decoder_table[x].cprobability)*help;
 	}
 
-	return true;
+	// the bytes the encoder output after the last symbol
+	while ( range <= BOTTOM_VALUE){
+		range <<= 8;
+		src++;
+	}
+
+	if ( src > src_end )
+		return -1;
+
+	return (int)(src-(const unsigned char *)source);
+}
+
+int RangeDecompress8(const void * source, int source_size, unsigned char * dest, int length, const DecoderPair * decoder_table, const unsigned char * lookup){
+
+	if ( source_size < 4 )
+		return -1;
+
+	const unsigned char * src = (const unsigned char *)source;
+	const unsigned char * const src_end = src+source_size;
+	unsigned char * ending = dest+length;
+	unsigned int range=TOP_VALUE;
+	unsigned int low=(src[0]<<24)+(src[1]<<16)+(src[2]<<8)+src[3];
+	src+=4;
+	unsigned char * dst = dest;
+
+	while ( dst < ending ){
+		while ( range <= BOTTOM_VALUE){
+			range <<= 8;
+			low <<= 8;
+			if ( src < src_end ){
+				low += src[0];
+			}
+			src++;
+		}
+
+		// every cumulative probability has its symbol in the lookup table, no search is needed
+		unsigned int help = range >> FRACTIONAL_BITS_8;
+		unsigned int v = low/help;
+		if ( v >= (1<<FRACTIONAL_BITS_8) ){
+			return -1;
+		}
+		int x = lookup[v];
+		low -= decoder_table[x].cprobability*help;
+		*dst++=(unsigned char)decoder_table[x].decoded_value;
+		range = (decoder_table[x+1].cprobability-decoder_table[x].cprobability)*help;
+	}
+
+	while ( range <= BOTTOM_VALUE){
+		range <<= 8;
+		src++;
+	}
+
+	if ( src > src_end )
+		return -1;
 
-}
\ No newline at end of file
+	return (int)(src-(const unsigned char *)source);
+}
@@ -6,5 +6,20 @@
 #include "Compressor.h"
 
 int RangeCompress(const unsigned short * src, void * dest,int length, EncoderPair * encoder_table);
-int RangeDecompress(const void * source, unsigned short * dest,int length, DecoderPair * decoder_table, const int * const hash );
+
+/*
+Decodes length symbols from the source_size bytes of the source. The lookup table has 1<<DECODER_LOOKUP_BITS entries,
+the index in decoder_table of the first symbol whose cumulative probability range holds each value of the top
+DECODER_LOOKUP_BITS bits of the cumulative probability.
+Returns the number of bytes used in the source, or a negative value if the data is damaged.
+*/
+int RangeDecompress(const void * source, int source_size, unsigned short * dest, int length, const DecoderPair * decoder_table, const unsigned short * lookup);
+
+/*
+The same coder for bytes, with 256 entry tables whose probabilities are in 1<<FRACTIONAL_BITS_8 units. The lookup
+table of the decoder has 1<<FRACTIONAL_BITS_8 entries, the index in decoder_table of the symbol of each cumulative
+probability.
+*/
+int RangeCompress8(const unsigned char * src, void * dest, int length, const EncoderPair * encoder_table);
+int RangeDecompress8(const void * source, int source_size, unsigned char * dest, int length, const DecoderPair * decoder_table, const unsigned char * lookup);
 
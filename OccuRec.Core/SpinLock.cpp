@@ -6,6 +6,7 @@
 #include "stdafx.h"
 #include "SpinLock.h"
 #include <iostream>
+#include <stdexcept>
 
 using namespace LockFree;
 using namespace std;
@@ -16,17 +17,17 @@ void tSpinWait::Lock(tSpinLock &LockObj)
 	while(true)
 	{
 		// A thread alreading owning the lock shouldn't be allowed to wait to acquire the lock - reentrant safe
-		if(LockObj.dest == GetCurrentThreadId())
+		if(LockObj.dest == (LONG)PlatformCurrentThreadId())
 			break;
 		/*
 		  Spinning in a loop of interlockedxxx calls can reduce the available memory bandwidth and slow
 		  down the rest of the system. Interlocked calls are expensive in their use of the system memory
 		  bus. It is better to see if the 'dest' value is what it is expected and then retry interlockedxx.
 		*/
-		if(InterlockedCompareExchange(&LockObj.dest, LockObj.exchange, LockObj.compare) == 0)
+		if(PlatformCompareExchange(&LockObj.dest, LockObj.exchange, LockObj.compare) == 0)
 		{
 			//assign CurrentThreadId to dest to make it re-entrant safe
-			LockObj.dest = GetCurrentThreadId();
+			LockObj.dest = (LONG)PlatformCurrentThreadId();
 			// lock acquired 
 			break;			
 		}
@@ -37,18 +38,18 @@ void tSpinWait::Lock(tSpinLock &LockObj)
 			if(HasThreasholdReached())
 			{
 				if(m_iterations + YIELD_ITERATION >= MAX_SLEEP_ITERATION)
-					Sleep(1);
+					PlatformSleep(1);
 				
 				if(m_iterations >= YIELD_ITERATION && m_iterations < MAX_SLEEP_ITERATION)
 				{
 					m_iterations = 0;
-					SwitchToThread();
+					PlatformYieldThread();
 				}
 			}
 			// Yield processor on multi-processor but if on single processor then give other thread the CPU
 			m_iterations++;
-			if(Helper::GetNumberOfProcessors() > 1) { YieldProcessor(/*no op*/); }
-			else { SwitchToThread(); }				
+			if(Helper::GetNumberOfProcessors() > 1) { PlatformSpinPause(); }
+			else { PlatformYieldThread(); }				
 		}				
 	}
 }
@@ -56,9 +57,9 @@ void tSpinWait::Lock(tSpinLock &LockObj)
 
 void tSpinWait::Unlock(tSpinLock &LockObj)
 {
-	if(LockObj.dest != GetCurrentThreadId())
+	if(LockObj.dest != (LONG)PlatformCurrentThreadId())
 		throw std::runtime_error("Unexpected thread-id in release");
 	// lock released
-	InterlockedCompareExchange(&LockObj.dest, LockObj.compare, GetCurrentThreadId());	
+	PlatformCompareExchange(&LockObj.dest, LockObj.compare, (LONG)PlatformCurrentThreadId());	
 }
 //
\ No newline at end of file
@@ -5,8 +5,9 @@
 #include "stdafx.h"
 #include "SyncLock.h"
 #include "SpinLock.h"
-#include <Windows.h>
+#ifdef _WIN32
 #include <Dbghelp.h>
+#endif
 #include "utils.h"
 
 namespace SyncLock
@@ -22,20 +23,23 @@ enum LockTech
 
 #define LOCK_TECH LockTech::Mutex
 
-CRITICAL_SECTION syncVideo;
-CRITICAL_SECTION syncIntDet;
-CRITICAL_SECTION syncRawFrame;
-HANDLE mutexVideo;
-HANDLE mutexRawFrame;
-HANDLE mutexIntDet;
-LockFree::tSpinLock lockVideo;
-LockFree::tSpinLock lockIntDet;
-LockFree::tSpinLock lockRawFrame;
+// The objects of all lock techniques, only the ones of LOCK_TECH are used
+struct SyncObject
+{
+#ifdef _WIN32
+	CRITICAL_SECTION Section;
+	HANDLE EventHandle;
+#endif
+	HANDLE MutexHandle;
+	LockFree::tSpinLock SpinLock;
+};
+
+SyncObject syncVideo;
+SyncObject syncRawFrame;
+SyncObject syncIntDet;
 LockFree::tSpinWait spinWait;
-HANDLE eventVideo;
-HANDLE eventRawFrame; 
-HANDLE eventIntDet; 
 
+#ifdef _WIN32
 
 void DebugPrintLastError(const char* message)
 {
@@ -94,118 +98,110 @@ LONG CALLBACK unhandled_handler(EXCEPTION_POINTERS* e)
     return EXCEPTION_CONTINUE_SEARCH;
 }
 
-void Initialise()
+#endif
+
+void InitialiseSyncObject(SyncObject& syncObject, const wchar_t* eventName)
 {
-	if (LOCK_TECH == LockTech::CriticalSection)
+	if (LOCK_TECH == LockTech::Mutex)
+		syncObject.MutexHandle = PlatformCreateMutex();
+#ifdef _WIN32
+	else if (LOCK_TECH == LockTech::CriticalSection)
 	{
-		if (0 == InitializeCriticalSectionAndSpinCount(&syncVideo, 4000))
-			DebugPrintLastError("Error calling InitializeCriticalSectionAndSpinCount(&syncVideo, 4000)");
+		if (0 == InitializeCriticalSectionAndSpinCount(&syncObject.Section, 4000))
+			DebugPrintLastError("Error calling InitializeCriticalSectionAndSpinCount(4000)");
+	}
+	else if (LOCK_TECH == LockTech::Event)
+		syncObject.EventHandle = CreateEvent(NULL, TRUE, TRUE, eventName);
+#endif
+}
 
-		if (0 == InitializeCriticalSectionAndSpinCount(&syncIntDet, 4000))
-			DebugPrintLastError("Error calling InitializeCriticalSectionAndSpinCount(&syncVideo, 4000)");
+void UninitialiseSyncObject(SyncObject& syncObject)
+{
+	if (LOCK_TECH == LockTech::Mutex)
+		PlatformDestroyMutex(syncObject.MutexHandle);
+#ifdef _WIN32
+	else if (LOCK_TECH == LockTech::CriticalSection)
+		DeleteCriticalSection(&syncObject.Section);
+#endif
+}
 
-		if (0 == InitializeCriticalSectionAndSpinCount(&syncRawFrame, 4000))
-			DebugPrintLastError("Error calling InitializeCriticalSectionAndSpinCount(&syncVideo, 4000)");
-	}
+void Lock(SyncObject& syncObject)
+{
+	if (LOCK_TECH == LockTech::Mutex)
+		PlatformLockMutex(syncObject.MutexHandle);
+	else if (LOCK_TECH == LockTech::CompExch)
+		spinWait.Lock(syncObject.SpinLock);
+#ifdef _WIN32
+	else if (LOCK_TECH == LockTech::CriticalSection)
+		EnterCriticalSection(&syncObject.Section);
 	else if (LOCK_TECH == LockTech::Event)
 	{
-		eventVideo = CreateEvent( NULL, TRUE, TRUE,  L"SyncLockEventVideo"); 
-		eventRawFrame = CreateEvent( NULL, TRUE, TRUE,  L"SyncLockEventRawFrame"); 
-		eventIntDet = CreateEvent( NULL, TRUE, TRUE,  L"SyncLockEventIntDet"); 
+		WaitForSingleObject(syncObject.EventHandle, INFINITE);
+		ResetEvent(syncObject.EventHandle);
 	}
+#endif
+}
+
+void Unlock(SyncObject& syncObject)
+{
+	if (LOCK_TECH == LockTech::Mutex)
+		PlatformUnlockMutex(syncObject.MutexHandle);
+	else if (LOCK_TECH == LockTech::CompExch)
+		spinWait.Unlock(syncObject.SpinLock);
+#ifdef _WIN32
+	else if (LOCK_TECH == LockTech::CriticalSection)
+		LeaveCriticalSection(&syncObject.Section);
+	else if (LOCK_TECH == LockTech::Event)
+		SetEvent(syncObject.EventHandle);
+#endif
+}
+
+void Initialise()
+{
+	InitialiseSyncObject(syncVideo, L"SyncLockEventVideo");
+	InitialiseSyncObject(syncRawFrame, L"SyncLockEventRawFrame");
+	InitialiseSyncObject(syncIntDet, L"SyncLockEventIntDet");
 
+#ifdef _WIN32
 	SetUnhandledExceptionFilter(unhandled_handler);
+#endif
 };
 
 void Uninitialise()
 {
-	if (LOCK_TECH == LockTech::CriticalSection)
-	{
-		DeleteCriticalSection(&syncVideo);
-		DeleteCriticalSection(&syncIntDet);
-		DeleteCriticalSection(&syncRawFrame);
-	}
+	UninitialiseSyncObject(syncVideo);
+	UninitialiseSyncObject(syncRawFrame);
+	UninitialiseSyncObject(syncIntDet);
 };
 
 void LockVideo()
 {
-	if (LOCK_TECH == LockTech::CriticalSection)
-		EnterCriticalSection(&syncVideo);
-	else if (LOCK_TECH == LockTech::Mutex)
-		WaitForSingleObject(mutexVideo, INFINITE);
-	else if (LOCK_TECH == LockTech::CompExch)
-		spinWait.Lock(lockVideo);
-	else if (LOCK_TECH == LockTech::Event)
-	{
-		WaitForSingleObject(eventVideo, INFINITE);
-		ResetEvent(eventVideo);
-	}
+	Lock(syncVideo);
 };
 
 void UnlockVideo()
 {
-	if (LOCK_TECH == LockTech::CriticalSection)
-		LeaveCriticalSection(&syncVideo);
-	else if (LOCK_TECH == LockTech::Mutex)
-		ReleaseMutex(mutexVideo);
-	else if (LOCK_TECH == LockTech::CompExch)
-		spinWait.Unlock(lockVideo);
-	else if (LOCK_TECH == LockTech::Event)
-		SetEvent(eventVideo);
+	Unlock(syncVideo);
 };
 
 void LockRawFrame()
 {
-	if (LOCK_TECH == LockTech::CriticalSection)
-		EnterCriticalSection(&syncRawFrame);
-	else if (LOCK_TECH == LockTech::Mutex)
-		WaitForSingleObject(mutexRawFrame, INFINITE);
-	else if (LOCK_TECH == LockTech::CompExch)
-		spinWait.Lock(lockRawFrame);
-	else if (LOCK_TECH == LockTech::Event)
-	{
-		WaitForSingleObject(eventRawFrame, INFINITE);
-		ResetEvent(eventRawFrame);
-	}
+	Lock(syncRawFrame);
 };
 
 void UnlockRawFrame()
 {
-	if (LOCK_TECH == LockTech::CriticalSection)
-		LeaveCriticalSection(&syncRawFrame);
-	else if (LOCK_TECH == LockTech::Mutex)
-		ReleaseMutex(mutexRawFrame);
-	else if (LOCK_TECH == LockTech::CompExch)
-		spinWait.Unlock(lockRawFrame);
-	else if (LOCK_TECH == LockTech::Event)
-		SetEvent(eventRawFrame);
+	Unlock(syncRawFrame);
 };
 
 void LockIntDet()
 {
-	if (LOCK_TECH == LockTech::CriticalSection)
-		EnterCriticalSection(&syncIntDet);
-	else if (LOCK_TECH == LockTech::Mutex)
-		WaitForSingleObject(mutexIntDet, INFINITE);
-	else if (LOCK_TECH == LockTech::CompExch)
-		spinWait.Lock(lockIntDet);
-	else if (LOCK_TECH == LockTech::Event)
-	{
-		WaitForSingleObject(eventIntDet, INFINITE);
-		ResetEvent(eventIntDet);
-	}
+	Lock(syncIntDet);
 };
 
 void UnlockIntDet()
 {
-	if (LOCK_TECH == LockTech::CriticalSection)
-		LeaveCriticalSection(&syncIntDet);
-	else if (LOCK_TECH == LockTech::Mutex)
-		ReleaseMutex(mutexIntDet);
-	else if (LOCK_TECH == LockTech::CompExch)
-		spinWait.Unlock(lockIntDet);
-	else if (LOCK_TECH == LockTech::Event)
-		SetEvent(eventIntDet);
+	Unlock(syncIntDet);
 };
 
 }
\ No newline at end of file
@@ -6,7 +6,7 @@
 #define SYNC_LOCK_H
 
 #include "stdafx.h"
-#include "windows.h"
+#include "platform.h"
 
 
 namespace SyncLock
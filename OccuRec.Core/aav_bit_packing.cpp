@@ -0,0 +1,169 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+
+#include "aav_bit_packing.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AAV_BIT_PACKING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace AavLib
+{
+
+unsigned int PackedPixelsBytes(unsigned int pixelsCount, unsigned int bitsPerPixel)
+{
+	return (pixelsCount + 3) / 4 * (bitsPerPixel / 2);
+}
+
+bool PixelsFitInBits(const unsigned short* pixels, unsigned int pixelsCount, unsigned int bitsPerPixel)
+{
+	if (bitsPerPixel >= 16)
+		return true;
+
+	unsigned int allBits = 0;
+	unsigned int i = 0;
+
+#ifdef AAV_BIT_PACKING_SSE2
+	__m128i allBits8 = _mm_setzero_si128();
+	for (; i + 8 <= pixelsCount; i += 8)
+		allBits8 = _mm_or_si128(allBits8, _mm_loadu_si128((const __m128i*)(pixels + i)));
+
+	allBits8 = _mm_or_si128(allBits8, _mm_srli_si128(allBits8, 8));
+	allBits8 = _mm_or_si128(allBits8, _mm_srli_si128(allBits8, 4));
+	allBits8 = _mm_or_si128(allBits8, _mm_srli_si128(allBits8, 2));
+	allBits = (unsigned int)_mm_cvtsi128_si32(allBits8) & 0xFFFF;
+#endif
+
+	for (; i < pixelsCount; i++)
+		allBits |= pixels[i];
+
+	return (allBits >> bitsPerPixel) == 0;
+}
+
+// Writes 8 bytes, of which the group takes bitsPerPixel / 2
+static inline void PackGroup(const unsigned short* pixels, unsigned int bitsPerPixel, unsigned char* packed)
+{
+	unsigned long long group =
+		(unsigned long long)pixels[0] |
+		((unsigned long long)pixels[1] << bitsPerPixel) |
+		((unsigned long long)pixels[2] << (2 * bitsPerPixel)) |
+		((unsigned long long)pixels[3] << (3 * bitsPerPixel));
+
+	memcpy(packed, &group, 8);
+}
+
+static inline void UnpackGroup(unsigned long long group, unsigned int bitsPerPixel, unsigned short* pixels, unsigned int pixelsCount)
+{
+	unsigned long long mask = (1ULL << bitsPerPixel) - 1;
+
+	for (unsigned int i = 0; i < pixelsCount; i++)
+		pixels[i] = (unsigned short)((group >> (i * bitsPerPixel)) & mask);
+}
+
+unsigned int PackPixels16(const unsigned short* pixels, unsigned int pixelsCount, unsigned int bitsPerPixel, unsigned char* packed)
+{
+	unsigned int groupBytes = bitsPerPixel / 2;
+	unsigned char* destination = packed;
+	unsigned int i = 0;
+
+	if (bitsPerPixel == 16)
+	{
+		// The whole groups are the pixels as they are
+		i = pixelsCount & ~3U;
+		memcpy(packed, pixels, 2 * i);
+		destination += 2 * i;
+	}
+
+#ifdef AAV_BIT_PACKING_SSE2
+	if (bitsPerPixel < 16)
+	{
+		// The pairs of pixels are joined by a multiply-add, which is signed but the pixels are below 1 << 14, and then
+		// the pairs into the groups of 4 pixels in the two 64 bit lanes
+		__m128i multiplier = _mm_set1_epi32((int)((1U << bitsPerPixel) << 16 | 1));
+		__m128i lowPairs = _mm_set_epi32(0, -1, 0, -1);
+		__m128i pairShift = _mm_cvtsi32_si128(2 * bitsPerPixel);
+
+		for (; i + 8 <= pixelsCount; i += 8)
+		{
+			__m128i pairs = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(pixels + i)), multiplier);
+			__m128i groups = _mm_or_si128(_mm_and_si128(pairs, lowPairs), _mm_sll_epi64(_mm_srli_epi64(pairs, 32), pairShift));
+
+			_mm_storel_epi64((__m128i*)destination, groups);
+			_mm_storel_epi64((__m128i*)(destination + groupBytes), _mm_unpackhi_epi64(groups, groups));
+			destination += 2 * groupBytes;
+		}
+	}
+#endif
+
+	for (; i + 4 <= pixelsCount; i += 4)
+	{
+		PackGroup(pixels + i, bitsPerPixel, destination);
+		destination += groupBytes;
+	}
+
+	if (i < pixelsCount)
+	{
+		unsigned short lastGroup[4] = { 0, 0, 0, 0 };
+		memcpy(lastGroup, pixels + i, 2 * (pixelsCount - i));
+		PackGroup(lastGroup, bitsPerPixel, destination);
+		destination += groupBytes;
+	}
+
+	return (unsigned int)(destination - packed);
+}
+
+void UnpackPixels16(const unsigned char* packed, unsigned int pixelsCount, unsigned int bitsPerPixel, unsigned short* pixels)
+{
+	if (bitsPerPixel == 16)
+	{
+		memcpy(pixels, packed, 2 * pixelsCount);
+		return;
+	}
+
+	unsigned int groupBytes = bitsPerPixel / 2;
+	unsigned int packedBytes = PackedPixelsBytes(pixelsCount, bitsPerPixel);
+	unsigned int offset = 0;
+	unsigned int i = 0;
+
+#ifdef AAV_BIT_PACKING_SSE2
+	// The 4 pixels of each group are shifted down to the bottom of the 64 bit lanes and moved to their 16 bit lanes
+	__m128i mask = _mm_set_epi32(0, (1 << bitsPerPixel) - 1, 0, (1 << bitsPerPixel) - 1);
+	__m128i shift1 = _mm_cvtsi32_si128(bitsPerPixel);
+	__m128i shift2 = _mm_cvtsi32_si128(2 * bitsPerPixel);
+	__m128i shift3 = _mm_cvtsi32_si128(3 * bitsPerPixel);
+
+	for (; i + 8 <= pixelsCount && offset + groupBytes + 8 <= packedBytes; i += 8, offset += 2 * groupBytes)
+	{
+		__m128i groups = _mm_unpacklo_epi64(
+			_mm_loadl_epi64((const __m128i*)(packed + offset)),
+			_mm_loadl_epi64((const __m128i*)(packed + offset + groupBytes)));
+
+		__m128i p0 = _mm_and_si128(groups, mask);
+		__m128i p1 = _mm_and_si128(_mm_srl_epi64(groups, shift1), mask);
+		__m128i p2 = _mm_and_si128(_mm_srl_epi64(groups, shift2), mask);
+		__m128i p3 = _mm_and_si128(_mm_srl_epi64(groups, shift3), mask);
+
+		__m128i unpacked = _mm_or_si128(
+			_mm_or_si128(p0, _mm_slli_epi64(p1, 16)),
+			_mm_or_si128(_mm_slli_epi64(p2, 32), _mm_slli_epi64(p3, 48)));
+
+		_mm_storeu_si128((__m128i*)(pixels + i), unpacked);
+	}
+#endif
+
+	for (; i < pixelsCount; i += 4, offset += groupBytes)
+	{
+		// Only the bytes of the group are read near the end, which may be the end of the mapped file
+		unsigned long long group = 0;
+		memcpy(&group, packed + offset, offset + 8 <= packedBytes ? 8 : groupBytes);
+
+		UnpackGroup(group, bitsPerPixel, pixels + i, pixelsCount - i < 4 ? pixelsCount - i : 4);
+	}
+}
+
+}
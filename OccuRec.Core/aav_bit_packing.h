@@ -0,0 +1,30 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef AAV_BIT_PACKING_H
+#define AAV_BIT_PACKING_H
+
+namespace AavLib
+{
+
+// The 16 bit pixels of the FULL-IMAGE-BIT-PACKED layouts are stored with an even number of bits each, up to 16.
+// Every 4 pixels are packed into bitsPerPixel / 2 bytes, the first pixel in the lowest bits, and the last group
+// is padded with zero pixels
+
+// The bytes of the packed pixels
+unsigned int PackedPixelsBytes(unsigned int pixelsCount, unsigned int bitsPerPixel);
+
+// Whether none of the pixels has a bit set above bitsPerPixel
+bool PixelsFitInBits(const unsigned short* pixels, unsigned int pixelsCount, unsigned int bitsPerPixel);
+
+// Packs the pixels, which must fit in bitsPerPixel. The packed bytes may be written up to 8 bytes past their end.
+// Returns the bytes of the packed pixels
+unsigned int PackPixels16(const unsigned short* pixels, unsigned int pixelsCount, unsigned int bitsPerPixel, unsigned char* packed);
+
+// Reads exactly PackedPixelsBytes() bytes
+void UnpackPixels16(const unsigned char* packed, unsigned int pixelsCount, unsigned int bitsPerPixel, unsigned short* pixels);
+
+}
+
+#endif // AAV_BIT_PACKING_H
@@ -0,0 +1,196 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+#include "aav_compression_pipeline.h"
+#include <stdlib.h>
+
+#define JOB_FREE 0
+#define JOB_FILLING 1
+#define JOB_PENDING 2
+#define JOB_COMPRESSING 3
+#define JOB_COMPRESSED 4
+
+// The timestamp and the exposure
+#define JOB_FRAME_BYTES 16
+
+namespace AavLib
+{
+
+unsigned int g_AavCompressionThreads = 0;
+
+__int64 g_AavCompressionWorkerTicks = 0;
+__int64 g_AavCompressionStallTicks = 0;
+
+AavCompressionPipeline::AavCompressionPipeline(unsigned int numWorkers, unsigned int width, unsigned int height, unsigned int maxImageBytes, unsigned int maxStatusBytes)
+{
+	m_Width = width;
+	m_Height = height;
+
+	// Enough jobs to keep all workers busy while the oldest frames are written
+	m_NumJobs = 2 * numWorkers + 2;
+	m_Jobs = new AavCompressionJob[m_NumJobs];
+	m_NextJob = 0;
+	m_OldestJob = 0;
+
+	for (unsigned int i = 0; i < m_NumJobs; i++)
+	{
+		AavCompressionJob* job = &m_Jobs[i];
+		job->State = JOB_FREE;
+		job->Layout = NULL;
+		job->FrameBytes = (unsigned char*)malloc(JOB_FRAME_BYTES);
+		job->BytesToCompress = (unsigned char*)malloc(maxImageBytes);
+		job->ImageBytes = (unsigned char*)malloc(maxImageBytes);
+		job->StatusBytes = (unsigned char*)malloc(maxStatusBytes);
+	}
+
+	m_JobPendingEvent = PlatformCreateEvent();
+	m_JobCompressedEvent = PlatformCreateEvent();
+
+	m_StopWorkers = 0;
+	m_NumWorkers = numWorkers;
+	m_Workers = new HANDLE[numWorkers];
+	for (unsigned int i = 0; i < numWorkers; i++)
+		m_Workers[i] = PlatformStartThread(WorkerThreadProc, this);
+}
+
+AavCompressionPipeline::~AavCompressionPipeline()
+{
+	PlatformInterlockedIncrement(&m_StopWorkers);
+	PlatformSetEvent(m_JobPendingEvent);
+	for (unsigned int i = 0; i < m_NumWorkers; i++)
+		PlatformWaitForThread(m_Workers[i]);
+
+	delete[] m_Workers;
+	m_Workers = NULL;
+
+	PlatformDestroyEvent(m_JobPendingEvent);
+	PlatformDestroyEvent(m_JobCompressedEvent);
+
+	for (unsigned int i = 0; i < m_NumJobs; i++)
+	{
+		free(m_Jobs[i].FrameBytes);
+		free(m_Jobs[i].BytesToCompress);
+		free(m_Jobs[i].ImageBytes);
+		free(m_Jobs[i].StatusBytes);
+	}
+
+	delete[] m_Jobs;
+	m_Jobs = NULL;
+}
+
+AavCompressionJob* AavCompressionPipeline::BeginJob()
+{
+	if (m_NextJob - m_OldestJob == m_NumJobs)
+		return NULL;
+
+	AavCompressionJob* job = &m_Jobs[m_NextJob % m_NumJobs];
+	job->State = JOB_FILLING;
+	m_NextJob++;
+
+	return job;
+}
+
+void AavCompressionPipeline::SubmitJob(AavCompressionJob* job)
+{
+	PlatformCompareExchange(&job->State, JOB_PENDING, JOB_FILLING);
+	PlatformSetEvent(m_JobPendingEvent);
+}
+
+AavCompressionJob* AavCompressionPipeline::GetCompressedJob(bool wait)
+{
+	if ((unsigned int)m_OldestJob == m_NextJob)
+		return NULL;
+
+	AavCompressionJob* job = &m_Jobs[m_OldestJob % m_NumJobs];
+
+	if (PlatformCompareExchange(&job->State, JOB_COMPRESSED, JOB_COMPRESSED) != JOB_COMPRESSED)
+	{
+		if (!wait)
+			return NULL;
+
+		__int64 startTicks = PlatformPerformanceCounter();
+
+		// Woken by every compressed job, which is not always the oldest one
+		while (PlatformCompareExchange(&job->State, JOB_COMPRESSED, JOB_COMPRESSED) != JOB_COMPRESSED)
+			PlatformWaitForEvent(m_JobCompressedEvent, PLATFORM_WAIT_INFINITE);
+
+		g_AavCompressionStallTicks += PlatformPerformanceCounter() - startTicks;
+	}
+
+	return job;
+}
+
+void AavCompressionPipeline::RetireJob(AavCompressionJob* job)
+{
+	g_AavCompressionWorkerTicks += job->CompressionTicks;
+
+	PlatformCompareExchange(&job->State, JOB_FREE, JOB_COMPRESSED);
+	PlatformInterlockedIncrement(&m_OldestJob);
+}
+
+unsigned int AavCompressionPipeline::GetNumWorkers()
+{
+	return m_NumWorkers;
+}
+
+void AavCompressionPipeline::WorkerThreadProc(void* context)
+{
+	AavCompressionPipeline* pipeline = (AavCompressionPipeline*)context;
+
+	qlz_state_compress* stateCompress = (qlz_state_compress*)malloc(sizeof(qlz_state_compress));
+	Compressor* lagarith16Compressor = new Compressor(pipeline->m_Width, pipeline->m_Height);
+	LocoICompressor* locoICompressor = new LocoICompressor(pipeline->m_Width);
+	Lagarith8Compressor* lagarith8Compressor = new Lagarith8Compressor(pipeline->m_Width);
+
+	for (;;)
+	{
+		AavCompressionJob* job = NULL;
+
+		// The oldest pending job first, as it is the next one to be written
+		unsigned int oldestJob = (unsigned int)pipeline->m_OldestJob;
+		for (unsigned int i = 0; i < pipeline->m_NumJobs; i++)
+		{
+			AavCompressionJob* candidate = &pipeline->m_Jobs[(oldestJob + i) % pipeline->m_NumJobs];
+			if (PlatformCompareExchange(&candidate->State, JOB_COMPRESSING, JOB_PENDING) == JOB_PENDING)
+			{
+				job = candidate;
+				break;
+			}
+		}
+
+		if (NULL != job)
+		{
+			// One event wakes one worker, so the next idle worker looks for more pending jobs
+			PlatformSetEvent(pipeline->m_JobPendingEvent);
+
+			__int64 startTicks = PlatformPerformanceCounter();
+
+			job->ImageBytesCount = job->BytesToCompressCount;
+			job->Layout->CompressDataBytes(job->BytesToCompressCount > 0 ? job->BytesToCompress : NULL, job->ImageBytes, &job->ImageBytesCount, stateCompress, lagarith16Compressor, locoICompressor, lagarith8Compressor);
+			job->CompressionTicks = PlatformPerformanceCounter() - startTicks;
+
+			PlatformCompareExchange(&job->State, JOB_COMPRESSED, JOB_COMPRESSING);
+			PlatformSetEvent(pipeline->m_JobCompressedEvent);
+			continue;
+		}
+
+		// All jobs are submitted and compressed before the workers are stopped. The event is passed on to stop
+		// the next worker
+		if (pipeline->m_StopWorkers != 0)
+		{
+			PlatformSetEvent(pipeline->m_JobPendingEvent);
+			break;
+		}
+
+		PlatformWaitForEvent(pipeline->m_JobPendingEvent, PLATFORM_WAIT_INFINITE);
+	}
+
+	free(stateCompress);
+	delete lagarith16Compressor;
+	delete locoICompressor;
+	delete lagarith8Compressor;
+}
+
+}
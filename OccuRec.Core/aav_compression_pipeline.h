@@ -0,0 +1,86 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef ADVCOMPRESSIONPIPELINE_H
+#define ADVCOMPRESSIONPIPELINE_H
+
+#include "aav_image_layout.h"
+#include "platform.h"
+
+namespace AavLib
+{
+
+// Configured with AavSetupCompressionThreads() and used by the next file. 0 compresses on the recording thread
+extern unsigned int g_AavCompressionThreads;
+
+// Statistics of the compression workers, reset by ResetProfilingInfo()
+extern __int64 g_AavCompressionWorkerTicks;
+extern __int64 g_AavCompressionStallTicks;
+
+// The image of a frame, compressed by any of the workers, and the rest of the frame waiting to be written with it
+class AavCompressionJob
+{
+	public:
+		volatile LONG State;
+
+		AavImageLayout* Layout;
+		char ByteMode;
+		unsigned int ElapsedTime;
+		__int64 CompressionTicks;
+
+		// The timestamp and the exposure
+		unsigned char* FrameBytes;
+
+		unsigned char* BytesToCompress;
+		unsigned int BytesToCompressCount;
+		unsigned char* ImageBytes;
+		unsigned int ImageBytesCount;
+		unsigned char* StatusBytes;
+		unsigned int StatusBytesCount;
+};
+
+// Compresses the frames with a pool of worker threads, each with its own QuickLZ state and Lagarith16, LOCO-I and
+// Lagarith8 compressors. The frames are compressed out of order but are returned in the order they were submitted,
+// through a ring of jobs that also works as the reorder buffer. Used from a single thread
+class AavCompressionPipeline {
+
+	private:
+		AavCompressionJob* m_Jobs;
+		unsigned int m_NumJobs;
+		unsigned int m_NextJob;
+		volatile LONG m_OldestJob;
+
+		HANDLE* m_Workers;
+		unsigned int m_NumWorkers;
+		volatile LONG m_StopWorkers;
+
+		// Set when a job is submitted or the workers are stopped, and when a job is compressed
+		HANDLE m_JobPendingEvent;
+		HANDLE m_JobCompressedEvent;
+
+		unsigned int m_Width;
+		unsigned int m_Height;
+
+		static void WorkerThreadProc(void* context);
+
+	public:
+		AavCompressionPipeline(unsigned int numWorkers, unsigned int width, unsigned int height, unsigned int maxImageBytes, unsigned int maxStatusBytes);
+		~AavCompressionPipeline();
+
+		// The job for the next frame, or NULL when all jobs are in use and the oldest one must be written first
+		AavCompressionJob* BeginJob();
+		void SubmitJob(AavCompressionJob* job);
+
+		// The oldest submitted job once it is compressed, or NULL when there is none. Waits for the compression
+		// when wait is true, otherwise returns NULL while the oldest job is still being compressed
+		AavCompressionJob* GetCompressedJob(bool wait);
+		// Called after the frame of the job returned by GetCompressedJob() has been written
+		void RetireJob(AavCompressionJob* job);
+
+		unsigned int GetNumWorkers();
+};
+
+}
+
+#endif // ADVCOMPRESSIONPIPELINE_H
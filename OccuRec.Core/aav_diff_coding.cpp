@@ -0,0 +1,261 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+
+#include "aav_diff_coding.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AAV_DIFF_CODING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace AavLib
+{
+
+void SubtractPixels8(const unsigned char* pixels, const unsigned char* basePixels, unsigned int pixelsCount, unsigned char* differences, unsigned char* nextBasePixels)
+{
+	unsigned int i = 0;
+
+#ifdef AAV_DIFF_CODING_SSE2
+	for (; i + 16 <= pixelsCount; i += 16)
+	{
+		__m128i current = _mm_loadu_si128((const __m128i*)(pixels + i));
+		__m128i base = _mm_loadu_si128((const __m128i*)(basePixels + i));
+
+		_mm_storeu_si128((__m128i*)(differences + i), _mm_sub_epi8(current, base));
+		if (NULL != nextBasePixels)
+			_mm_storeu_si128((__m128i*)(nextBasePixels + i), current);
+	}
+#endif
+
+	if (NULL != nextBasePixels)
+		memcpy(nextBasePixels + i, pixels + i, pixelsCount - i);
+
+	for (; i < pixelsCount; i++)
+		differences[i] = (unsigned char)(pixels[i] - basePixels[i]);
+}
+
+void SubtractPixelsWithSigns8(const unsigned char* pixels, const unsigned char* basePixels, unsigned int pixelsCount, unsigned char* signs, unsigned char* differences, unsigned char* nextBasePixels)
+{
+	unsigned int signedPixelsCount = pixelsCount & ~7U;
+	unsigned int i = 0;
+
+#ifdef AAV_DIFF_CODING_SSE2
+	// The absolute difference is the larger pixel less the smaller one, and the pixel is not above its base pixel
+	// when the larger one is the base pixel. The sign bits are the top bits of the 16 compares
+	for (; i + 16 <= pixelsCount; i += 16)
+	{
+		__m128i current = _mm_loadu_si128((const __m128i*)(pixels + i));
+		__m128i base = _mm_loadu_si128((const __m128i*)(basePixels + i));
+		__m128i larger = _mm_max_epu8(current, base);
+
+		_mm_storeu_si128((__m128i*)(differences + i), _mm_sub_epi8(larger, _mm_min_epu8(current, base)));
+		if (NULL != nextBasePixels)
+			_mm_storeu_si128((__m128i*)(nextBasePixels + i), current);
+
+		unsigned int negative = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(larger, base));
+		signs[i >> 3] = (unsigned char)(negative & 0xFF);
+		signs[(i >> 3) + 1] = (unsigned char)(negative >> 8);
+	}
+#endif
+
+	if (NULL != nextBasePixels)
+		memcpy(nextBasePixels + i, pixels + i, pixelsCount - i);
+
+	for (; i < signedPixelsCount; i += 8)
+	{
+		unsigned char signsByte = 0;
+
+		for (unsigned int bit = 0; bit < 8; bit++)
+		{
+			unsigned char pixel = pixels[i + bit];
+			unsigned char basePixel = basePixels[i + bit];
+
+			if (pixel > basePixel)
+				differences[i + bit] = (unsigned char)(pixel - basePixel);
+			else
+			{
+				differences[i + bit] = (unsigned char)(basePixel - pixel);
+				signsByte |= (unsigned char)(1 << bit);
+			}
+		}
+
+		signs[i >> 3] = signsByte;
+	}
+
+	for (; i < pixelsCount; i++)
+		differences[i] = (unsigned char)(pixels[i] - basePixels[i]);
+}
+
+void AddPixelsWithSigns8(const unsigned char* basePixels, const unsigned char* signs, const unsigned char* differences, unsigned int pixelsCount, unsigned char* pixels)
+{
+	unsigned int signedPixelsCount = pixelsCount & ~7U;
+	unsigned int i = 0;
+
+#ifdef AAV_DIFF_CODING_SSE2
+	// The 16 sign bits are spread to the bytes of their pixels and a negative difference d is added as (d ^ -1) + 1
+	__m128i signBits = _mm_set_epi8((char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, (char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+	for (; i + 16 <= pixelsCount; i += 16)
+	{
+		__m128i signs16 = _mm_cvtsi32_si128(signs[i >> 3] | (signs[(i >> 3) + 1] << 8));
+		signs16 = _mm_unpacklo_epi8(signs16, signs16);
+		signs16 = _mm_unpacklo_epi16(signs16, signs16);
+		signs16 = _mm_unpacklo_epi32(signs16, signs16);
+
+		__m128i negative = _mm_cmpeq_epi8(_mm_and_si128(signs16, signBits), signBits);
+		__m128i difference = _mm_loadu_si128((const __m128i*)(differences + i));
+		__m128i signedDifference = _mm_sub_epi8(_mm_xor_si128(difference, negative), negative);
+
+		_mm_storeu_si128((__m128i*)(pixels + i), _mm_add_epi8(_mm_loadu_si128((const __m128i*)(basePixels + i)), signedDifference));
+	}
+#endif
+
+	for (; i < pixelsCount; i++)
+	{
+		bool isNegative = i < signedPixelsCount && (signs[i >> 3] & (1 << (i & 7))) != 0;
+		pixels[i] = isNegative ? (unsigned char)(basePixels[i] - differences[i]) : (unsigned char)(basePixels[i] + differences[i]);
+	}
+}
+
+void SubtractPixelsZigZag16(const unsigned short* pixels, const unsigned short* basePixels, unsigned int pixelsCount, unsigned char* differences, unsigned short* nextBasePixels)
+{
+	unsigned int i = 0;
+
+#ifdef AAV_DIFF_CODING_SSE2
+	for (; i + 8 <= pixelsCount; i += 8)
+	{
+		__m128i current = _mm_loadu_si128((const __m128i*)(pixels + i));
+		__m128i difference = _mm_sub_epi16(current, _mm_loadu_si128((const __m128i*)(basePixels + i)));
+
+		_mm_storeu_si128((__m128i*)(differences + 2 * i), _mm_xor_si128(_mm_slli_epi16(difference, 1), _mm_srai_epi16(difference, 15)));
+		if (NULL != nextBasePixels)
+			_mm_storeu_si128((__m128i*)(nextBasePixels + i), current);
+	}
+#endif
+
+	if (NULL != nextBasePixels)
+		memcpy(nextBasePixels + i, pixels + i, 2 * (pixelsCount - i));
+
+	for (; i < pixelsCount; i++)
+	{
+		unsigned short difference = (unsigned short)(pixels[i] - basePixels[i]);
+		unsigned short zigZag = (unsigned short)((difference << 1) ^ (0U - (difference >> 15)));
+
+		differences[2 * i] = (unsigned char)(zigZag & 0xFF);
+		differences[2 * i + 1] = (unsigned char)(zigZag >> 8);
+	}
+}
+
+void AddPixelsZigZag16(const unsigned short* basePixels, const unsigned char* differences, unsigned int pixelsCount, unsigned short* pixels)
+{
+	unsigned int i = 0;
+
+#ifdef AAV_DIFF_CODING_SSE2
+	__m128i one = _mm_set1_epi16(1);
+
+	for (; i + 8 <= pixelsCount; i += 8)
+	{
+		__m128i zigZag = _mm_loadu_si128((const __m128i*)(differences + 2 * i));
+		__m128i difference = _mm_xor_si128(_mm_srli_epi16(zigZag, 1), _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(zigZag, one)));
+
+		_mm_storeu_si128((__m128i*)(pixels + i), _mm_add_epi16(_mm_loadu_si128((const __m128i*)(basePixels + i)), difference));
+	}
+#endif
+
+	for (; i < pixelsCount; i++)
+	{
+		unsigned int zigZag = differences[2 * i] | (differences[2 * i + 1] << 8);
+		unsigned int difference = (zigZag >> 1) ^ (0U - (zigZag & 1));
+
+		pixels[i] = (unsigned short)(basePixels[i] + difference);
+	}
+}
+
+void ShiftPixels(const unsigned char* pixels, unsigned int width, unsigned int height, unsigned int pixelBytes, int dx, int dy, unsigned char* shiftedPixels)
+{
+	int w = (int)width;
+	int h = (int)height;
+	if (dx <= -w) dx = 1 - w;
+	if (dx >= w) dx = w - 1;
+
+	// The pixels of the row which stay in the image, then the edge pixels repeated on the side they left
+	unsigned int keptPixels = (unsigned int)(w - (dx < 0 ? -dx : dx));
+	unsigned int firstKept = dx < 0 ? (unsigned int)-dx : 0;
+	unsigned int firstShifted = dx > 0 ? (unsigned int)dx : 0;
+	unsigned int rowBytes = width * pixelBytes;
+
+	for (int y = 0; y < h; y++)
+	{
+		int sourceY = y - dy < 0 ? 0 : (y - dy >= h ? h - 1 : y - dy);
+		const unsigned char* source = pixels + sourceY * rowBytes;
+		unsigned char* shifted = shiftedPixels + y * rowBytes;
+
+		memcpy(shifted + firstShifted * pixelBytes, source + firstKept * pixelBytes, keptPixels * pixelBytes);
+
+		for (unsigned int x = 0; x < firstShifted; x++)
+			memcpy(shifted + x * pixelBytes, source, pixelBytes);
+
+		for (unsigned int x = firstShifted + keptPixels; x < width; x++)
+			memcpy(shifted + x * pixelBytes, source + (width - 1) * pixelBytes, pixelBytes);
+	}
+}
+
+unsigned int SumOfAbsoluteDifferences8(const unsigned char* pixels, const unsigned char* basePixels, unsigned int pixelsCount)
+{
+	unsigned int sum = 0;
+	unsigned int i = 0;
+
+#ifdef AAV_DIFF_CODING_SSE2
+	// Each 64 bit lane sums 8 of the absolute differences
+	__m128i sums = _mm_setzero_si128();
+	for (; i + 16 <= pixelsCount; i += 16)
+	{
+		sums = _mm_add_epi64(sums, _mm_sad_epu8(
+			_mm_loadu_si128((const __m128i*)(pixels + i)),
+			_mm_loadu_si128((const __m128i*)(basePixels + i))));
+	}
+
+	sum = (unsigned int)_mm_cvtsi128_si32(sums) + (unsigned int)_mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums));
+#endif
+
+	for (; i < pixelsCount; i++)
+		sum += pixels[i] > basePixels[i] ? pixels[i] - basePixels[i] : basePixels[i] - pixels[i];
+
+	return sum;
+}
+
+unsigned int SumOfAbsoluteDifferences16(const unsigned short* pixels, const unsigned short* basePixels, unsigned int pixelsCount)
+{
+	unsigned int sum = 0;
+	unsigned int i = 0;
+
+#ifdef AAV_DIFF_CODING_SSE2
+	// One of the saturated differences is the absolute difference and the other is 0. They are widened to the 32 bit
+	// lanes, each of which sums 2 of them per 8 pixels
+	__m128i zero = _mm_setzero_si128();
+	__m128i sums = _mm_setzero_si128();
+	for (; i + 8 <= pixelsCount; i += 8)
+	{
+		__m128i current = _mm_loadu_si128((const __m128i*)(pixels + i));
+		__m128i base = _mm_loadu_si128((const __m128i*)(basePixels + i));
+		__m128i difference = _mm_or_si128(_mm_subs_epu16(current, base), _mm_subs_epu16(base, current));
+
+		sums = _mm_add_epi32(sums, _mm_add_epi32(_mm_unpacklo_epi16(difference, zero), _mm_unpackhi_epi16(difference, zero)));
+	}
+
+	sums = _mm_add_epi32(sums, _mm_unpackhi_epi64(sums, sums));
+	sums = _mm_add_epi32(sums, _mm_srli_si128(sums, 4));
+	sum = (unsigned int)_mm_cvtsi128_si32(sums);
+#endif
+
+	for (; i < pixelsCount; i++)
+		sum += pixels[i] > basePixels[i] ? pixels[i] - basePixels[i] : basePixels[i] - pixels[i];
+
+	return sum;
+}
+
+}
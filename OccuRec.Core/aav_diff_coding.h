@@ -0,0 +1,45 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef AAV_DIFF_CODING_H
+#define AAV_DIFF_CODING_H
+
+namespace AavLib
+{
+
+// The differences of the diff coded layouts from their base frame. The pixels are only read, and when
+// nextBasePixels is not NULL they are also copied there in the same pass, so a frame which becomes the next base
+// frame is read once. The differences may not overlap the pixels
+
+// The differences of the 8 bit pixels from the base pixels, modulo 256
+void SubtractPixels8(const unsigned char* pixels, const unsigned char* basePixels, unsigned int pixelsCount, unsigned char* differences, unsigned char* nextBasePixels);
+
+// The absolute differences of the 8 bit pixels from the base pixels, with the sign bit of each pixel set when it is
+// not above its base pixel, the first pixel in the lowest bit. Only the pixelsCount / 8 whole bytes of signs are
+// written, and the pixels after them get their differences modulo 256, which are decoded without a sign
+void SubtractPixelsWithSigns8(const unsigned char* pixels, const unsigned char* basePixels, unsigned int pixelsCount, unsigned char* signs, unsigned char* differences, unsigned char* nextBasePixels);
+
+// Adds the differences of SubtractPixelsWithSigns8() to the base pixels. The pixels may be the base pixels
+void AddPixelsWithSigns8(const unsigned char* basePixels, const unsigned char* signs, const unsigned char* differences, unsigned int pixelsCount, unsigned char* pixels);
+
+// The differences of the 16 bit pixels from the base pixels, zigzag coded as 2 * d for d >= 0 and -2 * d - 1 for
+// d < 0 so the small differences of either sign are small words, in little endian words
+void SubtractPixelsZigZag16(const unsigned short* pixels, const unsigned short* basePixels, unsigned int pixelsCount, unsigned char* differences, unsigned short* nextBasePixels);
+
+// Adds the differences of SubtractPixelsZigZag16() to the base pixels. The pixels may be the base pixels
+void AddPixelsZigZag16(const unsigned short* basePixels, const unsigned char* differences, unsigned int pixelsCount, unsigned short* pixels);
+
+// Shifts the image of 1 or 2 byte pixels by dx, dy pixels, so the pixel at x, y moves to x + dx, y + dy. The pixels
+// shifted in at the edges repeat the edge pixels. The shifted pixels may not overlap the pixels
+void ShiftPixels(const unsigned char* pixels, unsigned int width, unsigned int height, unsigned int pixelBytes, int dx, int dy, unsigned char* shiftedPixels);
+
+// The sum of the absolute differences of the 8 bit pixels from the base pixels, for up to 16843009 pixels
+unsigned int SumOfAbsoluteDifferences8(const unsigned char* pixels, const unsigned char* basePixels, unsigned int pixelsCount);
+
+// The sum of the absolute differences of the 16 bit pixels from the base pixels, for up to 65537 pixels
+unsigned int SumOfAbsoluteDifferences16(const unsigned short* pixels, const unsigned short* basePixels, unsigned int pixelsCount);
+
+}
+
+#endif // AAV_DIFF_CODING_H
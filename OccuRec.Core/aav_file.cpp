@@ -2,7 +2,7 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
-#include "StdAfx.h"
+#include "stdafx.h"
 #include "aav_file.h"
 #include <iostream>
 #include <stdlib.h>
@@ -26,10 +26,33 @@ AavFile::AavFile()
 	crc32_init();	
 	
 	m_FrameBytes = NULL;
+	m_WriteBehind = NULL;
+	m_CompressionPipeline = NULL;
+	m_CurrentJob = NULL;
+	m_Journal = NULL;
 }
 
 AavFile::~AavFile()
 {
+	if (NULL != m_CompressionPipeline)
+	{
+		delete m_CompressionPipeline;
+		m_CompressionPipeline = NULL;
+	}
+
+	if (NULL != m_WriteBehind)
+	{
+		delete m_WriteBehind;
+		m_WriteBehind = NULL;
+	}
+
+	// The journal of a file which was not ended is kept for its recovery
+	if (NULL != m_Journal)
+	{
+		fclose(m_Journal);
+		m_Journal = NULL;
+	}
+
 	if (NULL != m_File)
 	{
 		advfclose(m_File);
@@ -54,12 +77,6 @@ AavFile::~AavFile()
 		m_Index = NULL;
 	}
 	
-	if (NULL != m_FrameBytes)
-	{
-		delete m_FrameBytes;
-		m_FrameBytes = NULL;
-	}
-
 	m_UserMetadataTags.clear();
 }
 
@@ -105,6 +122,7 @@ bool AavFile::BeginFile(const char* fileName)
 	advfgetpos64(m_File, &sectionHeaderOffsets[0]);
 	ImageSection->WriteHeader(m_File);
 	advfgetpos64(m_File, &sectionHeaderOffsets[1]);
+	StatusSection->SetSnapshotInterval(g_AavStatusSnapshotInterval);
 	StatusSection->WriteHeader(m_File);
 
 	// Write section headers positions
@@ -143,6 +161,36 @@ bool AavFile::BeginFile(const char* fileName)
     m_Index = new AavLib::AavFramesIndex();	
 	
 	advfflush(m_File);
+
+	m_MaxFrameBytes = 
+		4 + // frame start magic
+		8 + // timestamp
+		4 + // exposure			
+		4 + 4 + // the length of each of the 2 sections 
+		StatusSection->MaxFrameBufferSize +
+		ImageSection->MaxFrameBufferSize() + 
+		100; // Just in case
+
+	// Lets RecoverFile() rebuild the index if the recording is not ended
+	m_JournalFileName = IndexJournalFileName(fileName);
+	m_Journal = fopen(m_JournalFileName.c_str(), "wb");
+	if (NULL != m_Journal)
+	{
+		unsigned int journalMagic = INDEX_JOURNAL_MAGIC;
+		fwrite(&journalMagic, 4, 1, m_Journal);
+		fflush(m_Journal);
+	}
+	else
+		DebugViewPrint(L"AAV: Cannot create the index journal, the file will not be recoverable\n");
+
+	// The frames are written by the write-behind thread from here until EndFile()
+	__int64 firstFrameOffset;
+	advfgetpos64(m_File, &firstFrameOffset);
+	m_WriteBehind = new AavLib::AavWriteBehind(m_File, firstFrameOffset, m_MaxFrameBytes, m_Journal);
+
+	if (g_AavCompressionThreads > 0)
+		m_CompressionPipeline = new AavLib::AavCompressionPipeline(
+			g_AavCompressionThreads, ImageSection->Width, ImageSection->Height, ImageSection->MaxFrameBufferSize(), StatusSection->MaxFrameBufferSize);
 		
 	m_FrameNo = 0;
 	
@@ -153,6 +201,29 @@ bool AavFile::BeginFile(const char* fileName)
 
 void AavFile::EndFile()
 {
+	if (NULL != m_CompressionPipeline)
+	{
+		AavLib::AavCompressionJob* job;
+		while (NULL != (job = m_CompressionPipeline->GetCompressedJob(true)))
+			WriteCompressedFrame(job);
+
+		delete m_CompressionPipeline;
+		m_CompressionPipeline = NULL;
+	}
+
+	if (!m_WriteBehind->Close())
+		DebugViewPrint(L"AAV: Not all frames could be written to the file\n");
+
+	delete m_WriteBehind;
+	m_WriteBehind = NULL;
+	m_FrameBytes = NULL;
+
+	if (NULL != m_Journal)
+	{
+		fclose(m_Journal);
+		m_Journal = NULL;
+	}
+
 	__int64 indexTableOffset;
 	advfgetpos64(m_File, &indexTableOffset);
 	
@@ -189,6 +260,8 @@ void AavFile::EndFile()
 	advfclose(m_File);	
 	
 	m_File = NULL;
+
+	remove(m_JournalFileName.c_str());
 }
 
 void AavFile::AddImageSection(AavLib::AavImageSection* section, int bitPix)
@@ -222,25 +295,30 @@ int AavFile::AddUserTag(const char* tagName, const char* tagValue)
 
 void AavFile::BeginFrame(long long timeStamp, unsigned int elapsedTime, unsigned int exposure)
 {
-	advfgetpos64(m_File, &m_NewFrameOffset);
-
 	m_FrameBufferIndex = 0;
 	
 	m_ElapedTime = elapsedTime;
 		
-	if (m_FrameBytes == NULL)
+	if (NULL != m_CompressionPipeline)
 	{
-		int maxUncompressedBufferSize = 
-			4 + // frame start magic
-			8 + // timestamp
-			4 + // exposure			
-			4 + 4 + // the length of each of the 2 sections 
-			StatusSection->MaxFrameBufferSize +
-			ImageSection->MaxFrameBufferSize() + 
-			100; // Just in case
-		
-		m_FrameBytes = new unsigned char[maxUncompressedBufferSize];
-	};		
+		// The frame is kept in a compression job until all earlier frames have been written
+		while (NULL == (m_CurrentJob = m_CompressionPipeline->BeginJob()))
+			WriteCompressedFrame(m_CompressionPipeline->GetCompressedJob(true));
+
+		m_FrameBytes = m_CurrentJob->FrameBytes;
+	}
+	else
+	{
+		m_NewFrameOffset = m_WriteBehind->GetPosition();
+
+		// The frame is assembled directly in the write buffer
+		unsigned char* frameStart = m_WriteBehind->BeginWrite(m_MaxFrameBytes);
+
+		// Frame start magic
+		unsigned int frameStartMagic = 0xEE0122FF;
+		memcpy(frameStart, &frameStartMagic, 4);
+		m_FrameBytes = frameStart + 4;
+	}
 	
 	// Add the timestamp
 	m_FrameBytes[0] = (unsigned char)(timeStamp & 0xFF);
@@ -299,43 +377,18 @@ void AavFile::AddFrameImage(unsigned char layoutId, unsigned char* pixels)
 	unsigned int imageBytesCount = 0;	
 	char byteMode = 0;
 	m_CurrentImageLayout = ImageSection->GetImageLayoutById(layoutId);
-	unsigned char *imageBytes = ImageSection->GetDataBytes(layoutId, pixels, &imageBytesCount, &byteMode);
-	
-	int imageSectionBytesCount = !m_CurrentImageLayout->IsNoImageLayout ? imageBytesCount + 2 : 2; // +1 byte for the layout id and +1 byte for the byteMode (See few lines below)
-	
-	m_FrameBytes[m_FrameBufferIndex] = imageSectionBytesCount & 0xFF;
-	m_FrameBytes[m_FrameBufferIndex + 1] = (imageSectionBytesCount >> 8) & 0xFF;
-	m_FrameBytes[m_FrameBufferIndex + 2] = (imageSectionBytesCount >> 16) & 0xFF;
-	m_FrameBytes[m_FrameBufferIndex + 3] = (imageSectionBytesCount >> 24) & 0xFF;
-	m_FrameBufferIndex+=4;
-	
-	// It is faster to write the layoutId and byteMode directly here
-	m_FrameBytes[m_FrameBufferIndex] = m_CurrentImageLayout->LayoutId;
-	m_FrameBytes[m_FrameBufferIndex + 1] = byteMode;
-	m_FrameBufferIndex+=2;	
-		
-	if (!m_CurrentImageLayout->IsNoImageLayout)
+
+	if (NULL != m_CompressionPipeline)
 	{
-		memcpy(&m_FrameBytes[m_FrameBufferIndex], &imageBytes[0], imageBytesCount);
-		m_FrameBufferIndex+= imageBytesCount;
+		unsigned char* bytesToCompress = ImageSection->GetBytesToCompress(layoutId, pixels, &imageBytesCount, &byteMode);
+		QueueFrameImage(bytesToCompress, imageBytesCount, byteMode);
+		return;
 	}
 
-	unsigned int statusBytesCount = 0;
-	unsigned char *statusBytes = StatusSection->GetDataBytes(&statusBytesCount);
+	// The image is compressed straight into the frame, after the section length, the layout id and the byteMode
+	ImageSection->GetDataBytes(layoutId, pixels, &m_FrameBytes[m_FrameBufferIndex + 6], &imageBytesCount, &byteMode);
 	
-	m_FrameBytes[m_FrameBufferIndex] = statusBytesCount & 0xFF;
-	m_FrameBytes[m_FrameBufferIndex + 1] = (statusBytesCount >> 8) & 0xFF;
-	m_FrameBytes[m_FrameBufferIndex + 2] = (statusBytesCount >> 16) & 0xFF;
-	m_FrameBytes[m_FrameBufferIndex + 3] = (statusBytesCount >> 24) & 0xFF;
-	m_FrameBufferIndex+=4;
-	
-	if (statusBytesCount > 0)
-	{
-		memcpy(&m_FrameBytes[m_FrameBufferIndex], &statusBytes[0], statusBytesCount);
-		m_FrameBufferIndex+=statusBytesCount;
-
-		delete statusBytes;		
-	}
+	AddFrameSections(imageBytesCount, byteMode, NULL, 0);
 }
 			
 void AavFile::AddFrameImage16(unsigned char layoutId, unsigned short* pixels)
@@ -343,8 +396,36 @@ void AavFile::AddFrameImage16(unsigned char layoutId, unsigned short* pixels)
 	unsigned int imageBytesCount = 0;	
 	char byteMode = 0;
 	m_CurrentImageLayout = ImageSection->GetImageLayoutById(layoutId);
-	unsigned char *imageBytes = ImageSection->GetDataBytes16(layoutId, pixels, &imageBytesCount, &byteMode);
+
+	if (NULL != m_CompressionPipeline)
+	{
+		unsigned char* bytesToCompress = ImageSection->GetBytesToCompress16(layoutId, pixels, &imageBytesCount, &byteMode);
+		QueueFrameImage(bytesToCompress, imageBytesCount, byteMode);
+		return;
+	}
+
+	// The image is compressed straight into the frame, after the section length, the layout id and the byteMode
+	ImageSection->GetDataBytes16(layoutId, pixels, &m_FrameBytes[m_FrameBufferIndex + 6], &imageBytesCount, &byteMode);
 	
+	AddFrameSections(imageBytesCount, byteMode, NULL, 0);
+}
+
+void AavFile::QueueFrameImage(unsigned char* bytesToCompress, unsigned int bytesCount, char byteMode)
+{
+	// The diff corrections are done above in frame order. Only the compression is left to the workers, which
+	// need their own copy of the bytes as the pixels and the diff buffers are reused by the next frame
+	m_CurrentJob->Layout = m_CurrentImageLayout;
+	m_CurrentJob->ByteMode = byteMode;
+	m_CurrentJob->BytesToCompressCount = NULL != bytesToCompress ? bytesCount : 0;
+	if (NULL != bytesToCompress)
+		memcpy(m_CurrentJob->BytesToCompress, bytesToCompress, m_CurrentImageLayout->BytesReadByCompressor(bytesCount));
+
+	m_CurrentJob->StatusBytesCount = 0;
+	StatusSection->GetDataBytes(m_CurrentJob->StatusBytes, &m_CurrentJob->StatusBytesCount);
+}
+
+void AavFile::AddFrameSections(unsigned int imageBytesCount, char byteMode, unsigned char* statusBytes, unsigned int statusBytesCount)
+{
 	int imageSectionBytesCount = !m_CurrentImageLayout->IsNoImageLayout ? imageBytesCount + 2 : 2; // +1 byte for the layout id and +1 byte for the byteMode (See few lines below)
 	
 	m_FrameBytes[m_FrameBufferIndex] = imageSectionBytesCount & 0xFF;
@@ -359,45 +440,82 @@ void AavFile::AddFrameImage16(unsigned char layoutId, unsigned short* pixels)
 	m_FrameBufferIndex+=2;	
 		
 	if (!m_CurrentImageLayout->IsNoImageLayout)
-	{
-		memcpy(&m_FrameBytes[m_FrameBufferIndex], &imageBytes[0], imageBytesCount);
 		m_FrameBufferIndex+= imageBytesCount;
-	}
 
-	unsigned int statusBytesCount = 0;
-	unsigned char *statusBytes = StatusSection->GetDataBytes(&statusBytesCount);
+	// The status bytes are also written straight into the frame, after their length, unless already serialized
+	if (NULL != statusBytes)
+		memcpy(&m_FrameBytes[m_FrameBufferIndex + 4], statusBytes, statusBytesCount);
+	else
+		StatusSection->GetDataBytes(&m_FrameBytes[m_FrameBufferIndex + 4], &statusBytesCount);
 	
 	m_FrameBytes[m_FrameBufferIndex] = statusBytesCount & 0xFF;
 	m_FrameBytes[m_FrameBufferIndex + 1] = (statusBytesCount >> 8) & 0xFF;
 	m_FrameBytes[m_FrameBufferIndex + 2] = (statusBytesCount >> 16) & 0xFF;
 	m_FrameBytes[m_FrameBufferIndex + 3] = (statusBytesCount >> 24) & 0xFF;
 	m_FrameBufferIndex+=4;
-	
-	if (statusBytesCount > 0)
+	m_FrameBufferIndex+=statusBytesCount;
+}
+
+void AavFile::EndFrame()
+{	
+	if (NULL != m_CompressionPipeline)
 	{
-		memcpy(&m_FrameBytes[m_FrameBufferIndex], &statusBytes[0], statusBytesCount);
-		m_FrameBufferIndex+=statusBytesCount;
+		m_CurrentJob->ElapsedTime = m_ElapedTime;
+		m_CompressionPipeline->SubmitJob(m_CurrentJob);
+		m_CurrentJob = NULL;
 
-		delete statusBytes;		
+		// Writes the frames compressed so far without waiting for the rest
+		AavLib::AavCompressionJob* job;
+		while (NULL != (job = m_CompressionPipeline->GetCompressedJob(false)))
+			WriteCompressedFrame(job);
+
+		return;
 	}
+
+	CompleteFrame(m_ElapedTime, m_NewFrameOffset);
 }
 
-void AavFile::EndFrame()
-{	
-	__int64 frameOffset;
-	advfgetpos64(m_File, &frameOffset);
-		
-	// Frame start magic
-	unsigned int frameStartMagic = 0xEE0122FF;
-	advfwrite(&frameStartMagic, 4, 1, m_File);	
-	
-	advfwrite(m_FrameBytes, m_FrameBufferIndex, 1, m_File);
+void AavFile::CompleteFrame(unsigned int elapsedTime, __int64 frameOffset)
+{
+	unsigned char entryBytes[INDEX_ENTRY_BYTES];
+	GetIndexEntryBytes(entryBytes, elapsedTime, frameOffset, m_FrameBufferIndex);
+	m_WriteBehind->AddJournalEntry(entryBytes, INDEX_ENTRY_BYTES);
+
+	m_WriteBehind->EndWrite(4 + m_FrameBufferIndex);
+
+	// The timestamp starts the frame and the byte mode follows the exposure, the image section length and the layout id
+	long long timeStamp;
+	memcpy(&timeStamp, m_FrameBytes, 8);
+	bool isKeyFrame = m_FrameBytes[12 + 4 + 1] != DiffCorrBytes;
 		
-	m_Index->AddFrame(m_FrameNo, m_ElapedTime, frameOffset, m_FrameBufferIndex);
-	
-	advfflush(m_File);
+	m_Index->AddFrame(m_FrameNo, elapsedTime, frameOffset, m_FrameBufferIndex, timeStamp, isKeyFrame);
 	
 	m_FrameNo++;
 }
 
+void AavFile::WriteCompressedFrame(AavLib::AavCompressionJob* job)
+{
+	__int64 frameOffset = m_WriteBehind->GetPosition();
+	unsigned char* frameStart = m_WriteBehind->BeginWrite(m_MaxFrameBytes);
+
+	// Frame start magic
+	unsigned int frameStartMagic = 0xEE0122FF;
+	memcpy(frameStart, &frameStartMagic, 4);
+	m_FrameBytes = frameStart + 4;
+
+	// The timestamp and the exposure
+	memcpy(m_FrameBytes, job->FrameBytes, 12);
+	m_FrameBufferIndex = 12;
+
+	m_CurrentImageLayout = job->Layout;
+	if (!m_CurrentImageLayout->IsNoImageLayout)
+		memcpy(&m_FrameBytes[m_FrameBufferIndex + 6], job->ImageBytes, job->ImageBytesCount);
+
+	AddFrameSections(job->ImageBytesCount, job->ByteMode, job->StatusBytes, job->StatusBytesCount);
+
+	CompleteFrame(job->ElapsedTime, frameOffset);
+
+	m_CompressionPipeline->RetireJob(job);
+}
+
 }
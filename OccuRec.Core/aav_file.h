@@ -9,6 +9,8 @@
 #include "aav_image_section.h"
 #include "aav_status_section.h"
 #include "aav_frames_index.h"
+#include "aav_write_behind.h"
+#include "aav_compression_pipeline.h"
 
 #include <map>
 #include <string>
@@ -35,13 +37,26 @@ namespace AavLib
 			__int64 m_NewFrameOffset;
 			unsigned int m_FrameNo;
 
+			// Points into the write buffer, after the frame start magic
 			unsigned char *m_FrameBytes;
+			unsigned int m_MaxFrameBytes;
+			AavLib::AavWriteBehind* m_WriteBehind;
+			// The index journal, removed once the index is written by EndFile()
+			FILE* m_Journal;
+			string m_JournalFileName;
+			// Compresses the images on worker threads when g_AavCompressionThreads > 0
+			AavLib::AavCompressionPipeline* m_CompressionPipeline;
+			AavLib::AavCompressionJob* m_CurrentJob;
 			unsigned int m_FrameBufferIndex; 
 			unsigned int m_ElapedTime;
 
 			map<const char*, string> m_UserMetadataTags;
 						
 			void InitFileState();
+			void AddFrameSections(unsigned int imageBytesCount, char byteMode, unsigned char* statusBytes, unsigned int statusBytesCount);
+			void QueueFrameImage(unsigned char* bytesToCompress, unsigned int bytesCount, char byteMode);
+			void WriteCompressedFrame(AavLib::AavCompressionJob* job);
+			void CompleteFrame(unsigned int elapsedTime, __int64 frameOffset);
 		public:
 			AavFile();
 			~AavFile();
@@ -2,53 +2,146 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
-#include "StdAfx.h"
+#include "stdafx.h"
 
 #include "aav_frames_index.h"
 #include "stdio.h"
+#include <stdlib.h>
+#include <string.h>
 
 namespace AavLib
 {
+
+string IndexJournalFileName(const char* fileName)
+{
+	return string(fileName) + ".idx";
+}
+
+void GetIndexEntryBytes(unsigned char* entryBytes, unsigned int elapedTime, __int64 frameOffset, unsigned int bytesCount)
+{
+	memcpy(entryBytes, &elapedTime, 4);
+	memcpy(entryBytes + 4, &frameOffset, 8);
+	memcpy(entryBytes + 12, &bytesCount, 4);
+}
 	
+// A power of two, so the chunk of a frame is found with a shift
+#define INDEX_CHUNK_FRAMES_BITS 14
+#define INDEX_CHUNK_FRAMES (1 << INDEX_CHUNK_FRAMES_BITS)
+#define INDEX_CHUNK_FRAMES_MASK (INDEX_CHUNK_FRAMES - 1)
+#define INDEX_CHUNK_KEY_FRAME_BYTES (INDEX_CHUNK_FRAMES / 8)
+
 AavFramesIndex::AavFramesIndex()
 {
-	m_IndexEntries = new vector<IndexEntry*>();
+	m_FramesCount = 0;
+
+	// The first chunk is allocated up front, so short recordings never allocate while recording
+	m_EntryChunks.push_back((unsigned char*)malloc(INDEX_CHUNK_FRAMES * INDEX_ENTRY_BYTES));
+	m_TimeStampChunks.push_back((long long*)malloc(INDEX_CHUNK_FRAMES * sizeof(long long)));
+	m_KeyFrameChunks.push_back((unsigned char*)calloc(INDEX_CHUNK_KEY_FRAME_BYTES, 1));
 }
 
 AavFramesIndex::~AavFramesIndex()
 {
-	m_IndexEntries->clear();
-	delete m_IndexEntries;
+	for (unsigned int i = 0; i < m_EntryChunks.size(); i++)
+	{
+		free(m_EntryChunks[i]);
+		free(m_TimeStampChunks[i]);
+		free(m_KeyFrameChunks[i]);
+	}
+
+	m_EntryChunks.clear();
+	m_TimeStampChunks.clear();
+	m_KeyFrameChunks.clear();
 }
 
-void AavFramesIndex::AddFrame(unsigned int frameNo, unsigned int elapedTime, __int64 frameOffset, unsigned int  bytesCount)
+void AavFramesIndex::AddFrame(unsigned int frameNo, unsigned int elapedTime, __int64 frameOffset, unsigned int  bytesCount, long long timeStamp, bool isKeyFrame)
 {
-	IndexEntry *entry = new IndexEntry();
-	entry->BytesCount = bytesCount;
-	entry->FrameOffset = frameOffset;
-	entry->ElapsedTime = elapedTime;
-	
-	m_IndexEntries->push_back(entry);
+	unsigned int chunk = m_FramesCount >> INDEX_CHUNK_FRAMES_BITS;
+	unsigned int entry = m_FramesCount & INDEX_CHUNK_FRAMES_MASK;
+
+	if (chunk == m_EntryChunks.size())
+	{
+		m_EntryChunks.push_back((unsigned char*)malloc(INDEX_CHUNK_FRAMES * INDEX_ENTRY_BYTES));
+		m_TimeStampChunks.push_back((long long*)malloc(INDEX_CHUNK_FRAMES * sizeof(long long)));
+		m_KeyFrameChunks.push_back((unsigned char*)calloc(INDEX_CHUNK_KEY_FRAME_BYTES, 1));
+	}
+
+	GetIndexEntryBytes(m_EntryChunks[chunk] + entry * INDEX_ENTRY_BYTES, elapedTime, frameOffset, bytesCount);
+	m_TimeStampChunks[chunk][entry] = timeStamp;
+	if (isKeyFrame)
+		m_KeyFrameChunks[chunk][entry >> 3] |= (unsigned char)(1 << (entry & 7));
+
+	m_FramesCount++;
 }
 
 void AavFramesIndex::WriteIndex(FILE *pFile)
 {
-	unsigned int framesCount = m_IndexEntries->size();
-	fwrite(&framesCount, 4, 1, pFile);
+	fwrite(&m_FramesCount, 4, 1, pFile);
+
+	for (unsigned int chunk = 0; chunk < m_EntryChunks.size(); chunk++)
+	{
+		unsigned int framesInChunk = min(m_FramesCount - chunk * INDEX_CHUNK_FRAMES, (unsigned int)INDEX_CHUNK_FRAMES);
+		if (framesInChunk == 0)
+			break;
+
+		fwrite(m_EntryChunks[chunk], INDEX_ENTRY_BYTES, framesInChunk, pFile);
+	}
+
+	unsigned int keyFramesMagic = KEY_FRAMES_TABLE_MAGIC;
+	fwrite(&keyFramesMagic, 4, 1, pFile);
+	fwrite(&m_FramesCount, 4, 1, pFile);
+
+	// The chunks hold a multiple of 8 frames, so their bits follow each other
+	for (unsigned int chunk = 0; chunk < m_KeyFrameChunks.size(); chunk++)
+	{
+		unsigned int framesInChunk = min(m_FramesCount - chunk * INDEX_CHUNK_FRAMES, (unsigned int)INDEX_CHUNK_FRAMES);
+		if (framesInChunk == 0)
+			break;
+
+		fwrite(m_KeyFrameChunks[chunk], 1, (framesInChunk + 7) / 8, pFile);
+	}
+}
+
+unsigned int AavFramesIndex::GetFramesCount()
+{
+	return m_FramesCount;
+}
+
+bool AavFramesIndex::GetFrame(unsigned int frameNo, unsigned int* elapedTime, __int64* frameOffset, unsigned int* bytesCount)
+{
+	if (frameNo >= m_FramesCount)
+		return false;
 
-	vector<IndexEntry*>::iterator curr = m_IndexEntries->begin();
-	while (curr != m_IndexEntries->end()) 
+	unsigned char* entryBytes = m_EntryChunks[frameNo >> INDEX_CHUNK_FRAMES_BITS] + (frameNo & INDEX_CHUNK_FRAMES_MASK) * INDEX_ENTRY_BYTES;
+	memcpy(elapedTime, entryBytes, 4);
+	memcpy(frameOffset, entryBytes + 4, 8);
+	memcpy(bytesCount, entryBytes + 12, 4);
+
+	return true;
+}
+
+long long AavFramesIndex::GetTimeStamp(unsigned int frameNo)
+{
+	return m_TimeStampChunks[frameNo >> INDEX_CHUNK_FRAMES_BITS][frameNo & INDEX_CHUNK_FRAMES_MASK];
+}
+
+int AavFramesIndex::FindFrame(long long timeStamp)
+{
+	// The frames are recorded in time order
+	unsigned int first = 0;
+	unsigned int last = m_FramesCount;
+
+	while (first < last)
 	{
-		unsigned int elapedTime = (*curr)->ElapsedTime;
-		__int64 frameOffset = (*curr)->FrameOffset;
-		unsigned int  bytesCount = (*curr)->BytesCount;
-		
-		fwrite(&elapedTime, 4, 1, pFile);
-		fwrite(&frameOffset, 8, 1, pFile);
-		fwrite(&bytesCount, 4, 1, pFile);
-		
-		curr++;
+		unsigned int middle = first + (last - first) / 2;
+
+		if (GetTimeStamp(middle) <= timeStamp)
+			first = middle + 1;
+		else
+			last = middle;
 	}
+
+	return (int)first - 1;
 }
 
 }
@@ -6,32 +6,52 @@
 #define ADVFRAMESINDEX_H
 
 #include <vector>
+#include <string>
 #include <stdio.h>
 
 using namespace std;
 
 namespace AavLib
 {
-		
-class IndexEntry
-{
-	public:
-		unsigned int ElapsedTime;
-		__int64 FrameOffset;
-		unsigned int  BytesCount;
-};
 
+// Entries of the index table, and of the index journal kept while recording: elapsed time (4), offset (8), bytes (4)
+#define INDEX_ENTRY_BYTES 16
+#define INDEX_JOURNAL_MAGIC 0x4A564141
+
+// The key frames table follows the index table: the magic, the number of frames (4) and a bit for each frame, set for
+// the key frames, which are decoded without a base frame. The readers of the index table skip it, as they find the
+// user metadata table by its offset
+#define KEY_FRAMES_TABLE_MAGIC 0x4B564141
+
+// The sidecar file with the index journal of a file being recorded
+string IndexJournalFileName(const char* fileName);
+void GetIndexEntryBytes(unsigned char* entryBytes, unsigned int elapedTime, __int64 frameOffset, unsigned int bytesCount);
+
+// The entries are kept in chunks, in the layout of the index table, so adding a frame never allocates memory
+// or moves the earlier entries and the table is written with one write per chunk. The timestamps of the frames
+// are kept in their own arrays for the lookups by time, and the key frame bits in the layout of the key frames table
 class AavFramesIndex {
 
 	private:
-		vector<IndexEntry*>* m_IndexEntries;
+		vector<unsigned char*> m_EntryChunks;
+		vector<long long*> m_TimeStampChunks;
+		vector<unsigned char*> m_KeyFrameChunks;
+		unsigned int m_FramesCount;
+
+		long long GetTimeStamp(unsigned int frameNo);
 	
 	public:
 		AavFramesIndex();
 		~AavFramesIndex();
 
-		void AddFrame(unsigned int frameNo, unsigned int elapedTime, __int64 frameOffset, unsigned int  bytesCount);
+		void AddFrame(unsigned int frameNo, unsigned int elapedTime, __int64 frameOffset, unsigned int  bytesCount, long long timeStamp, bool isKeyFrame);
 		void WriteIndex(FILE *file);
+
+		unsigned int GetFramesCount();
+		bool GetFrame(unsigned int frameNo, unsigned int* elapedTime, __int64* frameOffset, unsigned int* bytesCount);
+
+		// The last frame with a timestamp at or before timeStamp, or -1 if all frames are later
+		int FindFrame(long long timeStamp);
 };
 
 }
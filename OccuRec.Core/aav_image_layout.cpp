@@ -2,10 +2,15 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
-#include "StdAfx.h"
+#include "stdafx.h"
 
 #include "aav_image_layout.h"
 #include "utils.h"
+#include "crc32c.h"
+#include "aav_bit_packing.h"
+#include "aav_diff_coding.h"
+#include "aav_tiles.h"
+#include "aav_compression_pipeline.h"
 #include "stdlib.h"
 #include "math.h"
 #include <stdio.h>
@@ -18,6 +23,11 @@ namespace AavLib
 {
 
 bool m_UsesCompression;
+
+unsigned int g_AavLagarith16TablesKeyFrame = 0;
+unsigned int g_AavSceneChangeThreshold = 0;
+unsigned int g_AavTileSize = 0;
+bool g_AavPixelsCrc = true;
 	
 AavImageLayout::AavImageLayout(unsigned int width, unsigned int height, unsigned char bitPix, unsigned char layoutId, const char* layoutType, const char* compression, int keyFrame)
 {	
@@ -28,57 +38,120 @@ AavImageLayout::AavImageLayout(unsigned int width, unsigned int height, unsigned
 	KeyFrame = keyFrame;
 	IsDiffCorrLayout = false;
 	IsNoImageLayout = false;
-	
-	SIGNS_MASK = new unsigned char(8);
-	SIGNS_MASK[0] = 0x01;
-	SIGNS_MASK[1] = 0x02;
-	SIGNS_MASK[2] = 0x04;
-	SIGNS_MASK[3] = 0x08;
-	SIGNS_MASK[4] = 0x10;
-	SIGNS_MASK[5] = 0x20;
-	SIGNS_MASK[6] = 0x40;
-	SIGNS_MASK[7] = 0x80;
+	IsRegionsOfInterestLayout = false;
+	m_MotionVectorBytes = 0;
+	m_RegionsCount = 0;
 	
 	MaxFrameBufferSize = Width * Height * 4 + 1 + 4 + + 16; //NOTE: The buufer is for 32bit data!! should be Width * Height rather than Width * Height * 4
 
+	// The images are compressed directly into the frame buffer, which must also fit the output of the Lagarith16 compressor,
+	// the byte telling whether it reuses the tables and the CRC of the pixels
+	MaxFrameBufferSize = max(MaxFrameBufferSize, (int)(Width * Height * sizeof(unsigned short)) + 0x20000 + 1 + 4);
+
 	AddOrUpdateTag("DATA-LAYOUT", layoutType);
+
+	// The crops of the regions are not the Width * Height words which Lagarith16 codes
+	if (IsRegionsOfInterestLayout && 0 == strcmp(compression, "LAGARITH16"))
+		compression = "QUICKLZ";
+
 	AddOrUpdateTag("SECTION-DATA-COMPRESSION", compression);	
 
 	Compression = new char[strlen(compression) + 1];
 	strcpy(const_cast<char*>(Compression), compression);
 	m_UsesCompression = 0 != strcmp(compression, "UNCOMPRESSED");
+
+	// The workers compress the frames out of order, so the tables can only be reused on the recording thread
+	m_Lagarith16TablesKeyFrame = 0 == strcmp(compression, "LAGARITH16") && g_AavCompressionThreads == 0 ? g_AavLagarith16TablesKeyFrame : 0;
+	m_Lagarith16FramesCount = 0;
+	if (0 == strcmp(compression, "LAGARITH16") && g_AavCompressionThreads > 0 && g_AavLagarith16TablesKeyFrame > 0)
+		DebugViewPrint(L"AAV: The Lagarith16 tables are not reused when the images are compressed by worker threads\n");
+	if (m_Lagarith16TablesKeyFrame > 0)
+	{
+		char tablesKeyFrameStr [12];
+		snprintf(tablesKeyFrameStr, 12, "%u", m_Lagarith16TablesKeyFrame);
+		AddOrUpdateTag("LAGARITH16-TABLES-KEY-FRAME", tablesKeyFrameStr);
+	}
 	
 	if (keyFrame > 0)
 	{
-		char keyFrameStr [5];
-		snprintf(keyFrameStr, 5, "%d", keyFrame);
+		char keyFrameStr [12];
+		snprintf(keyFrameStr, 12, "%d", keyFrame);
 		AddOrUpdateTag("DIFFCODE-KEY-FRAME-FREQUENCY", keyFrameStr);		
 		AddOrUpdateTag("DIFFCODE-BASE-FRAME", "KEY-FRAME");		
 	}
+
+	m_HasKeyFrame = false;
+	m_FramesSinceKeyFrame = 0;
+	m_SceneChangeThreshold = IsDiffCorrLayout ? g_AavSceneChangeThreshold : 0;
+	if (m_SceneChangeThreshold > 0)
+	{
+		char thresholdStr [12];
+		snprintf(thresholdStr, 12, "%u", m_SceneChangeThreshold);
+		AddOrUpdateTag("DIFFCODE-SCENE-CHANGE-THRESHOLD", thresholdStr);
+	}
+
+	m_TileSize = 0;
+	if (m_BytesLayout == FullImageTiled)
+	{
+		m_TileSize = g_AavTileSize > 0 ? g_AavTileSize : AAV_DEFAULT_TILE_SIZE;
+
+		char tileSizeStr [12];
+		snprintf(tileSizeStr, 12, "%u", m_TileSize);
+		AddOrUpdateTag("TILE-SIZE", tileSizeStr);
+
+		// The tiles table, with the end and the CRC of each tile, and each tile compressed, or stored as it is when it
+		// does not compress
+		unsigned int pixelBytes = m_BitPix > 8 ? 2 : 1;
+		unsigned int tilesCount = TilesCount(Width, Height, m_TileSize);
+		int tilesBufferSize = 8 * tilesCount;
+		for (unsigned int i = 0; i < tilesCount; i++)
+		{
+			AavTile tile;
+			GetTile(Width, Height, m_TileSize, i, &tile);
+
+			unsigned int samplesCount = tile.Width * tile.Height;
+			unsigned int maxTileBytes = samplesCount * pixelBytes + 400;
+			maxTileBytes = max(maxTileBytes, LocoICompressor::MaxCompressedBytes(samplesCount, 8 * pixelBytes));
+			maxTileBytes = max(maxTileBytes, (unsigned int)Lagarith8Compressor::MaxCompressedBytes(samplesCount * pixelBytes));
+			tilesBufferSize += maxTileBytes;
+		}
+
+		MaxFrameBufferSize = max(MaxFrameBufferSize, tilesBufferSize);
+	}
+
+	m_UsesPixelsCrc = g_AavPixelsCrc && !IsNoImageLayout;
+	m_StoresPixelsCrcUncompressed = m_UsesPixelsCrc && (m_BytesLayout == FullImageRaw || (IsDiffCorrLayout && m_BitPix > 8));
+	if (m_UsesPixelsCrc)
+		AddOrUpdateTag("SECTION-DATA-REDUNDANCY-CHECK", "CRC32C");
 	
 	m_MaxSignsBytesCount = (unsigned int)ceil(Width * Height / 8.0) + 1;
 	
 	m_MaxPixelArrayLengthWithoutSigns = 1 + 4 + 2 * Width * Height;
 		
-	m_KeyFrameBytesCount = Width * Height * sizeof(unsigned char);
+	m_KeyFrameBytesCount = Width * Height * (m_BitPix > 8 ? sizeof(unsigned short) : sizeof(unsigned char));
 	
 	m_PrevFramePixels = NULL;
 	m_PrevFramePixelsTemp = NULL;
 	m_PixelArrayBuffer = NULL;
-	m_CompressedPixels = NULL;	
 	m_StateCompress = NULL;
 	
-	m_PixelArrayBuffer = (unsigned char*)malloc(m_MaxPixelArrayLengthWithoutSigns + m_MaxSignsBytesCount);
+	m_PixelArrayBuffer = (unsigned char*)malloc(AAV_MOTION_VECTOR_BYTES + AAV_REGIONS_TABLE_BYTES + m_MaxPixelArrayLengthWithoutSigns + m_MaxSignsBytesCount);
 	m_PrevFramePixels = (unsigned char*)malloc(m_KeyFrameBytesCount);		
 	memset(m_PrevFramePixels, 0, m_KeyFrameBytesCount);
 	
-	m_SignsBytes = (unsigned char*)malloc(m_MaxSignsBytesCount);
-	
 	m_PrevFramePixelsTemp = (unsigned char*)malloc(m_KeyFrameBytesCount);	
-	m_CompressedPixels = (char*)malloc(m_MaxPixelArrayLengthWithoutSigns + m_MaxSignsBytesCount + 401);
+
+	m_HasFramePosition = false;
+	m_HasBasePosition = false;
+	m_MotionX = 0;
+	m_MotionY = 0;
+	m_ShiftedBasePixels = NULL;
+	m_IsBaseShifted = false;
 	
 	m_StateCompress = (qlz_state_compress *)malloc(sizeof(qlz_state_compress));
 	m_Lagarith16Compressor = new Compressor(Width, Height);
+	m_LocoICompressor = new LocoICompressor(Width);
+	m_Lagarith8Compressor = new Lagarith8Compressor(Width);
 }
 
 AavImageLayout::~AavImageLayout()
@@ -87,6 +160,12 @@ AavImageLayout::~AavImageLayout()
 
 	delete m_Lagarith16Compressor;
 	m_Lagarith16Compressor = NULL;
+
+	delete m_LocoICompressor;
+	m_LocoICompressor = NULL;
+
+	delete m_Lagarith8Compressor;
+	m_Lagarith8Compressor = NULL;
 }
 
 void AavImageLayout::ResetBuffers()
@@ -100,27 +179,153 @@ void AavImageLayout::ResetBuffers()
 	if (NULL != m_PixelArrayBuffer)
 		delete m_PixelArrayBuffer;
 
-	if (NULL != m_CompressedPixels)
-		delete m_CompressedPixels;
-	
 	if (NULL != m_StateCompress)
 		delete m_StateCompress;	
-	
-	if (NULL != m_SignsBytes)
-		delete m_SignsBytes;
+
+	free(m_ShiftedBasePixels);
 
 	m_PrevFramePixels = NULL;
 	m_PrevFramePixelsTemp = NULL;
 	m_PixelArrayBuffer = NULL;
-	m_CompressedPixels = NULL;	
 	m_StateCompress = NULL;
-	m_SignsBytes = NULL;
+	m_ShiftedBasePixels = NULL;
 }
 
 
 void AavImageLayout::StartNewDiffCorrSequence()
 {
-   //TODO: Reset the prev frame buffer (do we need to do anything??)
+	// The base frame is from before the frames of the other layouts, so the sequence starts with a key frame
+	m_HasKeyFrame = false;
+	m_HasBasePosition = false;
+}
+
+void AavImageLayout::SetTrackedPosition(bool isLocated, double x, double y)
+{
+	m_HasFramePosition = isLocated;
+	m_FrameX = x;
+	m_FrameY = y;
+}
+
+void AavImageLayout::SetRegionsOfInterest(unsigned int regionsCount, const unsigned int* regions)
+{
+	unsigned int pixelsCount = 0;
+	m_RegionsCount = 0;
+
+	for (unsigned int i = 0; i < regionsCount && m_RegionsCount < AAV_MAX_REGIONS_OF_INTEREST; i++)
+	{
+		AavTile* region = &m_Regions[m_RegionsCount];
+		region->X = regions[4 * i];
+		region->Y = regions[4 * i + 1];
+		if (region->X >= Width || region->Y >= Height)
+			continue;
+
+		region->Width = regions[4 * i + 2] < Width - region->X ? regions[4 * i + 2] : Width - region->X;
+		region->Height = regions[4 * i + 3] < Height - region->Y ? regions[4 * i + 3] : Height - region->Y;
+		region->FirstPixel = pixelsCount;
+
+		unsigned int regionPixels = region->Width * region->Height;
+		if (regionPixels == 0 || regionPixels > Width * Height - pixelsCount)
+			continue;
+
+		pixelsCount += regionPixels;
+		m_RegionsCount++;
+	}
+}
+
+// The offset of the tracked object from its position in the base frame, rounded to whole pixels. A frame without a
+// located object, or with an offset too large to be a drift, is not shifted
+void AavImageLayout::PrepareMotionCompensation()
+{
+	m_MotionX = 0;
+	m_MotionY = 0;
+	m_IsBaseShifted = false;
+
+	if (m_MotionVectorBytes == 0 || !m_HasFramePosition || !m_HasBasePosition)
+		return;
+
+	int motionX = (int)floor(m_FrameX - m_BaseX + 0.5);
+	int motionY = (int)floor(m_FrameY - m_BaseY + 0.5);
+	if (abs(motionX) <= AAV_MAX_MOTION_OFFSET && abs(motionY) <= AAV_MAX_MOTION_OFFSET)
+	{
+		m_MotionX = motionX;
+		m_MotionY = motionY;
+	}
+}
+
+// The base frame shifted by the motion vector of the frame. It is shifted once per frame, when it is first needed
+const unsigned char* AavImageLayout::MotionCompensatedBaseFrame()
+{
+	if (m_MotionX == 0 && m_MotionY == 0)
+		return m_PrevFramePixels;
+
+	if (!m_IsBaseShifted)
+	{
+		if (NULL == m_ShiftedBasePixels)
+			m_ShiftedBasePixels = (unsigned char*)malloc(m_KeyFrameBytesCount);
+
+		ShiftPixels(m_PrevFramePixels, Width, Height, m_BitPix > 8 ? 2 : 1, m_MotionX, m_MotionY, m_ShiftedBasePixels);
+		m_IsBaseShifted = true;
+	}
+
+	return m_ShiftedBasePixels;
+}
+
+// The motion vector before the bytes of the frame, which is 0, 0 for the key frames
+void AavImageLayout::WriteMotionVector(enum GetByteMode mode)
+{
+	if (m_MotionVectorBytes == 0)
+		return;
+
+	short motionX = mode == DiffCorrBytes ? (short)m_MotionX : 0;
+	short motionY = mode == DiffCorrBytes ? (short)m_MotionY : 0;
+
+	m_PixelArrayBuffer[0] = (unsigned char)(motionX & 0xFF);
+	m_PixelArrayBuffer[1] = (unsigned char)((motionX >> 8) & 0xFF);
+	m_PixelArrayBuffer[2] = (unsigned char)(motionY & 0xFF);
+	m_PixelArrayBuffer[3] = (unsigned char)((motionY >> 8) & 0xFF);
+}
+
+// The frame is compared with the frame its differences would be taken from. The rows are summed until the
+// threshold is crossed, so a frame of a new scene is rejected early
+bool AavImageLayout::IsSceneChange(unsigned char* currFramePixels)
+{
+	unsigned int pixelsCount = Width * Height;
+	unsigned long long maxDifference = (unsigned long long)m_SceneChangeThreshold * pixelsCount;
+	unsigned long long difference = 0;
+	const unsigned char* basePixels = MotionCompensatedBaseFrame();
+
+	for (unsigned int y = 0; y < Height; y++)
+	{
+		if (m_BitPix > 8)
+			difference += SumOfAbsoluteDifferences16((const unsigned short*)currFramePixels + y * Width, (const unsigned short*)basePixels + y * Width, Width);
+		else
+			difference += SumOfAbsoluteDifferences8(currFramePixels + y * Width, basePixels + y * Width, Width);
+
+		if (difference > maxDifference)
+			return true;
+	}
+
+	return false;
+}
+
+enum GetByteMode AavImageLayout::NextDiffCorrByteMode(unsigned char* currFramePixels)
+{
+	PrepareMotionCompensation();
+
+	bool isKeyFrame =
+		!m_HasKeyFrame ||
+		(KeyFrame > 0 && m_FramesSinceKeyFrame >= KeyFrame) ||
+		(m_SceneChangeThreshold > 0 && NULL != currFramePixels && IsSceneChange(currFramePixels));
+
+	if (isKeyFrame)
+	{
+		m_HasKeyFrame = true;
+		m_FramesSinceKeyFrame = 1;
+		return KeyFrameBytes;
+	}
+
+	m_FramesSinceKeyFrame++;
+	return DiffCorrBytes;
 }
 
 void AavImageLayout::AddOrUpdateTag(const char* tagName, const char* tagValue)
@@ -158,9 +363,19 @@ void AavImageLayout::AddOrUpdateTag(const char* tagName, const char* tagValue)
 		m_BytesLayout = FullImageRaw;
 		if (0 == strcmp("FULL-IMAGE-DIFFERENTIAL-CODING", tagValue)) m_BytesLayout = FullImageDiffCorrWithSigns;
 		if (0 == strcmp("FULL-IMAGE-DIFFERENTIAL-CODING-NOSIGNS", tagValue)) m_BytesLayout = FullImageDiffCorrNoSigns;
+		if (0 == strcmp("FULL-IMAGE-BIT-PACKED", tagValue)) m_BytesLayout = FullImageBitPacked;
+		if (0 == strcmp("FULL-IMAGE-TILED", tagValue)) m_BytesLayout = FullImageTiled;
+		if (0 == strcmp("REGIONS-OF-INTEREST", tagValue)) m_BytesLayout = RegionsOfInterest;
 		IsDiffCorrLayout = m_BytesLayout == FullImageDiffCorrWithSigns || m_BytesLayout == FullImageDiffCorrNoSigns;
+		IsRegionsOfInterestLayout = m_BytesLayout == RegionsOfInterest;
 		if (0 == strcmp("STATUS-CHANNEL-ONLY", tagValue)) IsNoImageLayout = true;
 	}	
+
+	if (0 == strcmp("DIFFCODE-MOTION-COMPENSATION", tagName) && IsDiffCorrLayout && m_MotionVectorBytes == 0)
+	{
+		m_MotionVectorBytes = AAV_MOTION_VECTOR_BYTES;
+		MaxFrameBufferSize += AAV_MOTION_VECTOR_BYTES;
+	}
 }
 
 
@@ -299,91 +514,166 @@ unsigned int WordSignMask(int bit)
 }
 
 
-unsigned char* AavImageLayout::GetDataBytes16(unsigned short* currFramePixels, enum GetByteMode mode, unsigned int *bytesCount)
+unsigned char* AavImageLayout::GetBytesToCompress16(unsigned short* currFramePixels, enum GetByteMode mode, unsigned int *bytesCount)
 {
-	unsigned char* bytesToCompress;
-	
 	if (m_BytesLayout == FullImageRaw)
 	{
-		bytesToCompress = GetFullImageRawDataBytes16(currFramePixels, bytesCount);
-
-		if (0 == strcmp(Compression, "QUICKLZ"))
-		{
-			unsigned int frameSize = 0;
-
-			// compress and write result 
-			size_t len2 = qlz_compress(bytesToCompress, m_CompressedPixels, *bytesCount, m_StateCompress); 		
-
-	#if _DEBUG
-			DebugViewPrint(L"Compressed to %d %%\r\n",  100 * len2 / *bytesCount);
-	#endif
-			*bytesCount = len2;
-		
-			return (unsigned char*)(m_CompressedPixels);
-		}
-		else if (0 == strcmp(Compression, "LAGARITH16"))
-		{
-			*bytesCount = m_Lagarith16Compressor->CompressData((unsigned short*)bytesToCompress, m_CompressedPixels);
-
-			return (unsigned char*)(m_CompressedPixels);
-		}
-		else if (0 == strcmp(Compression, "UNCOMPRESSED"))
-		{
-			return bytesToCompress;
-		}
+		// The pixels are compressed straight from the caller's buffer
+		*bytesCount = Width * Height * 2 /* 2x 8 bit */;
+		return (unsigned char*)currFramePixels;
 	}
-		
+	else if (m_BytesLayout == FullImageBitPacked)
+	{
+		return GetFullImageBitPackedDataBytes(currFramePixels, bytesCount);
+	}
+	else if (IsDiffCorrLayout)
+	{
+		return GetFullImageDiffCorrDataBytes16(currFramePixels, mode, bytesCount);
+	}
+	else if (m_BytesLayout == FullImageTiled)
+	{
+		return GetFullImageTiledDataBytes((unsigned char*)currFramePixels, 2, bytesCount);
+	}
+	else if (m_BytesLayout == RegionsOfInterest)
+	{
+		return GetRegionsOfInterestDataBytes((unsigned char*)currFramePixels, 2, mode, bytesCount);
+	}
+
+	*bytesCount = 0;
 	return NULL;
 }
 
-unsigned char* AavImageLayout::GetDataBytes(unsigned char* currFramePixels, enum GetByteMode mode, unsigned int *bytesCount)
+unsigned char* AavImageLayout::GetBytesToCompress(unsigned char* currFramePixels, enum GetByteMode mode, unsigned int *bytesCount)
 {
-	unsigned char* bytesToCompress;
-	
 	if (m_BytesLayout == FullImageDiffCorrWithSigns)
 	{
-		bytesToCompress = GetFullImageDiffCorrWithSignsDataBytes(currFramePixels, mode, bytesCount);
+		return GetFullImageDiffCorrWithSignsDataBytes(currFramePixels, mode, bytesCount);
 	}
 	else if (m_BytesLayout == FullImageDiffCorrNoSigns)
 	{
-		bytesToCompress = GetFullImageDiffCorrNoSignsDataBytes(currFramePixels, mode, bytesCount);
+		return GetFullImageDiffCorrNoSignsDataBytes(currFramePixels, mode, bytesCount);
+	}
+	else if (m_BytesLayout == FullImageTiled)
+	{
+		return GetFullImageTiledDataBytes(currFramePixels, 1, bytesCount);
+	}
+	else if (m_BytesLayout == RegionsOfInterest)
+	{
+		return GetRegionsOfInterestDataBytes(currFramePixels, 1, mode, bytesCount);
+	}
+	else if (0 == strcmp(Compression, "LAGARITH16"))
+	{
+		// Lagarith16 reads 16 bit words, so the 8 bit pixels need the larger pixel array buffer
+		return GetFullImageRawDataBytes(currFramePixels, bytesCount);
 	}
-	else if (m_BytesLayout == FullImageRaw)
-		bytesToCompress = GetFullImageRawDataBytes(currFramePixels, bytesCount);
 
-	
-	if (0 == strcmp(Compression, "QUICKLZ"))
+	// The pixels are compressed straight from the caller's buffer
+	*bytesCount = Width * Height;
+	return currFramePixels;
+}
+
+unsigned int AavImageLayout::BytesReadByCompressor(unsigned int bytesCount)
+{
+	// At least the Width * Height words, and the CRC of the 16 bit diff coded layouts after them
+	if (0 == strcmp(Compression, "LAGARITH16"))
+		return max(bytesCount, m_MotionVectorBytes + Width * Height * (unsigned int)sizeof(unsigned short));
+
+	return bytesCount;
+}
+
+void AavImageLayout::CompressDataBytes(unsigned char* bytesToCompress, unsigned char* destination, unsigned int *bytesCount)
+{
+	CompressDataBytes(bytesToCompress, destination, bytesCount, m_StateCompress, m_Lagarith16Compressor, m_LocoICompressor, m_Lagarith8Compressor);
+}
+
+void AavImageLayout::CompressDataBytes(unsigned char* bytesToCompress, unsigned char* destination, unsigned int *bytesCount, qlz_state_compress* stateCompress, Compressor* lagarith16Compressor, LocoICompressor* locoICompressor, Lagarith8Compressor* lagarith8Compressor)
+{
+	if (NULL == bytesToCompress)
 	{
-		unsigned int frameSize = 0;
+		*bytesCount = 0;
+		return;
+	}
+
+	// The motion vector is stored as it is before the compressed bytes, so the reader finds it without decompressing
+	memcpy(destination, bytesToCompress, m_MotionVectorBytes);
+	unsigned char* imageBytes = bytesToCompress + m_MotionVectorBytes;
+	unsigned int imageBytesCount = *bytesCount - m_MotionVectorBytes;
 
+	// The CRC is stored as it is after the compressed bytes. The raw pixels are the bytes to compress and their CRC is
+	// taken here, the CRC of the 16 bit diff coded pixels follows their differences
+	unsigned char pixelsCrc[4];
+	if (m_StoresPixelsCrcUncompressed)
+	{
+		if (m_BytesLayout == FullImageRaw)
+			WritePixelsCrc(pixelsCrc, compute_crc32c(imageBytes, imageBytesCount));
+		else
+		{
+			imageBytesCount -= 4;
+			memcpy(pixelsCrc, imageBytes + imageBytesCount, 4);
+		}
+	}
+
+	unsigned char* compressedBytes = destination + m_MotionVectorBytes;
+	CompressImageBytes(imageBytes, compressedBytes, &imageBytesCount, stateCompress, lagarith16Compressor, locoICompressor, lagarith8Compressor);
+
+	if (m_StoresPixelsCrcUncompressed && imageBytesCount > 0)
+	{
+		memcpy(compressedBytes + imageBytesCount, pixelsCrc, 4);
+		imageBytesCount += 4;
+	}
+
+	*bytesCount = m_MotionVectorBytes + imageBytesCount;
+}
+
+void AavImageLayout::CompressImageBytes(unsigned char* bytesToCompress, unsigned char* destination, unsigned int *bytesCount, qlz_state_compress* stateCompress, Compressor* lagarith16Compressor, LocoICompressor* locoICompressor, Lagarith8Compressor* lagarith8Compressor)
+{
+	if (m_BytesLayout == FullImageTiled)
+	{
+		CompressTiles(bytesToCompress, destination, bytesCount, stateCompress, locoICompressor, lagarith8Compressor);
+	}
+	else if (0 == strcmp(Compression, "QUICKLZ"))
+	{
 		// compress and write result 
-		size_t len2 = qlz_compress(bytesToCompress, m_CompressedPixels, *bytesCount, m_StateCompress); 		
+		size_t len2 = qlz_compress(bytesToCompress, (char*)destination, *bytesCount, stateCompress); 		
 
 #if _DEBUG
 		DebugViewPrint(L"Compressed to %d %%\r\n",  100 * len2 / *bytesCount);
 #endif
 		*bytesCount = len2;
-		
-		return (unsigned char*)(m_CompressedPixels);
 	}
 	else if (0 == strcmp(Compression, "LAGARITH16"))
 	{
-		*bytesCount = m_Lagarith16Compressor->CompressData((unsigned short*)bytesToCompress, m_CompressedPixels);
+		if (m_Lagarith16TablesKeyFrame > 0)
+		{
+			bool newTables = (m_Lagarith16FramesCount % m_Lagarith16TablesKeyFrame) == 0;
+			m_Lagarith16FramesCount++;
 
-		return (unsigned char*)(m_CompressedPixels);
+			*bytesCount = lagarith16Compressor->CompressDataReusingTables((unsigned short*)bytesToCompress, destination, newTables);
+		}
+		else
+			*bytesCount = lagarith16Compressor->CompressData((unsigned short*)bytesToCompress, destination);
+	}
+	else if (0 == strcmp(Compression, "LAGARITH8"))
+	{
+		*bytesCount = lagarith8Compressor->CompressData(bytesToCompress, *bytesCount, destination);
+	}
+	else if (0 == strcmp(Compression, "LOCO-I"))
+	{
+		// The 16 bit raw pixels and crops are predicted as 16 bit samples, the 8 bit pixels and the diff coded bytes as bytes
+		unsigned int bitsPerSample = m_BitPix > 8 && (m_BytesLayout == FullImageRaw || m_BytesLayout == RegionsOfInterest) ? 16 : 8;
+		*bytesCount = locoICompressor->CompressData(bytesToCompress, *bytesCount / (bitsPerSample / 8), bitsPerSample, destination);
 	}
 	else if (0 == strcmp(Compression, "UNCOMPRESSED"))
 	{
-		return bytesToCompress;
+		memcpy(destination, bytesToCompress, *bytesCount);
 	}
-	
-		
-	return NULL;
+	else
+		*bytesCount = 0;
 }
 
-unsigned char* AavImageLayout::GetFullImageRawDataBytes16(unsigned short* currFramePixels, unsigned int *bytesCount)
+unsigned char* AavImageLayout::GetFullImageRawDataBytes(unsigned char* currFramePixels, unsigned int *bytesCount)
 {
-	int buffLen = Width * Height * 2 /* 2x 8 bit */;
+	int buffLen = Width * Height;
 	
 	memcpy(&m_PixelArrayBuffer[0], &currFramePixels[0], buffLen);
 
@@ -391,190 +681,256 @@ unsigned char* AavImageLayout::GetFullImageRawDataBytes16(unsigned short* currFr
 	return m_PixelArrayBuffer;
 }
 
-unsigned char* AavImageLayout::GetFullImageRawDataBytes(unsigned char* currFramePixels, unsigned int *bytesCount)
+// The bits per pixel of the frame, the packed pixels and the CRC of the 16 bit pixels. The frames are packed with the
+// bits per pixel of the layout, except for a frame with a brighter pixel, e.g. after the integration rate went up,
+// which is stored with 16 bits per pixel
+unsigned char* AavImageLayout::GetFullImageBitPackedDataBytes(unsigned short* currFramePixels, unsigned int *bytesCount)
 {
-	int buffLen = Width * Height;
-	
-	memcpy(&m_PixelArrayBuffer[0], &currFramePixels[0], buffLen);
-	
+	unsigned int pixelsCount = Width * Height;
+	unsigned char bitsPerPixel = PixelsFitInBits(currFramePixels, pixelsCount, m_BitPix) ? m_BitPix : 16;
+
+	m_PixelArrayBuffer[0] = bitsPerPixel;
+	unsigned int buffLen = 1 + PackPixels16(currFramePixels, pixelsCount, bitsPerPixel, &m_PixelArrayBuffer[1]);
+
+	if (m_UsesPixelsCrc)
+	{
+		WritePixelsCrc(&m_PixelArrayBuffer[buffLen], compute_crc32c((unsigned char*)currFramePixels, 2 * pixelsCount));
+		buffLen += 4;
+	}
 
 	*bytesCount = buffLen;
 	return m_PixelArrayBuffer;
 }
 
-unsigned char* AavImageLayout::GetFullImageDiffCorrNoSignsDataBytes(unsigned char* currFramePixels, enum GetByteMode mode, unsigned int *bytesCount)
+// The whole image of a reference frame, or else the table of the regions and their crops, followed by the CRC of the
+// pixels or of the crops. The table keeps the crops of the 16 bit pixels at an even offset
+unsigned char* AavImageLayout::GetRegionsOfInterestDataBytes(const unsigned char* currFramePixels, unsigned int pixelBytes, enum GetByteMode mode, unsigned int *bytesCount)
 {
-	bool isKeyFrame = mode == KeyFrameBytes;
-	bool diffCorrFromPrevFramePixels = isKeyFrame || this->BaseFrameType == DiffCorrPrevFrame;
-	
-	if (diffCorrFromPrevFramePixels)
-	{
-		// STEP1 from maintaining the old pixels for DiffCorr
-		if (mode == DiffCorrBytes)
-			memcpy(&m_PrevFramePixelsTemp[0], &currFramePixels[0], m_KeyFrameBytesCount);
-		else
-			memcpy(&m_PrevFramePixels[0], &currFramePixels[0], m_KeyFrameBytesCount);
-	}	
+	unsigned int tableBytes = 0;
+	unsigned int pixelsBytes = Width * Height * pixelBytes;
 
-    // NOTE: The CRC computation is a huge overhead and is currently disabled
-	//unsigned int pixelsCrc = ComputePixelsCRC32(currFramePixels);
-	unsigned int pixelsCrc = 0;
-	
-	if (mode == KeyFrameBytes)
+	if (mode == DiffCorrBytes)
 	{
-		*bytesCount = 0;
-	}
-	else if (mode == DiffCorrBytes)
-	{					
-		*bytesCount = 0;
-		
-		unsigned char* pCurrFramePixels = (unsigned char*)currFramePixels;
-		unsigned char* pPrevFramePixels = (unsigned char*)m_PrevFramePixels;
+		tableBytes = 2 + 8 * m_RegionsCount;
+		pixelsBytes = 0;
 
-		memcpy(&m_PixelArrayBuffer[5 + Width*Height], &currFramePixels[0], Width * Height);
+		m_PixelArrayBuffer[0] = (unsigned char)(m_RegionsCount & 0xFF);
+		m_PixelArrayBuffer[1] = (unsigned char)(m_RegionsCount >> 8);
 
-		for (int j = 0; j < Height; ++j)
+		for (unsigned int i = 0; i < m_RegionsCount; i++)
 		{
-			for (int i = 0; i < Width; ++i)
+			const AavTile* region = &m_Regions[i];
+			unsigned short entry[4] = { (unsigned short)region->X, (unsigned short)region->Y, (unsigned short)region->Width, (unsigned short)region->Height };
+
+			for (unsigned int j = 0; j < 4; j++)
 			{
-				unsigned long charCurr = (unsigned char)*pCurrFramePixels;
-				unsigned long charOld = (unsigned char)*pPrevFramePixels;
-				
-				unsigned char charDiff = (unsigned char)((charCurr - charOld) & 0xFF);
-
-				*pCurrFramePixels = charDiff;
-				
-				pCurrFramePixels++;
-				pPrevFramePixels++;
+				m_PixelArrayBuffer[2 + 8 * i + 2 * j] = (unsigned char)(entry[j] & 0xFF);
+				m_PixelArrayBuffer[2 + 8 * i + 2 * j + 1] = (unsigned char)(entry[j] >> 8);
 			}
+
+			CropTile(currFramePixels, Width, pixelBytes, region, &m_PixelArrayBuffer[tableBytes + region->FirstPixel * pixelBytes]);
+			pixelsBytes += region->Width * region->Height * pixelBytes;
 		}
 	}
+	else
+		memcpy(m_PixelArrayBuffer, currFramePixels, pixelsBytes);
 
-	if (diffCorrFromPrevFramePixels && mode == DiffCorrBytes)
-		// STEP2 from maintaining the old pixels for DiffCorr
-		memcpy(&m_PrevFramePixels[0], &m_PrevFramePixelsTemp[0], m_KeyFrameBytesCount);
-	
-	GetDataBytes(currFramePixels, mode, pixelsCrc, NULL, bytesCount);
+	unsigned int buffLen = tableBytes + pixelsBytes;
+	if (m_UsesPixelsCrc)
+	{
+		WritePixelsCrc(&m_PixelArrayBuffer[buffLen], compute_crc32c(&m_PixelArrayBuffer[tableBytes], pixelsBytes));
+		buffLen += 4;
+	}
 
-	*bytesCount+= Width * Height;
+	*bytesCount = buffLen;
+	return m_PixelArrayBuffer;
+}
 
+// The pixels split into the tiles. The CRCs of the tiles are taken when they are compressed
+unsigned char* AavImageLayout::GetFullImageTiledDataBytes(const unsigned char* currFramePixels, unsigned int pixelBytes, unsigned int *bytesCount)
+{
+	SplitTiles(currFramePixels, Width, Height, pixelBytes, m_TileSize, m_PixelArrayBuffer);
+
+	*bytesCount = Width * Height * pixelBytes;
 	return m_PixelArrayBuffer;
 }
 
-unsigned char* AavImageLayout::GetFullImageDiffCorrWithSignsDataBytes(unsigned char* currFramePixels, enum GetByteMode mode, unsigned int *bytesCount)
+// The tiles table, with the end of the compressed bytes of each tile from the end of the table and, when the layout
+// has the CRC, the CRC of the pixels of the tile, and then the tiles, each compressed on its own. LAGARITH16 codes
+// whole frames and does not compress tiles
+void AavImageLayout::CompressTiles(unsigned char* tiles, unsigned char* destination, unsigned int *bytesCount, qlz_state_compress* stateCompress, LocoICompressor* locoICompressor, Lagarith8Compressor* lagarith8Compressor)
 {
-	bool isKeyFrame = mode == KeyFrameBytes;
-	bool diffCorrFromPrevFramePixels = isKeyFrame || this->BaseFrameType == DiffCorrPrevFrame;
-	
-	if (diffCorrFromPrevFramePixels)
-	{
-		// STEP1 from maintaining the old pixels for DiffCorr
-		if (mode == DiffCorrBytes)
-			memcpy(&m_PrevFramePixelsTemp[0], &currFramePixels[0], m_KeyFrameBytesCount);
-		else
-			memcpy(&m_PrevFramePixels[0], &currFramePixels[0], m_KeyFrameBytesCount);
-	}	
+	unsigned int pixelBytes = m_BitPix > 8 ? 2 : 1;
+	unsigned int tilesCount = TilesCount(Width, Height, m_TileSize);
+	unsigned int entryBytes = m_UsesPixelsCrc ? 8 : 4;
+	unsigned char* compressedTiles = destination + tilesCount * entryBytes;
+	unsigned int compressedBytes = 0;
 
-    // NOTE: The CRC computation is a huge overhead and is currently disabled
-	//unsigned int pixelsCrc = ComputePixelsCRC32(currFramePixels);
-	unsigned int pixelsCrc = 0;
-	
-	if (mode == KeyFrameBytes)
+	for (unsigned int i = 0; i < tilesCount; i++)
 	{
-		*bytesCount = 0;		
-	}
-	else if (mode == DiffCorrBytes)
-	{					
-		*bytesCount = 0;
+		AavTile tile;
+		GetTile(Width, Height, m_TileSize, i, &tile);
 
-		memset(m_SignsBytes, 0, m_MaxSignsBytesCount);
-		
-		unsigned char* pCurrFramePixels = (unsigned char*)currFramePixels;
-		unsigned char* pPrevFramePixels = (unsigned char*)m_PrevFramePixels;
+		unsigned char* tilePixels = tiles + tile.FirstPixel * pixelBytes;
+		unsigned int tileBytes = tile.Width * tile.Height * pixelBytes;
+		unsigned char* compressedTile = compressedTiles + compressedBytes;
 
-		for (int y = 0; y < Height; ++y)
+		if (0 == strcmp(Compression, "QUICKLZ"))
+			compressedBytes += (unsigned int)qlz_compress(tilePixels, (char*)compressedTile, tileBytes, stateCompress);
+		else if (0 == strcmp(Compression, "LOCO-I"))
+			compressedBytes += locoICompressor->CompressData(tilePixels, tile.Width * tile.Height, tile.Width, 8 * pixelBytes, compressedTile);
+		else if (0 == strcmp(Compression, "LAGARITH8"))
+			compressedBytes += (unsigned int)lagarith8Compressor->CompressData(tilePixels, tileBytes, tile.Width * pixelBytes, compressedTile);
+		else if (0 == strcmp(Compression, "UNCOMPRESSED"))
 		{
-			for (int x = 0; x < Width; ++x)
-			{
-				unsigned long charCurr = (unsigned char)*pCurrFramePixels;
-				unsigned long charOld = (unsigned char)*pPrevFramePixels;
-				
-				unsigned long charDiffLong; 
-				int signsBit = (x + y * Width) % 8;
-				int signsIndex = (x + y * Width) / 8;
-				bool signIsNegative;
-				if (charCurr > charOld)
-				{
-					charDiffLong = charCurr - charOld;
-					signIsNegative = false;
-				}
-				else
-				{
-					charDiffLong = charOld - charCurr;
-					signIsNegative = true;
-				}
-
-				unsigned char charDiff = (unsigned char)(charDiffLong & 0xFF);
-				
-				if (signIsNegative)
-					m_SignsBytes[signsIndex] = m_SignsBytes[signsIndex] | SIGNS_MASK[signsBit];
-
-				*pCurrFramePixels = charDiff;
-				
-				pCurrFramePixels++;
-				pPrevFramePixels++;
-			}
+			memcpy(compressedTile, tilePixels, tileBytes);
+			compressedBytes += tileBytes;
 		}
+		else
+		{
+			*bytesCount = 0;
+			return;
+		}
+
+		unsigned char* entry = destination + i * entryBytes;
+		entry[0] = (unsigned char)(compressedBytes & 0xFF);
+		entry[1] = (unsigned char)((compressedBytes >> 8) & 0xFF);
+		entry[2] = (unsigned char)((compressedBytes >> 16) & 0xFF);
+		entry[3] = (unsigned char)((compressedBytes >> 24) & 0xFF);
 
-		*bytesCount = Width * Height / 8;
+		if (m_UsesPixelsCrc)
+			WritePixelsCrc(entry + 4, compute_crc32c(tilePixels, tileBytes));
 	}
 
-	if (diffCorrFromPrevFramePixels && mode == DiffCorrBytes)
-		// STEP2 from maintaining the old pixels for DiffCorr
-		memcpy(&m_PrevFramePixels[0], &m_PrevFramePixelsTemp[0], m_KeyFrameBytesCount);
-	
-	GetDataBytes(currFramePixels, mode, pixelsCrc, m_SignsBytes, bytesCount);
+	*bytesCount = tilesCount * entryBytes + compressedBytes;
+}
 
-	return m_PixelArrayBuffer;
+// The CRC of the pixels as they were before the differential coding, in the byte order of the pixels
+void AavImageLayout::WritePixelsCrc(unsigned char* destination, unsigned int pixelsCRC32)
+{
+	destination[0] = (unsigned char)(pixelsCRC32 & 0xFF);
+	destination[1] = (unsigned char)((pixelsCRC32 >> 8) & 0xFF);
+	destination[2] = (unsigned char)((pixelsCRC32 >> 16) & 0xFF);
+	destination[3] = (unsigned char)((pixelsCRC32 >> 24) & 0xFF);
 }
 
-void AavImageLayout::GetDataBytes(unsigned char* pixels, enum GetByteMode mode, unsigned int pixelsCRC32, unsigned char* signBytes, unsigned int *bytesCount)
+// Where a diff frame is copied while its differences are taken, when it is the base frame of the next frame
+unsigned char* AavImageLayout::NextBaseFramePixels(enum GetByteMode mode)
 {
-	// Flags: 0 - no key frame used, 1 - key frame follows, 2 - diff corr data follows
-	bool isKeyFrame = mode == KeyFrameBytes;
-	bool noKeyFrameUsed = mode == Normal;
-	bool isDiffCorrFrame = mode == DiffCorrBytes;
-	
-	int signsBytesCnt = *bytesCount;
-	
-	unsigned int bytesCounter = *bytesCount;
-	
-	m_PixelArrayBuffer[0] = noKeyFrameUsed ? (unsigned char)0 : (isKeyFrame ? (unsigned char)1 : (unsigned char)2);
-	bytesCounter++;
+	return mode == DiffCorrBytes && BaseFrameType == DiffCorrPrevFrame ? m_PrevFramePixelsTemp : NULL;
+}
+
+// A key frame is the base frame of the frames after it. A diff frame of a PREV-FRAME layout was copied by
+// NextBaseFramePixels() and becomes the base frame by swapping the buffers
+void AavImageLayout::UpdateBaseFrame(const unsigned char* currFramePixels, enum GetByteMode mode)
+{
+	bool isNewBase = mode != DiffCorrBytes || BaseFrameType == DiffCorrPrevFrame;
 
-	if (signsBytesCnt > 0)
+	if (mode != DiffCorrBytes)
+		memcpy(m_PrevFramePixels, currFramePixels, m_KeyFrameBytesCount);
+	else if (BaseFrameType == DiffCorrPrevFrame)
 	{
-		memcpy(&m_PixelArrayBuffer[1], &signBytes[0], signsBytesCnt);		
-	}	
+		unsigned char* basePixels = m_PrevFramePixels;
+		m_PrevFramePixels = m_PrevFramePixelsTemp;
+		m_PrevFramePixelsTemp = basePixels;
+	}
 
-	for (int y = 0; y < Height; ++y)
+	// A new base frame without a located object keeps the position of the base frame, as it was not shifted from it
+	if (isNewBase && m_HasFramePosition)
 	{
-		for (int x = 0; x < Width; ++x)
-		{
-			unsigned char pixel = (unsigned char)(pixels[x + y * Width]);
+		m_HasBasePosition = true;
+		m_BaseX = m_FrameX;
+		m_BaseY = m_FrameY;
+	}
+	else if (mode != DiffCorrBytes)
+		m_HasBasePosition = false;
 
-			m_PixelArrayBuffer[bytesCounter] = pixel;
-			bytesCounter++;
-		}
+	m_HasFramePosition = false;
+}
+
+// The flag, the pixels or their differences from the base frame, the CRC of the pixels and the copy of the pixels
+// of a diff frame. The diff coded layouts always have room for the CRC
+unsigned char* AavImageLayout::GetFullImageDiffCorrNoSignsDataBytes(unsigned char* currFramePixels, enum GetByteMode mode, unsigned int *bytesCount)
+{
+	unsigned int pixelsCount = Width * Height;
+	unsigned char* buffer = &m_PixelArrayBuffer[m_MotionVectorBytes];
+	unsigned char* data = &buffer[1];
+
+	WriteMotionVector(mode);
+
+	// Flags: 0 - no key frame used, 1 - key frame follows, 2 - diff corr data follows
+	buffer[0] = (unsigned char)mode;
+
+	if (mode == DiffCorrBytes)
+	{
+		SubtractPixels8(currFramePixels, MotionCompensatedBaseFrame(), pixelsCount, data, NextBaseFramePixels(mode));
+		memcpy(&data[pixelsCount + 4], currFramePixels, pixelsCount);
 	}
+	else
+		memcpy(data, currFramePixels, pixelsCount);
+
+	UpdateBaseFrame(currFramePixels, mode);
+
+	WritePixelsCrc(&data[pixelsCount], m_UsesPixelsCrc ? compute_crc32c(currFramePixels, pixelsCount) : 0);
+
+	*bytesCount = m_MotionVectorBytes + 1 + pixelsCount + 4 + pixelsCount;
+	return m_PixelArrayBuffer;
+}
+
+// The flag, the signs of the differences of a diff frame, the pixels or the absolute values of their differences
+// from the base frame and the CRC of the pixels
+unsigned char* AavImageLayout::GetFullImageDiffCorrWithSignsDataBytes(unsigned char* currFramePixels, enum GetByteMode mode, unsigned int *bytesCount)
+{
+	unsigned int pixelsCount = Width * Height;
+	unsigned int signsBytesCount = mode == DiffCorrBytes ? pixelsCount / 8 : 0;
+	unsigned char* buffer = &m_PixelArrayBuffer[m_MotionVectorBytes];
+	unsigned char* data = &buffer[1 + signsBytesCount];
+
+	WriteMotionVector(mode);
 
-	m_PixelArrayBuffer[bytesCounter] = (unsigned char)(pixelsCRC32 & 0xFF);
-	m_PixelArrayBuffer[bytesCounter + 1] = (unsigned char)((pixelsCRC32 >> 8) & 0xFF);
-	m_PixelArrayBuffer[bytesCounter + 2] = (unsigned char)((pixelsCRC32 >> 16) & 0xFF);
-	m_PixelArrayBuffer[bytesCounter + 3] = (unsigned char)((pixelsCRC32 >> 24) & 0xFF);
-	*bytesCount = bytesCounter + 4;
+	// Flags: 0 - no key frame used, 1 - key frame follows, 2 - diff corr data follows
+	buffer[0] = (unsigned char)mode;
+
+	if (mode == DiffCorrBytes)
+		SubtractPixelsWithSigns8(currFramePixels, MotionCompensatedBaseFrame(), pixelsCount, &buffer[1], data, NextBaseFramePixels(mode));
+	else
+		memcpy(data, currFramePixels, pixelsCount);
+
+	UpdateBaseFrame(currFramePixels, mode);
+
+	WritePixelsCrc(&data[pixelsCount], m_UsesPixelsCrc ? compute_crc32c(currFramePixels, pixelsCount) : 0);
 
+	*bytesCount = m_MotionVectorBytes + 1 + signsBytesCount + pixelsCount + 4;
+	return m_PixelArrayBuffer;
 }
 
+// The pixels, or their zigzag coded differences from the base frame when the byte mode of the frame is
+// DiffCorrBytes, and the CRC of the pixels. Both diff coded layouts store the 16 bit differences this way, as the
+// zigzag code keeps their signs. The CRC is not compressed, so the image is the Width * Height words which
+// Lagarith16 codes
+unsigned char* AavImageLayout::GetFullImageDiffCorrDataBytes16(unsigned short* currFramePixels, enum GetByteMode mode, unsigned int *bytesCount)
+{
+	unsigned int pixelsCount = Width * Height;
+	unsigned int buffLen = 2 * pixelsCount;
+	unsigned char* buffer = &m_PixelArrayBuffer[m_MotionVectorBytes];
+
+	WriteMotionVector(mode);
+
+	if (mode == DiffCorrBytes)
+		SubtractPixelsZigZag16(currFramePixels, (const unsigned short*)MotionCompensatedBaseFrame(), pixelsCount, buffer, (unsigned short*)NextBaseFramePixels(mode));
+	else
+		memcpy(buffer, currFramePixels, buffLen);
+
+	UpdateBaseFrame((unsigned char*)currFramePixels, mode);
+
+	if (m_UsesPixelsCrc)
+	{
+		WritePixelsCrc(&buffer[buffLen], compute_crc32c((unsigned char*)currFramePixels, buffLen));
+		buffLen += 4;
+	}
+
+	*bytesCount = m_MotionVectorBytes + buffLen;
+	return m_PixelArrayBuffer;
+}
 
 }
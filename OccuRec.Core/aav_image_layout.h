@@ -13,31 +13,96 @@
 #include <string>
 
 #include "Compressor.h"
+#include "LocoICompressor.h"
+#include "Lagarith8Compressor.h"
+#include "aav_tiles.h"
 
 using namespace std;
 using std::string;
 
+// The motion vector of a frame of the motion compensated layouts, two signed 16 bit words, and the largest offset
+// in pixels from the base frame which is compensated
+#define AAV_MOTION_VECTOR_BYTES 4
+#define AAV_MAX_MOTION_OFFSET 64
+
 namespace AavLib
 {
+	// Configured with AavSetupLagarith16TableReuse() and used by the next file. 0 stores the Lagarith16 tables in
+	// every frame, as do the files compressed by worker threads
+	extern unsigned int g_AavLagarith16TablesKeyFrame;
+
+	// Configured with AavSetupSceneChangeKeyFrames() and used by the next file. The mean absolute difference in
+	// gray levels of the recorded pixels, of 8 or 16 bits, from the base frame above which a diff coded frame is
+	// recorded as a key frame instead, 0 never
+	extern unsigned int g_AavSceneChangeThreshold;
+
+	// Configured with AavSetupTiles() and used by the next file. The tile size of the FULL-IMAGE-TILED layouts, 0 for
+	// AAV_DEFAULT_TILE_SIZE
+	extern unsigned int g_AavTileSize;
+
+	// Configured with AavSetupPixelsCrc() and used by the next file. Whether the layouts store the CRC-32C of the
+	// pixels of each frame after the pixels
+	extern bool g_AavPixelsCrc;
+
 	class AavImageLayout 
 	{
 
 	private:
-		unsigned char *SIGNS_MASK;
 		map<string, string> m_LayoutTags;
 		ImageBytesLayout m_BytesLayout;	
 		unsigned char m_BitPix;
 
 		int m_KeyFrameBytesCount;
+		// The base frame of the diff coded frames, and the buffer which a diff frame is copied to while its differences
+		// are taken and which is swapped with the base frame when the frame becomes the base of the next frame
 		unsigned char *m_PrevFramePixels;
 		unsigned char *m_PrevFramePixelsTemp;
 		unsigned char *m_PixelArrayBuffer;
-		unsigned char *m_SignsBytes;
 		unsigned int m_MaxSignsBytesCount;
 		unsigned int m_MaxPixelArrayLengthWithoutSigns;
-		char* m_CompressedPixels;
 		qlz_state_compress* m_StateCompress;
 		Compressor* m_Lagarith16Compressor;
+		LocoICompressor* m_LocoICompressor;
+		Lagarith8Compressor* m_Lagarith8Compressor;
+
+		// The Lagarith16 tables are stored in every m_Lagarith16TablesKeyFrame-th frame compressed by the layout and
+		// may be reused by the frames in between
+		unsigned int m_Lagarith16TablesKeyFrame;
+		unsigned int m_Lagarith16FramesCount;
+
+		// The diff coded frames since the last key frame, which is the first frame after StartNewDiffCorrSequence()
+		bool m_HasKeyFrame;
+		int m_FramesSinceKeyFrame;
+		unsigned int m_SceneChangeThreshold;
+
+		// The layout is tagged with SECTION-DATA-REDUNDANCY-CHECK and its image bytes end with the CRC of the pixels.
+		// The raw layouts, whose pixels are compressed from the caller's buffer, and the 16 bit diff coded layouts,
+		// whose differences are the Width * Height words which Lagarith16 codes, store it after the compressed bytes
+		bool m_UsesPixelsCrc;
+		bool m_StoresPixelsCrcUncompressed;
+
+		// The tiles of a FULL-IMAGE-TILED layout are m_TileSize pixels square
+		unsigned int m_TileSize;
+
+		// The diff coded layouts tagged with DIFFCODE-MOTION-COMPENSATION take the differences from the base frame
+		// shifted by the offset of the tracked object from its position in the base frame. The offset is stored
+		// before the compressed bytes of every frame, as m_MotionVectorBytes bytes
+		unsigned int m_MotionVectorBytes;
+		bool m_HasFramePosition;
+		double m_FrameX;
+		double m_FrameY;
+		bool m_HasBasePosition;
+		double m_BaseX;
+		double m_BaseY;
+		int m_MotionX;
+		int m_MotionY;
+		unsigned char* m_ShiftedBasePixels;
+		bool m_IsBaseShifted;
+
+		// The regions of the next frames of a REGIONS-OF-INTEREST layout, clipped to the image, with the first pixel
+		// of the crop of each among the crops of the frame
+		AavTile m_Regions[AAV_MAX_REGIONS_OF_INTEREST];
+		unsigned int m_RegionsCount;
 		
 	public:
 		unsigned char LayoutId;
@@ -47,30 +112,62 @@ namespace AavLib
 		const char* Compression;
 		bool IsDiffCorrLayout;
 		bool IsNoImageLayout;
+		bool IsRegionsOfInterestLayout;
 		int KeyFrame;
 		
 		int MaxFrameBufferSize;
 		enum DiffCorrBaseFrame BaseFrameType;
 	
 	private:
-		void GetDataBytes(unsigned char* currFramePixels, enum GetByteMode mode, unsigned int pixelsCRC32, unsigned char* signBytes, unsigned int *bytesCount);
-		
+		unsigned char* NextBaseFramePixels(enum GetByteMode mode);
+		void UpdateBaseFrame(const unsigned char* currFramePixels, enum GetByteMode mode);
+		void PrepareMotionCompensation();
+		const unsigned char* MotionCompensatedBaseFrame();
+		void WriteMotionVector(enum GetByteMode mode);
+
 		unsigned char* GetFullImageDiffCorrWithSignsDataBytes(unsigned char* currFramePixels, enum GetByteMode mode, unsigned int *bytesCount);
 		unsigned char* GetFullImageDiffCorrNoSignsDataBytes(unsigned char* currFramePixels, enum GetByteMode mode, unsigned int *bytesCount);
+		unsigned char* GetFullImageDiffCorrDataBytes16(unsigned short* currFramePixels, enum GetByteMode mode, unsigned int *bytesCount);
 		unsigned char* GetFullImageRawDataBytes(unsigned char* currFramePixels, unsigned int *bytesCount);
-		unsigned char* GetFullImageRawDataBytes16(unsigned short* currFramePixels, unsigned int *bytesCount);
+		unsigned char* GetFullImageBitPackedDataBytes(unsigned short* currFramePixels, unsigned int *bytesCount);
+		unsigned char* GetRegionsOfInterestDataBytes(const unsigned char* currFramePixels, unsigned int pixelBytes, enum GetByteMode mode, unsigned int *bytesCount);
+		unsigned char* GetFullImageTiledDataBytes(const unsigned char* currFramePixels, unsigned int pixelBytes, unsigned int *bytesCount);
+		void CompressTiles(unsigned char* tiles, unsigned char* destination, unsigned int *bytesCount, qlz_state_compress* stateCompress, LocoICompressor* locoICompressor, Lagarith8Compressor* lagarith8Compressor);
+		void WritePixelsCrc(unsigned char* destination, unsigned int pixelsCRC32);
+		void CompressImageBytes(unsigned char* bytesToCompress, unsigned char* destination, unsigned int *bytesCount, qlz_state_compress* stateCompress, Compressor* lagarith16Compressor, LocoICompressor* locoICompressor, Lagarith8Compressor* lagarith8Compressor);
 		
 		void ResetBuffers();
+		bool IsSceneChange(unsigned char* currFramePixels);
 		
 	public:
 		AavImageLayout(unsigned int width, unsigned int height, unsigned char bitPix, unsigned char layoutId, const char* layoutType, const char* compression, int keyFrame);
 		~AavImageLayout();
 		
 		void AddOrUpdateTag(const char* tagName, const char* tagValue);
-		unsigned char* GetDataBytes(unsigned char* currFramePixels, enum GetByteMode mode, unsigned int *bytesCount);
-		unsigned char* GetDataBytes16(unsigned short* currFramePixels, enum GetByteMode mode, unsigned int *bytesCount);
+		// The position of the tracked object in the next frame, which the motion compensated layouts take its offset
+		// from the base frame from. A frame without a located object is not shifted
+		void SetTrackedPosition(bool isLocated, double x, double y);
+		// The regions stored by the next frames of a REGIONS-OF-INTEREST layout which are not reference frames, as the
+		// x, y, width and height of each. The regions after the first AAV_MAX_REGIONS_OF_INTEREST, and the ones whose
+		// crops would take the crops of the frame over the size of the image, are left out
+		void SetRegionsOfInterest(unsigned int regionsCount, const unsigned int* regions);
+		// The differential coding, which depends on the previous frames. The caller's pixels are left unchanged, and the
+		// returned bytes are valid until the next call
+		unsigned char* GetBytesToCompress(unsigned char* currFramePixels, enum GetByteMode mode, unsigned int *bytesCount);
+		unsigned char* GetBytesToCompress16(unsigned short* currFramePixels, enum GetByteMode mode, unsigned int *bytesCount);
+		// The compressors may read more than the bytesCount returned by GetBytesToCompress()
+		unsigned int BytesReadByCompressor(unsigned int bytesCount);
+
+		// Write the (compressed) image bytes to the destination, which must have room for MaxFrameBufferSize bytes. Frames can be
+		// compressed in parallel by threads with their own QuickLZ state and Lagarith16, LOCO-I and Lagarith8 compressors, as
+		// long as the layout does not reuse the Lagarith16 tables
+		void CompressDataBytes(unsigned char* bytesToCompress, unsigned char* destination, unsigned int *bytesCount);
+		void CompressDataBytes(unsigned char* bytesToCompress, unsigned char* destination, unsigned int *bytesCount, qlz_state_compress* stateCompress, Compressor* lagarith16Compressor, LocoICompressor* locoICompressor, Lagarith8Compressor* lagarith8Compressor);
 		void WriteHeader(FILE* pfile);
 		void StartNewDiffCorrSequence();
+		// Whether the next frame of the diff coded layout is a key frame, every KeyFrame frames or when the scene changes.
+		// The pixels are NULL when they are not compared with the base frame
+		enum GetByteMode NextDiffCorrByteMode(unsigned char* currFramePixels);
 	};
 
 };
@@ -2,7 +2,7 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
-#include "StdAfx.h"
+#include "stdafx.h"
 
 #include "aav_image_section.h"
 #include "utils.h"
@@ -18,7 +18,7 @@ namespace AavLib
 
 #define UNINITIALIZED_LAYOUT_ID 0	
 unsigned char m_PreviousLayoutId;
-unsigned int m_NumFramesInThisLayoutId;
+int m_MaxImageLayoutFrameBufferSize = -1;
 
 AavImageSection::AavImageSection(unsigned int width, unsigned int height, unsigned char bitPix)
 {
@@ -26,7 +26,6 @@ AavImageSection::AavImageSection(unsigned int width, unsigned int height, unsign
 	Height = height;	
 	
 	m_PreviousLayoutId = UNINITIALIZED_LAYOUT_ID;
-	m_NumFramesInThisLayoutId = 0;
 	m_BitPix = bitPix;
 }
 
@@ -34,6 +33,7 @@ AavImageLayout* AavImageSection::AddImageLayout(unsigned char bitPix, unsigned c
 {
 	AavLib::AavImageLayout* layout = new AavLib::AavImageLayout(Width, Height, bitPix, layoutId, layoutType, compression, keyFrame); 
 	m_ImageLayouts.insert(make_pair(layoutId, layout));
+	m_MaxImageLayoutFrameBufferSize = -1;
 	return layout;
 }
 
@@ -51,8 +51,6 @@ AavImageSection::~AavImageSection()
 	m_ImageLayouts.empty();
 }
 
-int m_MaxImageLayoutFrameBufferSize = -1;
-
 int AavImageSection::MaxFrameBufferSize()
 {
 	// Max frame buffer size is the max frame buffer size of the largest image layout
@@ -113,88 +111,55 @@ AavImageLayout* AavImageSection::GetImageLayoutById(unsigned char layoutId)
 	return NULL;
 }
 
-unsigned char* AavImageSection::GetDataBytes16(unsigned char layoutId, unsigned short* currFramePixels, unsigned int *bytesCount, char* byteMode)
+enum GetByteMode AavImageSection::NextFrameByteMode(AavImageLayout* currentLayout, unsigned char layoutId, unsigned char* currFramePixels)
 {
-	AavImageLayout* currentLayout = GetImageLayoutById(layoutId);
-	
-	if (m_PreviousLayoutId == layoutId)
-		m_NumFramesInThisLayoutId++;
-	else
-	{
-		m_NumFramesInThisLayoutId = 0;
+	if (m_PreviousLayoutId != layoutId)
 		currentLayout->StartNewDiffCorrSequence();
-	}
 	
 	enum GetByteMode mode = Normal;
 	
-	if (currentLayout->IsDiffCorrLayout)
-	{
-		bool isKeyFrame = (m_NumFramesInThisLayoutId % currentLayout->KeyFrame) == 0;
-		bool diffCorrFromPrevFramePixels = isKeyFrame || currentLayout->BaseFrameType == DiffCorrPrevFrame;
-		
-		if (isKeyFrame)
-		{
-			// this is a key frame
-			mode = KeyFrameBytes;		
-		}
-		else
-		{
-			// this is not a key frame, compute and save the diff corr
-			mode = DiffCorrBytes;
-		}
-	}	
-	
-	unsigned char* pixels = currentLayout->GetDataBytes16(currFramePixels, mode, bytesCount);	
+	// A key frame, or a frame whose differences from the base frame are saved. The reference frames of the
+	// REGIONS-OF-INTEREST layouts are their key frames
+	if (currentLayout->IsDiffCorrLayout || currentLayout->IsRegionsOfInterestLayout)
+		mode = currentLayout->NextDiffCorrByteMode(currFramePixels);
 	
 	m_PreviousLayoutId = layoutId;
-	*byteMode = (char)mode;
 	
-	return pixels;
+	return mode;
 }
 
-unsigned char* AavImageSection::GetDataBytes(unsigned char layoutId, unsigned char* currFramePixels, unsigned int *bytesCount, char* byteMode)
+unsigned char* AavImageSection::GetBytesToCompress16(unsigned char layoutId, unsigned short* currFramePixels, unsigned int *bytesCount, char* byteMode)
 {
 	AavImageLayout* currentLayout = GetImageLayoutById(layoutId);
+	enum GetByteMode mode = NextFrameByteMode(currentLayout, layoutId, (unsigned char*)currFramePixels);
 	
-	if (m_PreviousLayoutId == layoutId)
-		m_NumFramesInThisLayoutId++;
-	else
-	{
-		m_NumFramesInThisLayoutId = 0;
-		currentLayout->StartNewDiffCorrSequence();
-	}
-	
-	enum GetByteMode mode = Normal;
-	
-	if (currentLayout->IsDiffCorrLayout)
-	{
-		bool isKeyFrame = (m_NumFramesInThisLayoutId % currentLayout->KeyFrame) == 0;
-		bool diffCorrFromPrevFramePixels = isKeyFrame || currentLayout->BaseFrameType == DiffCorrPrevFrame;
-		
-		if (isKeyFrame)
-		{
-			// this is a key frame
-			mode = KeyFrameBytes;		
-		}
-		else
-		{
-			// this is not a key frame, compute and save the diff corr
-			mode = DiffCorrBytes;
-		}
-	}	
-	
-	unsigned char* pixels = currentLayout->GetDataBytes(currFramePixels, mode, bytesCount);
+	*byteMode = (char)mode;
 	
+	return currentLayout->GetBytesToCompress16(currFramePixels, mode, bytesCount);
+}
+
+unsigned char* AavImageSection::GetBytesToCompress(unsigned char layoutId, unsigned char* currFramePixels, unsigned int *bytesCount, char* byteMode)
+{
+	AavImageLayout* currentLayout = GetImageLayoutById(layoutId);
+	enum GetByteMode mode = NextFrameByteMode(currentLayout, layoutId, currFramePixels);
 	
-	m_PreviousLayoutId = layoutId;
 	*byteMode = (char)mode;
 	
-	return pixels;
+	return currentLayout->GetBytesToCompress(currFramePixels, mode, bytesCount);
 }
+
+void AavImageSection::GetDataBytes16(unsigned char layoutId, unsigned short* currFramePixels, unsigned char* destination, unsigned int *bytesCount, char* byteMode)
+{
+	unsigned char* bytesToCompress = GetBytesToCompress16(layoutId, currFramePixels, bytesCount, byteMode);
 	
-unsigned int AavImageSection::ComputePixelsCRC32(unsigned char* pixels)
+	GetImageLayoutById(layoutId)->CompressDataBytes(bytesToCompress, destination, bytesCount);
+}
+
+void AavImageSection::GetDataBytes(unsigned char layoutId, unsigned char* currFramePixels, unsigned char* destination, unsigned int *bytesCount, char* byteMode)
 {
-	return compute_crc32((unsigned char*)pixels, 2 * Height * Width);
+	unsigned char* bytesToCompress = GetBytesToCompress(layoutId, currFramePixels, bytesCount, byteMode);
+	
+	GetImageLayoutById(layoutId)->CompressDataBytes(bytesToCompress, destination, bytesCount);
 }
 	
 void AavImageSection::WriteHeader(FILE* pFile)
@@ -26,7 +26,7 @@ class AavImageSection {
 		unsigned char m_BitPix;		
 		
 	private:
-		unsigned int ComputePixelsCRC32(unsigned char* pixels);
+		enum GetByteMode NextFrameByteMode(AavImageLayout* currentLayout, unsigned char layoutId, unsigned char* currFramePixels);
 		
 	public:
 		unsigned int Width;
@@ -40,8 +40,13 @@ class AavImageSection {
 		void AddOrUpdateTag(const char* tagName, const char* tagValue);
 		void WriteHeader(FILE* pfile);
 
-		unsigned char* GetDataBytes(unsigned char layoutId, unsigned char* currFramePixels, unsigned int *bytesCount, char* byteMode);		
-		unsigned char* GetDataBytes16(unsigned char layoutId, unsigned short* currFramePixels, unsigned int *bytesCount, char* byteMode);
+		// The sequential part of GetDataBytes(), which must be called in frame order. The returned bytes are 
+		// valid until the next frame and can be compressed by any thread with AavImageLayout::CompressDataBytes()
+		unsigned char* GetBytesToCompress(unsigned char layoutId, unsigned char* currFramePixels, unsigned int *bytesCount, char* byteMode);
+		unsigned char* GetBytesToCompress16(unsigned char layoutId, unsigned short* currFramePixels, unsigned int *bytesCount, char* byteMode);
+
+		void GetDataBytes(unsigned char layoutId, unsigned char* currFramePixels, unsigned char* destination, unsigned int *bytesCount, char* byteMode);		
+		void GetDataBytes16(unsigned char layoutId, unsigned short* currFramePixels, unsigned char* destination, unsigned int *bytesCount, char* byteMode);
 
 		void BeginFrame();
 		int MaxFrameBufferSize();
@@ -2,7 +2,7 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
-#include "StdAfx.h"
+#include "stdafx.h"
 #include <stdio.h>
 #include <iostream>
 #include <vector>
@@ -12,11 +12,13 @@
 #include "aav_lib.h"
 #include "aav_image_layout.h"
 #include "aav_profiling.h"
+#include "aav_recovery.h"
 
 
 char* g_CurrentAavFile;
 AavLib::AavFile* g_AavFile;
 bool g_FileStarted = false;
+AavLib::AavReader* g_AavReader = NULL;
 
 using namespace std;
 
@@ -106,6 +108,13 @@ void AavAddOrUpdateImageSectionTag(const char* tagName, const char* tagValue)
 	return g_AavFile->ImageSection->AddOrUpdateTag(tagName, tagValue);
 }
 
+void AavAddOrUpdateImageLayoutTag(unsigned char layoutId, const char* tagName, const char* tagValue)
+{
+	AavLib::AavImageLayout* imageLayout = g_AavFile->ImageSection->GetImageLayoutById(layoutId);
+	if (NULL != imageLayout)
+		imageLayout->AddOrUpdateTag(tagName, tagValue);
+}
+
 bool AavBeginFrame(long long timeStamp, unsigned int elapsedTime, unsigned int exposure)
 {
 	if (!g_FileStarted)
@@ -126,6 +135,23 @@ bool AavBeginFrame(long long timeStamp, unsigned int elapsedTime, unsigned int e
 	return true;
 }
 
+// Called before the image of the frame is added, for the motion compensated layouts
+void AavFrameSetTrackedPosition(unsigned char layoutId, bool isLocated, double x, double y)
+{
+	AavLib::AavImageLayout* imageLayout = g_AavFile->ImageSection->GetImageLayoutById(layoutId);
+	if (NULL != imageLayout)
+		imageLayout->SetTrackedPosition(isLocated, x, y);
+}
+
+// Called before the image of the frame is added, for the REGIONS-OF-INTEREST layouts. The regions are kept for the
+// frames after it until they are set again
+void AavFrameSetRegionsOfInterest(unsigned char layoutId, unsigned int regionsCount, const unsigned int* regions)
+{
+	AavLib::AavImageLayout* imageLayout = g_AavFile->ImageSection->GetImageLayoutById(layoutId);
+	if (NULL != imageLayout)
+		imageLayout->SetRegionsOfInterest(regionsCount, regions);
+}
+
 void AavFrameAddImage(unsigned char layoutId,  unsigned char* pixels)
 {
 	g_AavFile->AddFrameImage(layoutId, pixels);
@@ -169,4 +195,68 @@ void AddFrameStatusTagReal(unsigned int tagIndex, float tagValue)
 void AavEndFrame()
 {
 	g_AavFile->EndFrame();
+}
+
+void AavSetupWriteBehind(unsigned int bufferSize, unsigned int durabilityIntervalMs)
+{
+	AavLib::g_AavWriteBufferSize = bufferSize;
+	AavLib::g_AavDurabilityIntervalMs = durabilityIntervalMs;
+}
+
+void AavSetupCompressionThreads(unsigned int numberOfThreads)
+{
+	AavLib::g_AavCompressionThreads = numberOfThreads;
+}
+
+void AavSetupStatusDeltaEncoding(unsigned int snapshotInterval)
+{
+	AavLib::g_AavStatusSnapshotInterval = snapshotInterval;
+}
+
+void AavSetupLagarith16TableReuse(unsigned int tablesKeyFrame)
+{
+	AavLib::g_AavLagarith16TablesKeyFrame = tablesKeyFrame;
+}
+
+void AavSetupSceneChangeKeyFrames(unsigned int sceneChangeThreshold)
+{
+	AavLib::g_AavSceneChangeThreshold = sceneChangeThreshold;
+}
+
+void AavSetupPixelsCrc(bool enabled)
+{
+	AavLib::g_AavPixelsCrc = enabled;
+}
+
+void AavSetupTiles(unsigned int tileSize)
+{
+	AavLib::g_AavTileSize = tileSize;
+}
+
+bool AavRecoverFile(const char* fileName, unsigned int* recoveredFrames)
+{
+	return AavLib::RecoverFile(fileName, recoveredFrames);
+}
+
+bool AavOpenReader(const char* fileName)
+{
+	AavCloseReader();
+
+	g_AavReader = new AavLib::AavReader();
+	if (!g_AavReader->OpenFile(fileName))
+	{
+		AavCloseReader();
+		return false;
+	}
+
+	return true;
+}
+
+void AavCloseReader()
+{
+	if (NULL != g_AavReader)
+	{
+		delete g_AavReader;
+		g_AavReader = NULL;
+	}
 }
\ No newline at end of file
@@ -6,10 +6,12 @@
 #define ADV_LIB
 
 #include "aav_file.h"
+#include "aav_reader.h"
 
 extern char* g_CurrentAavFile;
 extern AavLib::AavFile* g_AavFile;
 extern bool g_FileStarted;
+extern AavLib::AavReader* g_AavReader;
 
 		
 char* AavGetCurrentFilePath(void);
@@ -20,8 +22,21 @@ unsigned int AavDefineStatusSectionTag(const char* tagName, int tagType);
 unsigned int AavAddFileTag(const char* tagName, const char* tagValue);
 unsigned int AavAddUserTag(const char* tagName, const char* tagValue);
 void AavAddOrUpdateImageSectionTag(const char* tagName, const char* tagValue);
+void AavAddOrUpdateImageLayoutTag(unsigned char layoutId, const char* tagName, const char* tagValue);
 void AavEndFile();
+void AavSetupWriteBehind(unsigned int bufferSize, unsigned int durabilityIntervalMs);
+void AavSetupCompressionThreads(unsigned int numberOfThreads);
+void AavSetupStatusDeltaEncoding(unsigned int snapshotInterval);
+void AavSetupLagarith16TableReuse(unsigned int tablesKeyFrame);
+void AavSetupSceneChangeKeyFrames(unsigned int sceneChangeThreshold);
+void AavSetupPixelsCrc(bool enabled);
+void AavSetupTiles(unsigned int tileSize);
+bool AavRecoverFile(const char* fileName, unsigned int* recoveredFrames);
+bool AavOpenReader(const char* fileName);
+void AavCloseReader();
 bool AavBeginFrame(long long timeStamp, unsigned int elapsedTime, unsigned int exposure);
+void AavFrameSetTrackedPosition(unsigned char layoutId, bool isLocated, double x, double y);
+void AavFrameSetRegionsOfInterest(unsigned char layoutId, unsigned int regionsCount, const unsigned int* regions);
 void AavFrameAddImage(unsigned char layoutId, unsigned char* pixels);
 void AavFrameAddImage16(unsigned char layoutId,  unsigned short* pixels);
 void AavFrameAddStatusTag(unsigned int tagIndex, const char* tagValue);
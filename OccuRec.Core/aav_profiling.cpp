@@ -2,12 +2,13 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
-#include "StdAfx.h"
+#include "stdafx.h"
 #include "aav_profiling.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <cstring>
-#include "windows.h"
+
+__int64 g_AdvBytesWritten = 0;
 
 int advfclose(FILE* file)
 {
@@ -23,6 +24,7 @@ FILE* advfopen(const char* fileName, const char* modes)
 size_t advfwrite(const void* pData, size_t size, size_t count, FILE* file)
 {
 	size_t written = fwrite(pData, size, count, file);
+	g_AdvBytesWritten += written * size;
 	return written;
 }
 
@@ -21,4 +21,7 @@ int advfseek(FILE* stream, __int64 origin, int whence);
 int advfclose(FILE* file);
 int advfflush(FILE* file);
 
+// Total bytes written with advfwrite()
+extern __int64 g_AdvBytesWritten;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,1080 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+#include "aav_reader.h"
+#include "aav_frames_index.h"
+#include "platform.h"
+#include "crc32c.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FILE_MAGIC 0x46545346
+#define FILE_DATAFORMAT_VERSION 1
+#define FRAME_START_MAGIC 0xEE0122FF
+
+// The frame start magic, the timestamp, the exposure and the length of the image section
+#define FRAME_HEADER_BYTES 20
+
+#define MAX_SYSTEM_METADATA_TAGS 1024
+
+namespace AavLib
+{
+
+AavReader::AavReader()
+{
+	m_View = NULL;
+	m_FileSize = 0;
+	m_IndexEntries = NULL;
+	m_FramesCount = 0;
+	m_IndexRebuilt = false;
+	m_KeyFrames = NULL;
+
+	m_StateDecompress = NULL;
+	m_Lagarith16Decompressor = NULL;
+	m_HasLagarith16Tables = false;
+	m_Lagarith16TablesLayoutId = 0;
+	m_Lagarith16TablesNextFrameNo = 0;
+	m_LocoIDecompressor = NULL;
+	m_Lagarith8Decompressor = NULL;
+	m_DecompressedBytes = NULL;
+	m_MaxDecompressedBytes = 0;
+
+	m_BasePixels = NULL;
+	m_BaseNextFrameNo = 0;
+	m_HasBaseFrame = false;
+	m_FramePixels = NULL;
+	m_ShiftedBasePixels = NULL;
+
+	Width = 0;
+	Height = 0;
+	DataBpp = 0;
+	StatusSectionVersion = 0;
+}
+
+AavReader::~AavReader()
+{
+	CloseFile();
+}
+
+bool AavReader::OpenFile(const char* fileName)
+{
+	CloseFile();
+
+	m_View = PlatformMapFile(fileName, &m_FileSize);
+	if (NULL == m_View)
+		return false;
+
+	__int64 offset = 0;
+	unsigned int magic = 0;
+	unsigned char version = 0;
+	unsigned int framesCount = 0;
+	__int64 indexTableOffset = 0;
+	__int64 systemMetadataTableOffset = 0;
+	__int64 userMetadataTableOffset = 0;
+	unsigned char sectionsCount = 0;
+
+	bool isValid =
+		ReadBytes(&offset, &magic, 4) && magic == FILE_MAGIC &&
+		ReadBytes(&offset, &version, 1) && version == FILE_DATAFORMAT_VERSION &&
+		ReadBytes(&offset, &framesCount, 4) &&
+		ReadBytes(&offset, &indexTableOffset, 8) &&
+		ReadBytes(&offset, &systemMetadataTableOffset, 8) &&
+		ReadBytes(&offset, &userMetadataTableOffset, 8) &&
+		ReadBytes(&offset, &sectionsCount, 1);
+
+	bool hasImageSection = false;
+	bool hasStatusSection = false;
+
+	for (unsigned int i = 0; isValid && i < sectionsCount; i++)
+	{
+		string sectionName;
+		__int64 sectionHeaderOffset;
+		isValid = ReadString(&offset, &sectionName) && ReadBytes(&offset, &sectionHeaderOffset, 8);
+
+		if (isValid && sectionName == "IMAGE")
+		{
+			isValid = ReadImageSectionHeader(sectionHeaderOffset);
+			hasImageSection = true;
+		}
+		else if (isValid && sectionName == "STATUS")
+		{
+			isValid = ReadStatusSectionHeader(sectionHeaderOffset);
+			hasStatusSection = true;
+		}
+	}
+
+	__int64 firstFrameOffset = 0;
+	isValid = isValid && hasImageSection && hasStatusSection && ReadSystemMetadataTable(systemMetadataTableOffset, &firstFrameOffset);
+
+	if (!isValid)
+	{
+		CloseFile();
+		return false;
+	}
+
+	// EndFile() writes the index, then the user metadata table and then their offsets and the frames count
+	if (userMetadataTableOffset <= 0 || userMetadataTableOffset >= m_FileSize || !ReadIndex(indexTableOffset, framesCount))
+		RebuildIndex(firstFrameOffset);
+	else
+		ReadKeyFramesTable(indexTableOffset + 4 + (__int64)framesCount * INDEX_ENTRY_BYTES, userMetadataTableOffset);
+
+	// Enough for the 16 bit pixels and for the diff coded layouts, where the pixels follow the flag and the signs
+	// and are followed by a CRC and by another copy of the pixels, and for the crops after the table of the regions
+	m_MaxDecompressedBytes = 2 * Width * Height + Width * Height / 8 + 16 + AAV_REGIONS_TABLE_BYTES;
+	m_DecompressedBytes = (unsigned char*)malloc(m_MaxDecompressedBytes);
+	m_StateDecompress = (qlz_state_decompress*)malloc(sizeof(qlz_state_decompress));
+	m_Lagarith16Decompressor = new Compressor(Width, Height);
+	m_HasLagarith16Tables = false;
+	m_LocoIDecompressor = new LocoICompressor(Width);
+	m_Lagarith8Decompressor = new Lagarith8Compressor(Width);
+	m_BasePixels = (unsigned char*)malloc(Width * Height * (DataBpp > 8 ? 2 : 1));
+	m_HasBaseFrame = false;
+	m_FramePixels = (unsigned char*)malloc(Width * Height * (DataBpp > 8 ? 2 : 1));
+	m_ShiftedBasePixels = (unsigned char*)malloc(Width * Height * (DataBpp > 8 ? 2 : 1));
+
+	return true;
+}
+
+void AavReader::CloseFile()
+{
+	if (NULL != m_View)
+	{
+		PlatformUnmapFile(m_View, m_FileSize);
+		m_View = NULL;
+	}
+
+	m_FileSize = 0;
+	m_IndexEntries = NULL;
+	m_RebuiltIndexEntries.clear();
+	m_FramesCount = 0;
+	m_IndexRebuilt = false;
+	m_KeyFrames = NULL;
+	m_RebuiltKeyFrames.clear();
+
+	m_Layouts.clear();
+	m_FileTags.clear();
+	StatusTagNames.clear();
+	StatusTagTypes.clear();
+
+	free(m_StateDecompress);
+	m_StateDecompress = NULL;
+	delete m_Lagarith16Decompressor;
+	m_Lagarith16Decompressor = NULL;
+	delete m_LocoIDecompressor;
+	m_LocoIDecompressor = NULL;
+	delete m_Lagarith8Decompressor;
+	m_Lagarith8Decompressor = NULL;
+	free(m_DecompressedBytes);
+	m_DecompressedBytes = NULL;
+	m_MaxDecompressedBytes = 0;
+
+	free(m_BasePixels);
+	m_BasePixels = NULL;
+	m_HasBaseFrame = false;
+	free(m_FramePixels);
+	m_FramePixels = NULL;
+	free(m_ShiftedBasePixels);
+	m_ShiftedBasePixels = NULL;
+}
+
+unsigned int AavReader::GetFramesCount()
+{
+	return m_FramesCount;
+}
+
+bool AavReader::IsIndexRebuilt()
+{
+	return m_IndexRebuilt;
+}
+
+const char* AavReader::GetFileTag(const char* tagName)
+{
+	map<string, string>::iterator tag = m_FileTags.find(tagName);
+	return tag != m_FileTags.end() ? tag->second.c_str() : NULL;
+}
+
+bool AavReader::ReadBytes(__int64* offset, void* data, unsigned int bytesCount)
+{
+	if (*offset < 0 || *offset > m_FileSize - bytesCount)
+		return false;
+
+	memcpy(data, m_View + *offset, bytesCount);
+	*offset += bytesCount;
+	return true;
+}
+
+// As written by WriteString()
+bool AavReader::ReadString(__int64* offset, string* value)
+{
+	unsigned char length;
+	if (!ReadBytes(offset, &length, 1) || *offset > m_FileSize - length)
+		return false;
+
+	value->assign((const char*)m_View + *offset, length);
+	*offset += length;
+	return true;
+}
+
+bool AavReader::ReadImageSectionHeader(__int64 offset)
+{
+	unsigned char version;
+	unsigned char layoutsCount;
+
+	if (!ReadBytes(&offset, &version, 1) || version != 1 ||
+		!ReadBytes(&offset, &Width, 4) || !ReadBytes(&offset, &Height, 4) || !ReadBytes(&offset, &DataBpp, 1) ||
+		!ReadBytes(&offset, &layoutsCount, 1))
+	{
+		return false;
+	}
+
+	// The width and the height are set as 16 bit values by AavDefineImageSection()
+	if (Width == 0 || Height == 0 || Width > 0xFFFF || Height > 0xFFFF)
+		return false;
+
+	for (unsigned int i = 0; i < layoutsCount; i++)
+	{
+		unsigned char layoutId;
+		unsigned char layoutVersion;
+		unsigned char tagsCount;
+		AavReaderLayout layout;
+
+		if (!ReadBytes(&offset, &layoutId, 1) || !ReadBytes(&offset, &layoutVersion, 1) || layoutVersion != 1 ||
+			!ReadBytes(&offset, &layout.Bpp, 1) || !ReadBytes(&offset, &tagsCount, 1))
+		{
+			return false;
+		}
+
+		layout.BytesLayout = FullImageRaw;
+		layout.Compression = UnknownCompression;
+		layout.BaseFrameType = DiffCorrKeyFrame;
+		layout.IsNoImageLayout = false;
+		layout.Lagarith16TablesKeyFrame = 0;
+		layout.HasPixelsCrc = false;
+		layout.HasUncompressedPixelsCrc = false;
+		layout.TileSize = 0;
+		layout.HasMotionVectors = false;
+
+		// The same tags as in AavImageLayout::AddOrUpdateTag()
+		for (unsigned int j = 0; j < tagsCount; j++)
+		{
+			string tagName;
+			string tagValue;
+			if (!ReadString(&offset, &tagName) || !ReadString(&offset, &tagValue))
+				return false;
+
+			if (tagName == "DATA-LAYOUT")
+			{
+				if (tagValue == "FULL-IMAGE-DIFFERENTIAL-CODING") layout.BytesLayout = FullImageDiffCorrWithSigns;
+				if (tagValue == "FULL-IMAGE-DIFFERENTIAL-CODING-NOSIGNS") layout.BytesLayout = FullImageDiffCorrNoSigns;
+				if (tagValue == "FULL-IMAGE-BIT-PACKED") layout.BytesLayout = FullImageBitPacked;
+				if (tagValue == "FULL-IMAGE-TILED") layout.BytesLayout = FullImageTiled;
+				if (tagValue == "REGIONS-OF-INTEREST") layout.BytesLayout = RegionsOfInterest;
+				if (tagValue == "STATUS-CHANNEL-ONLY") layout.IsNoImageLayout = true;
+			}
+			else if (tagName == "SECTION-DATA-COMPRESSION")
+			{
+				if (tagValue == "UNCOMPRESSED") layout.Compression = Uncompressed;
+				if (tagValue == "QUICKLZ") layout.Compression = QuickLZ;
+				if (tagValue == "LAGARITH16") layout.Compression = Lagarith16;
+				if (tagValue == "LOCO-I") layout.Compression = LocoI;
+				if (tagValue == "LAGARITH8") layout.Compression = Lagarith8;
+			}
+			else if (tagName == "LAGARITH16-TABLES-KEY-FRAME")
+			{
+				layout.Lagarith16TablesKeyFrame = (unsigned int)strtoul(tagValue.c_str(), NULL, 10);
+			}
+			else if (tagName == "DIFFCODE-MOTION-COMPENSATION")
+			{
+				layout.HasMotionVectors = tagValue == "TRACKED-OBJECT";
+			}
+			else if (tagName == "TILE-SIZE")
+			{
+				layout.TileSize = (unsigned int)strtoul(tagValue.c_str(), NULL, 10);
+			}
+			else if (tagName == "SECTION-DATA-REDUNDANCY-CHECK")
+			{
+				// The ADV files tagged with CRC32 have another CRC, which is not checked
+				layout.HasPixelsCrc = tagValue == "CRC32C";
+			}
+			else if (tagName == "DIFFCODE-BASE-FRAME")
+			{
+				if (tagValue == "KEY-FRAME") layout.BaseFrameType = DiffCorrKeyFrame;
+				if (tagValue == "PREV-FRAME") layout.BaseFrameType = DiffCorrPrevFrame;
+			}
+		}
+
+		// As in the constructor of AavImageLayout
+		bool isDiffCorrLayout = layout.BytesLayout == FullImageDiffCorrWithSigns || layout.BytesLayout == FullImageDiffCorrNoSigns;
+		layout.HasUncompressedPixelsCrc = layout.HasPixelsCrc && !layout.IsNoImageLayout &&
+			(layout.BytesLayout == FullImageRaw || (isDiffCorrLayout && layout.Bpp > 8));
+
+		m_Layouts[layoutId] = layout;
+	}
+
+	return true;
+}
+
+bool AavReader::ReadStatusSectionHeader(__int64 offset)
+{
+	unsigned char tagsCount;
+	if (!ReadBytes(&offset, &StatusSectionVersion, 1) || !ReadBytes(&offset, &tagsCount, 1))
+		return false;
+
+	for (unsigned int i = 0; i < tagsCount; i++)
+	{
+		string tagName;
+		unsigned char tagType;
+		if (!ReadString(&offset, &tagName) || !ReadBytes(&offset, &tagType, 1))
+			return false;
+
+		StatusTagNames.push_back(tagName);
+		StatusTagTypes.push_back((AavTagType)tagType);
+	}
+
+	return true;
+}
+
+// The first frame follows the system metadata table
+bool AavReader::ReadSystemMetadataTable(__int64 offset, __int64* firstFrameOffset)
+{
+	unsigned int tagsCount;
+	if (offset <= 0 || !ReadBytes(&offset, &tagsCount, 4) || tagsCount > MAX_SYSTEM_METADATA_TAGS)
+		return false;
+
+	for (unsigned int i = 0; i < tagsCount; i++)
+	{
+		string tagName;
+		string tagValue;
+		if (!ReadString(&offset, &tagName) || !ReadString(&offset, &tagValue))
+			return false;
+
+		m_FileTags[tagName] = tagValue;
+	}
+
+	*firstFrameOffset = offset;
+	return true;
+}
+
+// The index table is used in place
+bool AavReader::ReadIndex(__int64 indexTableOffset, unsigned int framesCount)
+{
+	unsigned int indexFramesCount;
+	if (indexTableOffset <= 0 || !ReadBytes(&indexTableOffset, &indexFramesCount, 4) || indexFramesCount != framesCount)
+		return false;
+
+	if ((m_FileSize - indexTableOffset) / INDEX_ENTRY_BYTES < framesCount)
+		return false;
+
+	m_IndexEntries = m_View + indexTableOffset;
+	m_FramesCount = framesCount;
+	m_IndexRebuilt = false;
+	return true;
+}
+
+// The key frames table is between the index table and the user metadata table
+void AavReader::ReadKeyFramesTable(__int64 offset, __int64 endOffset)
+{
+	unsigned int magic;
+	unsigned int framesCount;
+
+	m_KeyFrames = NULL;
+	if (ReadBytes(&offset, &magic, 4) && magic == KEY_FRAMES_TABLE_MAGIC &&
+		ReadBytes(&offset, &framesCount, 4) && framesCount == m_FramesCount &&
+		offset + ((__int64)framesCount + 7) / 8 <= endOffset)
+	{
+		m_KeyFrames = m_View + offset;
+	}
+}
+
+// Checks the frame start magic and that the sections of the frame are complete
+bool AavReader::ReadFrameAt(__int64 offset, long long minTimeStamp, AavReaderFrame* frame, unsigned int* frameBytesCount)
+{
+	unsigned int magic;
+	unsigned int imageSectionBytes;
+	unsigned int statusSectionBytes;
+
+	// At least the layout id and the byte mode
+	if (!ReadBytes(&offset, &magic, 4) || magic != FRAME_START_MAGIC ||
+		!ReadBytes(&offset, &frame->TimeStamp, 8) || frame->TimeStamp < minTimeStamp ||
+		!ReadBytes(&offset, &frame->Exposure, 4) ||
+		!ReadBytes(&offset, &imageSectionBytes, 4) || imageSectionBytes < 2 || imageSectionBytes > m_FileSize - offset)
+	{
+		return false;
+	}
+
+	frame->LayoutId = m_View[offset];
+	frame->ByteMode = m_View[offset + 1];
+	frame->ImageBytes = m_View + offset + 2;
+	frame->ImageBytesCount = imageSectionBytes - 2;
+	offset += imageSectionBytes;
+
+	// The motion vector is stored uncompressed before the image bytes
+	frame->MotionX = 0;
+	frame->MotionY = 0;
+	map<unsigned char, AavReaderLayout>::iterator layoutEntry = m_Layouts.find(frame->LayoutId);
+	if (layoutEntry != m_Layouts.end() && layoutEntry->second.HasMotionVectors)
+	{
+		if (frame->ImageBytesCount < 4)
+			return false;
+
+		frame->MotionX = (short)(frame->ImageBytes[0] | (frame->ImageBytes[1] << 8));
+		frame->MotionY = (short)(frame->ImageBytes[2] | (frame->ImageBytes[3] << 8));
+		frame->ImageBytes += 4;
+		frame->ImageBytesCount -= 4;
+	}
+
+	// And the CRC after them, except in the frames without an image
+	frame->PixelsCrc = NULL;
+	if (layoutEntry != m_Layouts.end() && layoutEntry->second.HasUncompressedPixelsCrc && frame->ImageBytesCount > 0)
+	{
+		if (frame->ImageBytesCount < 4)
+			return false;
+
+		frame->ImageBytesCount -= 4;
+		frame->PixelsCrc = frame->ImageBytes + frame->ImageBytesCount;
+	}
+
+	// At least the number of tags
+	if (!ReadBytes(&offset, &statusSectionBytes, 4) || statusSectionBytes < 1 || statusSectionBytes > m_FileSize - offset)
+		return false;
+
+	frame->StatusBytes = m_View + offset;
+	frame->StatusBytesCount = statusSectionBytes;
+
+	// Excluding the frame start magic, as in the index
+	*frameBytesCount = 12 + 4 + imageSectionBytes + 4 + statusSectionBytes;
+	return true;
+}
+
+// The next intact frame after a damaged one. The magic can also occur in the compressed images, so the frame
+// must be followed by another frame or by the end of the file
+bool AavReader::SearchFrame(__int64 offset, long long minTimeStamp, AavReaderFrame* frame, __int64* frameOffset, unsigned int* frameBytesCount)
+{
+	for (; offset + FRAME_HEADER_BYTES <= m_FileSize; offset++)
+	{
+		const unsigned char* bytes = m_View + offset;
+		if (bytes[0] != 0xFF || bytes[1] != 0x22 || bytes[2] != 0x01 || bytes[3] != 0xEE)
+			continue;
+
+		if (!ReadFrameAt(offset, minTimeStamp, frame, frameBytesCount))
+			continue;
+
+		__int64 frameEnd = offset + 4 + *frameBytesCount;
+		unsigned int magic;
+		if (frameEnd == m_FileSize || (ReadBytes(&frameEnd, &magic, 4) && magic == FRAME_START_MAGIC))
+		{
+			*frameOffset = offset;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// The frames are walked by their section lengths, as RecoverFile() does. The torn frames at the end are left out
+void AavReader::RebuildIndex(__int64 firstFrameOffset)
+{
+	__int64 frameOffset = firstFrameOffset;
+	unsigned int frameNo = 0;
+	long long firstTimeStamp = 0;
+	long long lastTimeStamp = 0;
+	AavReaderFrame frame;
+	unsigned int frameBytesCount;
+	unsigned char entryBytes[INDEX_ENTRY_BYTES];
+
+	m_RebuiltIndexEntries.clear();
+	m_RebuiltKeyFrames.clear();
+
+	while (frameOffset < m_FileSize)
+	{
+		if (!ReadFrameAt(frameOffset, lastTimeStamp, &frame, &frameBytesCount) &&
+			!SearchFrame(frameOffset + 1, lastTimeStamp, &frame, &frameOffset, &frameBytesCount))
+		{
+			break;
+		}
+
+		if (frameNo == 0)
+			firstTimeStamp = frame.TimeStamp;
+
+		// In milliseconds since the first frame
+		GetIndexEntryBytes(entryBytes, (unsigned int)(frame.TimeStamp - firstTimeStamp), frameOffset, frameBytesCount);
+		m_RebuiltIndexEntries.insert(m_RebuiltIndexEntries.end(), entryBytes, entryBytes + INDEX_ENTRY_BYTES);
+
+		if ((frameNo & 7) == 0)
+			m_RebuiltKeyFrames.push_back(0);
+		if (frame.ByteMode != DiffCorrBytes)
+			m_RebuiltKeyFrames[frameNo >> 3] |= (unsigned char)(1 << (frameNo & 7));
+
+		frameNo++;
+		lastTimeStamp = frame.TimeStamp;
+		frameOffset += 4 + frameBytesCount;
+	}
+
+	m_IndexEntries = frameNo > 0 ? &m_RebuiltIndexEntries[0] : NULL;
+	m_KeyFrames = frameNo > 0 ? &m_RebuiltKeyFrames[0] : NULL;
+	m_FramesCount = frameNo;
+	m_IndexRebuilt = true;
+}
+
+bool AavReader::GetFrame(unsigned int frameNo, AavReaderFrame* frame)
+{
+	if (frameNo >= m_FramesCount)
+		return false;
+
+	const unsigned char* entryBytes = m_IndexEntries + (size_t)frameNo * INDEX_ENTRY_BYTES;
+	__int64 frameOffset;
+	unsigned int bytesCount;
+	unsigned int frameBytesCount;
+	memcpy(&frame->ElapsedTime, entryBytes, 4);
+	memcpy(&frameOffset, entryBytes + 4, 8);
+	memcpy(&bytesCount, entryBytes + 12, 4);
+	frame->FrameNo = frameNo;
+
+	return ReadFrameAt(frameOffset, LLONG_MIN, frame, &frameBytesCount) && frameBytesCount == bytesCount;
+}
+
+int AavReader::FindKeyFrame(unsigned int frameNo)
+{
+	if (frameNo >= m_FramesCount)
+		return -1;
+
+	if (NULL != m_KeyFrames)
+	{
+		// The bits of the frames after frameNo are masked out of its byte, then the bytes before it are searched
+		int byteNo = (int)(frameNo >> 3);
+		unsigned int bits = m_KeyFrames[byteNo] & ((2u << (frameNo & 7)) - 1);
+		while (bits == 0 && byteNo > 0)
+			bits = m_KeyFrames[--byteNo];
+
+		if (bits == 0)
+			return -1;
+
+		int bitNo = 7;
+		while ((bits & (1 << bitNo)) == 0)
+			bitNo--;
+
+		return 8 * byteNo + bitNo;
+	}
+
+	AavReaderFrame frame;
+	for (int keyFrameNo = (int)frameNo; keyFrameNo >= 0; keyFrameNo--)
+	{
+		if (!GetFrame((unsigned int)keyFrameNo, &frame))
+			return -1;
+
+		if (frame.ByteMode != DiffCorrBytes)
+			return keyFrameNo;
+	}
+
+	return -1;
+}
+
+// Loads the tables stored by the last frame of the layout before the frame, which is at most the tables key frame
+// interval of the layout before it
+bool AavReader::LoadLagarith16Tables(const AavReaderLayout* layout, const AavReaderFrame* frame)
+{
+	unsigned int framesCount = 0;
+	unsigned int frameNo = frame->FrameNo;
+
+	while (frameNo > 0 && framesCount < layout->Lagarith16TablesKeyFrame)
+	{
+		frameNo--;
+
+		AavReaderFrame tablesFrame;
+		if (!GetFrame(frameNo, &tablesFrame))
+			return false;
+
+		// The frames of the other layouts and without an image were not compressed by the compressor of the layout
+		if (tablesFrame.LayoutId != frame->LayoutId || tablesFrame.ImageBytesCount == 0)
+			continue;
+
+		if (!Compressor::ReusesTables(tablesFrame.ImageBytes, tablesFrame.ImageBytesCount))
+			return m_Lagarith16Decompressor->LoadTables(tablesFrame.ImageBytes, tablesFrame.ImageBytesCount);
+
+		framesCount++;
+	}
+
+	return false;
+}
+
+// Decodes a Lagarith16 image into the decompressed bytes. Frames which reuse the tables of an earlier frame are
+// decoded with the tables of the frame of the layout decoded just before them, or else with the tables loaded
+// from the frame which stored them. Returns the number of bytes used, or a negative value
+int AavReader::DecompressLagarith16(const AavReaderLayout* layout, const AavReaderFrame* frame)
+{
+	int bytesUsed;
+	if (layout->Lagarith16TablesKeyFrame == 0)
+	{
+		bytesUsed = m_Lagarith16Decompressor->DecompressData(frame->ImageBytes, frame->ImageBytesCount, (unsigned short*)m_DecompressedBytes);
+		m_HasLagarith16Tables = false;
+		return bytesUsed;
+	}
+
+	bool hasTables = m_HasLagarith16Tables && m_Lagarith16TablesLayoutId == frame->LayoutId && m_Lagarith16TablesNextFrameNo == frame->FrameNo;
+	if (Compressor::ReusesTables(frame->ImageBytes, frame->ImageBytesCount) && !hasTables && !LoadLagarith16Tables(layout, frame))
+	{
+		m_HasLagarith16Tables = false;
+		return -1;
+	}
+
+	bytesUsed = m_Lagarith16Decompressor->DecompressDataReusingTables(frame->ImageBytes, frame->ImageBytesCount, (unsigned short*)m_DecompressedBytes);
+
+	m_HasLagarith16Tables = bytesUsed >= 0;
+	m_Lagarith16TablesLayoutId = frame->LayoutId;
+	m_Lagarith16TablesNextFrameNo = frame->FrameNo + 1;
+
+	return bytesUsed;
+}
+
+const unsigned char* AavReader::DecompressImage(const AavReaderLayout* layout, const AavReaderFrame* frame, unsigned int* bytesCount)
+{
+	if (layout->Compression == Uncompressed)
+	{
+		*bytesCount = frame->ImageBytesCount;
+		return frame->ImageBytes;
+	}
+
+	if (layout->Compression == QuickLZ)
+	{
+		// The header is 3 bytes, or 9 bytes when bit 1 of the first byte is set
+		const char* source = (const char*)frame->ImageBytes;
+		if (frame->ImageBytesCount < 3 || ((source[0] & 2) != 0 && frame->ImageBytesCount < 9) ||
+			qlz_size_compressed(source) != frame->ImageBytesCount || qlz_size_decompressed(source) > m_MaxDecompressedBytes)
+		{
+			return NULL;
+		}
+
+		*bytesCount = (unsigned int)qlz_decompress(source, m_DecompressedBytes, m_StateDecompress);
+		return m_DecompressedBytes;
+	}
+
+	if (layout->Compression == Lagarith16)
+	{
+		// Lagarith16 codes Width * Height 16 bit words, also when they hold the bytes of the 8 bit layouts
+		if (DecompressLagarith16(layout, frame) != (int)frame->ImageBytesCount)
+			return NULL;
+
+		*bytesCount = 2 * Width * Height;
+		return m_DecompressedBytes;
+	}
+
+	if (layout->Compression == Lagarith8)
+	{
+		int samplesCount;
+		if (!Lagarith8Compressor::ReadHeader(frame->ImageBytes, frame->ImageBytesCount, &samplesCount) ||
+			(unsigned int)samplesCount > m_MaxDecompressedBytes ||
+			m_Lagarith8Decompressor->DecompressData(frame->ImageBytes, frame->ImageBytesCount, m_DecompressedBytes) != (int)frame->ImageBytesCount)
+		{
+			return NULL;
+		}
+
+		*bytesCount = (unsigned int)samplesCount;
+		return m_DecompressedBytes;
+	}
+
+	if (layout->Compression == LocoI)
+	{
+		unsigned int samplesCount;
+		unsigned int bitsPerSample;
+		if (!LocoICompressor::ReadHeader(frame->ImageBytes, frame->ImageBytesCount, &samplesCount, &bitsPerSample) ||
+			samplesCount > m_MaxDecompressedBytes / (bitsPerSample / 8) ||
+			m_LocoIDecompressor->DecompressData(frame->ImageBytes, frame->ImageBytesCount, m_DecompressedBytes) != (int)frame->ImageBytesCount)
+		{
+			return NULL;
+		}
+
+		*bytesCount = samplesCount * (bitsPerSample / 8);
+		return m_DecompressedBytes;
+	}
+
+	return NULL;
+}
+
+bool AavReader::DecodeImage(const AavReaderLayout* layout, const AavReaderFrame* frame, const unsigned char* basePixels, unsigned char* pixels)
+{
+	unsigned int pixelsCount = Width * Height;
+
+	if (layout->IsNoImageLayout)
+	{
+		memset(pixels, 0, pixelsCount * (DataBpp > 8 ? 2 : 1));
+		return true;
+	}
+
+	if (layout->BytesLayout == FullImageTiled)
+		return DecodeTiles(layout, frame, 0, 0, Width, Height, pixels);
+
+	if (NULL != basePixels && (frame->MotionX != 0 || frame->MotionY != 0))
+	{
+		ShiftPixels(basePixels, Width, Height, DataBpp > 8 ? 2 : 1, frame->MotionX, frame->MotionY, m_ShiftedBasePixels);
+		basePixels = m_ShiftedBasePixels;
+	}
+
+	unsigned int bytesCount = 0;
+	const unsigned char* bytes = DecompressImage(layout, frame, &bytesCount);
+	if (NULL == bytes)
+		return false;
+
+	if (layout->BytesLayout == FullImageRaw)
+	{
+		unsigned int pixelsBytes = pixelsCount * (DataBpp > 8 ? 2 : 1);
+		if ((layout->Bpp > 8) != (DataBpp > 8) || bytesCount < pixelsBytes)
+			return false;
+
+		memcpy(pixels, bytes, pixelsBytes);
+		return !layout->HasPixelsCrc || (NULL != frame->PixelsCrc && CheckPixelsCrc(pixels, pixelsBytes, frame->PixelsCrc));
+	}
+
+	if (layout->BytesLayout == RegionsOfInterest)
+		return DecodeRegionsOfInterest(layout, frame, bytes, bytesCount, basePixels, pixels);
+
+	if (layout->BytesLayout == FullImageBitPacked)
+	{
+		// The bits per pixel of the frame, which are the bits of the layout or 16, then the packed pixels
+		unsigned int bitsPerPixel = bytesCount > 0 ? bytes[0] : 0;
+		if (DataBpp <= 8 || (bitsPerPixel != layout->Bpp && bitsPerPixel != 16) || bitsPerPixel < 2 || bitsPerPixel > 16 || (bitsPerPixel & 1) != 0)
+			return false;
+
+		unsigned int packedBytes = PackedPixelsBytes(pixelsCount, bitsPerPixel);
+		if (bytesCount < 1 + packedBytes + (layout->HasPixelsCrc ? 4 : 0))
+			return false;
+
+		UnpackPixels16(bytes + 1, pixelsCount, bitsPerPixel, (unsigned short*)pixels);
+		return !layout->HasPixelsCrc || CheckPixelsCrc(pixels, 2 * pixelsCount, bytes + 1 + packedBytes);
+	}
+
+	if (DataBpp > 8)
+	{
+		// The 16 bit diff coded layouts are the pixels, or their zigzag coded differences from the base frame when
+		// the byte mode of the frame says so
+		unsigned int pixelsBytes = 2 * pixelsCount;
+		if (layout->Bpp <= 8 || bytesCount < pixelsBytes)
+			return false;
+
+		if (frame->ByteMode != DiffCorrBytes)
+			memcpy(pixels, bytes, pixelsBytes);
+		else if (NULL == basePixels)
+			return false;
+		else
+			AddPixelsZigZag16((const unsigned short*)basePixels, bytes, pixelsCount, (unsigned short*)pixels);
+
+		return !layout->HasPixelsCrc || (NULL != frame->PixelsCrc && CheckPixelsCrc(pixels, pixelsBytes, frame->PixelsCrc));
+	}
+
+	// The 8 bit diff coded layouts are the GetByteMode flag, the signs of the differences, the pixels or their
+	// differences from the base frame and the CRC of the pixels
+	if (bytesCount < 1)
+		return false;
+
+	bool isDiffFrame = bytes[0] == DiffCorrBytes;
+	unsigned int signsBytesCount = isDiffFrame && layout->BytesLayout == FullImageDiffCorrWithSigns ? pixelsCount / 8 : 0;
+	if (layout->Bpp > 8 || bytesCount < 1 + signsBytesCount + pixelsCount + 4)
+		return false;
+
+	const unsigned char* data = bytes + 1 + signsBytesCount;
+
+	if (!isDiffFrame)
+		memcpy(pixels, data, pixelsCount);
+	else if (layout->BytesLayout == FullImageDiffCorrNoSigns)
+	{
+		// The differences are followed by a copy of the pixels, unless Lagarith16 has cut it to the size of the
+		// 16 bit image and the pixels are added to the base frame instead
+		if (bytesCount >= 1 + pixelsCount + 4 + pixelsCount)
+			memcpy(pixels, data + pixelsCount + 4, pixelsCount);
+		else if (NULL == basePixels)
+			return false;
+		else
+		{
+			for (unsigned int i = 0; i < pixelsCount; i++)
+				pixels[i] = (unsigned char)(basePixels[i] + data[i]);
+		}
+	}
+	else
+	{
+		if (NULL == basePixels)
+			return false;
+
+		// A set sign bit is a negative difference. The pixels may be decoded in place of the base frame
+		AddPixelsWithSigns8(basePixels, bytes + 1, data, pixelsCount, pixels);
+	}
+
+	return !layout->HasPixelsCrc || CheckPixelsCrc(pixels, pixelsCount, data + pixelsCount);
+}
+
+// A reference frame is the whole image and the frames after it are the reference frame with the crops of their
+// regions pasted in. The CRC of a frame is of its pixels or of its crops
+bool AavReader::DecodeRegionsOfInterest(const AavReaderLayout* layout, const AavReaderFrame* frame, const unsigned char* bytes, unsigned int bytesCount, const unsigned char* basePixels, unsigned char* pixels)
+{
+	unsigned int pixelBytes = DataBpp > 8 ? 2 : 1;
+	unsigned int pixelsBytes = Width * Height * pixelBytes;
+	unsigned int crcBytes = layout->HasPixelsCrc ? 4 : 0;
+	if ((layout->Bpp > 8) != (DataBpp > 8))
+		return false;
+
+	if (frame->ByteMode != DiffCorrBytes)
+	{
+		if (bytesCount < pixelsBytes + crcBytes)
+			return false;
+
+		memcpy(pixels, bytes, pixelsBytes);
+		return !layout->HasPixelsCrc || CheckPixelsCrc(pixels, pixelsBytes, bytes + pixelsBytes);
+	}
+
+	unsigned int regionsCount = bytesCount >= 2 ? bytes[0] | (bytes[1] << 8) : 0;
+	unsigned int tableBytes = 2 + 8 * regionsCount;
+	if (NULL == basePixels || bytesCount < 2 || regionsCount > AAV_MAX_REGIONS_OF_INTEREST || bytesCount < tableBytes + crcBytes)
+		return false;
+
+	const unsigned char* crops = bytes + tableBytes;
+	unsigned int cropsBytes = bytesCount - tableBytes - crcBytes;
+	unsigned int cropsEnd = 0;
+
+	if (pixels != basePixels)
+		memcpy(pixels, basePixels, pixelsBytes);
+
+	for (unsigned int i = 0; i < regionsCount; i++)
+	{
+		const unsigned char* entry = bytes + 2 + 8 * i;
+		AavTile region;
+		region.X = entry[0] | (entry[1] << 8);
+		region.Y = entry[2] | (entry[3] << 8);
+		region.Width = entry[4] | (entry[5] << 8);
+		region.Height = entry[6] | (entry[7] << 8);
+		region.FirstPixel = cropsEnd / pixelBytes;
+
+		unsigned int regionBytes = region.Width * region.Height * pixelBytes;
+		if (region.X >= Width || region.Y >= Height || region.Width > Width - region.X || region.Height > Height - region.Y || regionBytes > cropsBytes - cropsEnd)
+			return false;
+
+		CopyTileToRegion(crops + cropsEnd, &region, pixelBytes, 0, 0, Width, Height, pixels);
+		cropsEnd += regionBytes;
+	}
+
+	return !layout->HasPixelsCrc || CheckPixelsCrc(crops, cropsEnd, crops + cropsEnd);
+}
+
+// The CRC is of the decoded pixels, so it also catches a wrong base frame
+bool AavReader::CheckPixelsCrc(const unsigned char* pixels, unsigned int pixelsBytes, const unsigned char* crcBytes)
+{
+	unsigned int crc = crcBytes[0] | (crcBytes[1] << 8) | (crcBytes[2] << 16) | ((unsigned int)crcBytes[3] << 24);
+
+	return compute_crc32c(pixels, pixelsBytes) == crc;
+}
+
+bool AavReader::DecompressTile(const AavReaderLayout* layout, const unsigned char* compressedTile, unsigned int compressedBytes, const AavTile* tile, unsigned char* tilePixels)
+{
+	unsigned int pixelBytes = DataBpp > 8 ? 2 : 1;
+	unsigned int tileBytes = tile->Width * tile->Height * pixelBytes;
+
+	if (layout->Compression == Uncompressed)
+	{
+		if (compressedBytes != tileBytes)
+			return false;
+
+		memcpy(tilePixels, compressedTile, tileBytes);
+		return true;
+	}
+
+	if (layout->Compression == QuickLZ)
+	{
+		// The tiles are compressed on their own, also when the QUICKLZ frames of the other layouts are streamed
+		const char* source = (const char*)compressedTile;
+		if (compressedBytes < 3 || ((source[0] & 2) != 0 && compressedBytes < 9) ||
+			qlz_size_compressed(source) != compressedBytes || qlz_size_decompressed(source) != tileBytes)
+		{
+			return false;
+		}
+
+		return qlz_decompress(source, tilePixels, m_StateDecompress) == tileBytes;
+	}
+
+	if (layout->Compression == LocoI)
+	{
+		unsigned int samplesCount;
+		unsigned int bitsPerSample;
+		return
+			LocoICompressor::ReadHeader(compressedTile, compressedBytes, &samplesCount, &bitsPerSample) &&
+			samplesCount == tile->Width * tile->Height && bitsPerSample == 8 * pixelBytes &&
+			m_LocoIDecompressor->DecompressData(compressedTile, compressedBytes, tile->Width, tilePixels) == (int)compressedBytes;
+	}
+
+	if (layout->Compression == Lagarith8)
+	{
+		int samplesCount;
+		return
+			Lagarith8Compressor::ReadHeader(compressedTile, compressedBytes, &samplesCount) &&
+			(unsigned int)samplesCount == tileBytes &&
+			m_Lagarith8Decompressor->DecompressData(compressedTile, compressedBytes, tile->Width * pixelBytes, tilePixels) == (int)compressedBytes;
+	}
+
+	return false;
+}
+
+// The tiled frames start with the end offsets of the tiles, counted from the end of the table, each followed by the
+// CRC of the pixels of the tile when the layout has them. Only the tiles which overlap the region are decompressed
+bool AavReader::DecodeTiles(const AavReaderLayout* layout, const AavReaderFrame* frame, unsigned int x, unsigned int y, unsigned int width, unsigned int height, unsigned char* pixels)
+{
+	unsigned int pixelBytes = DataBpp > 8 ? 2 : 1;
+	unsigned int tileSize = layout->TileSize;
+	if ((layout->Bpp > 8) != (DataBpp > 8) || tileSize == 0)
+		return false;
+
+	unsigned int tilesCount = TilesCount(Width, Height, tileSize);
+	unsigned int entryBytes = layout->HasPixelsCrc ? 8 : 4;
+	if (frame->ImageBytesCount < tilesCount * entryBytes)
+		return false;
+
+	const unsigned char* compressedTiles = frame->ImageBytes + tilesCount * entryBytes;
+	unsigned int compressedTilesBytes = frame->ImageBytesCount - tilesCount * entryBytes;
+	unsigned int tilesPerRow = (Width + tileSize - 1) / tileSize;
+
+	for (unsigned int tileRow = y / tileSize; tileRow <= (y + height - 1) / tileSize; tileRow++)
+	{
+		for (unsigned int tileColumn = x / tileSize; tileColumn <= (x + width - 1) / tileSize; tileColumn++)
+		{
+			unsigned int tileNo = tileRow * tilesPerRow + tileColumn;
+			const unsigned char* entry = frame->ImageBytes + tileNo * entryBytes;
+			const unsigned char* previousEntry = entry - entryBytes;
+			unsigned int tileEnd = entry[0] | (entry[1] << 8) | (entry[2] << 16) | ((unsigned int)entry[3] << 24);
+			unsigned int tileStart = tileNo == 0 ? 0 : previousEntry[0] | (previousEntry[1] << 8) | (previousEntry[2] << 16) | ((unsigned int)previousEntry[3] << 24);
+			if (tileStart > tileEnd || tileEnd > compressedTilesBytes)
+				return false;
+
+			AavTile tile;
+			GetTile(Width, Height, tileSize, tileNo, &tile);
+
+			if (!DecompressTile(layout, compressedTiles + tileStart, tileEnd - tileStart, &tile, m_DecompressedBytes) ||
+				(layout->HasPixelsCrc && !CheckPixelsCrc(m_DecompressedBytes, tile.Width * tile.Height * pixelBytes, entry + 4)))
+			{
+				return false;
+			}
+
+			CopyTileToRegion(m_DecompressedBytes, &tile, pixelBytes, x, y, width, height, pixels);
+		}
+	}
+
+	return true;
+}
+
+// Decodes into m_BasePixels the frame which the diff frame frameNo was coded from, starting with its key frame
+bool AavReader::LoadBaseFrame(unsigned int frameNo, const AavReaderLayout* layout, unsigned char layoutId)
+{
+	if (m_HasBaseFrame && m_BaseNextFrameNo == frameNo)
+		return true;
+
+	m_HasBaseFrame = false;
+
+	// A new layout starts with a key frame, so the frames from the key frame are all of the layout
+	AavReaderFrame frame;
+	int keyFrameNo = frameNo > 0 ? FindKeyFrame(frameNo - 1) : -1;
+	if (keyFrameNo < 0 || !GetFrame((unsigned int)keyFrameNo, &frame) || frame.LayoutId != layoutId)
+		return false;
+
+	if (!DecodeImage(layout, &frame, NULL, m_BasePixels))
+		return false;
+
+	if (layout->BaseFrameType == DiffCorrPrevFrame)
+	{
+		for (unsigned int baseFrameNo = keyFrameNo + 1; baseFrameNo < frameNo; baseFrameNo++)
+		{
+			if (!GetFrame(baseFrameNo, &frame) || frame.LayoutId != layoutId || !DecodeImage(layout, &frame, m_BasePixels, m_BasePixels))
+				return false;
+		}
+	}
+
+	m_HasBaseFrame = true;
+	m_BaseNextFrameNo = frameNo;
+	return true;
+}
+
+// The diff frames of the layout with signs, of the layout without signs when the copy of their pixels does not
+// fit in the Lagarith16 image, and of the 16 bit layouts, which have no copy, are added to the base frame. The crops
+// of the regions of interest are pasted into their reference frame
+bool AavReader::UsesBaseFrame(const AavReaderLayout* layout)
+{
+	if (layout->IsNoImageLayout)
+		return false;
+
+	return
+		layout->BytesLayout == RegionsOfInterest ||
+		layout->BytesLayout == FullImageDiffCorrWithSigns ||
+		(layout->BytesLayout == FullImageDiffCorrNoSigns && (layout->Compression == Lagarith16 || layout->Bpp > 8));
+}
+
+unsigned int AavReader::DecodeFrames(unsigned int firstFrameNo, unsigned int framesCount, unsigned char* pixels, AavReaderFrame* frames)
+{
+	if (NULL == m_View)
+		return 0;
+
+	size_t frameBytes = (size_t)Width * Height * (DataBpp > 8 ? 2 : 1);
+
+	for (unsigned int i = 0; i < framesCount; i++)
+	{
+		unsigned int frameNo = firstFrameNo + i;
+		unsigned char* framePixels = pixels + i * frameBytes;
+		AavReaderFrame frame;
+
+		if (frameNo < firstFrameNo || !GetFrame(frameNo, &frame))
+			return i;
+
+		map<unsigned char, AavReaderLayout>::iterator layoutEntry = m_Layouts.find(frame.LayoutId);
+		if (layoutEntry == m_Layouts.end())
+			return i;
+
+		const AavReaderLayout* layout = &layoutEntry->second;
+
+		bool usesBaseFrame = UsesBaseFrame(layout);
+		bool isDiffFrame = usesBaseFrame && frame.ByteMode == DiffCorrBytes;
+
+		if (isDiffFrame && !LoadBaseFrame(frameNo, layout, frame.LayoutId))
+			return i;
+
+		if (!DecodeImage(layout, &frame, isDiffFrame ? m_BasePixels : NULL, framePixels))
+		{
+			m_HasBaseFrame = false;
+			return i;
+		}
+
+		if (usesBaseFrame)
+		{
+			if (!isDiffFrame || layout->BaseFrameType == DiffCorrPrevFrame)
+				memcpy(m_BasePixels, framePixels, frameBytes);
+
+			m_HasBaseFrame = true;
+			m_BaseNextFrameNo = frameNo + 1;
+		}
+
+		if (NULL != frames)
+			frames[i] = frame;
+	}
+
+	return framesCount;
+}
+
+bool AavReader::DecodeRegion(unsigned int frameNo, unsigned int x, unsigned int y, unsigned int width, unsigned int height, unsigned char* pixels)
+{
+	if (NULL == m_View || width == 0 || height == 0 || x >= Width || y >= Height || width > Width - x || height > Height - y)
+		return false;
+
+	AavReaderFrame frame;
+	if (!GetFrame(frameNo, &frame))
+		return false;
+
+	map<unsigned char, AavReaderLayout>::iterator layoutEntry = m_Layouts.find(frame.LayoutId);
+	if (layoutEntry == m_Layouts.end())
+		return false;
+
+	if (layoutEntry->second.BytesLayout == FullImageTiled && !layoutEntry->second.IsNoImageLayout)
+		return DecodeTiles(&layoutEntry->second, &frame, x, y, width, height, pixels);
+
+	if (DecodeFrames(frameNo, 1, m_FramePixels, NULL) != 1)
+		return false;
+
+	AavTile image = { 0, 0, Width, Height, 0 };
+	CopyTileToRegion(m_FramePixels, &image, DataBpp > 8 ? 2 : 1, x, y, width, height, pixels);
+	return true;
+}
+
+}
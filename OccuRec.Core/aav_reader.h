@@ -0,0 +1,187 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef ADVREADER_H
+#define ADVREADER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "utils.h"
+#include "quicklz.h"
+#include "Compressor.h"
+#include "LocoICompressor.h"
+#include "Lagarith8Compressor.h"
+#include "aav_bit_packing.h"
+#include "aav_diff_coding.h"
+#include "aav_tiles.h"
+
+using namespace std;
+using std::string;
+
+namespace AavLib
+{
+
+enum AavCompression
+{
+	Uncompressed = 0,
+	QuickLZ = 1,
+	Lagarith16 = 2,
+	LocoI = 3,
+	Lagarith8 = 4,
+	UnknownCompression = 5
+};
+
+// An image layout as defined in the header of the image section
+struct AavReaderLayout
+{
+	unsigned char Bpp;
+	ImageBytesLayout BytesLayout;
+	AavCompression Compression;
+	DiffCorrBaseFrame BaseFrameType;
+	bool IsNoImageLayout;
+	// The interval of the frames which store the Lagarith16 tables, 0 when every frame stores them
+	unsigned int Lagarith16TablesKeyFrame;
+	// Whether the pixels are followed by their CRC-32C, which is checked when they are decoded. The raw layouts and
+	// the 16 bit diff coded layouts store it uncompressed after the compressed bytes
+	bool HasPixelsCrc;
+	bool HasUncompressedPixelsCrc;
+	// The tile size of the FULL-IMAGE-TILED layouts
+	unsigned int TileSize;
+	// Whether the image bytes of the frames start with the motion vector by which the base frame is shifted
+	bool HasMotionVectors;
+};
+
+// A frame as found in the mapped file. The image bytes follow the layout id and the byte mode, and the motion
+// vector of the motion compensated layouts, and are still compressed. They exclude the CRC stored after them. The
+// status bytes are as written by the status section
+struct AavReaderFrame
+{
+	unsigned int FrameNo;
+	long long TimeStamp;
+	unsigned int Exposure;
+	unsigned int ElapsedTime;
+	unsigned char LayoutId;
+	unsigned char ByteMode;
+	// The offset of the frame from its base frame, by which the base frame is shifted before the differences are added
+	int MotionX;
+	int MotionY;
+	// The CRC of the pixels stored uncompressed after the image bytes, or NULL
+	const unsigned char* PixelsCrc;
+	const unsigned char* ImageBytes;
+	unsigned int ImageBytesCount;
+	const unsigned char* StatusBytes;
+	unsigned int StatusBytesCount;
+};
+
+// Reads an AAV file through a read only mapping of the whole file. The header, the section definitions and the
+// index are parsed once by OpenFile(), after which any frame is found with one lookup in the index table and
+// decoded without reading the frames before it, except for the diff coded frames which need their key frame or
+// previous frame. The key frames are found in the key frames table which follows the index. The last decoded
+// base frame is kept, so frames read in order are each decoded once. A file which was not ended by EndFile(), e.g.
+// one still being recorded or left by a crash, has no index and its frames are found by walking them by their
+// section lengths and searching for the frame start magic after a damaged one, as RecoverFile() does, but without
+// changing the file. Not thread safe
+class AavReader {
+
+	private:
+		const unsigned char* m_View;
+		__int64 m_FileSize;
+
+		// The index table of the file, or the one rebuilt from the frames when the file has no index
+		const unsigned char* m_IndexEntries;
+		vector<unsigned char> m_RebuiltIndexEntries;
+		unsigned int m_FramesCount;
+		bool m_IndexRebuilt;
+
+		// The key frame bits of the key frames table or of the rebuilt index, NULL for the files written before the
+		// key frames table, whose key frames are found by reading the frames
+		const unsigned char* m_KeyFrames;
+		vector<unsigned char> m_RebuiltKeyFrames;
+
+		map<unsigned char, AavReaderLayout> m_Layouts;
+		map<string, string> m_FileTags;
+
+		qlz_state_decompress* m_StateDecompress;
+		Compressor* m_Lagarith16Decompressor;
+		// The layout and the next frame of the last frame decoded with the Lagarith16 tables which are loaded
+		bool m_HasLagarith16Tables;
+		unsigned char m_Lagarith16TablesLayoutId;
+		unsigned int m_Lagarith16TablesNextFrameNo;
+		LocoICompressor* m_LocoIDecompressor;
+		Lagarith8Compressor* m_Lagarith8Decompressor;
+		unsigned char* m_DecompressedBytes;
+		unsigned int m_MaxDecompressedBytes;
+
+		// The frame of a diff coded layout which m_BaseNextFrameNo is added to
+		unsigned char* m_BasePixels;
+		unsigned int m_BaseNextFrameNo;
+		bool m_HasBaseFrame;
+
+		// The whole image of a frame which is not tiled, which a region is cropped from
+		unsigned char* m_FramePixels;
+		// The base frame shifted by the motion vector of a motion compensated frame
+		unsigned char* m_ShiftedBasePixels;
+
+		bool ReadBytes(__int64* offset, void* data, unsigned int bytesCount);
+		bool ReadString(__int64* offset, string* value);
+		bool ReadImageSectionHeader(__int64 offset);
+		bool ReadStatusSectionHeader(__int64 offset);
+		bool ReadSystemMetadataTable(__int64 offset, __int64* firstFrameOffset);
+		bool ReadIndex(__int64 indexTableOffset, unsigned int framesCount);
+		void ReadKeyFramesTable(__int64 offset, __int64 endOffset);
+		bool ReadFrameAt(__int64 offset, long long minTimeStamp, AavReaderFrame* frame, unsigned int* frameBytesCount);
+		bool SearchFrame(__int64 offset, long long minTimeStamp, AavReaderFrame* frame, __int64* frameOffset, unsigned int* frameBytesCount);
+		void RebuildIndex(__int64 firstFrameOffset);
+
+		bool LoadLagarith16Tables(const AavReaderLayout* layout, const AavReaderFrame* frame);
+		int DecompressLagarith16(const AavReaderLayout* layout, const AavReaderFrame* frame);
+		const unsigned char* DecompressImage(const AavReaderLayout* layout, const AavReaderFrame* frame, unsigned int* bytesCount);
+		bool DecodeImage(const AavReaderLayout* layout, const AavReaderFrame* frame, const unsigned char* basePixels, unsigned char* pixels);
+		bool DecodeRegionsOfInterest(const AavReaderLayout* layout, const AavReaderFrame* frame, const unsigned char* bytes, unsigned int bytesCount, const unsigned char* basePixels, unsigned char* pixels);
+		bool CheckPixelsCrc(const unsigned char* pixels, unsigned int pixelsBytes, const unsigned char* crcBytes);
+		bool DecompressTile(const AavReaderLayout* layout, const unsigned char* compressedTile, unsigned int compressedBytes, const AavTile* tile, unsigned char* tilePixels);
+		bool DecodeTiles(const AavReaderLayout* layout, const AavReaderFrame* frame, unsigned int x, unsigned int y, unsigned int width, unsigned int height, unsigned char* pixels);
+		bool LoadBaseFrame(unsigned int frameNo, const AavReaderLayout* layout, unsigned char layoutId);
+		bool UsesBaseFrame(const AavReaderLayout* layout);
+
+	public:
+		unsigned int Width;
+		unsigned int Height;
+		unsigned char DataBpp;
+
+		unsigned char StatusSectionVersion;
+		vector<string> StatusTagNames;
+		vector<AavTagType> StatusTagTypes;
+
+	public:
+		AavReader();
+		~AavReader();
+
+		bool OpenFile(const char* fileName);
+		void CloseFile();
+
+		unsigned int GetFramesCount();
+		// Whether the file had no index and its frames were found by walking them
+		bool IsIndexRebuilt();
+		// The value of a system metadata tag, or NULL
+		const char* GetFileTag(const char* tagName);
+
+		bool GetFrame(unsigned int frameNo, AavReaderFrame* frame);
+		// The last key frame at or before frameNo, which is decoded without the frames before it, or -1. Seeking to a
+		// frame decodes the frames from its key frame
+		int FindKeyFrame(unsigned int frameNo);
+		// Decodes the images of framesCount frames into pixels, Width * Height pixels per frame of 1 byte, or of 2
+		// bytes when DataBpp is above 8. The frames may be NULL. Returns the number of frames decoded, which is less
+		// than framesCount if a frame cannot be decoded or its pixels do not match their CRC
+		unsigned int DecodeFrames(unsigned int firstFrameNo, unsigned int framesCount, unsigned char* pixels, AavReaderFrame* frames);
+		// Decodes the region of the image of the frame into pixels, width * height pixels of 1 or 2 bytes. Only the
+		// tiles which overlap the region are decompressed when the frame is tiled, and the other frames are decoded
+		// whole and cropped
+		bool DecodeRegion(unsigned int frameNo, unsigned int x, unsigned int y, unsigned int width, unsigned int height, unsigned char* pixels);
+};
+
+}
+
+#endif // ADVREADER_H
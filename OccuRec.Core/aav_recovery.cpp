@@ -0,0 +1,297 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+#include "aav_recovery.h"
+#include "aav_frames_index.h"
+#include "aav_profiling.h"
+#include "platform.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FILE_MAGIC 0x46545346
+#define FILE_HEADER_BYTES 0x21
+#define FRAME_START_MAGIC 0xEE0122FF
+
+// The frame start magic, the timestamp, the exposure and the length of the image section
+#define FRAME_HEADER_BYTES 20
+
+// Read at once when searching for the start of a frame after a damaged one
+#define SEARCH_BLOCK_BYTES (1024 * 1024)
+
+#define MAX_SYSTEM_METADATA_TAGS 1024
+
+namespace AavLib
+{
+
+struct RecoveredFrame
+{
+	__int64 Offset;
+	// Excluding the frame start magic, as in the index
+	unsigned int BytesCount;
+	long long TimeStamp;
+	// Not coded from a base frame
+	bool IsKeyFrame;
+};
+
+static bool ReadAt(FILE* file, __int64 offset, void* data, unsigned int bytes)
+{
+	if (0 != advfsetpos64(file, &offset))
+		return false;
+
+	return fread(data, 1, bytes, file) == bytes;
+}
+
+// Checks the frame start magic and that the sections of the frame are complete
+static bool ReadFrame(FILE* file, __int64 offset, __int64 fileSize, long long minTimeStamp, RecoveredFrame* frame)
+{
+	// Also the layout id and the byte mode
+	unsigned char header[FRAME_HEADER_BYTES + 2];
+	if (offset + FRAME_HEADER_BYTES + 2 > fileSize || !ReadAt(file, offset, header, FRAME_HEADER_BYTES + 2))
+		return false;
+
+	unsigned int magic;
+	memcpy(&magic, header, 4);
+	if (magic != FRAME_START_MAGIC)
+		return false;
+
+	// The frames are recorded in time order
+	long long timeStamp;
+	memcpy(&timeStamp, header + 4, 8);
+	if (timeStamp < minTimeStamp)
+		return false;
+
+	// At least the layout id and the byte mode
+	unsigned int imageSectionBytes;
+	memcpy(&imageSectionBytes, header + 16, 4);
+	if (imageSectionBytes < 2)
+		return false;
+
+	__int64 statusSectionOffset = offset + FRAME_HEADER_BYTES + imageSectionBytes;
+	unsigned int statusSectionBytes;
+	if (statusSectionOffset + 4 > fileSize || !ReadAt(file, statusSectionOffset, &statusSectionBytes, 4))
+		return false;
+
+	// At least the number of tags
+	if (statusSectionBytes < 1 || statusSectionOffset + 4 + statusSectionBytes > fileSize)
+		return false;
+
+	frame->Offset = offset;
+	frame->BytesCount = 12 + 4 + imageSectionBytes + 4 + statusSectionBytes;
+	frame->TimeStamp = timeStamp;
+	frame->IsKeyFrame = header[FRAME_HEADER_BYTES + 1] != DiffCorrBytes;
+
+	return true;
+}
+
+static bool IsFrameStart(FILE* file, __int64 offset)
+{
+	unsigned int magic;
+	return ReadAt(file, offset, &magic, 4) && magic == FRAME_START_MAGIC;
+}
+
+// The next intact frame after a damaged one. The magic can also occur in the compressed images, so the frame
+// must be followed by another frame or by the end of the file
+static bool SearchFrame(FILE* file, __int64 offset, __int64 fileSize, long long minTimeStamp, RecoveredFrame* frame)
+{
+	unsigned char* block = (unsigned char*)malloc(SEARCH_BLOCK_BYTES);
+	bool found = false;
+
+	while (!found && offset + FRAME_HEADER_BYTES <= fileSize)
+	{
+		unsigned int blockBytes = (unsigned int)min((__int64)SEARCH_BLOCK_BYTES, fileSize - offset);
+		if (!ReadAt(file, offset, block, blockBytes))
+			break;
+
+		for (unsigned int i = 0; i + 4 <= blockBytes; i++)
+		{
+			if (block[i] != 0xFF || block[i + 1] != 0x22 || block[i + 2] != 0x01 || block[i + 3] != 0xEE)
+				continue;
+
+			if (ReadFrame(file, offset + i, fileSize, minTimeStamp, frame))
+			{
+				__int64 frameEnd = frame->Offset + 4 + frame->BytesCount;
+				if (frameEnd == fileSize || IsFrameStart(file, frameEnd))
+				{
+					found = true;
+					break;
+				}
+			}
+		}
+
+		// The magic may span two blocks
+		offset += blockBytes > 3 ? blockBytes - 3 : blockBytes;
+	}
+
+	free(block);
+	return found;
+}
+
+// The first frame follows the system metadata table
+static bool SkipSystemMetadataTable(FILE* file, __int64 tableOffset, __int64 fileSize, __int64* firstFrameOffset)
+{
+	unsigned int tagsCount;
+	if (tableOffset <= 0 || tableOffset >= fileSize || !ReadAt(file, tableOffset, &tagsCount, 4) || tagsCount > MAX_SYSTEM_METADATA_TAGS)
+		return false;
+
+	// Tag names and values are written by WriteString()
+	for (unsigned int i = 0; i < 2 * tagsCount; i++)
+	{
+		int length = fgetc(file);
+		if (length == EOF || 0 != advfseek(file, length, SEEK_CUR))
+			return false;
+	}
+
+	advfgetpos64(file, firstFrameOffset);
+	return *firstFrameOffset <= fileSize;
+}
+
+bool RecoverFile(const char* fileName, unsigned int* recoveredFrames)
+{
+	*recoveredFrames = 0;
+
+	FILE* file = advfopen(fileName, "r+b");
+	if (NULL == file)
+		return false;
+
+	__int64 fileSize;
+	advfseek(file, 0, SEEK_END);
+	advfgetpos64(file, &fileSize);
+
+	unsigned char header[FILE_HEADER_BYTES];
+	unsigned int fileMagic = 0;
+	if (ReadAt(file, 0, header, FILE_HEADER_BYTES))
+		memcpy(&fileMagic, header, 4);
+
+	if (fileMagic != FILE_MAGIC)
+	{
+		advfclose(file);
+		return false;
+	}
+
+	unsigned int framesCount;
+	__int64 indexTableOffset;
+	__int64 systemMetadataTableOffset;
+	__int64 userMetadataTableOffset;
+	memcpy(&framesCount, header + 5, 4);
+	memcpy(&indexTableOffset, header + 9, 8);
+	memcpy(&systemMetadataTableOffset, header + 0x11, 8);
+	memcpy(&userMetadataTableOffset, header + 0x19, 8);
+
+	string journalFileName = IndexJournalFileName(fileName);
+
+	if (indexTableOffset > 0 && indexTableOffset < fileSize && userMetadataTableOffset > 0 && userMetadataTableOffset < fileSize)
+	{
+		// Ended by EndFile()
+		advfclose(file);
+		remove(journalFileName.c_str());
+
+		*recoveredFrames = framesCount;
+		return true;
+	}
+
+	__int64 frameOffset;
+	if (!SkipSystemMetadataTable(file, systemMetadataTableOffset, fileSize, &frameOffset))
+	{
+		advfclose(file);
+		return false;
+	}
+
+	AavFramesIndex* index = new AavFramesIndex();
+	unsigned int frameNo = 0;
+	long long firstTimeStamp = 0;
+	long long lastTimeStamp = 0;
+	RecoveredFrame frame;
+
+	// The exact elapsed times of the frames which were journaled
+	FILE* journal = fopen(journalFileName.c_str(), "rb");
+	if (NULL != journal)
+	{
+		unsigned int journalMagic = 0;
+		unsigned char entryBytes[INDEX_ENTRY_BYTES];
+
+		if (fread(&journalMagic, 4, 1, journal) == 1 && journalMagic == INDEX_JOURNAL_MAGIC)
+		{
+			while (fread(entryBytes, INDEX_ENTRY_BYTES, 1, journal) == 1)
+			{
+				unsigned int elapsedTime;
+				__int64 entryOffset;
+				unsigned int entryBytesCount;
+				memcpy(&elapsedTime, entryBytes, 4);
+				memcpy(&entryOffset, entryBytes + 4, 8);
+				memcpy(&entryBytesCount, entryBytes + 12, 4);
+
+				if (entryOffset != frameOffset || !ReadFrame(file, frameOffset, fileSize, lastTimeStamp, &frame) || frame.BytesCount != entryBytesCount)
+					break;
+
+				if (frameNo == 0)
+					firstTimeStamp = frame.TimeStamp;
+
+				index->AddFrame(frameNo, elapsedTime, frame.Offset, frame.BytesCount, frame.TimeStamp, frame.IsKeyFrame);
+				frameNo++;
+				lastTimeStamp = frame.TimeStamp;
+				frameOffset = frame.Offset + 4 + frame.BytesCount;
+			}
+		}
+
+		fclose(journal);
+	}
+
+	// The frames written after the last journal entry
+	while (frameOffset < fileSize)
+	{
+		if (!ReadFrame(file, frameOffset, fileSize, lastTimeStamp, &frame) &&
+			!SearchFrame(file, frameOffset + 1, fileSize, lastTimeStamp, &frame))
+		{
+			break;
+		}
+
+		if (frameNo == 0)
+			firstTimeStamp = frame.TimeStamp;
+
+		// In milliseconds since the first frame
+		index->AddFrame(frameNo, (unsigned int)(frame.TimeStamp - firstTimeStamp), frame.Offset, frame.BytesCount, frame.TimeStamp, frame.IsKeyFrame);
+		frameNo++;
+		lastTimeStamp = frame.TimeStamp;
+		frameOffset = frame.Offset + 4 + frame.BytesCount;
+	}
+
+	// The torn frames at the end are replaced by the index and the user metadata table
+	bool success = 0 == PlatformTruncateFile(file, frameOffset);
+	if (success)
+	{
+		indexTableOffset = frameOffset;
+		advfsetpos64(file, &indexTableOffset);
+		index->WriteIndex(file);
+
+		advfgetpos64(file, &userMetadataTableOffset);
+		unsigned int userTagsCount = 0;
+		advfwrite(&userTagsCount, 4, 1, file);
+
+		advfseek(file, 5, SEEK_SET);
+		advfwrite(&frameNo, 4, 1, file);
+		advfwrite(&indexTableOffset, 8, 1, file);
+		advfseek(file, 0x19, SEEK_SET);
+		advfwrite(&userMetadataTableOffset, 8, 1, file);
+
+		success = 0 == PlatformSyncFile(file);
+	}
+
+	advfclose(file);
+	delete index;
+
+	if (success)
+	{
+		remove(journalFileName.c_str());
+		*recoveredFrames = frameNo;
+	}
+	else
+		DebugViewPrint(L"AAV: Cannot write the recovered index\n");
+
+	return success;
+}
+
+}
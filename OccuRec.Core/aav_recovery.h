@@ -0,0 +1,20 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef ADVRECOVERY_H
+#define ADVRECOVERY_H
+
+namespace AavLib
+{
+
+// Finalises a file whose recording was not ended by EndFile(), e.g. after a crash or a power loss. The frames are
+// walked by their section lengths in one pass, following the index journal while it matches the file and searching
+// for the next frame start magic after a damaged frame. The torn frames at the end are cut, then the index, an empty
+// user metadata table and the header offsets are written as EndFile() does. A complete file is left unchanged.
+// Returns false if the file is not an AAV file or cannot be written
+bool RecoverFile(const char* fileName, unsigned int* recoveredFrames);
+
+}
+
+#endif // ADVRECOVERY_H
@@ -2,10 +2,11 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
-#include "StdAfx.h"
+#include "stdafx.h"
 #include "aav_status_section.h"
 #include <string>
 #include <stdlib.h>
+#include <string.h>
 
 using namespace std;
 using std::string;
@@ -13,280 +14,544 @@ using std::string;
 namespace AavLib
 {
 
+// The tag id, the length and up to 255 chars
+#define STRING_ENTRY_BYTES (1 + 1 + 255)
+// The length and up to 255 chars
+#define MESSAGE_BYTES (1 + 255)
+#define MAX_MESSAGES 16
+
+// A zigzag varint of 64 bits takes up to 10 bytes, the value is written instead when it is longer than 8 bytes
+#define MAX_DELTA_BYTES 8
+
+unsigned int g_AavStatusSnapshotInterval = 0;
+
 AavStatusSection::AavStatusSection()
 {
-	MaxFrameBufferSize = 0;
+	MaxFrameBufferSize = 2; // The type of the frame and the number of tags
+
+	m_FixedSizeEntries = NULL;
+	m_FixedSizeEntriesBytes = 0;
+	m_StringEntries = NULL;
+	m_MessageEntries = NULL;
+	m_FixedSizeTagsSet = 0;
+	m_OtherTagsSet = 0;
+
+	m_SnapshotInterval = 0;
+	m_FramesSinceSnapshot = 0;
+	m_PrevFixedSizeEntries = NULL;
+	m_PrevStringEntries = NULL;
 }
 
 AavStatusSection::~AavStatusSection()
 {
+	free(m_FixedSizeEntries);
+	free(m_StringEntries);
+	free(m_MessageEntries);
+	free(m_PrevFixedSizeEntries);
+	free(m_PrevStringEntries);
 }
 
 unsigned int AavStatusSection::DefineTag(const char* tagName, AavTagType tagType)
 {
 	m_TagDefinitionNames.push_back(string(tagName));
-	m_TagDefinitionTypes.push_back(tagType);
-	
+
+	AavStatusTagSlot slot;
+	slot.Type = tagType;
+	slot.Offset = -1;
+	slot.EntryBytes = 0;
+	slot.FirstMessage = 0;
+	slot.MessagesCount = 0;
+
+	// The tag id and the value
 	switch(tagType)
 	{
 		case UInt8:
-			MaxFrameBufferSize+=1;
+			slot.EntryBytes = 1 + 1;
+			MaxFrameBufferSize+=1 + 1;
 			break;
 			
 		case UInt16:
-			MaxFrameBufferSize+=2;
+			slot.EntryBytes = 1 + 2;
+			MaxFrameBufferSize+=1 + 2;
 			break;
 
 		case UInt32:
-			MaxFrameBufferSize+=4;
+			MaxFrameBufferSize+=1 + 4;
 			break;
 			
 		case ULong64:
-			MaxFrameBufferSize+=8;
+			slot.EntryBytes = 1 + 8;
+			MaxFrameBufferSize+=1 + 8;
 			break;			
 			
 		case Real:
-			MaxFrameBufferSize+=4;
+			slot.EntryBytes = 1 + 4;
+			MaxFrameBufferSize+=1 + 4;
 			break;	
 			
 		case AnsiString255:
-			MaxFrameBufferSize+=256;
+			MaxFrameBufferSize+=1 + 256;
 			break;
 			
 		case List16OfAnsiString255:
-			MaxFrameBufferSize+=16 * 256;
+			MaxFrameBufferSize+=1 + 1 + 16 * 256;
 			break;
 	}
 	
+	// The code of the entry in delta frames, and up to two more bytes for the ULong64 deltas and the string prefixes
+	MaxFrameBufferSize+=3;
+
+	m_TagSlots.push_back(slot);
+	CompileSchema();
+
 	return m_TagDefinitionNames.size() - 1;
 }
 
+void AavStatusSection::CompileSchema()
+{
+	m_FixedSizeTags.clear();
+	m_StringTags.clear();
+	m_MessageTags.clear();
+
+	// The order of the fixed size tags in the frame
+	const AavTagType fixedSizeTypes[] = { ULong64, UInt16, UInt8, Real };
+	unsigned int offset = 0;
+
+	for (int i = 0; i < 4; i++)
+	{
+		for (unsigned int tagId = 0; tagId < m_TagSlots.size(); tagId++)
+		{
+			if (m_TagSlots[tagId].Type == fixedSizeTypes[i])
+			{
+				m_TagSlots[tagId].Offset = offset;
+				offset += m_TagSlots[tagId].EntryBytes;
+				m_FixedSizeTags.push_back(tagId);
+			}
+		}
+	}
+
+	m_FixedSizeEntriesBytes = offset;
+
+	for (unsigned int tagId = 0; tagId < m_TagSlots.size(); tagId++)
+	{
+		if (m_TagSlots[tagId].Type == AnsiString255)
+		{
+			m_TagSlots[tagId].Offset = m_StringTags.size() * STRING_ENTRY_BYTES;
+			m_StringTags.push_back(tagId);
+		}
+		else if (m_TagSlots[tagId].Type == List16OfAnsiString255)
+		{
+			m_TagSlots[tagId].Offset = m_MessageTags.size() * MAX_MESSAGES * MESSAGE_BYTES;
+			m_MessageTags.push_back(tagId);
+		}
+	}
+
+	m_FixedSizeEntries = (unsigned char*)realloc(m_FixedSizeEntries, max(m_FixedSizeEntriesBytes, 1U));
+	m_StringEntries = (unsigned char*)realloc(m_StringEntries, max((unsigned int)m_StringTags.size() * STRING_ENTRY_BYTES, 1U));
+	m_MessageEntries = (unsigned char*)realloc(m_MessageEntries, max((unsigned int)m_MessageTags.size() * MAX_MESSAGES * MESSAGE_BYTES, 1U));
+	m_PrevFixedSizeEntries = (unsigned char*)realloc(m_PrevFixedSizeEntries, max(m_FixedSizeEntriesBytes, 1U));
+	m_PrevStringEntries = (unsigned char*)realloc(m_PrevStringEntries, max((unsigned int)m_StringTags.size() * STRING_ENTRY_BYTES, 1U));
+
+	// The tag ids are written once, only the values change from frame to frame
+	for (unsigned int i = 0; i < m_FixedSizeTags.size(); i++)
+		m_FixedSizeEntries[m_TagSlots[m_FixedSizeTags[i]].Offset] = (unsigned char)(m_FixedSizeTags[i] & 0xFF);
+
+	for (unsigned int i = 0; i < m_StringTags.size(); i++)
+		m_StringEntries[m_TagSlots[m_StringTags[i]].Offset] = (unsigned char)(m_StringTags[i] & 0xFF);
+
+	m_TagIsSet.assign(m_TagSlots.size(), 0);
+	m_TagWasSet.assign(m_TagSlots.size(), 0);
+	m_TagSteps.assign(m_TagSlots.size(), 0);
+	m_FramesSinceSnapshot = 0;
+	BeginFrame();
+}
+
+void AavStatusSection::SetSnapshotInterval(unsigned int snapshotInterval)
+{
+	m_SnapshotInterval = snapshotInterval;
+	m_FramesSinceSnapshot = 0;
+}
+
 void AavStatusSection::BeginFrame()
 {
-	m_FrameStatusTags.clear();
-	m_FrameStatusTagsUInt8.clear();
-	m_FrameStatusTagsUInt16.clear();
-	m_FrameStatusTagsUInt64.clear();
-	m_FrameStatusTagsReal.clear();
-	
-	m_FrameStatusTagsMessages.clear();
+	if (m_TagIsSet.size() > 0)
+		memset(&m_TagIsSet[0], 0, m_TagIsSet.size());
+
+	m_FixedSizeTagsSet = 0;
+	m_OtherTagsSet = 0;
+
+	for (unsigned int i = 0; i < m_MessageTags.size(); i++)
+	{
+		m_TagSlots[m_MessageTags[i]].FirstMessage = 0;
+		m_TagSlots[m_MessageTags[i]].MessagesCount = 0;
+	}
+}
+
+// The value of the tag in its entry, or NULL if the tag is not defined with this type or is already set in this frame
+unsigned char* AavStatusSection::BeginFixedSizeTag(unsigned int tagIndex, AavTagType tagType)
+{
+	if (tagIndex >= m_TagSlots.size() || m_TagSlots[tagIndex].Type != tagType || m_TagIsSet[tagIndex])
+		return NULL;
+
+	m_TagIsSet[tagIndex] = 1;
+	m_FixedSizeTagsSet++;
+
+	return m_FixedSizeEntries + m_TagSlots[tagIndex].Offset + 1;
 }
 
 void AavStatusSection::AddFrameStatusTag(unsigned int tagIndex, const char* tagValue)
 {
-	// TODO: Do a check of the max length of a string (255) and copy only the first 255 chars	
-	m_FrameStatusTags.insert(make_pair(tagIndex, string(tagValue == NULL ? "" : tagValue)));
+	if (tagIndex >= m_TagSlots.size() || m_TagSlots[tagIndex].Type != AnsiString255 || m_TagIsSet[tagIndex])
+		return;
+
+	m_TagIsSet[tagIndex] = 1;
+	m_OtherTagsSet++;
+
+	// The length of the strings is saved in one byte, so only the first 255 chars are written
+	unsigned char* entry = m_StringEntries + m_TagSlots[tagIndex].Offset;
+	int strLen = tagValue == NULL ? 0 : (int)strnlen(tagValue, 255);
+	entry[1] = strLen;
+	memcpy(entry + 2, tagValue, strLen);
 }
 
 void AavStatusSection::AddFrameStatusTagMessage(unsigned int tagIndex, const char* tagValue)
 {
-	list<string> messageList = m_FrameStatusTagsMessages[tagIndex];
-	
-	if (messageList.size() == 16) messageList.pop_front();
-	
-	// TODO: Do a check of the max length of a string (255) and copy only the first 255 chars
-	messageList.push_back(string(tagValue == NULL ? "" : tagValue));
-	
-	m_FrameStatusTagsMessages[tagIndex] = messageList;
+	if (tagIndex >= m_TagSlots.size() || m_TagSlots[tagIndex].Type != List16OfAnsiString255)
+		return;
+
+	AavStatusTagSlot& slot = m_TagSlots[tagIndex];
+
+	if (!m_TagIsSet[tagIndex])
+	{
+		m_TagIsSet[tagIndex] = 1;
+		m_OtherTagsSet++;
+	}
+
+	// Only the last 16 messages are kept
+	unsigned int messageNo;
+	if (slot.MessagesCount == MAX_MESSAGES)
+	{
+		messageNo = slot.FirstMessage;
+		slot.FirstMessage = (slot.FirstMessage + 1) % MAX_MESSAGES;
+	}
+	else
+	{
+		messageNo = (slot.FirstMessage + slot.MessagesCount) % MAX_MESSAGES;
+		slot.MessagesCount++;
+	}
+
+	unsigned char* message = m_MessageEntries + slot.Offset + messageNo * MESSAGE_BYTES;
+	int strLen = tagValue == NULL ? 0 : (int)strnlen(tagValue, 255);
+	message[0] = strLen;
+	memcpy(message + 1, tagValue, strLen);
 }
 
 void AavStatusSection::AddFrameStatusTagUInt8(unsigned int tagIndex, unsigned char tagValue)
 {
-	m_FrameStatusTagsUInt8.insert(make_pair(tagIndex, tagValue));
+	unsigned char* value = BeginFixedSizeTag(tagIndex, UInt8);
+	if (NULL != value)
+		*value = tagValue;
 }
 
 void AavStatusSection::AddFrameStatusTagUInt16(unsigned int tagIndex, unsigned short tagValue)
 {
-	m_FrameStatusTagsUInt16.insert(make_pair(tagIndex, tagValue));
+	unsigned char* value = BeginFixedSizeTag(tagIndex, UInt16);
+	if (NULL != value)
+		memcpy(value, &tagValue, 2);
 }
 
 void AavStatusSection::AddFrameStatusTagReal(unsigned int tagIndex, float tagValue)
 {
-	m_FrameStatusTagsReal.insert(make_pair(tagIndex, tagValue));
+	// IEEE 754 single-precision
+	unsigned char* value = BeginFixedSizeTag(tagIndex, Real);
+	if (NULL != value)
+		memcpy(value, &tagValue, 4);
 }
 
 void AavStatusSection::AddFrameStatusTagUInt64(unsigned int tagIndex, long long tagValue)
 {
-	m_FrameStatusTagsUInt64.insert(make_pair(tagIndex, tagValue));
+	unsigned char* value = BeginFixedSizeTag(tagIndex, ULong64);
+	if (NULL != value)
+		memcpy(value, &tagValue, 8);
 }
 
-unsigned int FloatToIntBits(const float x)
+void AavStatusSection::GetDataBytes(unsigned char* destination, unsigned int *bytesCount)
 {
-    union {
-       float f;  		  // assuming 32-bit IEEE 754 single-precision
-       unsigned int i;    // assuming 32-bit 2's complement int
-    } u;
-        
-    u.f = x;
-    return u.i;
+	if (m_SnapshotInterval == 0)
+	{
+		GetFullFrameBytes(destination, bytesCount);
+		return;
+	}
+
+	bool keyFrame = m_FramesSinceSnapshot == 0;
+
+	destination[0] = keyFrame ? STATUS_KEY_FRAME : STATUS_DELTA_FRAME;
+	if (keyFrame)
+		GetFullFrameBytes(destination + 1, bytesCount);
+	else
+		GetDeltaFrameBytes(destination + 1, bytesCount);
+
+	(*bytesCount)++;
+
+	KeepPreviousFrame(keyFrame);
+	m_FramesSinceSnapshot = (m_FramesSinceSnapshot + 1) % m_SnapshotInterval;
 }
 
-unsigned char* AavStatusSection::GetDataBytes(unsigned int *bytesCount)
+void AavStatusSection::GetFullFrameBytes(unsigned char* destination, unsigned int *bytesCount)
 {
-	int size = 0;
-	int arrayLength = 0;
-	int numTagEntries = 0;
-	
-	map<unsigned int, string>::iterator curr = m_FrameStatusTags.begin();
-	while (curr != m_FrameStatusTags.end()) 
+	unsigned char *statusData = destination;
+	unsigned int numTagEntries = m_FixedSizeTagsSet + m_OtherTagsSet;
+
+	statusData[0] = (numTagEntries & 0xFF);
+	int dataPos = 1;
+
+	if (m_FixedSizeTagsSet == m_FixedSizeTags.size())
 	{
-		char* tagValue = const_cast<char*>(curr->second.c_str());
-		
-		arrayLength+=strlen(tagValue) + 1 /* TagId*/  + 1 /* length */ ;
-		curr++;
-		numTagEntries++;
+		memcpy(&statusData[dataPos], m_FixedSizeEntries, m_FixedSizeEntriesBytes);
+		dataPos += m_FixedSizeEntriesBytes;
 	}
-	
-	map<unsigned int, list<string> >::iterator currLst = m_FrameStatusTagsMessages.begin();
-	while (currLst != m_FrameStatusTagsMessages.end()) 
+	else if (m_FixedSizeTagsSet > 0)
 	{
-		list<string> lst = currLst->second;
-		list<string>::iterator currMsg = lst.begin();
-		while (currMsg != lst.end()) 
+		// The entries of the tags which are set, one copy for each run of them
+		unsigned int runStart = 0;
+		unsigned int runBytes = 0;
+
+		for (unsigned int i = 0; i < m_FixedSizeTags.size(); i++)
 		{
-			char* tagValue = const_cast<char*>(currMsg->c_str());
-			
-			arrayLength+=strlen(tagValue) + 1 /* length*/;
-			currMsg++;
+			const AavStatusTagSlot& slot = m_TagSlots[m_FixedSizeTags[i]];
+
+			if (m_TagIsSet[m_FixedSizeTags[i]])
+			{
+				if (runBytes == 0)
+					runStart = slot.Offset;
+				runBytes += slot.EntryBytes;
+			}
+			else if (runBytes > 0)
+			{
+				memcpy(&statusData[dataPos], m_FixedSizeEntries + runStart, runBytes);
+				dataPos += runBytes;
+				runBytes = 0;
+			}
 		}
-		arrayLength+= (1 /* TagId*/ + 1 /* num messages*/);
-		currLst++;
-		numTagEntries++;
+
+		memcpy(&statusData[dataPos], m_FixedSizeEntries + runStart, runBytes);
+		dataPos += runBytes;
 	}
-	
-	arrayLength+=m_FrameStatusTagsUInt8.size() * (1 /*sizeof(unsigned char)*/ + 1 /* TagId*/ );
-	numTagEntries+=m_FrameStatusTagsUInt8.size();
-	arrayLength+=m_FrameStatusTagsUInt16.size() * (2 /*sizeof(unsigned short)*/ + 1 /* TagId*/ );
-	numTagEntries+=m_FrameStatusTagsUInt16.size();
-	arrayLength+=m_FrameStatusTagsUInt64.size() * (8 /*sizeof(long long)*/ + 1 /* TagId*/ );
-	numTagEntries+=m_FrameStatusTagsUInt64.size();
-	arrayLength+=m_FrameStatusTagsReal.size() * (4 /*sizeof(float)*/ + 1 /* TagId*/ );
-	numTagEntries+=m_FrameStatusTagsReal.size();
-	
-	size = arrayLength + 1;
-	
-	unsigned char *statusData = (unsigned char*)malloc(size);
-	statusData[0] = (numTagEntries & 0xFF);		
-		
-	if (arrayLength > 0)
+
+	if (m_OtherTagsSet > 0)
 	{
-		int dataPos = 1;
-		
-		map<unsigned int, long long>::iterator currUInt64 = m_FrameStatusTagsUInt64.begin();
-		while (currUInt64 != m_FrameStatusTagsUInt64.end()) 
+		for (unsigned int i = 0; i < m_StringTags.size(); i++)
 		{
-			unsigned char tagId = (unsigned char)(currUInt64->first & 0xFF);
-			statusData[dataPos] = tagId;
-
-			long long tagValue = (long long)(currUInt64->second);
-			statusData[dataPos + 1] = (unsigned char)(tagValue & 0xFF);
-			statusData[dataPos + 2] = (unsigned char)((tagValue >> 8) & 0xFF);
-			statusData[dataPos + 3] = (unsigned char)((tagValue >> 16) & 0xFF);
-			statusData[dataPos + 4] = (unsigned char)((tagValue >> 24) & 0xFF);
-			statusData[dataPos + 5] = (unsigned char)((tagValue >> 32) & 0xFF);
-			statusData[dataPos + 6] = (unsigned char)((tagValue >> 40) & 0xFF);
-			statusData[dataPos + 7] = (unsigned char)((tagValue >> 48) & 0xFF);
-			statusData[dataPos + 8] = (unsigned char)((tagValue >> 56) & 0xFF);			
-	
-			dataPos+=9;
-			
-			currUInt64++;
+			if (!m_TagIsSet[m_StringTags[i]])
+				continue;
+
+			const unsigned char* entry = m_StringEntries + m_TagSlots[m_StringTags[i]].Offset;
+			memcpy(&statusData[dataPos], entry, 2 + entry[1]);
+			dataPos += 2 + entry[1];
 		}
-		
-		map<unsigned int, unsigned short>::iterator currUInt16 = m_FrameStatusTagsUInt16.begin();
-		while (currUInt16 != m_FrameStatusTagsUInt16.end()) 
+
+		for (unsigned int i = 0; i < m_MessageTags.size(); i++)
 		{
-			unsigned char tagId = (unsigned char)(currUInt16->first & 0xFF);
-			statusData[dataPos] = tagId;
+			if (!m_TagIsSet[m_MessageTags[i]])
+				continue;
 
-			unsigned short tagValue = (unsigned short)(currUInt16->second);
-			statusData[dataPos + 1] = (unsigned char)(tagValue & 0xFF);
-			statusData[dataPos + 2] = (unsigned char)((tagValue >> 8) & 0xFF);
+			const AavStatusTagSlot& slot = m_TagSlots[m_MessageTags[i]];
+			statusData[dataPos] = (unsigned char)(m_MessageTags[i] & 0xFF);
+			statusData[dataPos + 1] = slot.MessagesCount;
+			dataPos += 2;
 
-			dataPos+=3;
-			
-			currUInt16++;
+			for (unsigned int j = 0; j < slot.MessagesCount; j++)
+			{
+				const unsigned char* message = m_MessageEntries + slot.Offset + ((slot.FirstMessage + j) % MAX_MESSAGES) * MESSAGE_BYTES;
+				memcpy(&statusData[dataPos], message, 1 + message[0]);
+				dataPos += 1 + message[0];
+			}
 		}
-		
-		map<unsigned int, unsigned char>::iterator currUInt8 = m_FrameStatusTagsUInt8.begin();
-		while (currUInt8 != m_FrameStatusTagsUInt8.end()) 
-		{
-			unsigned char tagId = (unsigned char)(currUInt8->first & 0xFF);
-			statusData[dataPos] = tagId;
+	}
 
-			unsigned char tagValue = (unsigned char)(currUInt8->second);
-			statusData[dataPos + 1] = tagValue;
+	*bytesCount = dataPos;
+}
 
-			dataPos+=2;
-			
-			currUInt8++;
+void AavStatusSection::GetDeltaFrameBytes(unsigned char* destination, unsigned int *bytesCount)
+{
+	unsigned char *statusData = destination;
+	unsigned int numTagEntries = 0;
+	int dataPos = 1;
+
+	for (unsigned int i = 0; i < m_FixedSizeTags.size(); i++)
+	{
+		unsigned int tagId = m_FixedSizeTags[i];
+		const AavStatusTagSlot& slot = m_TagSlots[tagId];
+
+		if (!m_TagIsSet[tagId])
+		{
+			if (m_TagWasSet[tagId])
+			{
+				statusData[dataPos] = (unsigned char)(tagId & 0xFF);
+				statusData[dataPos + 1] = STATUS_ENTRY_NOT_SET;
+				dataPos += 2;
+				numTagEntries++;
+			}
+
+			continue;
 		}
-		
-		map<unsigned int, float>::iterator currReal = m_FrameStatusTagsReal.begin();
-		while (currReal != m_FrameStatusTagsReal.end()) 
+
+		const unsigned char* value = m_FixedSizeEntries + slot.Offset + 1;
+		const unsigned char* prevValue = m_PrevFixedSizeEntries + slot.Offset + 1;
+		unsigned int valueBytes = slot.EntryBytes - 1;
+
+		if (m_TagWasSet[tagId])
 		{
-			unsigned char tagId = (unsigned char)(currReal->first & 0xFF);
-			statusData[dataPos] = tagId;
+			if (slot.Type == ULong64)
+			{
+				long long tagValue;
+				long long prevTagValue;
+				memcpy(&tagValue, value, 8);
+				memcpy(&prevTagValue, prevValue, 8);
 
-			float tagValue = (float)(currReal->second);
-			unsigned int intValue = FloatToIntBits(tagValue);
-			
-			statusData[dataPos + 1] = intValue & 0xFF;
-			statusData[dataPos + 2] = (intValue >> 8) & 0xFF;
-			statusData[dataPos + 3] = (intValue >> 16) & 0xFF;
-			statusData[dataPos + 4] = (intValue >> 24) & 0xFF;
+				// Wraps around as the reader does
+				unsigned long long delta = (unsigned long long)tagValue - ((unsigned long long)prevTagValue + (unsigned long long)m_TagSteps[tagId]);
+				if (delta == 0)
+					continue;
 
-			dataPos+=5;
-			
-			currReal++;
+				unsigned long long zigzag = (delta << 1) ^ (unsigned long long)((long long)delta >> 63);
+				unsigned char varint[10];
+				unsigned int varintBytes = 0;
+				do
+				{
+					varint[varintBytes] = (unsigned char)(zigzag & 0x7F);
+					zigzag >>= 7;
+					if (zigzag != 0) varint[varintBytes] |= 0x80;
+					varintBytes++;
+				}
+				while (zigzag != 0);
+
+				if (varintBytes <= MAX_DELTA_BYTES)
+				{
+					statusData[dataPos] = (unsigned char)(tagId & 0xFF);
+					statusData[dataPos + 1] = STATUS_ENTRY_DELTA;
+					memcpy(&statusData[dataPos + 2], varint, varintBytes);
+					dataPos += 2 + varintBytes;
+					numTagEntries++;
+					continue;
+				}
+			}
+			else if (memcmp(value, prevValue, valueBytes) == 0)
+				continue;
 		}
-		
-		curr = m_FrameStatusTags.begin();
-		while (curr != m_FrameStatusTags.end()) 
+
+		statusData[dataPos] = (unsigned char)(tagId & 0xFF);
+		statusData[dataPos + 1] = STATUS_ENTRY_VALUE;
+		memcpy(&statusData[dataPos + 2], value, valueBytes);
+		dataPos += 2 + valueBytes;
+		numTagEntries++;
+	}
+
+	for (unsigned int i = 0; i < m_StringTags.size(); i++)
+	{
+		unsigned int tagId = m_StringTags[i];
+
+		if (!m_TagIsSet[tagId])
 		{
-			unsigned char tagId = (unsigned char)(curr->first & 0xFF);
-			statusData[dataPos] = tagId;
-			
-			char* tagValue = const_cast<char*>(curr->second.c_str());
-			
-			int strLen = strlen(tagValue);
-			statusData[dataPos + 1] = strLen;
-			memcpy(&statusData[dataPos + 2], tagValue, strLen);
-			dataPos+= strLen + 2;
-			
-			curr++;
-		}	
+			if (m_TagWasSet[tagId])
+			{
+				statusData[dataPos] = (unsigned char)(tagId & 0xFF);
+				statusData[dataPos + 1] = STATUS_ENTRY_NOT_SET;
+				dataPos += 2;
+				numTagEntries++;
+			}
+
+			continue;
+		}
+
+		const unsigned char* entry = m_StringEntries + m_TagSlots[tagId].Offset;
+		const unsigned char* prevEntry = m_PrevStringEntries + m_TagSlots[tagId].Offset;
+		unsigned int strLen = entry[1];
 
-		currLst = m_FrameStatusTagsMessages.begin();
-		while (currLst != m_FrameStatusTagsMessages.end()) 
+		if (m_TagWasSet[tagId])
 		{
-			unsigned char tagId = (unsigned char)(currLst->first & 0xFF);
-			statusData[dataPos] = tagId;
-			
-			list<string> lst = currLst->second;
-			statusData[dataPos + 1] = lst.size();
-			
-			dataPos+=2;
-			
-			list<string>::iterator currMsg = lst.begin();
-			while (currMsg != lst.end()) 
+			unsigned int prevStrLen = prevEntry[1];
+			unsigned int prefixLen = 0;
+			while (prefixLen < strLen && prefixLen < prevStrLen && entry[2 + prefixLen] == prevEntry[2 + prefixLen])
+				prefixLen++;
+
+			if (prefixLen == strLen && strLen == prevStrLen)
+				continue;
+
+			// Shorter than the whole value when more than one char is shared
+			if (prefixLen > 1)
 			{
-				char* tagValue = const_cast<char*>(currMsg->c_str());
-				
-				int strLen = strlen(tagValue);
-				statusData[dataPos] = strLen;
-				memcpy(&statusData[dataPos + 1], tagValue, strLen);
-				dataPos+= strLen + 1;
-			
-				currMsg++;
+				statusData[dataPos] = (unsigned char)(tagId & 0xFF);
+				statusData[dataPos + 1] = STATUS_ENTRY_PREFIX;
+				statusData[dataPos + 2] = prefixLen;
+				statusData[dataPos + 3] = strLen - prefixLen;
+				memcpy(&statusData[dataPos + 4], entry + 2 + prefixLen, strLen - prefixLen);
+				dataPos += 4 + strLen - prefixLen;
+				numTagEntries++;
+				continue;
 			}
+		}
 
-			currLst++;
-		}	
+		statusData[dataPos] = (unsigned char)(tagId & 0xFF);
+		statusData[dataPos + 1] = STATUS_ENTRY_VALUE;
+		memcpy(&statusData[dataPos + 2], entry + 1, 1 + strLen);
+		dataPos += 3 + strLen;
+		numTagEntries++;
 	}
-	
-	*bytesCount = size;
-	return statusData;
+
+	for (unsigned int i = 0; i < m_MessageTags.size(); i++)
+	{
+		unsigned int tagId = m_MessageTags[i];
+		if (!m_TagIsSet[tagId])
+			continue;
+
+		const AavStatusTagSlot& slot = m_TagSlots[tagId];
+		statusData[dataPos] = (unsigned char)(tagId & 0xFF);
+		statusData[dataPos + 1] = STATUS_ENTRY_VALUE;
+		statusData[dataPos + 2] = slot.MessagesCount;
+		dataPos += 3;
+
+		for (unsigned int j = 0; j < slot.MessagesCount; j++)
+		{
+			const unsigned char* message = m_MessageEntries + slot.Offset + ((slot.FirstMessage + j) % MAX_MESSAGES) * MESSAGE_BYTES;
+			memcpy(&statusData[dataPos], message, 1 + message[0]);
+			dataPos += 1 + message[0];
+		}
+
+		numTagEntries++;
+	}
+
+	statusData[0] = (numTagEntries & 0xFF);
+	*bytesCount = dataPos;
+}
+
+// The predictions of the next delta frame. The steps of the ULong64 tags start again from 0 at each key frame
+void AavStatusSection::KeepPreviousFrame(bool keyFrame)
+{
+	for (unsigned int i = 0; i < m_FixedSizeTags.size(); i++)
+	{
+		unsigned int tagId = m_FixedSizeTags[i];
+		const AavStatusTagSlot& slot = m_TagSlots[tagId];
+		if (slot.Type != ULong64)
+			continue;
+
+		long long step = 0;
+		if (!keyFrame && m_TagIsSet[tagId] && m_TagWasSet[tagId])
+		{
+			long long tagValue;
+			long long prevTagValue;
+			memcpy(&tagValue, m_FixedSizeEntries + slot.Offset + 1, 8);
+			memcpy(&prevTagValue, m_PrevFixedSizeEntries + slot.Offset + 1, 8);
+			step = (long long)((unsigned long long)tagValue - (unsigned long long)prevTagValue);
+		}
+
+		m_TagSteps[tagId] = step;
+	}
+
+	memcpy(m_PrevFixedSizeEntries, m_FixedSizeEntries, m_FixedSizeEntriesBytes);
+	memcpy(m_PrevStringEntries, m_StringEntries, m_StringTags.size() * STRING_ENTRY_BYTES);
+	if (m_TagIsSet.size() > 0)
+		memcpy(&m_TagWasSet[0], &m_TagIsSet[0], m_TagIsSet.size());
 }
 
 void AavStatusSection::WriteHeader(FILE* pFile)
@@ -295,7 +560,7 @@ void AavStatusSection::WriteHeader(FILE* pFile)
 	unsigned long buffLong;
 	unsigned char buffChar;
 	
-	buffChar = 1;
+	buffChar = m_SnapshotInterval > 0 ? 2 : 1;
 	fwrite(&buffChar, 1, 1, pFile); /* Version */
 	
 	buffChar = m_TagDefinitionNames.size();
@@ -304,14 +569,11 @@ void AavStatusSection::WriteHeader(FILE* pFile)
 	
 	for(int i = 0; i<tagCount; i++)
 	{
-		char* tagName = const_cast<char*>(m_TagDefinitionNames.front().c_str());
+		char* tagName = const_cast<char*>(m_TagDefinitionNames[i].c_str());
 		WriteString(pFile, tagName);
 		
-		buffChar = (unsigned char)(int)(m_TagDefinitionTypes.front());
+		buffChar = (unsigned char)(int)(m_TagSlots[i].Type);
 		fwrite(&buffChar, 1, 1, pFile);		
-		
-		m_TagDefinitionNames.pop_front();
-		m_TagDefinitionTypes.pop_front();
 	}
 }
 
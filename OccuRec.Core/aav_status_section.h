@@ -5,8 +5,7 @@
 #ifndef ADVSTATUSSECTION_H
 #define ADVSTATUSSECTION_H
 
-#include <map>
-#include <list>
+#include <vector>
 #include <string>
 #include <stdio.h>
 #include "utils.h"
@@ -14,30 +13,92 @@
 using namespace std;
 using std::string;
 
+// The first byte of a frame in version 2 of the status section
+#define STATUS_KEY_FRAME 0
+#define STATUS_DELTA_FRAME 1
+
+// How the value of a tag in a delta frame is written
+#define STATUS_ENTRY_VALUE 0
+#define STATUS_ENTRY_DELTA 1
+#define STATUS_ENTRY_PREFIX 2
+#define STATUS_ENTRY_NOT_SET 3
+
 namespace AavLib
 {
-	
+
+// Configured with AavSetupStatusDeltaEncoding() and used by the next file. 0 writes every tag of every frame
+extern unsigned int g_AavStatusSnapshotInterval;
+
+// Where the entry of a tag (the tag id and the value) is kept between BeginFrame() and GetDataBytes()
+struct AavStatusTagSlot
+{
+	AavTagType Type;
+	// Offset of the entry in the buffer of its kind of tags, or -1 for tags which cannot be set
+	int Offset;
+	// Bytes of the entry of a fixed size tag
+	unsigned int EntryBytes;
+	// The oldest message and the number of messages of a List16OfAnsiString255 tag
+	unsigned int FirstMessage;
+	unsigned int MessagesCount;
+};
+
+// The tags are compiled by DefineTag() into slots at fixed offsets, in the order GetDataBytes() writes them: the
+// fixed size tags grouped by type (ULong64, UInt16, UInt8, Real) then the strings and the message lists, each by
+// tag id. The entries of the fixed size tags are stored in place with their tag ids already written, so when all
+// of them are set the frame is encoded with one copy whatever the number of tags.
+//
+// Version 2 of the section starts each frame with STATUS_KEY_FRAME or STATUS_DELTA_FRAME. A key frame, written every
+// snapshot interval frames, holds the tags as version 1 does. A delta frame only holds the tags which changed since
+// the previous frame, each as the tag id, an STATUS_ENTRY_* code and the value. The ULong64 tags are predicted to
+// keep the step they had between the previous two frames, so counters and timestamps taken at a constant rate are
+// not written at all, and the others are written as zigzag varints of the difference from the prediction. The
+// strings are written as the chars which follow the prefix they share with the previous value. Message lists are
+// events and are not carried over from the previous frame
 class AavStatusSection {
 
-	private:		
-		list<string> m_TagDefinitionNames;
-		list<AavTagType> m_TagDefinitionTypes;
-		
-		map<unsigned int, string> m_FrameStatusTags;
-		map<unsigned int, unsigned char> m_FrameStatusTagsUInt8;
-		map<unsigned int, unsigned short> m_FrameStatusTagsUInt16;
-		map<unsigned int, long long> m_FrameStatusTagsUInt64;
-		map<unsigned int, float> m_FrameStatusTagsReal;
-		map<unsigned int, list<string> > m_FrameStatusTagsMessages;
-		
+	private:
+		vector<string> m_TagDefinitionNames;
+		vector<AavStatusTagSlot> m_TagSlots;
+
+		// The tag ids of each kind of tags, in the order they are written
+		vector<unsigned int> m_FixedSizeTags;
+		vector<unsigned int> m_StringTags;
+		vector<unsigned int> m_MessageTags;
+
+		unsigned char* m_FixedSizeEntries;
+		unsigned int m_FixedSizeEntriesBytes;
+		unsigned char* m_StringEntries;
+		unsigned char* m_MessageEntries;
+
+		// Whether each tag is set in the current frame, and how many of the fixed size tags are
+		vector<unsigned char> m_TagIsSet;
+		unsigned int m_FixedSizeTagsSet;
+		unsigned int m_OtherTagsSet;
+
+		// Version 2 only, the tags as the reader decoded them from the previous frame
+		unsigned int m_SnapshotInterval;
+		unsigned int m_FramesSinceSnapshot;
+		unsigned char* m_PrevFixedSizeEntries;
+		unsigned char* m_PrevStringEntries;
+		vector<unsigned char> m_TagWasSet;
+		vector<long long> m_TagSteps;
+
+		void CompileSchema();
+		unsigned char* BeginFixedSizeTag(unsigned int tagIndex, AavTagType tagType);
+		void GetFullFrameBytes(unsigned char* destination, unsigned int *bytesCount);
+		void GetDeltaFrameBytes(unsigned char* destination, unsigned int *bytesCount);
+		void KeepPreviousFrame(bool keyFrame);
+
 	public:
 		int MaxFrameBufferSize;
-		
+
 	public:
 		AavStatusSection();
 		~AavStatusSection();
 
 		unsigned int DefineTag(const char* tagName, enum AavTagType tagType);
+		// Version 2 with a key frame every snapshotInterval frames, or version 1 when 0. Called before WriteHeader()
+		void SetSnapshotInterval(unsigned int snapshotInterval);
 		void WriteHeader(FILE* pfile);
 		void AddFrameStatusTag(unsigned int tagIndex, const char* tagValue);
 		void AddFrameStatusTagMessage(unsigned int tagIndex, const char* tagValue);
@@ -45,9 +106,10 @@ class AavStatusSection {
 		void AddFrameStatusTagUInt16(unsigned int tagIndex, unsigned short tagValue);
 		void AddFrameStatusTagReal(unsigned int tagIndex, float tagValue);
 		void AddFrameStatusTagUInt64(unsigned int tagIndex, long long tagValue);
-		unsigned char* GetDataBytes(unsigned int *bytesCount);
+		// Writes the status bytes to the destination, which must have room for MaxFrameBufferSize bytes
+		void GetDataBytes(unsigned char* destination, unsigned int *bytesCount);
 		void BeginFrame();
-		
+
 };
 
 
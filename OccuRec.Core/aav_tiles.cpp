@@ -0,0 +1,71 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+
+#include "aav_tiles.h"
+#include <string.h>
+
+namespace AavLib
+{
+
+unsigned int TilesCount(unsigned int width, unsigned int height, unsigned int tileSize)
+{
+	return ((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+}
+
+void GetTile(unsigned int width, unsigned int height, unsigned int tileSize, unsigned int tileNo, AavTile* tile)
+{
+	unsigned int tilesPerRow = (width + tileSize - 1) / tileSize;
+	unsigned int tileRow = tileNo / tilesPerRow;
+	unsigned int tileColumn = tileNo % tilesPerRow;
+
+	tile->X = tileColumn * tileSize;
+	tile->Y = tileRow * tileSize;
+	tile->Width = width - tile->X < tileSize ? width - tile->X : tileSize;
+	tile->Height = height - tile->Y < tileSize ? height - tile->Y : tileSize;
+
+	// The rows of tiles above it are tileSize rows of the whole image, and the tiles before it in its row have its height
+	tile->FirstPixel = tile->Y * width + tile->X * tile->Height;
+}
+
+void CropTile(const unsigned char* pixels, unsigned int width, unsigned int pixelBytes, const AavTile* tile, unsigned char* tilePixels)
+{
+	for (unsigned int y = 0; y < tile->Height; y++)
+		memcpy(tilePixels + y * tile->Width * pixelBytes, pixels + ((tile->Y + y) * width + tile->X) * pixelBytes, tile->Width * pixelBytes);
+}
+
+void SplitTiles(const unsigned char* pixels, unsigned int width, unsigned int height, unsigned int pixelBytes, unsigned int tileSize, unsigned char* tiles)
+{
+	unsigned int tilesCount = TilesCount(width, height, tileSize);
+
+	for (unsigned int i = 0; i < tilesCount; i++)
+	{
+		AavTile tile;
+		GetTile(width, height, tileSize, i, &tile);
+
+		CropTile(pixels, width, pixelBytes, &tile, tiles + tile.FirstPixel * pixelBytes);
+	}
+}
+
+void CopyTileToRegion(const unsigned char* tilePixels, const AavTile* tile, unsigned int pixelBytes, unsigned int regionX, unsigned int regionY, unsigned int regionWidth, unsigned int regionHeight, unsigned char* regionPixels)
+{
+	unsigned int left = tile->X > regionX ? tile->X : regionX;
+	unsigned int top = tile->Y > regionY ? tile->Y : regionY;
+	unsigned int right = tile->X + tile->Width < regionX + regionWidth ? tile->X + tile->Width : regionX + regionWidth;
+	unsigned int bottom = tile->Y + tile->Height < regionY + regionHeight ? tile->Y + tile->Height : regionY + regionHeight;
+
+	if (left >= right)
+		return;
+
+	for (unsigned int y = top; y < bottom; y++)
+	{
+		memcpy(
+			regionPixels + ((y - regionY) * regionWidth + left - regionX) * pixelBytes,
+			tilePixels + ((y - tile->Y) * tile->Width + left - tile->X) * pixelBytes,
+			(right - left) * pixelBytes);
+	}
+}
+
+}
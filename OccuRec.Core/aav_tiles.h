@@ -0,0 +1,51 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef AAV_TILES_H
+#define AAV_TILES_H
+
+// The tile size of a FULL-IMAGE-TILED layout defined without one
+#define AAV_DEFAULT_TILE_SIZE 64
+
+// The most regions of a frame of the REGIONS-OF-INTEREST layouts, and the bytes of the table of the regions which
+// starts the frame, the number of regions and the x, y, width and height of each, in little endian 16 bit words
+#define AAV_MAX_REGIONS_OF_INTEREST 16
+#define AAV_REGIONS_TABLE_BYTES (2 + 8 * AAV_MAX_REGIONS_OF_INTEREST)
+
+namespace AavLib
+{
+
+// The FULL-IMAGE-TILED layouts split the image into tiles of tileSize x tileSize pixels, cut at the right and bottom
+// edges of the image. The tiles are stored one after the other in row order, each with its pixels in row order, and
+// are compressed independently, so a region of the image is decoded from the tiles it overlaps. The frames of the
+// REGIONS-OF-INTEREST layouts between their reference frames store only the crops of the regions, which are tiles of
+// any size and position, one after the other
+
+struct AavTile
+{
+	unsigned int X;
+	unsigned int Y;
+	unsigned int Width;
+	unsigned int Height;
+	// The number of pixels of the tiles before it
+	unsigned int FirstPixel;
+};
+
+unsigned int TilesCount(unsigned int width, unsigned int height, unsigned int tileSize);
+
+void GetTile(unsigned int width, unsigned int height, unsigned int tileSize, unsigned int tileNo, AavTile* tile);
+
+// Copies the pixels of the tile from the image of the given width into the tile pixels, in row order
+void CropTile(const unsigned char* pixels, unsigned int width, unsigned int pixelBytes, const AavTile* tile, unsigned char* tilePixels);
+
+// Copies the pixels of the image, of 1 or 2 bytes each, into the tiles
+void SplitTiles(const unsigned char* pixels, unsigned int width, unsigned int height, unsigned int pixelBytes, unsigned int tileSize, unsigned char* tiles);
+
+// Copies the pixels of the tile which are in the region into the region pixels, regionWidth pixels per row. A tile of
+// the whole image crops the image
+void CopyTileToRegion(const unsigned char* tilePixels, const AavTile* tile, unsigned int pixelBytes, unsigned int regionX, unsigned int regionY, unsigned int regionWidth, unsigned int regionHeight, unsigned char* regionPixels);
+
+}
+
+#endif // AAV_TILES_H
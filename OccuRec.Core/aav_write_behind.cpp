@@ -0,0 +1,356 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+#include "aav_write_behind.h"
+#include "aav_profiling.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BUFFER_FREE 0
+#define BUFFER_PENDING 1
+
+#define FILL_IDLE 0
+#define FILL_WRITING 1
+#define FILL_TAKING 2
+
+// Keeps the buffers and the writes aligned to the sectors and memory pages
+#define WRITE_BUFFER_ALIGNMENT 4096
+
+namespace AavLib
+{
+
+unsigned int g_AavWriteBufferSize = 8 * 1024 * 1024;
+unsigned int g_AavDurabilityIntervalMs = 1000;
+
+__int64 g_AavDiskWrites = 0;
+__int64 g_AavDiskWriteTicks = 0;
+__int64 g_AavDiskWriteMaxTicks = 0;
+__int64 g_AavDiskSyncs = 0;
+__int64 g_AavWriteStallTicks = 0;
+
+AavWriteBehind::AavWriteBehind(FILE* file, __int64 position, unsigned int maxWriteSize, FILE* journal)
+{
+	m_File = file;
+	m_Position = position;
+	m_Journal = journal;
+
+	// Two frames of the largest size must always fit in a buffer
+	m_BufferSize = max(g_AavWriteBufferSize, 2 * maxWriteSize);
+	m_BufferSize = (m_BufferSize + WRITE_BUFFER_ALIGNMENT - 1) & ~(WRITE_BUFFER_ALIGNMENT - 1);
+
+	for (int i = 0; i < 2; i++)
+	{
+		m_Buffers[i] = (unsigned char*)PlatformAlignedAlloc(m_BufferSize, WRITE_BUFFER_ALIGNMENT);
+		m_BufferLength[i] = 0;
+		m_BufferState[i] = BUFFER_FREE;
+
+		m_JournalBuffers[i] = NULL;
+		m_JournalLength[i] = 0;
+		m_JournalCapacity[i] = 0;
+	}
+
+	m_FillBuffer = 0;
+	m_FillLength = 0;
+	m_FillState = FILL_IDLE;
+	m_FillReleasedEvent = PlatformCreateEvent();
+	m_JournalFailed = false;
+
+	m_DurabilityIntervalTicks = PlatformPerformanceFrequency() * g_AavDurabilityIntervalMs / 1000;
+	m_LastSubmitTicks = PlatformPerformanceCounter();
+	m_LastSyncTicks = m_LastSubmitTicks;
+	m_IsSynced = true;
+
+	m_BufferPendingEvent = PlatformCreateEvent();
+	m_BufferWrittenEvent = PlatformCreateEvent();
+
+	m_StopWriter = 0;
+	m_WriteFailed = 0;
+	m_WriterThread = PlatformStartThread(WriterThreadProc, this);
+}
+
+AavWriteBehind::~AavWriteBehind()
+{
+	Close();
+
+	PlatformDestroyEvent(m_BufferPendingEvent);
+	PlatformDestroyEvent(m_BufferWrittenEvent);
+	PlatformDestroyEvent(m_FillReleasedEvent);
+
+	for (int i = 0; i < 2; i++)
+	{
+		PlatformAlignedFree(m_Buffers[i]);
+		m_Buffers[i] = NULL;
+
+		if (NULL != m_JournalBuffers[i])
+		{
+			free(m_JournalBuffers[i]);
+			m_JournalBuffers[i] = NULL;
+		}
+	}
+}
+
+// The fill buffer is only ever claimed for a short time by the writer thread
+void AavWriteBehind::ClaimFillBuffer(LONG fillState)
+{
+	while (PlatformCompareExchange(&m_FillState, fillState, FILL_IDLE) != FILL_IDLE)
+		PlatformWaitForEvent(m_FillReleasedEvent, PLATFORM_WAIT_INFINITE);
+}
+
+// Only the recording thread waits for the fill buffer
+void AavWriteBehind::ReleaseFillBuffer(LONG fillState)
+{
+	PlatformCompareExchange(&m_FillState, FILL_IDLE, fillState);
+	if (fillState == FILL_TAKING)
+		PlatformSetEvent(m_FillReleasedEvent);
+}
+
+unsigned char* AavWriteBehind::BeginWrite(unsigned int maxBytes)
+{
+	ClaimFillBuffer(FILL_WRITING);
+
+	if (m_FillLength + maxBytes > m_BufferSize)
+		SubmitFillBuffer();
+
+	return m_Buffers[m_FillBuffer] + m_FillLength;
+}
+
+void AavWriteBehind::EndWrite(unsigned int bytes)
+{
+	bool wasEmpty = m_FillLength == 0;
+	m_FillLength += bytes;
+	m_Position += bytes;
+
+	// Written before the buffer is full when the durability interval has passed. Only done when the writer
+	// is idle, so this never stalls the recording
+	if (PlatformPerformanceCounter() - m_LastSubmitTicks >= m_DurabilityIntervalTicks &&
+		PlatformCompareExchange(&m_BufferState[1 - m_FillBuffer], BUFFER_FREE, BUFFER_FREE) == BUFFER_FREE)
+	{
+		SubmitFillBuffer();
+	}
+	else if (wasEmpty)
+	{
+		// The idle writer waits for the durability interval of the new data
+		PlatformSetEvent(m_BufferPendingEvent);
+	}
+
+	ReleaseFillBuffer(FILL_WRITING);
+}
+
+void AavWriteBehind::AddJournalEntry(const unsigned char* entry, unsigned int bytes)
+{
+	if (NULL == m_Journal || m_JournalFailed)
+		return;
+
+	// The journal of the fill buffer is only used by the writer thread once the buffer is submitted
+	unsigned int length = m_JournalLength[m_FillBuffer];
+	if (length + bytes > m_JournalCapacity[m_FillBuffer])
+	{
+		unsigned int capacity = max(2 * m_JournalCapacity[m_FillBuffer], length + bytes + 4096);
+		unsigned char* journalBuffer = (unsigned char*)realloc(m_JournalBuffers[m_FillBuffer], capacity);
+		if (NULL == journalBuffer)
+		{
+			// The entries already journaled still describe the frames before this one, which are recoverable
+			DebugViewPrint(L"AAV: Cannot grow the index journal buffer, the next frames will not be recoverable\n");
+			m_JournalFailed = true;
+			return;
+		}
+
+		m_JournalBuffers[m_FillBuffer] = journalBuffer;
+		m_JournalCapacity[m_FillBuffer] = capacity;
+	}
+
+	memcpy(m_JournalBuffers[m_FillBuffer] + length, entry, bytes);
+	m_JournalLength[m_FillBuffer] = length + bytes;
+}
+
+__int64 AavWriteBehind::GetPosition()
+{
+	return m_Position;
+}
+
+// Called by the thread which has claimed the fill buffer
+void AavWriteBehind::HandOffFillBuffer()
+{
+	m_BufferLength[m_FillBuffer] = m_FillLength;
+	PlatformCompareExchange(&m_BufferState[m_FillBuffer], BUFFER_PENDING, BUFFER_FREE);
+	PlatformSetEvent(m_BufferPendingEvent);
+
+	m_FillBuffer = 1 - m_FillBuffer;
+	m_FillLength = 0;
+	m_LastSubmitTicks = PlatformPerformanceCounter();
+}
+
+void AavWriteBehind::SubmitFillBuffer()
+{
+	if (m_FillLength == 0)
+		return;
+
+	HandOffFillBuffer();
+
+	if (PlatformCompareExchange(&m_BufferState[m_FillBuffer], BUFFER_FREE, BUFFER_FREE) != BUFFER_FREE)
+	{
+		// Both buffers are waiting for the disk
+		while (PlatformCompareExchange(&m_BufferState[m_FillBuffer], BUFFER_FREE, BUFFER_FREE) != BUFFER_FREE)
+			PlatformWaitForEvent(m_BufferWrittenEvent, PLATFORM_WAIT_INFINITE);
+
+		g_AavWriteStallTicks += PlatformPerformanceCounter() - m_LastSubmitTicks;
+	}
+}
+
+// Called by the writer thread when the data in the fill buffer has waited for the durability interval. Not taken
+// while a frame is written to it, as EndWrite() then submits it
+bool AavWriteBehind::TakeFillBuffer()
+{
+	if (PlatformCompareExchange(&m_FillState, FILL_TAKING, FILL_IDLE) != FILL_IDLE)
+		return false;
+
+	bool isTaken = m_FillLength > 0 &&
+		PlatformCompareExchange(&m_BufferState[1 - m_FillBuffer], BUFFER_FREE, BUFFER_FREE) == BUFFER_FREE;
+	if (isTaken)
+		HandOffFillBuffer();
+
+	ReleaseFillBuffer(FILL_TAKING);
+	return isTaken;
+}
+
+void AavWriteBehind::WriteBuffer(int bufferIndex)
+{
+	__int64 startTicks = PlatformPerformanceCounter();
+
+	unsigned int length = m_BufferLength[bufferIndex];
+	if (advfwrite(m_Buffers[bufferIndex], 1, length, m_File) != length || 0 != advfflush(m_File))
+	{
+		if (0 == PlatformCompareExchange(&m_WriteFailed, 1, 0))
+			DebugViewPrint(L"AAV: Writing %d bytes to the file failed\n", length);
+	}
+
+	// The journal only describes frames which are already written. Once a write has failed the entries are kept
+	// but no longer journaled, so the journal never describes frames which are not in the file
+	unsigned int journalLength = m_JournalLength[bufferIndex];
+	if (journalLength > 0 && m_WriteFailed == 0)
+	{
+		if (fwrite(m_JournalBuffers[bufferIndex], 1, journalLength, m_Journal) != journalLength || 0 != fflush(m_Journal))
+			DebugViewPrint(L"AAV: Writing %d bytes to the index journal failed\n", journalLength);
+
+		m_JournalLength[bufferIndex] = 0;
+	}
+
+	m_IsSynced = false;
+
+	__int64 endTicks = PlatformPerformanceCounter();
+	if (endTicks - m_LastSyncTicks >= m_DurabilityIntervalTicks)
+	{
+		SyncFiles();
+		g_AavDiskSyncs++;
+		m_IsSynced = true;
+		m_LastSyncTicks = endTicks = PlatformPerformanceCounter();
+	}
+
+	g_AavDiskWrites++;
+	g_AavDiskWriteTicks += endTicks - startTicks;
+	if (endTicks - startTicks > g_AavDiskWriteMaxTicks)
+		g_AavDiskWriteMaxTicks = endTicks - startTicks;
+}
+
+void AavWriteBehind::WriterThreadProc(void* context)
+{
+	AavWriteBehind* writer = (AavWriteBehind*)context;
+	int nextBuffer = 0;
+
+	for (;;)
+	{
+		if (PlatformCompareExchange(&writer->m_BufferState[nextBuffer], BUFFER_PENDING, BUFFER_PENDING) == BUFFER_PENDING)
+		{
+			writer->WriteBuffer(nextBuffer);
+
+			PlatformCompareExchange(&writer->m_BufferState[nextBuffer], BUFFER_FREE, BUFFER_PENDING);
+			PlatformSetEvent(writer->m_BufferWrittenEvent);
+			nextBuffer = 1 - nextBuffer;
+			continue;
+		}
+
+		// The last buffer is submitted before the writer is stopped, so it is pending if not seen above
+		if (writer->m_StopWriter != 0)
+		{
+			if (PlatformCompareExchange(&writer->m_BufferState[nextBuffer], BUFFER_PENDING, BUFFER_PENDING) == BUFFER_PENDING)
+				continue;
+
+			break;
+		}
+
+		// Idle until the next buffer is submitted, or until the written data is due to be synced or the data of the
+		// partly filled buffer is due to be written
+		__int64 timeoutTicks = -1;
+		if (!writer->m_IsSynced)
+		{
+			__int64 remainingTicks = writer->m_DurabilityIntervalTicks - (PlatformPerformanceCounter() - writer->m_LastSyncTicks);
+			if (remainingTicks <= 0)
+			{
+				writer->SyncFiles();
+				g_AavDiskSyncs++;
+				writer->m_IsSynced = true;
+				writer->m_LastSyncTicks = PlatformPerformanceCounter();
+				continue;
+			}
+
+			timeoutTicks = remainingTicks;
+		}
+
+		if (writer->m_FillLength > 0)
+		{
+			// Only a hint until the fill buffer is claimed
+			__int64 remainingTicks = writer->m_DurabilityIntervalTicks - (PlatformPerformanceCounter() - writer->m_LastSubmitTicks);
+			if (remainingTicks <= 0)
+			{
+				if (writer->TakeFillBuffer())
+					continue;
+			}
+			else if (timeoutTicks < 0 || remainingTicks < timeoutTicks)
+				timeoutTicks = remainingTicks;
+		}
+
+		unsigned int timeoutMs = timeoutTicks < 0
+			? PLATFORM_WAIT_INFINITE
+			: (unsigned int)(timeoutTicks * 1000 / PlatformPerformanceFrequency()) + 1;
+
+		PlatformWaitForEvent(writer->m_BufferPendingEvent, timeoutMs);
+	}
+}
+
+// The data first, so the journal on the disk never describes frames which are not
+int AavWriteBehind::SyncFiles()
+{
+	int rv = PlatformSyncFile(m_File);
+
+	if (NULL != m_Journal && 0 != PlatformSyncFile(m_Journal))
+		rv = -1;
+
+	return rv;
+}
+
+bool AavWriteBehind::Close()
+{
+	if (NULL != m_WriterThread)
+	{
+		ClaimFillBuffer(FILL_WRITING);
+		SubmitFillBuffer();
+		ReleaseFillBuffer(FILL_WRITING);
+
+		PlatformInterlockedIncrement(&m_StopWriter);
+		PlatformSetEvent(m_BufferPendingEvent);
+		PlatformWaitForThread(m_WriterThread);
+		m_WriterThread = NULL;
+
+		if (0 != SyncFiles())
+			m_WriteFailed = 1;
+
+		g_AavDiskSyncs++;
+	}
+
+	return m_WriteFailed == 0;
+}
+
+}
@@ -0,0 +1,99 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef ADVWRITEBEHIND_H
+#define ADVWRITEBEHIND_H
+
+#include <stdio.h>
+#include "platform.h"
+
+namespace AavLib
+{
+
+// Configured with AavSetupWriteBehind() and used by the next file
+extern unsigned int g_AavWriteBufferSize;
+extern unsigned int g_AavDurabilityIntervalMs;
+
+// Statistics of the writer thread, reset by ResetProfilingInfo()
+extern __int64 g_AavDiskWrites;
+extern __int64 g_AavDiskWriteTicks;
+extern __int64 g_AavDiskWriteMaxTicks;
+extern __int64 g_AavDiskSyncs;
+extern __int64 g_AavWriteStallTicks;
+
+// Frames are assembled directly in one of two large aligned buffers. A full buffer is handed to a dedicated
+// writer thread while the recording continues in the other one, so a slow disk only stalls the recording
+// when both buffers are waiting to be written. The file is synced to the disk every durability interval
+// instead of flushed after every frame.
+// A partly filled buffer is taken by the writer thread once its data has waited for the durability interval,
+// also when no more frames come.
+// The index entries of the frames can be journaled to a second file. They are appended to it after the data
+// of their frames is written and synced together with it, so a file which is not closed can be recovered
+class AavWriteBehind {
+
+	private:
+		FILE* m_File;
+		unsigned char* m_Buffers[2];
+		unsigned int m_BufferSize;
+		volatile unsigned int m_BufferLength[2];
+		volatile LONG m_BufferState[2];
+		int m_FillBuffer;
+		volatile unsigned int m_FillLength;
+		__int64 m_Position;
+
+		// Claimed by the recording thread from BeginWrite() to EndWrite(), or by the writer thread while it takes the
+		// partly filled buffer, which sets the event when done
+		volatile LONG m_FillState;
+		HANDLE m_FillReleasedEvent;
+
+		FILE* m_Journal;
+		unsigned char* m_JournalBuffers[2];
+		volatile unsigned int m_JournalLength[2];
+		unsigned int m_JournalCapacity[2];
+		bool m_JournalFailed;
+
+		__int64 m_DurabilityIntervalTicks;
+		__int64 m_LastSubmitTicks;
+		__int64 m_LastSyncTicks;
+		bool m_IsSynced;
+
+		HANDLE m_WriterThread;
+		volatile LONG m_StopWriter;
+		// Set when a buffer is submitted, the fill buffer gets its first data or the writer is stopped, and when a buffer
+		// has been written
+		HANDLE m_BufferPendingEvent;
+		HANDLE m_BufferWrittenEvent;
+		volatile LONG m_WriteFailed;
+
+		void ClaimFillBuffer(LONG fillState);
+		void ReleaseFillBuffer(LONG fillState);
+		void HandOffFillBuffer();
+		void SubmitFillBuffer();
+		bool TakeFillBuffer();
+		void WriteBuffer(int bufferIndex);
+		int SyncFiles();
+
+		static void WriterThreadProc(void* context);
+
+	public:
+		AavWriteBehind(FILE* file, __int64 position, unsigned int maxWriteSize, FILE* journal);
+		~AavWriteBehind();
+
+		// Returns at least maxBytes of contiguous space for the next write, which is completed by EndWrite()
+		unsigned char* BeginWrite(unsigned int maxBytes);
+		void EndWrite(unsigned int bytes);
+
+		// Journals bytes describing the data written since BeginWrite(). Must be called before EndWrite()
+		void AddJournalEntry(const unsigned char* entry, unsigned int bytes);
+
+		// The file offset of the next write
+		__int64 GetPosition();
+
+		// Writes all buffered data, syncs the files and stops the writer thread. The files can be used directly afterwards
+		bool Close();
+};
+
+}
+
+#endif // ADVWRITEBEHIND_H
@@ -0,0 +1,142 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+#include "crc32c.h"
+#include <string.h>
+
+// The SSE 4.2 code is compiled for any x86 CPU and only called when cpuid reports the instruction
+#if defined(_M_X64) || defined(_M_IX86)
+#define CRC32C_SSE42
+#define CRC32C_TARGET_SSE42
+#include <intrin.h>
+#include <nmmintrin.h>
+#elif (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CRC32C_SSE42
+#define CRC32C_TARGET_SSE42 __attribute__((target("sse4.2")))
+#include <cpuid.h>
+#include <nmmintrin.h>
+#endif
+
+// The reversed Castagnoli polynomial
+#define CRC32C_POLY 0x82F63B78
+
+typedef unsigned int (*Crc32cFunction)(const unsigned char* data, size_t len);
+
+static unsigned int s_Crc32cTables[8][256];
+
+// s_Crc32cTables[k][b] is the CRC of the byte b followed by k zero bytes
+static void InitCrc32cTables()
+{
+	for (unsigned int b = 0; b < 256; b++)
+	{
+		unsigned int crc = b;
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+
+		s_Crc32cTables[0][b] = crc;
+	}
+
+	for (unsigned int b = 0; b < 256; b++)
+	{
+		for (int k = 1; k < 8; k++)
+			s_Crc32cTables[k][b] = (s_Crc32cTables[k - 1][b] >> 8) ^ s_Crc32cTables[0][s_Crc32cTables[k - 1][b] & 0xFF];
+	}
+}
+
+bool crc32c_has_sse42(void)
+{
+#if defined(CRC32C_SSE42) && (defined(_M_X64) || defined(_M_IX86))
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 20)) != 0;
+#elif defined(CRC32C_SSE42)
+	unsigned int eax, ebx, ecx, edx;
+	return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSE4_2) != 0;
+#else
+	return false;
+#endif
+}
+
+// Eight bytes are looked up in the eight tables at once, the x86 byte order is assumed
+unsigned int compute_crc32c_slicing8(const unsigned char* data, size_t len)
+{
+	unsigned int crc = 0xFFFFFFFF;
+
+	for (; len > 0 && ((size_t)data & 7) != 0; len--)
+		crc = s_Crc32cTables[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+
+	for (; len >= 8; len -= 8, data += 8)
+	{
+		unsigned int lo;
+		unsigned int hi;
+		memcpy(&lo, data, 4);
+		memcpy(&hi, data + 4, 4);
+		lo ^= crc;
+
+		crc =
+			s_Crc32cTables[7][lo & 0xFF] ^ s_Crc32cTables[6][(lo >> 8) & 0xFF] ^
+			s_Crc32cTables[5][(lo >> 16) & 0xFF] ^ s_Crc32cTables[4][lo >> 24] ^
+			s_Crc32cTables[3][hi & 0xFF] ^ s_Crc32cTables[2][(hi >> 8) & 0xFF] ^
+			s_Crc32cTables[1][(hi >> 16) & 0xFF] ^ s_Crc32cTables[0][hi >> 24];
+	}
+
+	for (; len > 0; len--)
+		crc = s_Crc32cTables[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+#ifdef CRC32C_SSE42
+CRC32C_TARGET_SSE42 unsigned int compute_crc32c_sse42(const unsigned char* data, size_t len)
+{
+	unsigned int crc = 0xFFFFFFFF;
+
+	for (; len > 0 && ((size_t)data & 7) != 0; len--)
+		crc = _mm_crc32_u8(crc, *data++);
+
+#if defined(_M_X64) || defined(__x86_64__)
+	unsigned long long crc64 = crc;
+	for (; len >= 8; len -= 8, data += 8)
+	{
+		unsigned long long value;
+		memcpy(&value, data, 8);
+		crc64 = _mm_crc32_u64(crc64, value);
+	}
+	crc = (unsigned int)crc64;
+#else
+	for (; len >= 4; len -= 4, data += 4)
+	{
+		unsigned int value;
+		memcpy(&value, data, 4);
+		crc = _mm_crc32_u32(crc, value);
+	}
+#endif
+
+	for (; len > 0; len--)
+		crc = _mm_crc32_u8(crc, *data++);
+
+	return ~crc;
+}
+#else
+unsigned int compute_crc32c_sse42(const unsigned char* data, size_t len)
+{
+	return compute_crc32c_slicing8(data, len);
+}
+#endif
+
+static Crc32cFunction SelectCrc32c()
+{
+	InitCrc32cTables();
+
+	return crc32c_has_sse42() ? compute_crc32c_sse42 : compute_crc32c_slicing8;
+}
+
+// Selected when the library is loaded, so the frames can be checked by any thread
+static Crc32cFunction s_Crc32c = SelectCrc32c();
+
+unsigned int compute_crc32c(const unsigned char* data, size_t len)
+{
+	return s_Crc32c(data, len);
+}
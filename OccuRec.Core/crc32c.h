@@ -0,0 +1,19 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+
+// The CRC-32C (Castagnoli) of the bytes, as computed by the crc32 instruction of SSE 4.2. The instruction is used
+// when the CPU has it, and the slicing by 8 tables otherwise
+unsigned int compute_crc32c(const unsigned char* data, size_t len);
+
+// The two implementations, for the benchmarks. compute_crc32c_sse42() must only be called when crc32c_has_sse42()
+bool crc32c_has_sse42(void);
+unsigned int compute_crc32c_slicing8(const unsigned char* data, size_t len);
+unsigned int compute_crc32c_sse42(const unsigned char* data, size_t len);
+
+#endif // CRC32C_H
@@ -5,7 +5,6 @@
 // dllmain.cpp : Defines the entry point for the DLL application.
 #include "stdafx.h"
 #include "SyncLock.h"
-#include <process.h>
 #include "OccuRec.Core.h"
 #include "utils.h"
 
@@ -24,8 +23,8 @@ BOOL APIENTRY DllMain( HMODULE hModule,
 
 		case DLL_PROCESS_ATTACH:
 			DebugViewPrint(L"OccuRec: DLL_PROCESS_ATTACH\r\n");
-			hFrameProcessingThread = (HANDLE)_beginthread(FrameProcessingThreadProc, 0, NULL);
 			SyncLock::Initialise();
+			hFrameProcessingThread = PlatformStartThread(FrameProcessingThreadProc, NULL);
 			break;
 		
 		case DLL_PROCESS_DETACH:
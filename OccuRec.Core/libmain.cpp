@@ -0,0 +1,26 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// libmain.cpp : The counterpart of dllmain.cpp for the shared library builds on non Windows platforms.
+#include "stdafx.h"
+#include "SyncLock.h"
+#include "OccuRec.Core.h"
+#include "utils.h"
+
+#ifndef _WIN32
+
+HANDLE hFrameProcessingThread;
+
+__attribute__((constructor))
+static void SharedLibraryLoad()
+{
+	DebugViewPrint(L"OccuRec: Shared library loaded\r\n");
+	SyncLock::Initialise();
+	hFrameProcessingThread = PlatformStartThread(FrameProcessingThreadProc, NULL);
+}
+
+// No destructor calling SyncLock::Uninitialise(). The frame processing thread never exits and may still
+// hold or wait for the locks while the process is shutting down
+
+#endif
@@ -0,0 +1,535 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "stdafx.h"
+#include "platform.h"
+
+#ifdef _WIN32
+
+#include <io.h>
+#include <malloc.h>
+#include <process.h>
+#include <stdlib.h>
+
+struct PlatformThreadStart
+{
+	PlatformThreadProc ThreadProc;
+	void* Context;
+};
+
+static unsigned __stdcall PlatformThreadEntry(void* arg)
+{
+	PlatformThreadStart start = *(PlatformThreadStart*)arg;
+	free(arg);
+
+	start.ThreadProc(start.Context);
+	return 0;
+}
+
+// _beginthreadex() rather than _beginthread(), which closes the handle when the thread exits
+HANDLE PlatformStartThread(PlatformThreadProc threadProc, void* context)
+{
+	PlatformThreadStart* start = (PlatformThreadStart*)malloc(sizeof(PlatformThreadStart));
+	start->ThreadProc = threadProc;
+	start->Context = context;
+
+	HANDLE thread = (HANDLE)_beginthreadex(NULL, 0, PlatformThreadEntry, start, 0, NULL);
+	if (NULL == thread)
+		free(start);
+
+	return thread;
+}
+
+void PlatformWaitForThread(HANDLE thread)
+{
+	if (NULL == thread)
+		return;
+
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+}
+
+void PlatformSleep(unsigned int milliseconds)
+{
+	Sleep(milliseconds);
+}
+
+void PlatformYieldThread(void)
+{
+	SwitchToThread();
+}
+
+void PlatformSpinPause(void)
+{
+	YieldProcessor();
+}
+
+unsigned long PlatformCurrentThreadId(void)
+{
+	return GetCurrentThreadId();
+}
+
+unsigned int PlatformNumberOfProcessors(void)
+{
+	SYSTEM_INFO sysinfo;
+	GetSystemInfo(&sysinfo);
+	return sysinfo.dwNumberOfProcessors;
+}
+
+HANDLE PlatformCreateMutex(void)
+{
+	return CreateMutex(NULL, FALSE, NULL);
+}
+
+void PlatformLockMutex(HANDLE mutex)
+{
+	WaitForSingleObject(mutex, INFINITE);
+}
+
+void PlatformUnlockMutex(HANDLE mutex)
+{
+	ReleaseMutex(mutex);
+}
+
+void PlatformDestroyMutex(HANDLE mutex)
+{
+	CloseHandle(mutex);
+}
+
+HANDLE PlatformCreateEvent(void)
+{
+	return CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+void PlatformSetEvent(HANDLE event)
+{
+	SetEvent(event);
+}
+
+int PlatformWaitForEvent(HANDLE event, unsigned int milliseconds)
+{
+	return WaitForSingleObject(event, PLATFORM_WAIT_INFINITE == milliseconds ? INFINITE : milliseconds) == WAIT_OBJECT_0 ? 1 : 0;
+}
+
+void PlatformDestroyEvent(HANDLE event)
+{
+	CloseHandle(event);
+}
+
+LONG PlatformCompareExchange(volatile LONG* destination, LONG exchange, LONG comparand)
+{
+	return InterlockedCompareExchange(destination, exchange, comparand);
+}
+
+LONG PlatformInterlockedIncrement(volatile LONG* destination)
+{
+	return InterlockedIncrement(destination);
+}
+
+LONG PlatformInterlockedDecrement(volatile LONG* destination)
+{
+	return InterlockedDecrement(destination);
+}
+
+__int64 PlatformPerformanceCounter(void)
+{
+	LARGE_INTEGER ticks;
+	QueryPerformanceCounter(&ticks);
+	return ticks.QuadPart;
+}
+
+__int64 PlatformPerformanceFrequency(void)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return frequency.QuadPart;
+}
+
+void* PlatformAlignedAlloc(size_t size, size_t alignment)
+{
+	return _aligned_malloc(size, alignment);
+}
+
+void PlatformAlignedFree(void* memory)
+{
+	_aligned_free(memory);
+}
+
+int PlatformSyncFile(FILE* file)
+{
+	if (0 != fflush(file))
+		return -1;
+
+	return _commit(_fileno(file));
+}
+
+int PlatformTruncateFile(FILE* file, __int64 size)
+{
+	if (0 != fflush(file))
+		return -1;
+
+	return _chsize_s(_fileno(file), size);
+}
+
+const unsigned char* PlatformMapFile(const char* fileName, __int64* size)
+{
+	HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == file)
+		return NULL;
+
+	LARGE_INTEGER fileSize;
+	const unsigned char* view = NULL;
+
+	if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0 && (unsigned __int64)fileSize.QuadPart <= (SIZE_T)-1)
+	{
+		HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (NULL != mapping)
+		{
+			// The view keeps the mapping and the file open
+			view = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+		}
+	}
+
+	CloseHandle(file);
+
+	*size = NULL != view ? fileSize.QuadPart : 0;
+	return view;
+}
+
+void PlatformUnmapFile(const unsigned char* view, __int64 size)
+{
+	UnmapViewOfFile(view);
+}
+
+void PlatformDebugOutput(const wchar_t* message)
+{
+	OutputDebugString(message);
+}
+
+#else
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FILETIME_TICKS_AT_UNIX_EPOCH 116444736000000000LL
+
+struct PlatformThreadStart
+{
+	PlatformThreadProc ThreadProc;
+	void* Context;
+};
+
+static void* PlatformThreadEntry(void* arg)
+{
+	PlatformThreadStart start = *(PlatformThreadStart*)arg;
+	free(arg);
+
+	start.ThreadProc(start.Context);
+	return NULL;
+}
+
+HANDLE PlatformStartThread(PlatformThreadProc threadProc, void* context)
+{
+	PlatformThreadStart* start = (PlatformThreadStart*)malloc(sizeof(PlatformThreadStart));
+	start->ThreadProc = threadProc;
+	start->Context = context;
+
+	pthread_t* thread = (pthread_t*)malloc(sizeof(pthread_t));
+	if (0 != pthread_create(thread, NULL, PlatformThreadEntry, start))
+	{
+		free(start);
+		free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+void PlatformWaitForThread(HANDLE thread)
+{
+	if (NULL == thread)
+		return;
+
+	pthread_join(*(pthread_t*)thread, NULL);
+	free(thread);
+}
+
+void PlatformSleep(unsigned int milliseconds)
+{
+	struct timespec duration;
+	duration.tv_sec = milliseconds / 1000;
+	duration.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+
+	while (0 != nanosleep(&duration, &duration))
+		;
+}
+
+void PlatformYieldThread(void)
+{
+	sched_yield();
+}
+
+void PlatformSpinPause(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+unsigned long PlatformCurrentThreadId(void)
+{
+	return (unsigned long)pthread_self();
+}
+
+unsigned int PlatformNumberOfProcessors(void)
+{
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	return processors > 0 ? (unsigned int)processors : 1;
+}
+
+HANDLE PlatformCreateMutex(void)
+{
+	pthread_mutex_t* mutex = (pthread_mutex_t*)malloc(sizeof(pthread_mutex_t));
+	pthread_mutex_init(mutex, NULL);
+	return mutex;
+}
+
+void PlatformLockMutex(HANDLE mutex)
+{
+	pthread_mutex_lock((pthread_mutex_t*)mutex);
+}
+
+void PlatformUnlockMutex(HANDLE mutex)
+{
+	pthread_mutex_unlock((pthread_mutex_t*)mutex);
+}
+
+void PlatformDestroyMutex(HANDLE mutex)
+{
+	pthread_mutex_destroy((pthread_mutex_t*)mutex);
+	free(mutex);
+}
+
+struct PlatformEvent
+{
+	pthread_mutex_t Mutex;
+	pthread_cond_t Condition;
+	bool IsSet;
+};
+
+HANDLE PlatformCreateEvent(void)
+{
+	PlatformEvent* event = (PlatformEvent*)malloc(sizeof(PlatformEvent));
+	pthread_mutex_init(&event->Mutex, NULL);
+	pthread_cond_init(&event->Condition, NULL);
+	event->IsSet = false;
+	return event;
+}
+
+void PlatformSetEvent(HANDLE event)
+{
+	PlatformEvent* platformEvent = (PlatformEvent*)event;
+
+	pthread_mutex_lock(&platformEvent->Mutex);
+	platformEvent->IsSet = true;
+	pthread_cond_signal(&platformEvent->Condition);
+	pthread_mutex_unlock(&platformEvent->Mutex);
+}
+
+int PlatformWaitForEvent(HANDLE event, unsigned int milliseconds)
+{
+	PlatformEvent* platformEvent = (PlatformEvent*)event;
+
+	// The condition variable uses the real time clock, which is the only one all POSIX systems support
+	struct timespec deadline;
+	if (PLATFORM_WAIT_INFINITE != milliseconds)
+	{
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += milliseconds / 1000;
+		deadline.tv_nsec += (long)(milliseconds % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+	}
+
+	pthread_mutex_lock(&platformEvent->Mutex);
+
+	while (!platformEvent->IsSet)
+	{
+		if (PLATFORM_WAIT_INFINITE == milliseconds)
+			pthread_cond_wait(&platformEvent->Condition, &platformEvent->Mutex);
+		else if (0 != pthread_cond_timedwait(&platformEvent->Condition, &platformEvent->Mutex, &deadline))
+			break;
+	}
+
+	int isSet = platformEvent->IsSet ? 1 : 0;
+	platformEvent->IsSet = false;
+
+	pthread_mutex_unlock(&platformEvent->Mutex);
+	return isSet;
+}
+
+void PlatformDestroyEvent(HANDLE event)
+{
+	PlatformEvent* platformEvent = (PlatformEvent*)event;
+
+	pthread_cond_destroy(&platformEvent->Condition);
+	pthread_mutex_destroy(&platformEvent->Mutex);
+	free(platformEvent);
+}
+
+LONG PlatformCompareExchange(volatile LONG* destination, LONG exchange, LONG comparand)
+{
+	return __sync_val_compare_and_swap(destination, comparand, exchange);
+}
+
+LONG PlatformInterlockedIncrement(volatile LONG* destination)
+{
+	return __sync_add_and_fetch(destination, 1);
+}
+
+LONG PlatformInterlockedDecrement(volatile LONG* destination)
+{
+	return __sync_sub_and_fetch(destination, 1);
+}
+
+__int64 PlatformPerformanceCounter(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (__int64)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+__int64 PlatformPerformanceFrequency(void)
+{
+	return 1000000000LL;
+}
+
+void* PlatformAlignedAlloc(size_t size, size_t alignment)
+{
+	void* memory = NULL;
+	if (0 != posix_memalign(&memory, alignment, size))
+		return NULL;
+
+	return memory;
+}
+
+void PlatformAlignedFree(void* memory)
+{
+	free(memory);
+}
+
+int PlatformSyncFile(FILE* file)
+{
+	if (0 != fflush(file))
+		return -1;
+
+	return fsync(fileno(file));
+}
+
+int PlatformTruncateFile(FILE* file, __int64 size)
+{
+	if (0 != fflush(file))
+		return -1;
+
+	return ftruncate(fileno(file), (off_t)size);
+}
+
+const unsigned char* PlatformMapFile(const char* fileName, __int64* size)
+{
+	*size = 0;
+
+	int file = open(fileName, O_RDONLY);
+	if (file < 0)
+		return NULL;
+
+	struct stat fileStat;
+	void* view = MAP_FAILED;
+
+	if (0 == fstat(file, &fileStat) && fileStat.st_size > 0 && (unsigned long long)fileStat.st_size <= (size_t)-1)
+		view = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_SHARED, file, 0);
+
+	// The mapping keeps the file open
+	close(file);
+
+	if (MAP_FAILED == view)
+		return NULL;
+
+	*size = fileStat.st_size;
+	return (const unsigned char*)view;
+}
+
+void PlatformUnmapFile(const unsigned char* view, __int64 size)
+{
+	munmap((void*)view, (size_t)size);
+}
+
+void PlatformDebugOutput(const wchar_t* message)
+{
+	static int debugOutputEnabled = -1;
+	if (debugOutputEnabled < 0)
+		debugOutputEnabled = NULL != getenv("OCCUREC_DEBUG_OUTPUT") ? 1 : 0;
+
+	if (debugOutputEnabled == 0)
+		return;
+
+	// Converted, so the output can be mixed with the narrow output of the host on stderr
+	char narrowMessage[1024];
+	size_t length = wcstombs(narrowMessage, message, sizeof(narrowMessage) - 1);
+	if (length == (size_t)-1)
+		return;
+
+	narrowMessage[length] = 0;
+	fputs(narrowMessage, stderr);
+}
+
+void GetSystemTime(SYSTEMTIME* systemTime)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	struct tm utc;
+	gmtime_r(&now.tv_sec, &utc);
+
+	systemTime->wYear = (WORD)(utc.tm_year + 1900);
+	systemTime->wMonth = (WORD)(utc.tm_mon + 1);
+	systemTime->wDayOfWeek = (WORD)utc.tm_wday;
+	systemTime->wDay = (WORD)utc.tm_mday;
+	systemTime->wHour = (WORD)utc.tm_hour;
+	systemTime->wMinute = (WORD)utc.tm_min;
+	systemTime->wSecond = (WORD)utc.tm_sec;
+	systemTime->wMilliseconds = (WORD)(now.tv_nsec / 1000000);
+}
+
+BOOL SystemTimeToFileTime(const SYSTEMTIME* systemTime, FILETIME* fileTime)
+{
+	struct tm utc;
+	memset(&utc, 0, sizeof(utc));
+	utc.tm_year = systemTime->wYear - 1900;
+	utc.tm_mon = systemTime->wMonth - 1;
+	utc.tm_mday = systemTime->wDay;
+	utc.tm_hour = systemTime->wHour;
+	utc.tm_min = systemTime->wMinute;
+	utc.tm_sec = systemTime->wSecond;
+
+	unsigned long long ticks = (unsigned long long)((__int64)timegm(&utc) * 10000000LL + FILETIME_TICKS_AT_UNIX_EPOCH);
+	ticks += (unsigned long long)systemTime->wMilliseconds * 10000;
+
+	fileTime->dwLowDateTime = (DWORD)(ticks & 0xFFFFFFFF);
+	fileTime->dwHighDateTime = (DWORD)(ticks >> 32);
+	return TRUE;
+}
+
+#endif
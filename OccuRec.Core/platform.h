@@ -0,0 +1,197 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+// Threads, locks, sleep, timers and debug output of the core. The Windows build maps them to the
+// Win32 API and all other builds to POSIX. Non Windows builds also get the small subset of the Win32
+// types and helpers used by the core sources. This header can be included from C and C++
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include <stdio.h>
+
+#else
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+typedef int32_t HRESULT;
+typedef int BOOL;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef int64_t LONGLONG;
+typedef void* HANDLE;
+typedef void* LPVOID;
+typedef void* HMODULE;
+// The core always receives ANSI strings, also from the Unicode Windows build
+typedef const char* LPCTSTR;
+
+#define __int64 long long
+
+#define S_OK ((HRESULT)0L)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define E_POINTER ((HRESULT)0x80004003L)
+#define E_HANDLE ((HRESULT)0x80070006L)
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+
+#define TRUE 1
+#define FALSE 0
+#define MAX_PATH 260
+
+#define ZeroMemory(destination, length) memset((destination), 0, (length))
+#define CopyMemory(destination, source, length) memcpy((destination), (source), (length))
+#define RtlMoveMemory(destination, source, length) memmove((destination), (source), (length))
+
+#define _fseeki64 fseeko
+#define _ftelli64 ftello
+
+#ifdef __cplusplus
+// In place of the min() and max() macros of windows.h
+#include <algorithm>
+using std::min;
+using std::max;
+#endif
+
+typedef struct _SYSTEMTIME
+{
+	WORD wYear;
+	WORD wMonth;
+	WORD wDayOfWeek;
+	WORD wDay;
+	WORD wHour;
+	WORD wMinute;
+	WORD wSecond;
+	WORD wMilliseconds;
+} SYSTEMTIME;
+
+// 100ns intervals since 1 Jan 1601 (UTC)
+typedef struct _FILETIME
+{
+	DWORD dwLowDateTime;
+	DWORD dwHighDateTime;
+} FILETIME;
+
+typedef union _ULARGE_INTEGER
+{
+	struct
+	{
+		DWORD LowPart;
+		DWORD HighPart;
+	};
+	unsigned long long QuadPart;
+} ULARGE_INTEGER;
+
+// The in-memory bitmap returned by GetCurrentImage()
+#pragma pack(push, 2)
+typedef struct tagBITMAPFILEHEADER
+{
+	WORD bfType;
+	DWORD bfSize;
+	WORD bfReserved1;
+	WORD bfReserved2;
+	DWORD bfOffBits;
+} BITMAPFILEHEADER;
+#pragma pack(pop)
+
+typedef struct tagBITMAPINFOHEADER
+{
+	DWORD biSize;
+	LONG biWidth;
+	LONG biHeight;
+	WORD biPlanes;
+	WORD biBitCount;
+	DWORD biCompression;
+	DWORD biSizeImage;
+	LONG biXPelsPerMeter;
+	LONG biYPelsPerMeter;
+	DWORD biClrUsed;
+	DWORD biClrImportant;
+} BITMAPINFOHEADER;
+
+#define BI_RGB 0L
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void GetSystemTime(SYSTEMTIME* systemTime);
+BOOL SystemTimeToFileTime(const SYSTEMTIME* systemTime, FILETIME* fileTime);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _WIN32
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*PlatformThreadProc)(void* context);
+
+// Starts a new thread. The returned handle can be passed once to PlatformWaitForThread()
+HANDLE PlatformStartThread(PlatformThreadProc threadProc, void* context);
+void PlatformWaitForThread(HANDLE thread);
+void PlatformSleep(unsigned int milliseconds);
+void PlatformYieldThread(void);
+// A processor hint to be used in busy wait loops
+void PlatformSpinPause(void);
+unsigned long PlatformCurrentThreadId(void);
+unsigned int PlatformNumberOfProcessors(void);
+
+// Must not be locked recursively and must be released by the thread that holds it
+HANDLE PlatformCreateMutex(void);
+void PlatformLockMutex(HANDLE mutex);
+void PlatformUnlockMutex(HANDLE mutex);
+void PlatformDestroyMutex(HANDLE mutex);
+
+// Auto reset events, which wake one waiting thread and are then reset. An event set while no thread waits stays set
+// until the next wait, so a state change signalled just before the wait is not missed
+#define PLATFORM_WAIT_INFINITE 0xFFFFFFFF
+HANDLE PlatformCreateEvent(void);
+void PlatformSetEvent(HANDLE event);
+// Returns 1 when the event was set and 0 when the timeout in milliseconds passed first
+int PlatformWaitForEvent(HANDLE event, unsigned int milliseconds);
+void PlatformDestroyEvent(HANDLE event);
+
+// All return the new value of the destination, except PlatformCompareExchange() which returns the initial one
+LONG PlatformCompareExchange(volatile LONG* destination, LONG exchange, LONG comparand);
+LONG PlatformInterlockedIncrement(volatile LONG* destination);
+LONG PlatformInterlockedDecrement(volatile LONG* destination);
+
+// High resolution monotonic timer
+__int64 PlatformPerformanceCounter(void);
+__int64 PlatformPerformanceFrequency(void);
+
+// Memory aligned for fast disk writes and SIMD loads. Must be released with PlatformAlignedFree()
+void* PlatformAlignedAlloc(size_t size, size_t alignment);
+void PlatformAlignedFree(void* memory);
+
+// Writes the stdio buffers of the file and then the file cache of the OS to the disk
+int PlatformSyncFile(FILE* file);
+
+// Cuts the file at the given size, after writing its stdio buffers
+int PlatformTruncateFile(FILE* file, __int64 size);
+
+// Maps the whole file read only, also while it is still written by another file handle. Returns NULL if the file
+// is empty or cannot be mapped, e.g. when it is larger than the free address space of a 32 bit process
+const unsigned char* PlatformMapFile(const char* fileName, __int64* size);
+void PlatformUnmapFile(const unsigned char* view, __int64 size);
+
+// Sent to OutputDebugString() on Windows and to stderr elsewhere when OCCUREC_DEBUG_OUTPUT is set
+void PlatformDebugOutput(const wchar_t* message);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PLATFORM_H
@@ -9,7 +9,7 @@
 
 // 1.5.0 final
 
-#include "StdAfx.h"
+#include "stdafx.h"
 #include "quicklz.h"
 
 #if QLZ_VERSION_MAJOR != 1 || QLZ_VERSION_MINOR != 5 || QLZ_VERSION_REVISION != 0
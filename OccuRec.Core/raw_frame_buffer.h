@@ -9,12 +9,13 @@
 #include <list>
 #include "RawFrame.h";
 
-#include <windows.h>
+#include "platform.h"
 #include "SyncLock.h"
 
 using namespace std;
 
 list<RawFrame*> rawFrameBuffer;
+long rawFrameBufferHighWaterMark = 0;
 
 
 void ClearRawFrameBuffer()
@@ -41,6 +42,20 @@ long AddFrameToRawFrameBuffer(RawFrame* frameToAdd)
 	rawFrameBuffer.push_back(frameToAdd);
 	long numItems = rawFrameBuffer.size();
 
+	if (numItems > rawFrameBufferHighWaterMark)
+		rawFrameBufferHighWaterMark = numItems;
+
+	SyncLock::UnlockRawFrame();
+
+	return numItems;
+}
+
+long GetRawFrameBufferLength()
+{
+	SyncLock::LockRawFrame();
+
+	long numItems = rawFrameBuffer.size();
+
 	SyncLock::UnlockRawFrame();
 
 	return numItems;
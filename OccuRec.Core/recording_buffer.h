@@ -9,15 +9,17 @@
 #include <list>
 #include "IntegratedFrame.h";
 
-#include <windows.h>
-#include <process.h>
+#include "platform.h"
 #include "SyncLock.h"
 
 
 using namespace std;
 
-IntegratedFrame* recordingBuffer[1024];
+#define RECORDING_BUFFER_SIZE 1024
+
+IntegratedFrame* recordingBuffer[RECORDING_BUFFER_SIZE];
 long currentIndex = -1;
+long recordingBufferHighWaterMark = 0;
 
 
 void ClearRecordingBuffer()
@@ -35,14 +37,35 @@ void ClearRecordingBuffer()
 	SyncLock::UnlockVideo();
 }
 
+// Returns the number of buffered frames or -1 if the buffer is full and the frame was not added
 long AddFrameToRecordingBuffer(IntegratedFrame* frameToAdd)
 {
 	SyncLock::LockVideo();
 
+	if (currentIndex + 1 >= RECORDING_BUFFER_SIZE)
+	{
+		SyncLock::UnlockVideo();
+		return -1;
+	}
+
 	currentIndex++;
 	recordingBuffer[currentIndex] = frameToAdd;
 	long numItems = currentIndex + 1;
 
+	if (numItems > recordingBufferHighWaterMark)
+		recordingBufferHighWaterMark = numItems;
+
+	SyncLock::UnlockVideo();
+
+	return numItems;
+}
+
+long GetRecordingBufferLength()
+{
+	SyncLock::LockVideo();
+
+	long numItems = currentIndex + 1;
+
 	SyncLock::UnlockVideo();
 
 	return numItems;
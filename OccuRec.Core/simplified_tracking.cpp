@@ -488,6 +488,8 @@ long SimplifiedTracker::TrackerGetTargetState(long objectId, NativeTrackedObject
 		
 		psfFit->CopyResiduals(residuals, psfInfo->MatrixSize);
 	}
+
+	return S_OK;
 }
 
 
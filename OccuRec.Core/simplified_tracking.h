@@ -5,24 +5,7 @@
 #pragma once
 
 #include "psf_fit.h"
-
-struct NativePsfFitInfo
-{	
-	float XCenter;
-	float YCenter;
-	float FWHM;
-	float IMax;
-	float I0;
-	float X0;
-	float Y0;
-	unsigned char MatrixSize;
-	unsigned char IsSolved;
-
-	unsigned char IsAsymmetric;
-	unsigned char Reserved;
-	float R0;
-	float R02;	
-};
+#include "OccuRec.Core.Api.h"
 
 struct NativeTrackedObjectInfo
 {
@@ -106,13 +89,8 @@ public:
 	bool IsTrackedSuccessfully();
 };
 
-HRESULT TrackerSettings(double maxElongation, double minFWHM, double maxFWHM, double minCertainty, double minGuidingStarCertainty);
-HRESULT TrackerNewConfiguration(long width, long height, long numTrackedObjects, bool isFullDisappearance);
-HRESULT TrackerConfigureObject(long objectId, bool isFixedAperture, bool isOccultedStar, double startingX, double startingY, double apertureInPixels);
-HRESULT TrackerNextFrame(long frameId, unsigned long* pixels);
 HRESULT TrackerNextFrame_int8(long frameId, unsigned char* pixels);
 HRESULT TrackerGetTargetState(long objectId, NativeTrackedObjectInfo* trackingInfo, NativePsfFitInfo* psfInfo, double* residuals);
-HRESULT TrackerInitialiseNewTracking();
 
 float MeasureObjectUsingAperturePhotometry(
 	unsigned long* data, float aperture, 
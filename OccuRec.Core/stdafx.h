@@ -10,6 +10,8 @@
 
 #pragma once
 
+#ifdef _WIN32
+
 #include "targetver.h"
 
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
@@ -20,7 +22,11 @@
 #define _WIN32_WINNT 0x0501	// Change this to the appropriate value to target other versions of Windows.
 #endif	
 
+#include <tchar.h>
+
+#endif
+
 // TODO: reference additional headers your program requires here
 #include <stdio.h>
-#include <tchar.h>
+#include "platform.h"
 
@@ -2,8 +2,9 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
-#include "StdAfx.h"
+#include "stdafx.h"
 #include "utils.h"
+#include <stdarg.h>
 
 
 void WriteString(FILE* pFile, const char* str)
@@ -118,6 +119,6 @@ void DebugViewPrint(const wchar_t* formatText, ...)
     va_start(args, formatText);
 	vswprintf(debug512CharBuffer, 512, formatText, args);
     
-	OutputDebugString(debug512CharBuffer);
+	PlatformDebugOutput(debug512CharBuffer);
 	va_end(args);
 }
\ No newline at end of file
@@ -41,7 +41,10 @@ enum ImageBytesLayout
 {
 	FullImageRaw = 0,
 	FullImageDiffCorrWithSigns = 1,
-	FullImageDiffCorrNoSigns = 2
+	FullImageDiffCorrNoSigns = 2,
+	FullImageBitPacked = 3,
+	FullImageTiled = 4,
+	RegionsOfInterest = 5
 };
 
 void crc32_init(void);
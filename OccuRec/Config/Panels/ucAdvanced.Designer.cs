@@ -257,7 +257,9 @@ private void InitializeComponent()
 			this.cbxAdvCompression.FormattingEnabled = true;
 			this.cbxAdvCompression.Items.AddRange(new object[] {
             "QuickLZ",
-            "Lagarith16"});
+            "Lagarith16",
+            "LocoI",
+            "Lagarith8"});
 			this.cbxAdvCompression.Location = new System.Drawing.Point(164, 138);
 			this.cbxAdvCompression.Name = "cbxAdvCompression";
 			this.cbxAdvCompression.Size = new System.Drawing.Size(170, 21);
@@ -46,6 +46,8 @@ public override void LoadSettings()
 			cbxAdvCompression.Items.Clear();
 			cbxAdvCompression.Items.Add(AavCompression.QuickLZ);
 			cbxAdvCompression.Items.Add(AavCompression.Lagarith16);
+			cbxAdvCompression.Items.Add(AavCompression.LocoI);
+			cbxAdvCompression.Items.Add(AavCompression.Lagarith8);
 
 			cbxImageLayoutMode.SelectedIndex = cbxImageLayoutMode.Items.IndexOf(Settings.Default.AavImageLayout);
 			cbxAdvCompression.SelectedIndex = cbxAdvCompression.Items.IndexOf(Settings.Default.AavCompression);
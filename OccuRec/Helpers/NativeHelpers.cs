@@ -39,7 +39,9 @@ public enum AavImageLayout
 	public enum AavCompression
 	{
 		QuickLZ,
-		Lagarith16
+		Lagarith16,
+		LocoI,
+		Lagarith8
 	}
 
 	public enum DenoiseMode
@@ -34,6 +34,9 @@ public class AdvFile
 
     	private bool m_IsCorrupted;
 
+		// The last frame whose status was decoded, which the next delta encoded status is relative to
+		private int m_LastStatusFrameNo = -1;
+
 
 		private AdvFile()
 		{ }
@@ -156,13 +159,9 @@ public void GetFrameImageSectionHeader(int frameNo, out byte layoutId, out AdvIm
 
     	public object[] GetFrameSectionData(int frameNo, ushort[,] prevFrame)
         {
-            AdvFramesIndexEntry idxEntry = m_Index.Index[frameNo];
-            m_InputFile.Seek(idxEntry.Offset, SeekOrigin.Begin);
+			PrepareStatusSection(frameNo);
 
-			uint frameDataMagic = m_FileReader.ReadUInt32();
-			Trace.Assert(frameDataMagic == 0xEE0122FF);
-            
-            byte[] data = m_FileReader.ReadBytes((int)idxEntry.Length);
+			byte[] data = ReadFrameData(frameNo);
 
 			// Read the timestamp and exposure 
 			long frameTimeMsSince2010 =
@@ -182,6 +181,8 @@ public object[] GetFrameSectionData(int frameNo, ushort[,] prevFrame)
 				dataOffset += sectionDataLength + 4;
             }
 
+			m_LastStatusFrameNo = frameNo;
+
 			// ADV Format Specification v1.5 (and later), the time stamp is the MIDDLE of the exposure (this changed from spec v1.4 where it was the START) of the exposure
 			try
 			{
@@ -197,6 +198,68 @@ public object[] GetFrameSectionData(int frameNo, ushort[,] prevFrame)
             return sectionObjects.ToArray();
         }
 
+		private byte[] ReadFrameData(int frameNo)
+		{
+			AdvFramesIndexEntry idxEntry = m_Index.Index[frameNo];
+			m_InputFile.Seek(idxEntry.Offset, SeekOrigin.Begin);
+
+			uint frameDataMagic = m_FileReader.ReadUInt32();
+			Trace.Assert(frameDataMagic == 0xEE0122FF);
+
+			return m_FileReader.ReadBytes((int)idxEntry.Length);
+		}
+
+		private int GetStatusSectionOffset(byte[] data, out int sectionDataLength)
+		{
+			int dataOffset = 12;
+			foreach (IAdvDataSection section in m_Sections)
+			{
+				sectionDataLength = data[dataOffset] + (data[dataOffset + 1] << 8) + (data[dataOffset + 2] << 16) + (data[dataOffset + 3] << 24);
+
+				if (section.SectionType == AdvSectionTypes.SECTION_SYSTEM_STATUS)
+					return dataOffset + 4;
+
+				dataOffset += sectionDataLength + 4;
+			}
+
+			sectionDataLength = 0;
+			return -1;
+		}
+
+		// A delta encoded status only holds the tags which changed since the previous frame, so when the frames are not read in
+		// order the statuses from the last key frame before the frame are decoded first
+		private void PrepareStatusSection(int frameNo)
+		{
+			AdvStatusSection statusSection = StatusSection;
+			if (statusSection == null || !statusSection.IsDeltaEncoded || m_LastStatusFrameNo == frameNo - 1)
+				return;
+
+			int keyFrameNo = frameNo;
+			while (keyFrameNo > 0)
+			{
+				int sectionDataLength;
+				byte[] data = ReadFrameData(keyFrameNo);
+				int statusOffset = GetStatusSectionOffset(data, out sectionDataLength);
+
+				if (statusOffset >= 0 && sectionDataLength > 0 && data[statusOffset] == AdvStatusSection.STATUS_KEY_FRAME)
+					break;
+
+				keyFrameNo--;
+			}
+
+			for (int i = keyFrameNo; i < frameNo; i++)
+			{
+				int sectionDataLength;
+				byte[] data = ReadFrameData(i);
+				int statusOffset = GetStatusSectionOffset(data, out sectionDataLength);
+
+				if (statusOffset >= 0)
+					statusSection.GetDataFromDataBytes(data, null, sectionDataLength, statusOffset);
+			}
+
+			m_LastStatusFrameNo = frameNo - 1;
+		}
+
         public void AddDataSection(IAdvDataSection section)
         {
             m_Sections.Add(section);
@@ -39,7 +39,25 @@ public class AdvTagDefinition
     }
 
     public class AdvStatusSection : IAdvDataSection
-    {      
+    {
+		// The first byte of a frame in version 2
+		public const byte STATUS_KEY_FRAME = 0;
+		public const byte STATUS_DELTA_FRAME = 1;
+
+		// How the value of a tag in a delta frame is written
+		private const byte STATUS_ENTRY_VALUE = 0;
+		private const byte STATUS_ENTRY_DELTA = 1;
+		private const byte STATUS_ENTRY_PREFIX = 2;
+		private const byte STATUS_ENTRY_NOT_SET = 3;
+
+		private byte m_Version = 1;
+
+		// The tags decoded from the previous frame, which the delta frames of version 2 are relative to
+		private bool[] m_TagIsSet;
+		private ulong[] m_TagValues;
+		private long[] m_TagSteps;
+		private string[] m_TagStrings;
+
         public AdvStatusSection()
         { }
 
@@ -60,9 +78,19 @@ public List<AdvTagDefinition> TagDefinitions
     		get { return m_TagDefinitions; }
     	}
 
+		/// <summary>
+		/// Version 2 only writes the tags which changed since the previous frame, so the frames must be decoded in
+		/// order from the last key frame before them
+		/// </summary>
+		public bool IsDeltaEncoded
+		{
+			get { return m_Version >= 2; }
+		}
+
         public AdvStatusSection(BinaryReader reader)
         {
 		    byte version = reader.ReadByte();
+			m_Version = version;
 
             if (version >= 1)
             {
@@ -76,10 +104,18 @@ public AdvStatusSection(BinaryReader reader)
                     m_TagDefinitions.Add(new AdvTagDefinition() { Name = tagName, Type = tagType} );
                 }
             }
+
+			m_TagIsSet = new bool[m_TagDefinitions.Count];
+			m_TagValues = new ulong[m_TagDefinitions.Count];
+			m_TagSteps = new long[m_TagDefinitions.Count];
+			m_TagStrings = new string[m_TagDefinitions.Count];
         }
 
 		public object GetDataFromDataBytes(byte[] bytes, ushort[,] prevFrame, int size, int startIndex)
 		{
+			if (IsDeltaEncoded)
+				return GetDataFromDeltaBytes(bytes, size, startIndex);
+
 			var rv = new AdvStatusData();
 
 			if (size > 0)
@@ -188,6 +224,168 @@ public object GetDataFromDataBytes(byte[] bytes, ushort[,] prevFrame, int size,
 		
             return rv;
         }
+
+		private object GetDataFromDeltaBytes(byte[] bytes, int size, int startIndex)
+		{
+			var rv = new AdvStatusData();
+
+			if (size == 0)
+				return rv;
+
+			bool keyFrame = bytes[startIndex] == STATUS_KEY_FRAME;
+			byte tagValuesCount = bytes[startIndex + 1];
+			startIndex += 2;
+
+			int tagsCount = m_TagDefinitions.Count;
+			var prevValues = (ulong[])m_TagValues.Clone();
+			var wasSet = (bool[])m_TagIsSet.Clone();
+			var isListed = new bool[tagsCount];
+			var messages = new Dictionary<int, string>();
+
+			// A key frame holds all tags which are set
+			if (keyFrame)
+			{
+				for (int i = 0; i < tagsCount; i++)
+					m_TagIsSet[i] = false;
+			}
+
+			for (int i = 0; i < tagValuesCount; i++)
+			{
+				int tagId = bytes[startIndex];
+				AdvTagType tagType = m_TagDefinitions[tagId].Type;
+				byte entry = STATUS_ENTRY_VALUE;
+
+				if (keyFrame)
+					startIndex++;
+				else
+				{
+					entry = bytes[startIndex + 1];
+					startIndex += 2;
+				}
+
+				isListed[tagId] = true;
+				m_TagIsSet[tagId] = entry != STATUS_ENTRY_NOT_SET;
+
+				if (entry == STATUS_ENTRY_NOT_SET)
+					continue;
+				else if (entry == STATUS_ENTRY_DELTA)
+				{
+					// A zigzag varint of the difference from the value predicted by the step of the previous frame
+					ulong zigzag = 0;
+					int shift = 0;
+					byte b;
+					do
+					{
+						b = bytes[startIndex];
+						zigzag |= (ulong)(b & 0x7F) << shift;
+						shift += 7;
+						startIndex++;
+					}
+					while ((b & 0x80) != 0);
+
+					long delta = (long)(zigzag >> 1) ^ -(long)(zigzag & 1);
+					m_TagValues[tagId] = unchecked(prevValues[tagId] + (ulong)m_TagSteps[tagId] + (ulong)delta);
+				}
+				else if (entry == STATUS_ENTRY_PREFIX)
+				{
+					byte prefixLen = bytes[startIndex];
+					byte suffixLen = bytes[startIndex + 1];
+					m_TagStrings[tagId] = m_TagStrings[tagId].Substring(0, prefixLen) + Encoding.ASCII.GetString(bytes, startIndex + 2, suffixLen);
+
+					startIndex += 2 + suffixLen;
+				}
+				else if (tagType == AdvTagType.AnsiString254)
+				{
+					byte len = bytes[startIndex];
+					m_TagStrings[tagId] = Encoding.ASCII.GetString(bytes, startIndex + 1, len);
+
+					startIndex += 1 + len;
+				}
+				else if (tagType == AdvTagType.List16AnsiString254)
+				{
+					StringBuilder bld = new StringBuilder();
+					byte count = bytes[startIndex];
+					startIndex++;
+					for (int j = 0; j < count; j++)
+					{
+						byte len = bytes[startIndex];
+						bld.AppendLine(Encoding.ASCII.GetString(bytes, startIndex + 1, len));
+
+						startIndex += 1 + len;
+					}
+
+					messages[tagId] = bld.ToString();
+				}
+				else
+				{
+					int valueBytes = tagType == AdvTagType.UInt8 ? 1 : (tagType == AdvTagType.UInt16 ? 2 : (tagType == AdvTagType.ULong64 ? 8 : 4));
+					ulong value = 0;
+					for (int j = 0; j < valueBytes; j++)
+						value |= (ulong)bytes[startIndex + j] << (8 * j);
+
+					m_TagValues[tagId] = value;
+					startIndex += valueBytes;
+				}
+			}
+
+			for (int tagId = 0; tagId < tagsCount; tagId++)
+			{
+				AdvTagDefinition tagDef = m_TagDefinitions[tagId];
+
+				if (tagDef.Type == AdvTagType.List16AnsiString254)
+				{
+					// The messages are not carried over from the previous frame
+					string tagMessages;
+					if (messages.TryGetValue(tagId, out tagMessages))
+						rv.TagValues[tagDef] = tagMessages;
+
+					m_TagIsSet[tagId] = false;
+					continue;
+				}
+
+				if (tagDef.Type == AdvTagType.ULong64)
+				{
+					// The ULong64 tags which are not written kept the step they had in the previous frame
+					if (!keyFrame && !isListed[tagId] && m_TagIsSet[tagId])
+						m_TagValues[tagId] = unchecked(prevValues[tagId] + (ulong)m_TagSteps[tagId]);
+
+					m_TagSteps[tagId] = !keyFrame && m_TagIsSet[tagId] && wasSet[tagId] ? unchecked((long)(m_TagValues[tagId] - prevValues[tagId])) : 0;
+				}
+
+				if (m_TagIsSet[tagId])
+					rv.TagValues[tagDef] = FormatTagValue(tagDef.Type, tagId);
+			}
+
+			return rv;
+		}
+
+		private string FormatTagValue(AdvTagType tagType, int tagId)
+		{
+			ulong value = m_TagValues[tagId];
+
+			switch (tagType)
+			{
+				case AdvTagType.UInt8:
+					return ((byte)value).ToString();
+
+				case AdvTagType.UInt16:
+					return ((ushort)value).ToString();
+
+				case AdvTagType.UInt32:
+					return ((uint)value).ToString();
+
+				case AdvTagType.ULong64:
+					return ((long)value).ToString();
+
+				case AdvTagType.Real:
+					IntToFloatStruct converter = new IntToFloatStruct();
+					converter.UInt32Value = (uint)value;
+					return converter.RealValue.ToString();
+
+				default:
+					return m_TagStrings[tagId];
+			}
+		}
     }
 
 	internal class AdvStatusData
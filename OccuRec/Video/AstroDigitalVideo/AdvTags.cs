@@ -55,6 +55,8 @@ public static class AdvCompressionMethods
 		public static string COMPR_DIFF_CORR_HUFFMAN = "HUFFMAN";
 		public static string COMPR_DIFF_CORR_QUICKLZ = "QUICKLZ";
 		public static string COMPR_LAGARITH16 = "LAGARITH16";
+		public static string COMPR_LOCOI = "LOCO-I";
+		public static string COMPR_LAGARITH8 = "LAGARITH8";
 	}
 
 	public static class AdvRedundancyCheck